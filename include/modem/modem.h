@@ -22,6 +22,31 @@ int modem_init(const char* socket_path);
 /** deinitialize library */
 void modem_cleanup(void);
 
+/**
+ * @brief return statistics of daemon
+ * @param stats buffer for statistics
+ * @return zero, if successful
+ */
+int modemd_stats(modemd_stats_t* stats);
+
+/**
+ * @brief return statistics of RPC functions called on daemon
+ * @param stats pointer to array of functions which were called
+ * @return number of functions, -1 if failed
+ *
+ * Array must be freed by free()
+ */
+int modemd_func_stats(modemd_func_stats_t** stats);
+
+/**
+ * @brief return statistics of timers of background work of modems
+ * @param stats pointer to array of timers
+ * @return number of timers, -1 if failed
+ *
+ * Array must be freed by free()
+ */
+int modemd_sched_stats(modemd_sched_stats_t** stats);
+
 /**
  * @brief return first modem
  * @return pointer to modem_info_t, zero if no modem detected
@@ -49,10 +74,31 @@ void modem_find_close(modem_find_t* find);
  * @param port port name (bus-devpath)
  * @return modem handle 
  *
- * Modem handle must be closed by modem_close()
+ * Opening of modem by daemon is waited for. Modem handle must be closed
+ * by modem_close()
  */
 modem_t* modem_open_by_port(const char* port);
 
+/**
+ * @brief open modem by port and return handle at once
+ * @param port port name (bus-devpath)
+ * @return modem handle
+ *
+ * Device, driver and queues are prepared by daemon in background, functions
+ * of modem fail until modem_get_init_state() returns MODEM_INIT_READY, its
+ * changes are pushed by MODEM_EVENT_INIT. Modem handle must be closed by
+ * modem_close()
+ */
+modem_t* modem_open_by_port_nowait(const char* port);
+
+/**
+ * @brief return state of opening of modem
+ * @param modem handle
+ * @param wait_ms maximal time of waiting for the end of opening, zero to not wait
+ * @return MODEM_INIT_*, MODEM_INIT_FAILED if failed
+ */
+modem_init_state_t modem_get_init_state(modem_t* modem, uint32_t wait_ms);
+
 /**
  * @brief close modem handle
  * @param modem handle
@@ -70,6 +116,57 @@ usb_device_info_t* modem_get_info(modem_t* modem, usb_device_info_t *mi);
  */
 int modem_get_last_error(modem_t* modem);
 
+/**
+ * @brief return statistics of states of registration routine
+ * @param modem handle
+ * @param stats pointer to array of entered states
+ * @return number of states, -1 if failed
+ *
+ * Array must be freed by free()
+ */
+int modem_get_reg_stats(modem_t* modem, modem_reg_state_stats_t** stats);
+
+/**
+ * @brief return statistics of adaptive polling of values
+ * @param modem handle
+ * @param stats pointer to array of polled values
+ * @return number of values, -1 if failed
+ *
+ * Array must be freed by free()
+ */
+int modem_get_poll_stats(modem_t* modem, modem_poll_stats_t** stats);
+
+/**
+ * @brief return timeline of last registration cycles
+ * @param modem handle
+ * @param timeline pointer to array of transitions, oldest cycle first
+ * @return number of transitions, -1 if failed
+ *
+ * Cycle is started by opening of modem, by reset and by loss of registration.
+ * Array must be freed by free()
+ */
+int modem_get_reg_timeline(modem_t* modem, modem_reg_timeline_t** timeline);
+
+/**
+ * @brief return last retry decisions of registration routine
+ * @param modem handle
+ * @param trace pointer to array of decisions, oldest first
+ * @return number of decisions, -1 if failed
+ *
+ * Array must be freed by free()
+ */
+int modem_get_reg_retries(modem_t* modem, modem_reg_retry_t** trace);
+
+/**
+ * @brief return statistics of probes and steps of recovery of watchdog
+ * @param modem handle
+ * @param stats pointer to array of probes followed by steps
+ * @return number of probes and steps, -1 if failed
+ *
+ * Array must be freed by free()
+ */
+int modem_get_watchdog_stats(modem_t* modem, modem_watchdog_stats_t** stats);
+
 /**
  * @brief return last registration error on modem
  * @param modem handle
@@ -147,6 +244,74 @@ int modem_operator_scan(modem_t* modem, modem_oper_t** opers);
  */
 int modem_get_cell_id(modem_t* modem);
 
+/**
+ * @brief return all cached values of modem by one call
+ * @param modem modem handle
+ * @param status output buffer
+ * @return pointer to status, if successful
+ *
+ * Check status->version before use of fields added in later versions
+ */
+modem_status_t* modem_get_status(modem_t* modem, modem_status_t* status);
+
+/** status page of modem in shared memory */
+typedef struct modem_status_page_s modem_status_page_t;
+
+/**
+ * @brief map status page of modem published by the daemon
+ * @param port modem port, for example 1-1
+ * @return page, NULL if modem is not opened by the daemon
+ *
+ * Page is valid while the modem is opened by somebody. Connection to the
+ * daemon is not required. Page must be closed by modem_status_page_close()
+ */
+modem_status_page_t* modem_status_page_open(const char* port);
+
+/**
+ * @brief read consistent status from page without syscalls
+ * @param page page
+ * @param status output buffer
+ * @return pointer to status, NULL if page is not ready yet
+ */
+modem_status_t* modem_status_page_read(modem_status_page_t* page, modem_status_t* status);
+
+/**
+ * @brief unmap status page
+ * @param page page
+ */
+void modem_status_page_close(modem_status_page_t* page);
+
+/** handler of changes of modem state */
+typedef void (*modem_event_func_t)(modem_t* modem, const modem_event_t* event, void* prm);
+
+/**
+ * @brief subscribe to changes of modem state pushed by daemon
+ * @param modem modem handle
+ * @param mask events MODEM_EVENT_*, zero to unsubscribe
+ * @param interval minimal interval between notifications in ms
+ * @param func handler of changes
+ * @param prm parameter of handler
+ * @return zero if successful
+ *
+ * Handler is called in a separate thread with all subscribed values right
+ * after subscription and later only with changed values, see event->mask.
+ */
+int modem_subscribe(modem_t* modem, uint32_t mask, uint32_t interval, modem_event_func_t func, void* prm);
+
+/**
+ * @brief enable cache of read-only getters of modem
+ * @param modem modem handle
+ * @param enable non zero to enable, zero to disable and drop cached values
+ * @return zero if successful
+ *
+ * Results of modem_get_signal_quality(), modem_network_registration(),
+ * modem_get_operator_name(), modem_get_network_type() are kept for the
+ * refresh period of the daemon, identity of modem and SIM for minutes. The
+ * daemon drops them earlier by notifications, so interval of subscription
+ * delays drops. Must not be called simultaneously with other calls of modem.
+ */
+int modem_cache(modem_t* modem, int enable);
+
 int modem_set_default_profile(modem_data_profile_t* profile);
 
 /**
@@ -0,0 +1,139 @@
+#ifndef __MODEM_ASYNC_H
+#define __MODEM_ASYNC_H
+
+#include <stdint.h>
+
+#include <modem/types.h>
+
+/***************************************************************************
+ * asynchronous client for event-driven programs                           *
+ **************************************************************************/
+
+/*
+
+	Connection of asynchronous client is independent of modem_init(). Its
+	descriptor is added to poll/epoll loop of the caller:
+
+		fd = modem_async_fd(async);
+
+		poll for modem_async_events(async), then modem_async_process(async)
+
+	Calls return immediately, handlers are called from modem_async_process()
+	in order of responses, which may differ from order of calls. Modems are
+	opened by modem_async_open_by_port() and can't be used with synchronous
+	functions.
+
+*/
+
+typedef struct modem_async_s modem_async_t;
+
+/**
+ * @brief handler of completed call
+ * @param modem modem of call, opened modem for modem_async_open_by_port()
+ * @param res result, NULL if failed
+ * @param len length of result in bytes
+ * @param prm parameter of call
+ *
+ * Result is valid until return of handler. Handler may make new calls.
+ */
+typedef void (*modem_async_func_t)(modem_t* modem, const void* res, uint32_t len, void* prm);
+
+/**
+ * @brief connect to the server
+ * @param socket_path path to the local socket
+ * @return client, NULL if failed or server is too old
+ *
+ * Only negotiation of protocol waits for the server. Client must be closed
+ * by modem_async_cleanup()
+ */
+modem_async_t* modem_async_init(const char* socket_path);
+
+/**
+ * @brief close connection, handlers of pending calls are called with NULL
+ * @param async client
+ */
+void modem_async_cleanup(modem_async_t* async);
+
+/**
+ * @brief descriptor of connection for poll/epoll loop
+ * @param async client
+ * @return descriptor
+ */
+int modem_async_fd(modem_async_t* async);
+
+/**
+ * @brief events to wait for on descriptor
+ * @param async client
+ * @return POLLIN, with POLLOUT while queries are waiting for the socket
+ */
+int modem_async_events(modem_async_t* async);
+
+/**
+ * @brief send queued queries and handle received responses without blocking
+ * @param async client
+ * @return number of pending calls, -1 if connection is broken
+ *
+ * On broken connection handlers of pending calls are called with NULL.
+ */
+int modem_async_process(modem_async_t* async);
+
+/**
+ * @brief open modem by port
+ * @param async client
+ * @param port port name (bus-devpath)
+ * @param func handler, modem is NULL if failed
+ * @param prm parameter of handler
+ * @return zero if call is queued
+ *
+ * Modem is returned while it is opened by daemon in background, see
+ * modem_async_get_init_state(). Modem must be closed by modem_async_close()
+ */
+int modem_async_open_by_port(modem_async_t* async, const char* port, modem_async_func_t func, void* prm);
+
+/**
+ * @brief close modem, response is not waited for
+ * @param async client
+ * @param modem modem
+ *
+ * Pending calls of modem are completed with the modem, it is freed after
+ * the last of them. Modem must not be used by new calls.
+ */
+void modem_async_close(modem_async_t* async, modem_t* modem);
+
+/** result is usb_device_info_t */
+int modem_async_get_info(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is zero terminated string */
+int modem_async_get_imei(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is zero terminated string */
+int modem_async_get_imsi(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is zero terminated string */
+int modem_async_get_operator_name(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is zero terminated string */
+int modem_async_get_network_type(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is modem_signal_quality_t */
+int modem_async_get_signal_quality(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is modem_network_reg_t */
+int modem_async_network_registration(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is modem_status_t */
+int modem_async_get_status(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is modem_init_state_t, NULL from daemon returning only opened modems */
+int modem_async_get_init_state(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+/** result is reply of modem, zero terminated string */
+int modem_async_at_command(modem_async_t* async, modem_t* modem, const char* query, modem_async_func_t func, void* prm);
+
+/** result is reply of network, zero terminated string */
+int modem_async_ussd_cmd(modem_async_t* async, modem_t* modem, const char* query, modem_async_func_t func, void* prm);
+
+/** result is array of modem_oper_t */
+int modem_async_operator_scan(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm);
+
+#endif /* __MODEM_ASYNC_H */
@@ -184,6 +184,23 @@ typedef struct
 
 /*------------------------------------------------------------------------*/
 
+/** fields of modem status snapshot having own age */
+typedef enum
+{
+	MODEM_STATUS_REG = 0,
+	MODEM_STATUS_SQ,
+	MODEM_STATUS_OPER,
+	MODEM_STATUS_NETWORK_TYPE,
+	MODEM_STATUS_FW_INFO,
+	MODEM_STATUS_IMEI,
+	MODEM_STATUS_IMSI,
+	MODEM_STATUS_CCID,
+
+	MODEM_STATUS_FIELDS
+} modem_status_field_t;
+
+/*------------------------------------------------------------------------*/
+
 struct cached_s
 {
 	/* cached values, update per 10 seconds */
@@ -213,6 +230,14 @@ struct cached_s
 	char mcc[4];
 
 	char mnc[4];
+
+	/* values refreshed only while subscribed */
+
+	modem_state_wwan_t state_wwan;
+
+	/* monotonic time of last update in ms, zero if never updated */
+
+	uint64_t updated[MODEM_STATUS_FIELDS];
 };
 
 /*------------------------------------------------------------------------*/
@@ -228,12 +253,33 @@ typedef struct modem_queues_s
 
 /*------------------------------------------------------------------------*/
 
+/** state of opening of modem by daemon */
+typedef enum
+{
+	/** device and driver are looked for in background */
+	MODEM_INIT_PENDING = 0,
+
+	/** device is missing, port is powered on and device is waited for */
+	MODEM_INIT_WAIT_DEVICE,
+
+	/** modem is ready, registration routine is started */
+	MODEM_INIT_READY,
+
+	/** device or driver is missing, modem can be only closed */
+	MODEM_INIT_FAILED
+} __attribute__((__packed__)) modem_init_state_t;
+
+/*------------------------------------------------------------------------*/
+
 typedef struct
 {
 	int refs;
 
 	char port[0x100];
 
+	/** state of opening, functions fail until MODEM_INIT_READY */
+	modem_init_state_t init;
+
 	modem_queues_t* queues;
 
 	usb_device_info_t usb;
@@ -242,10 +288,6 @@ typedef struct
 
 	struct
 	{
-		pthread_t thread;
-
-		int terminate;
-
 		int ready;
 
 		int last_error;
@@ -270,6 +312,315 @@ typedef struct
 
 /*------------------------------------------------------------------------*/
 
+typedef struct
+{
+	/** number of worker threads */
+	uint32_t threads;
+
+	/** workers executing a request */
+	uint32_t busy;
+
+	/** requests waiting for worker */
+	uint32_t queued;
+
+	/** maximum of waiting requests */
+	uint32_t queued_max;
+
+	/** executed requests */
+	uint64_t done;
+
+	/** requests rejected on full queue */
+	uint64_t rejected;
+} __attribute__((__packed__)) modemd_pool_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** opened client connections */
+	uint32_t connections;
+
+	/** maximum of opened client connections */
+	uint32_t connections_max;
+
+	/** accepted client connections */
+	uint64_t accepted;
+
+	/** pool for fast requests */
+	modemd_pool_stats_t pool;
+
+	/** pool for slow requests (scan, USSD, AT commands..) */
+	modemd_pool_stats_t pool_slow;
+} __attribute__((__packed__)) modemd_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+/** buckets of latency histogram, bucket i counts calls shorter than 2^i us,
+the last one counts the rest */
+#define MODEMD_FUNC_HIST 24
+
+typedef struct
+{
+	/** number of calls */
+	uint64_t calls;
+
+	/** total time of handlers in microseconds */
+	uint64_t time_us;
+
+	/** maximal time of handler in microseconds */
+	uint32_t time_max_us;
+
+	/** latency histogram */
+	uint32_t hist[MODEMD_FUNC_HIST];
+} __attribute__((__packed__)) modemd_func_time_t;
+
+typedef struct
+{
+	/** name of function */
+	char name[0x40];
+
+	/** calls with result */
+	modemd_func_time_t ok;
+
+	/** calls with NULL result */
+	modemd_func_time_t null;
+} __attribute__((__packed__)) modemd_func_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** port of modem */
+	char port[0x40];
+
+	/** name of timer */
+	char name[0x10];
+
+	/** time until deadline in ms, negative if late, INT64_MAX if not armed */
+	int64_t next_ms;
+
+	/** executed callbacks */
+	uint64_t runs;
+
+	/** lateness of callbacks against deadline in microseconds */
+	uint32_t late_last_us;
+	uint32_t late_avg_us;
+	uint32_t late_max_us;
+
+	/** maximal time of callback in microseconds */
+	uint32_t run_max_us;
+} __attribute__((__packed__)) modemd_sched_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** name of state of registration routine */
+	char name[0x20];
+
+	/** entries to state */
+	uint32_t entries;
+
+	/** total time in state in milliseconds */
+	uint64_t dwell_ms;
+
+	/** maximal time of one stay in state in milliseconds */
+	uint32_t dwell_max_ms;
+
+	/** routine is in this state now */
+	uint8_t current;
+} __attribute__((__packed__)) modem_reg_state_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** number of registration cycle since start of routine */
+	uint32_t cycle;
+
+	/** name of entered state, REGISTERED or FAILED at the end of cycle */
+	char name[0x20];
+
+	/** monotonic time of entry in milliseconds */
+	uint64_t time_ms;
+
+	/** time since start of cycle in milliseconds */
+	uint32_t offset_ms;
+
+	/** repeats of action of state */
+	uint32_t retries;
+} __attribute__((__packed__)) modem_reg_timeline_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** monotonic time of decision in milliseconds */
+	uint64_t time_ms;
+
+	/** name of repeated state */
+	char name[0x20];
+
+	/** error of last command of state */
+	int32_t error;
+
+	/** consecutive retries of state with this error */
+	uint32_t attempt;
+
+	/** delay before retry in milliseconds */
+	uint32_t delay_ms;
+
+	/** rule of policy: config, default, table or action */
+	char rule[0x10];
+} __attribute__((__packed__)) modem_reg_retry_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** name of probe or step of recovery of watchdog */
+	char name[0x20];
+
+	/** executed probes or steps */
+	uint32_t runs;
+
+	/** failed probes, steps not followed by recovery */
+	uint32_t failures;
+
+	/** total time of probes or of steps until recovery or next step in milliseconds */
+	uint64_t time_ms;
+
+	/** maximal time of one run in milliseconds */
+	uint32_t time_max_ms;
+
+	/** probe is failed or step is in progress now */
+	uint8_t current;
+} __attribute__((__packed__)) modem_watchdog_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** name of polled value */
+	char name[0x20];
+
+	/** current interval of polling in milliseconds */
+	uint32_t interval_ms;
+
+	/** AT commands sent for value */
+	uint32_t commands;
+
+	/** AT commands saved against polling with fixed period */
+	uint32_t saved;
+
+	/** saved AT commands per hour */
+	uint32_t saved_per_hour;
+
+	/** value is read or subscribed by clients */
+	uint8_t observed;
+} __attribute__((__packed__)) modem_poll_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+/** version of modem_status_t, new fields are added only at the end */
+#define MODEM_STATUS_VERSION 1
+
+/** age of field which was never updated */
+#define MODEM_STATUS_AGE_NONE UINT32_MAX
+
+/** slots for ages, reserved for fields of later versions */
+#define MODEM_STATUS_AGES 16
+
+typedef struct
+{
+	/** version of structure filled by the daemon */
+	uint8_t version;
+
+	/** modem is registered in network */
+	uint8_t ready;
+
+	/** last registration error, -1 if no errors */
+	int32_t last_error;
+
+	modem_network_reg_t reg;
+
+	modem_signal_quality_t sq;
+
+	/** operator name, or number if name is unknown */
+	char oper[0x20];
+
+	char network_type[0x10];
+
+	char firmware[0x80];
+
+	int64_t fw_release;
+
+	char imei[0x10];
+
+	char imsi[0x10];
+
+	char ccid[0x18];
+
+	/** age of fields in ms, MODEM_STATUS_AGE_NONE if field is unknown */
+	uint32_t age[MODEM_STATUS_AGES];
+
+	/* fields of later versions are added here */
+} __attribute__((__packed__)) modem_status_t;
+
+/*------------------------------------------------------------------------*/
+
+/** changes of modem state which may be subscribed */
+typedef enum
+{
+	MODEM_EVENT_REG = 0x01,
+	MODEM_EVENT_SQ = 0x02,
+	MODEM_EVENT_NETWORK_TYPE = 0x04,
+	MODEM_EVENT_STATE_WWAN = 0x08,
+	MODEM_EVENT_LAST_ERROR = 0x10,
+
+	/** values cached by client are stale, no value is sent */
+	MODEM_EVENT_INVALIDATE = 0x20,
+
+	/** state of opening of modem is changed */
+	MODEM_EVENT_INIT = 0x40,
+
+	MODEM_EVENT_ALL = 0x7f
+} modem_event_mask_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** subscribed events, zero to unsubscribe */
+	uint32_t mask;
+
+	/** minimal interval between notifications in ms, changes are coalesced */
+	uint32_t interval;
+} __attribute__((__packed__)) modem_subscribe_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** changed values, MODEM_EVENT_*, other values are not valid */
+	uint32_t mask;
+
+	modem_network_reg_t reg;
+
+	modem_signal_quality_t sq;
+
+	char network_type[0x10];
+
+	modem_state_wwan_t state_wwan;
+
+	int32_t last_error;
+
+	/** state of opening, absent in events of older daemons */
+	modem_init_state_t init;
+} __attribute__((__packed__)) modem_event_t;
+
+/*------------------------------------------------------------------------*/
+
 typedef struct freq_band_s
 {
 	uint8_t index;
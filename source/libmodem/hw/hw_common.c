@@ -2,6 +2,9 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "utils/file.h"
+#include "utils/sysfs.h"
+
 #ifdef __HW_C1KMBR
 #   include "hw_c1kmbr.h"
 #endif /* __HW_C1KMBR */
@@ -44,3 +47,24 @@ void port_reset(const char* port)
 #endif /* __HW_C1KMBR */
 		printf("(WW) %s() Port %s not implemented\n", __func__, port);
 }
+
+/*------------------------------------------------------------------------*/
+
+int port_usb_reset(const char* port)
+{
+	char path[0x200];
+
+	printf("(DD) %s(%s)\n", __func__, port);
+
+	/* device is disconnected and enumerated again by USB core */
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s/authorized", sysfs_root(), port);
+
+	if(file_put_contents(path, "0") || file_put_contents(path, "1"))
+	{
+		printf("(WW) %s() Port %s failed\n", __func__, port);
+
+		return(-1);
+	}
+
+	return(0);
+}
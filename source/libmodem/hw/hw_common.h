@@ -5,4 +5,6 @@ void port_power(const char* port, int state);
 
 void port_reset(const char* port);
 
+int port_usb_reset(const char* port);
+
 #endif /* __HW_COMMON_H */
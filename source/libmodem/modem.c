@@ -1,128 +1,450 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <sys/un.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "modem/types.h"
+#include "modem/modem.h"
 #include "rpc.h"
+#include "rpc_client.h"
+#include "rpc_iface.h"
+#include "modem_shm.h"
+#include "utils/clock.h"
  
 /*------------------------------------------------------------------------*/
 
-#define __DEFAULT_TRIES 3
+/** period of registration cycle of daemon refreshing values, ms */
+#define __CACHE_TTL_REG 10000
+
+/** waiting for opening of modem by one query, ms */
+#define __INIT_WAIT 1000
+
+/** values read once per registration are dropped by daemon, ms */
+#define __CACHE_TTL_STATIC 300000
+
+/* cached getters: F(name, result type, events changing result, TTL) */
+#define MODEM_CACHED(F)																	\
+	F(modem_get_info,				usb_device_info_t,		0,							__CACHE_TTL_STATIC)	\
+	F(modem_get_fw_version,			modem_fw_ver_t,			0,							__CACHE_TTL_STATIC)	\
+	F(modem_get_imei,				str,					0,							__CACHE_TTL_STATIC)	\
+	F(modem_get_imsi,				str,					0,							__CACHE_TTL_STATIC)	\
+	F(modem_network_registration,	i8,						MODEM_EVENT_REG,			__CACHE_TTL_REG)	\
+	F(modem_get_signal_quality,		modem_signal_quality_t,	MODEM_EVENT_SQ,				__CACHE_TTL_REG)	\
+	F(modem_get_network_type,		str,					MODEM_EVENT_NETWORK_TYPE,	__CACHE_TTL_REG)	\
+	F(modem_get_operator_name,		str,					MODEM_EVENT_REG,			__CACHE_TTL_REG)
+
+enum
+{
+#define __CACHED_ENUM(name, res_t, events, ttl) MODEM_CACHED_##name,
+	MODEM_CACHED(__CACHED_ENUM)
+#undef __CACHED_ENUM
+
+	MODEM_CACHED_COUNT
+};
+
+/** events subscribed for cache */
+#define __CACHE_EVENTS (MODEM_EVENT_REG | MODEM_EVENT_SQ | MODEM_EVENT_NETWORK_TYPE | MODEM_EVENT_INVALIDATE)
 
 /*------------------------------------------------------------------------*/
 
-static int sock = -1;
+typedef struct
+{
+	const rpc_type_t* type;
+
+	/** events dropping the value, MODEM_EVENT_INVALIDATE drops all */
+	uint32_t events;
+
+	/** time to live of value, ms */
+	uint32_t ttl;
+} modem_cached_t;
+
+/** cached result of getter */
+typedef struct
+{
+	/** copy of result, NULL if not cached */
+	void* obj;
+
+	/** time of the call, ms */
+	uint64_t time;
+
+	/** counter of drops, result of call started before drop is not kept */
+	uint32_t drops;
+} modem_cache_item_t;
+
+/** modem opened by client */
+typedef struct modem_client_s
+{
+	/** copy of modem from server, must be first */
+	modem_t modem;
+
+	/** handle of modem on server connection */
+	uint16_t handle;
+
+	/** handler of subscribed changes */
+	modem_event_func_t event_func;
+
+	void* event_prm;
+
+	/** events subscribed by handler */
+	uint32_t event_mask;
+
+	uint32_t event_interval;
+
+	/** cached results, NULL if cache is disabled */
+	modem_cache_item_t* cache;
+
+	/** next subscribed modem */
+	struct modem_client_s* next;
+} modem_client_t;
+
+/** page mapped by the client */
+struct modem_status_page_s
+{
+	const modem_shm_page_t* page;
+
+	size_t size;
+};
 
 /*------------------------------------------------------------------------*/
 
-int modem_init(const char* socket_path)
+/** attempts to read page while it is written */
+#define __READ_TRIES 1000
+
+/*------------------------------------------------------------------------*/
+
+static rpc_client_t* client = NULL;
+
+/** handlers may subscribe or close modems, so lock is recursive */
+static pthread_mutex_t subs_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+/** subscribed modems */
+static modem_client_t* subs = NULL;
+
+/** cached results are read by callers and dropped by events */
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const modem_cached_t modem_cached[MODEM_CACHED_COUNT] =
 {
-	struct sockaddr_un sa_srv;
+#define __CACHED_ITEM(name, res_t, events, ttl) [MODEM_CACHED_##name] = {&rpc_type_##res_t, events, ttl},
+	MODEM_CACHED(__CACHED_ITEM)
+#undef __CACHED_ITEM
+};
 
-	if(sock != -1)
-		/* already initialized */
-		return(0);
+/*------------------------------------------------------------------------*/
 
-	/* creating socket client */
-	if((sock = socket(AF_LOCAL, SOCK_STREAM, 0)) < 0)
-		return(-1);
+static modem_client_t* modem_client(modem_t* modem)
+{
+	/* modem_t is packed, but its copy is allocated as modem_client_t */
+	void* res = modem;
+
+	return(res);
+}
 
-	/* filling address */
-	memset(&sa_srv, 0, sizeof(sa_srv));
-	sa_srv.sun_family = AF_LOCAL;
-	strncpy(sa_srv.sun_path, socket_path, sizeof(sa_srv.sun_path) - 1);
-	sa_srv.sun_path[sizeof(sa_srv.sun_path) - 1] = 0;
+/*------------------------------------------------------------------------*/
+
+static rpc_packet_t* modem_rpc_call(modem_t* modem, uint16_t opcode, const void* data, uint16_t data_len)
+{
+	if(!client)
+		return(NULL);
+
+	return(rpc_client_call(client, modem ? modem_client(modem)->handle : 0, opcode, data, data_len));
+}
+
+/*------------------------------------------------------------------------*/
 
-	/* connecting */
-	if(connect(sock, (struct sockaddr*)&sa_srv, sizeof(sa_srv)))
+static void modem_subs_remove(modem_client_t* modem)
+{
+	modem_client_t** prev;
+
+	pthread_mutex_lock(&subs_lock);
+
+	for(prev = &subs; *prev; prev = &(*prev)->next)
 	{
-		close(sock);
+		if(*prev == modem)
+		{
+			*prev = modem->next;
+			break;
+		}
+	}
 
-		sock = -1;
+	pthread_mutex_unlock(&subs_lock);
+}
 
+/*------------------------------------------------------------------------*/
+
+/** drop cached results changed by events */
+static void modem_cache_drop(modem_cache_item_t* cache, uint32_t events)
+{
+	int i;
+
+	pthread_mutex_lock(&cache_lock);
+
+	for(i = 0; i < MODEM_CACHED_COUNT; ++ i)
+	{
+		if(!(events & (modem_cached[i].events | MODEM_EVENT_INVALIDATE)))
+			continue;
+
+		++ cache[i].drops;
+
+		if(cache[i].obj)
+		{
+			rpc_obj_free(modem_cached[i].type, cache[i].obj);
+			free(cache[i].obj);
+
+			cache[i].obj = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&cache_lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void modem_event(rpc_packet_t* p, void* prm)
+{
+	modem_client_t* item;
+	modem_event_t ev;
+
+	if(p->hdr.opcode != RPC_OP_modem_event || p->hdr.data_len < offsetof(modem_event_t, init))
+		return;
+
+	/* older daemon sends events only of opened modems */
+	memset(&ev, 0, sizeof(ev));
+	ev.init = MODEM_INIT_READY;
+	memcpy(&ev, p->data, p->hdr.data_len < sizeof(ev) ? p->hdr.data_len : sizeof(ev));
+
+	/* modem can't be closed while handler is running */
+	pthread_mutex_lock(&subs_lock);
+
+	for(item = subs; item; item = item->next)
+	{
+		if(item->handle != p->hdr.modem)
+			continue;
+
+		if(item->cache)
+			modem_cache_drop(item->cache, ev.mask);
+
+		if(ev.mask & MODEM_EVENT_INIT)
+			item->modem.init = ev.init;
+
+		/* handler gets only its events */
+		if(item->event_func && (ev.mask & item->event_mask))
+		{
+			ev.mask &= item->event_mask;
+
+			item->event_func(&item->modem, &ev, item->event_prm);
+		}
+
+		break;
+	}
+
+	pthread_mutex_unlock(&subs_lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** subscribe for events of handler and cache */
+static int modem_subs_update(modem_client_t* mc)
+{
+	modem_subscribe_t sub;
+	rpc_packet_t* p;
+	int res = -1;
+
+	sub.mask = mc->event_mask | (mc->cache ? __CACHE_EVENTS : 0);
+	sub.interval = mc->event_func ? mc->event_interval : 0;
+
+	/* receiving of notifications */
+	if(sub.mask && rpc_client_listen(client, modem_event, NULL))
 		return(-1);
+
+	modem_subs_remove(mc);
+
+	if(sub.mask)
+	{
+		/* handler must be ready before the first notification */
+		pthread_mutex_lock(&subs_lock);
+
+		mc->next = subs;
+		subs = mc;
+
+		pthread_mutex_unlock(&subs_lock);
 	}
 
-	return(0);
+	/* call function, server replies with accepted events */
+	p = modem_rpc_call(&mc->modem, RPC_OP_modem_subscribe, &sub, sizeof(sub));
+
+	if(p && p->hdr.data_len == sizeof(uint32_t))
+		res = 0;
+	else
+		modem_subs_remove(mc);
+
+	rpc_free(p);
+
+	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-void modem_cleanup(void)
+/** free cached results */
+static void modem_cache_free(modem_cache_item_t* cache)
 {
-	if(sock != -1)
+	int i;
+
+	if(!cache)
+		return;
+
+	for(i = 0; i < MODEM_CACHED_COUNT; ++ i)
 	{
-		/* if socket valid close them */
-		close(sock);
-		sock = -1;
+		if(!cache[i].obj)
+			continue;
+
+		rpc_obj_free(modem_cached[i].type, cache[i].obj);
+		free(cache[i].obj);
 	}
+
+	free(cache);
 }
 
 /*------------------------------------------------------------------------*/
 
-#define RPC_FUNCTION_PRM_VOID(result, funcname)							\
-																		   \
-	result funcname##_res_unpack(rpc_packet_t*);						   \
-																		   \
-	result funcname(void)												  \
-	{																	  \
-		rpc_packet_t* p;												   \
-		result res;														\
-																		   \
-		/* build packet and send it */									 \
-		p = rpc_create(TYPE_QUERY, __func__, NULL, 0);					 \
-		rpc_send(sock, p);												 \
-		rpc_free(p);													   \
-																		   \
-		/* receive result and unpack it */								 \
-		p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);				\
-																		   \
-		res = funcname##_res_unpack(p);									\
-																		   \
-		rpc_free(p);													   \
-																		   \
-		/* returning result */											 \
-		return(res);													   \
+/** call getter through cache of modem */
+static int modem_cache_call(modem_t* modem, int item, int (*stub)(modem_t*, const void*, void*), void* res)
+{
+	modem_cache_item_t* cache = modem ? modem_client(modem)->cache : NULL;
+	const modem_cached_t* c = &modem_cached[item];
+	void* obj, *old;
+	uint32_t drops;
+	uint64_t now;
+
+	if(!cache)
+		return(stub(modem, NULL, res));
+
+	cache += item;
+	now = clock_ms();
+
+	pthread_mutex_lock(&cache_lock);
+
+	if(cache->obj && now < cache->time + c->ttl && !rpc_obj_copy(c->type, res, cache->obj))
+	{
+		pthread_mutex_unlock(&cache_lock);
+
+		return(0);
+	}
+
+	drops = cache->drops;
+
+	pthread_mutex_unlock(&cache_lock);
+
+	if(stub(modem, NULL, res))
+		return(-1);
+
+	/* failed results are not cached */
+	if(!(obj = malloc(c->type->size)))
+		return(0);
+
+	if(rpc_obj_copy(c->type, obj, res))
+	{
+		free(obj);
+
+		return(0);
+	}
+
+	pthread_mutex_lock(&cache_lock);
+
+	/* result of call started before drop may be stale */
+	if(cache->drops == drops)
+	{
+		old = cache->obj;
+
+		cache->obj = obj;
+		cache->time = now;
+
+		obj = old;
 	}
 
+	pthread_mutex_unlock(&cache_lock);
+
+	if(obj)
+	{
+		rpc_obj_free(c->type, obj);
+		free(obj);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_init(const char* socket_path)
+{
+	if(client)
+		/* already initialized */
+		return(0);
+
+	if(!(client = rpc_client_open(socket_path)))
+		return(-1);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_cleanup(void)
+{
+	/* if connection valid close them */
+	rpc_client_close(client);
+
+	client = NULL;
+}
+
 /*------------------------------------------------------------------------*/
 
-#define RPC_FUNCTION_RES_STR(funcname)									 \
-																		   \
-	char* funcname(modem_t *modem, char *s, int len)					   \
-	{																	  \
-		rpc_packet_t* p;												   \
-		char* res = NULL;												  \
-																		   \
-		/* build packet and send it */									 \
-		p = rpc_create(TYPE_QUERY, __func__, NULL, 0);					 \
-		rpc_send(sock, p);												 \
-		rpc_free(p);													   \
-																		   \
-		/* receive result and unpack it */								 \
-		p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);				\
-																		   \
-		if(p && p->hdr.data_len)										   \
-		{																  \
-			len = (p->hdr.data_len >= len ? len - 1 : p->hdr.data_len);	\
-			memcpy(s, (const char*)p->data, len);						  \
-			s[len] = 0;													\
-																		   \
-			res = s;													   \
-		}																  \
-																		   \
-		rpc_free(p);													   \
-																		   \
-		return(res);													   \
+/* client stubs of RPC_INTERFACE, zero if successful */
+#define __RPC_STUB(name, arg_t, res_t)											\
+	static int name##_rpc(modem_t* modem, const void* arg, void* res)			\
+	{																			\
+		if(!client)																\
+			return(-1);															\
+																				\
+		return(rpc_client_call_obj(client, modem ? modem_client(modem)->handle : 0,	\
+			RPC_OP_##name, &rpc_type_##arg_t, arg, &rpc_type_##res_t, res));	\
 	}
 
+RPC_INTERFACE(__RPC_STUB)
+
+#undef __RPC_STUB
+
+/* getters reading through cache of modem */
+#define __CACHED_STUB(name, res_t, events, ttl)						\
+	static int name##_cached(modem_t* modem, void* res)				\
+	{																\
+		return(modem_cache_call(modem, MODEM_CACHED_##name, name##_rpc, res));	\
+	}
+
+MODEM_CACHED(__CACHED_STUB)
+
+#undef __CACHED_STUB
+
 /*------------------------------------------------------------------------*/
 
-RPC_FUNCTION_PRM_VOID(modem_network_reg_t, modem_network_registration)
+#define RPC_FUNCTION_RES_STR(funcname)									\
+																		\
+	char* funcname(modem_t *modem, char *s, int len)					\
+	{																	\
+		char* str;														\
+																		\
+		if(funcname##_cached(modem, &str))							\
+			return(NULL);												\
+																		\
+		snprintf(s, len, "%s", str);									\
+		free(str);														\
+																		\
+		return(s);														\
+	}
 
 /*------------------------------------------------------------------------*/
 
@@ -133,120 +455,121 @@ RPC_FUNCTION_RES_STR(modem_get_network_type)
 
 /*------------------------------------------------------------------------*/
 
-usb_device_info_t* modem_find_first_res_unpack(rpc_packet_t* p)
+modem_network_reg_t modem_network_registration(modem_t* modem)
 {
-	usb_device_info_t* res = NULL;
+	modem_network_reg_t res;
 
-	if(p && p->hdr.data_len == sizeof(*res))
-	{
-		res = malloc(sizeof(*res));
-		memcpy(res, p->data, sizeof(*res));
-	}
+	if(modem_network_registration_cached(modem, &res))
+		return(MODEM_NETWORK_REG_UNKNOWN);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-usb_device_info_t* modem_find_next_res_unpack(rpc_packet_t* p)
-	/* the result of modem_find_next_res_unpack() have the same format with
-	function modem_find_first_res_unpack(), so we can use it as a alias */
-	__attribute__((alias("modem_find_first_res_unpack")));
+modem_find_t* modem_find_first(usb_device_info_t* mi)
+{
+	modem_find_first_next_t res;
+
+	if(modem_find_first_rpc(NULL, NULL, &res))
+		return(NULL);
+
+	memcpy(mi, &res.mi, sizeof(*mi));
+
+	/* on this stage this result is not necessary */
+	return(res.find);
+}
 
 /*------------------------------------------------------------------------*/
 
-modem_network_reg_t modem_network_registration_res_unpack(rpc_packet_t* p)
+modem_find_t* modem_find_next(modem_find_t* find, usb_device_info_t* mi)
 {
-	modem_network_reg_t res = MODEM_NETWORK_REG_UNKNOWN;
+	modem_find_first_next_t res;
 
-	if(p && p->hdr.data_len == sizeof(res))
-		res = *((modem_network_reg_t*)p->data);
+	if(modem_find_next_rpc(NULL, &find, &res))
+		return(NULL);
 
-	return(res);
+	memcpy(mi, &res.mi, sizeof(*mi));
+
+	/* on this stage this result is not necessary */
+	return(res.find);
 }
 
 /*------------------------------------------------------------------------*/
 
-modem_find_t* modem_find_first(usb_device_info_t* mi)
+modem_t* modem_open_by_port_nowait(const char* port)
 {
-	modem_find_first_next_t res;
+	modem_client_t* res = NULL;
 	rpc_packet_t* p;
 
-	memset(&res, 0, sizeof(res));
+	/* call function and unpack result */
+	p = modem_rpc_call(NULL, RPC_OP_modem_open_by_port, port, strlen(port));
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
-
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
-
-	if(p->data && p->hdr.data_len == sizeof(res))
+	/* cache and subscription are off until enabled */
+	if(p && (res = calloc(1, sizeof(*res))))
 	{
-		memcpy(&res, p->data, sizeof(res));
-		memcpy(mi, &res.mi, sizeof(*mi));
+		if(rpc_get_modem(p, client->version, &res->modem))
+		{
+			free(res);
+			res = NULL;
+		}
+		else
+			/* handle is zero for servers without modem handles */
+			res->handle = p->hdr.modem;
 	}
 
 	rpc_free(p);
 
 	/* returning result */
-	/* on this stage this result is not necessary */
-	return(res.find);
+	return((modem_t*)res);
 }
 
 /*------------------------------------------------------------------------*/
 
-modem_find_t* modem_find_next(modem_find_t* find, usb_device_info_t* mi)
+modem_init_state_t modem_get_init_state(modem_t* modem, uint32_t wait_ms)
 {
-	modem_find_first_next_t res;
+	modem_init_state_t res = MODEM_INIT_FAILED;
 	rpc_packet_t* p;
 
-	memset(&res, 0, sizeof(res));
-
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, (uint8_t*)&find, sizeof(find));
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(!client || client->version < RPC_PROTO_VERSION_7)
+		/* older daemon returns only opened modem */
+		return(client ? MODEM_INIT_READY : MODEM_INIT_FAILED);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	/* call function and unpack result */
+	p = modem_rpc_call(modem, RPC_OP_modem_get_init_state, &wait_ms, sizeof(wait_ms));
 
-	if(p->data && p->hdr.data_len == sizeof(res))
+	if(p && p->hdr.data_len == sizeof(res))
 	{
 		memcpy(&res, p->data, sizeof(res));
-		memcpy(mi, &res.mi, sizeof(*mi));
+
+		modem->init = res;
 	}
 
 	rpc_free(p);
 
-	/* returning result */
-	/* on this stage this result is not necessary */
-	return(res.find);
+	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
 modem_t* modem_open_by_port(const char* port)
 {
-	rpc_packet_t* p;
-	modem_t* res = NULL;
+	modem_init_state_t state;
+	modem_t* res;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, (uint8_t*)port, strlen(port));
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(!(res = modem_open_by_port_nowait(port)))
+		return(NULL);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	/* each query waits on daemon for a while, so worker is not held long */
+	while((state = modem_get_init_state(res, __INIT_WAIT)) < MODEM_INIT_READY);
 
-	if(p && p->hdr.data_len == sizeof(*res))
-		res = (modem_t*)p->data;
+	if(state != MODEM_INIT_READY)
+	{
+		modem_close(res);
 
-	rpc_free(p);
+		return(NULL);
+	}
 
-	/* returning result */
-	/* on this stage this result is not necessary */
 	return(res);
 }
 
@@ -259,14 +582,14 @@ void modem_close(modem_t* modem)
 	if(!modem)
 		return;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	modem_subs_remove(modem_client(modem));
+	modem_cache_free(modem_client(modem)->cache);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	/* call function */
+	p = modem_rpc_call(modem, RPC_OP_modem_close, NULL, 0);
 	rpc_free(p);
+
+	free(modem);
 }
 
 /*------------------------------------------------------------------------*/
@@ -278,13 +601,8 @@ void modem_conf_reload(modem_t* modem)
 	if(!modem)
 		return;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
-
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	/* call function and unpack result */
+	p = modem_rpc_call(modem, RPC_OP_modem_conf_reload, NULL, 0);
 	rpc_free(p);
 }
 
@@ -292,48 +610,17 @@ void modem_conf_reload(modem_t* modem)
 
 int modem_get_signal_quality(modem_t* modem, modem_signal_quality_t* sq)
 {
-	rpc_packet_t* p;
-	int res = -1;
-
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
-
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
-
-	if(p && p->hdr.data_len == sizeof(*sq))
-	{
-		memcpy(sq, p->data, sizeof(*sq));
-
-		res = 0;
-	}
-
-	rpc_free(p);
-
-	return(res);
+	return(modem_get_signal_quality_cached(modem, sq) ? -1 : 0);
 }
 
 /*------------------------------------------------------------------------*/
 
 time_t modem_get_network_time(modem_t* modem)
 {
-	rpc_packet_t* p;
-	time_t res = 0;
-
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	time_t res;
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
-
-	if(p && p->hdr.data_len == sizeof(time_t))
-		res = *((time_t*)p->data);
-
-	rpc_free(p);
+	if(modem_get_network_time_rpc(modem, NULL, &res))
+		return(0);
 
 	return(res);
 }
@@ -349,13 +636,8 @@ int modem_change_pin(modem_t* modem, const char* old_pin, const char* new_pin)
 	strncpy(pc.old_pin, old_pin, sizeof(pc.old_pin));
 	strncpy(pc.new_pin, new_pin, sizeof(pc.new_pin));
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, (uint8_t*)&pc, sizeof(pc));
-	rpc_send(sock, p);
-	rpc_free(p);
-
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	/* call function and unpack result */
+	p = modem_rpc_call(modem, RPC_OP_modem_change_pin, &pc, sizeof(pc));
 
 	if(p && p->hdr.data_len)
 		res = 0;
@@ -369,77 +651,91 @@ int modem_change_pin(modem_t* modem, const char* old_pin, const char* new_pin)
 
 modem_fw_ver_t* modem_get_fw_version(modem_t* modem, modem_fw_ver_t* fw_info)
 {
-	modem_fw_ver_t* res = NULL;
-	rpc_packet_t* p;
+	return(modem_get_fw_version_cached(modem, fw_info) ? NULL : fw_info);
+}
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+/*------------------------------------------------------------------------*/
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+usb_device_info_t* modem_get_info(modem_t* modem, usb_device_info_t *mi)
+{
+	return(modem_get_info_cached(modem, mi) ? NULL : mi);
+}
 
-	if(p && p->hdr.data_len == sizeof(*fw_info))
-	{
-		memcpy(fw_info, (const char*)p->data, sizeof(*fw_info));
+/*------------------------------------------------------------------------*/
 
-		res = fw_info;
-	}
+int modem_get_cell_id(modem_t* modem)
+{
+	int32_t res;
 
-	rpc_free(p);
+	if(modem_get_cell_id_rpc(modem, NULL, &res))
+		return(0);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-usb_device_info_t* modem_get_info(modem_t* modem, usb_device_info_t *mi)
+modem_status_t* modem_get_status(modem_t* modem, modem_status_t* status)
 {
-	usb_device_info_t* res = NULL;
-	rpc_packet_t* p;
+	/* structure of other version may be shorter or longer */
+	return(modem_get_status_rpc(modem, NULL, status) ? NULL : status);
+}
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+/*------------------------------------------------------------------------*/
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+int modem_subscribe(modem_t* modem, uint32_t mask, uint32_t interval, modem_event_func_t func, void* prm)
+{
+	modem_client_t* mc = modem_client(modem);
 
-	if(p && p->hdr.data_len == sizeof(*mi))
-	{
-		memcpy(mi, (const char*)p->data, sizeof(*mi));
+	if(!modem || !client)
+		return(-1);
 
-		res = mi;
-	}
+	/* subscription is shared with cache */
+	pthread_mutex_lock(&subs_lock);
 
-	rpc_free(p);
+	mc->event_func = mask ? func : NULL;
+	mc->event_prm = prm;
+	mc->event_mask = mask;
+	mc->event_interval = interval;
 
-	return(res);
+	pthread_mutex_unlock(&subs_lock);
+
+	return(modem_subs_update(mc));
 }
 
 /*------------------------------------------------------------------------*/
 
-int modem_get_cell_id(modem_t* modem)
+int modem_cache(modem_t* modem, int enable)
 {
-	rpc_packet_t* p;
-	int res = 0;
+	modem_client_t* mc = modem_client(modem);
+	modem_cache_item_t* cache = NULL;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(!modem || !client)
+		return(-1);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	if(!enable == !mc->cache)
+		return(0);
 
-	if(p && p->hdr.data_len == sizeof(int32_t))
-		res = *((int32_t*)p->data);
+	if(enable && !(cache = calloc(MODEM_CACHED_COUNT, sizeof(*cache))))
+		return(-1);
 
-	rpc_free(p);
+	/* events are handled with subscriptions locked */
+	pthread_mutex_lock(&subs_lock);
+
+	if(!enable)
+		cache = mc->cache;
+
+	mc->cache = enable ? cache : NULL;
+
+	pthread_mutex_unlock(&subs_lock);
+
+	/* without notifications of old daemons values are kept for TTL */
+	modem_subs_update(mc);
+
+	if(!enable)
+		modem_cache_free(cache);
 
-	return res;
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
@@ -449,13 +745,8 @@ int modem_operator_scan(modem_t* modem, modem_oper_t** opers)
 	rpc_packet_t* p;
 	int res = 0;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
-
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	/* call function and unpack result */
+	p = modem_rpc_call(modem, RPC_OP_modem_operator_scan, NULL, 0);
 
 	if(p && (p->hdr.data_len % sizeof(modem_oper_t) == 0))
 	{
@@ -477,43 +768,57 @@ int modem_operator_scan(modem_t* modem, modem_oper_t** opers)
 
 char* modem_at_command(modem_t* modem, const char* query)
 {
-	rpc_packet_t* p;
-	char* res = NULL;
+	char* res;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, (uint8_t*)query, strlen(query) + 1);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(modem_at_command_rpc(modem, &query, &res))
+		return(NULL);
+
+	return(res);
+}
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+/*------------------------------------------------------------------------*/
 
-	if(p && p->hdr.data_len)
-		if((res = malloc(p->hdr.data_len + 1)))
-		{
-			memcpy(res, p->data, p->hdr.data_len);
-			res[p->hdr.data_len] = 0;
-		}
+int modem_operator_scan_start(modem_t* modem, const char* file)
+{
+	int32_t res;
 
-	rpc_free(p);
+	/* result of server is not necessary, scan is started in background */
+	return(modem_operator_scan_start_rpc(modem, &file, &res) ? -1 : 0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_operator_scan_is_running(modem_t* modem)
+{
+	int8_t res;
+
+	if(modem_operator_scan_is_running_rpc(modem, NULL, &res))
+		return(-1);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-int modem_operator_scan_start(modem_t* modem, const char* file)
+int modem_get_last_error(modem_t* modem)
+{
+	int32_t res;
+
+	if(modem_get_last_error_rpc(modem, NULL, &res))
+		return(-1);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_set_wwan_profile(modem_t* modem, modem_data_profile_t* profile)
 {
 	rpc_packet_t* p;
 	int res = -1;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, (uint8_t*)file, strlen(file) + 1);
-	rpc_send(sock, p);
-	rpc_free(p);
-
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	/* call function and unpack result */
+	p = modem_rpc_call(modem, RPC_OP_modem_set_wwan_profile, profile, sizeof(*profile));
 
 	if(p && p->hdr.data_len)
 		res = 0;
@@ -525,165 +830,257 @@ int modem_operator_scan_start(modem_t* modem, const char* file)
 
 /*------------------------------------------------------------------------*/
 
-int modem_operator_scan_is_running(modem_t* modem)
+int modem_start_wwan(modem_t* modem)
 {
-	rpc_packet_t* p;
-	int res = -1;
+	int32_t res;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(modem_start_wwan_rpc(modem, NULL, &res))
+		return(-1);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	return(res);
+}
 
-	if(p && p->hdr.data_len == sizeof(int8_t))
-		res = *((int8_t*)p->data);
+/*------------------------------------------------------------------------*/
 
-	rpc_free(p);
+int modem_stop_wwan(modem_t* modem)
+{
+	int32_t res;
+
+	if(modem_stop_wwan_rpc(modem, NULL, &res))
+		return(-1);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-int modem_get_last_error(modem_t* modem)
+modem_state_wwan_t modem_state_wwan(modem_t* modem)
 {
-	rpc_packet_t* p;
-	int res = -1;
+	modem_state_wwan_t res;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(modem_state_wwan_rpc(modem, NULL, &res))
+		return(MODEM_STATE_WWAN_UKNOWN);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	return(res);
+}
 
-	if(p && p->hdr.data_len == sizeof(int32_t))
-		res = *((int32_t*)p->data);
+/*------------------------------------------------------------------------*/
 
-	rpc_free(p);
+char* modem_ussd_cmd(modem_t* modem, const char* query)
+{
+	char* res;
+
+	if(modem_ussd_cmd_rpc(modem, &query, &res))
+		return(NULL);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-int modem_set_wwan_profile(modem_t* modem, modem_data_profile_t* profile)
+int modemd_stats(modemd_stats_t* stats)
 {
-	rpc_packet_t* p;
-	int res = -1;
+	return(modemd_stats_rpc(NULL, NULL, stats) ? -1 : 0);
+}
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, (uint8_t*)profile, sizeof(*profile));
-	rpc_send(sock, p);
-	rpc_free(p);
+/*------------------------------------------------------------------------*/
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+int modemd_func_stats(modemd_func_stats_t** stats)
+{
+	rpc_array_t a;
 
-	if(p && p->hdr.data_len)
-		res = 0;
+	if(modemd_func_stats_rpc(NULL, NULL, &a))
+		return(-1);
 
-	rpc_free(p);
+	*stats = a.items;
 
-	return(res);
+	return(a.count);
 }
 
 /*------------------------------------------------------------------------*/
 
-int modem_start_wwan(modem_t* modem)
+int modem_get_reg_stats(modem_t* modem, modem_reg_state_stats_t** stats)
 {
-	rpc_packet_t* p;
-	int res = -1;
+	rpc_array_t a;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(modem_get_reg_stats_rpc(modem, NULL, &a))
+		return(-1);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	*stats = a.items;
 
-	if(p && p->hdr.data_len == sizeof(int32_t))
-		res = *((int32_t*)p->data);
+	return(a.count);
+}
 
-	rpc_free(p);
+/*------------------------------------------------------------------------*/
 
-	return(res);
+int modem_get_poll_stats(modem_t* modem, modem_poll_stats_t** stats)
+{
+	rpc_array_t a;
+
+	if(modem_get_poll_stats_rpc(modem, NULL, &a))
+		return(-1);
+
+	*stats = a.items;
+
+	return(a.count);
 }
 
 /*------------------------------------------------------------------------*/
 
-int modem_stop_wwan(modem_t* modem)
+int modem_get_reg_timeline(modem_t* modem, modem_reg_timeline_t** timeline)
 {
-	rpc_packet_t* p;
-	int res = -1;
+	rpc_array_t a;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(modem_get_reg_timeline_rpc(modem, NULL, &a))
+		return(-1);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	*timeline = a.items;
 
-	if(p && p->hdr.data_len == sizeof(int32_t))
-		res = *((int32_t*)p->data);
+	return(a.count);
+}
 
-	rpc_free(p);
+/*------------------------------------------------------------------------*/
 
-	return(res);
+int modem_get_reg_retries(modem_t* modem, modem_reg_retry_t** trace)
+{
+	rpc_array_t a;
+
+	if(modem_get_reg_retries_rpc(modem, NULL, &a))
+		return(-1);
+
+	*trace = a.items;
+
+	return(a.count);
 }
 
 /*------------------------------------------------------------------------*/
 
-modem_state_wwan_t modem_state_wwan(modem_t* modem)
+int modem_get_watchdog_stats(modem_t* modem, modem_watchdog_stats_t** stats)
 {
-	modem_state_wwan_t res = MODEM_STATE_WWAN_UKNOWN;
-	rpc_packet_t* p;
+	rpc_array_t a;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, NULL, 0);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(modem_get_watchdog_stats_rpc(modem, NULL, &a))
+		return(-1);
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	*stats = a.items;
 
-	if(p && p->hdr.data_len == sizeof(res))
-		res = *((modem_state_wwan_t*)p->data);
+	return(a.count);
+}
 
-	rpc_free(p);
+/*------------------------------------------------------------------------*/
 
-	return(res);
+int modemd_sched_stats(modemd_sched_stats_t** stats)
+{
+	rpc_array_t a;
+
+	if(modemd_sched_stats_rpc(NULL, NULL, &a))
+		return(-1);
+
+	*stats = a.items;
+
+	return(a.count);
 }
 
 /*------------------------------------------------------------------------*/
 
-char* modem_ussd_cmd(modem_t* modem, const char* query)
+modem_status_page_t* modem_status_page_open(const char* port)
 {
-	rpc_packet_t* p;
-	char* res = NULL;
+	modem_status_page_t* res;
+	char path[0x100];
+	struct stat st;
+	int fd;
 
-	/* build packet and send it */
-	p = rpc_create(TYPE_QUERY, __func__, (uint8_t*)query, strlen(query) + 1);
-	rpc_send(sock, p);
-	rpc_free(p);
+	if(!(res = malloc(sizeof(*res))))
+		goto err;
 
-	/* receive result and unpack it */
-	p = rpc_recv_func(sock, __func__, __DEFAULT_TRIES);
+	snprintf(path, sizeof(path), MODEM_SHM_PATH, port);
 
-	if(p && p->hdr.data_len)
-		if((res = malloc(p->hdr.data_len + 1)))
-		{
-			memcpy(res, p->data, p->hdr.data_len);
-			res[p->hdr.data_len] = 0;
-		}
+	if((fd = open(path, O_RDONLY)) < 0)
+		goto err_open;
 
-	rpc_free(p);
+	/* page of other version may have other size */
+	if(fstat(fd, &st) || st.st_size < offsetof(modem_shm_page_t, status) + 1)
+		goto err_map;
+
+	res->size = st.st_size;
+
+	if((res->page = mmap(NULL, res->size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		goto err_map;
+
+	close(fd);
 
 	return(res);
+
+err_map:
+	close(fd);
+
+err_open:
+	free(res);
+
+err:
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+modem_status_t* modem_status_page_read(modem_status_page_t* page, modem_status_t* status)
+{
+	const modem_shm_page_t* p = page->page;
+	uint64_t written, now;
+	uint32_t seq;
+	size_t len;
+	int i, tries;
+
+	/* page is not ready yet */
+	if(__atomic_load_n(&p->magic, __ATOMIC_ACQUIRE) != MODEM_SHM_MAGIC)
+		return(NULL);
+
+	len = page->size - offsetof(modem_shm_page_t, status);
+
+	if(len > sizeof(*status))
+		len = sizeof(*status);
+
+	for(tries = 0; tries < __READ_TRIES; ++ tries)
+	{
+		seq = seqlock_read_begin(&p->lock);
+
+		memset(status, 0, sizeof(*status));
+		memcpy(status, &p->status, len);
+		written = p->written;
+
+		if(!seqlock_read_retry(&p->lock, seq))
+			break;
+	}
+
+	/* writer is gone in the middle of writing */
+	if(tries == __READ_TRIES)
+		return(NULL);
+
+	/* ages were calculated at the time of writing */
+	now = clock_ms();
+
+	for(i = 0; i < MODEM_STATUS_AGES; ++ i)
+	{
+		if(status->age[i] == MODEM_STATUS_AGE_NONE)
+			continue;
+
+		if(status->age[i] + now - written >= MODEM_STATUS_AGE_NONE)
+			status->age[i] = MODEM_STATUS_AGE_NONE - 1;
+		else
+			status->age[i] += now - written;
+	}
+
+	return(status);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_status_page_close(modem_status_page_t* page)
+{
+	if(!page)
+		return;
+
+	munmap((void*)page->page, page->size);
+
+	free(page);
 }
@@ -0,0 +1,589 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "modem/modem_async.h"
+#include "rpc.h"
+#include "rpc_iface.h"
+
+/*------------------------------------------------------------------------*/
+
+/** bytes read from socket at once */
+#define __READ_SIZE 0x1000
+
+/*------------------------------------------------------------------------*/
+
+/** modem opened by asynchronous client */
+typedef struct
+{
+	/** copy of modem from server, must be first */
+	modem_t modem;
+
+	/** handle of modem on connection */
+	uint16_t handle;
+
+	/** pending calls of modem, closed modem is freed by the last one */
+	uint32_t calls;
+
+	/** modem_async_close() is called */
+	int closed;
+} modem_async_modem_t;
+
+/** pending call */
+typedef struct modem_async_call_s
+{
+	uint32_t id;
+
+	/** query waiting for socket, NULL if sent */
+	rpc_packet_t* q;
+
+	/** sent bytes of query */
+	uint32_t sent;
+
+	/** joined chunks of response */
+	rpc_packet_t* p;
+
+	/** type of result, NULL for raw data */
+	const rpc_type_t* res_type;
+
+	/** call of modem_async_open_by_port() */
+	int open;
+
+	modem_t* modem;
+
+	modem_async_func_t func;
+
+	void* prm;
+
+	struct modem_async_call_s* next;
+} modem_async_call_t;
+
+struct modem_async_s
+{
+	int sock;
+
+	/** socket is SOCK_SEQPACKET, packet is one message */
+	int seqpacket;
+
+	/** negotiated version of protocol */
+	uint8_t version;
+
+	uint32_t last_id;
+
+	/** pending calls in order of queries */
+	modem_async_call_t* calls;
+
+	modem_async_call_t* calls_last;
+
+	/** received bytes not parsed yet */
+	uint8_t* in;
+
+	uint32_t in_len;
+
+	uint32_t in_size;
+};
+
+/*------------------------------------------------------------------------*/
+
+static modem_async_modem_t* modem_async_modem(modem_t* modem)
+{
+	/* modem_t is packed, but it is allocated as modem_async_modem_t */
+	void* res = modem;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int modem_async_hello(modem_async_t* async)
+{
+	uint8_t version = RPC_PROTO_VERSION;
+	rpc_packet_t* p;
+
+	if(!(p = rpc_create(TYPE_QUERY, RPC_OP_rpc_hello, &version, sizeof(version))))
+		return(-1);
+
+	/* query with a legacy framing is understood by all servers */
+	p->version = RPC_PROTO_VERSION_1;
+
+	if(rpc_send(async->sock, p) < 0)
+	{
+		rpc_free(p);
+
+		return(-1);
+	}
+
+	rpc_free(p);
+
+	if(!(p = rpc_recv_func(async->sock, async->seqpacket, RPC_OP_rpc_hello, 1)))
+		return(-1);
+
+	if(p->hdr.data_len == sizeof(version))
+		async->version = *p->data < RPC_PROTO_VERSION ? *p->data : RPC_PROTO_VERSION;
+
+	rpc_free(p);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+modem_async_t* modem_async_init(const char* socket_path)
+{
+	modem_async_t* res;
+
+	if(!(res = malloc(sizeof(*res))))
+		goto err;
+
+	memset(res, 0, sizeof(*res));
+
+	if((res->sock = rpc_connect(socket_path, &res->seqpacket)) < 0)
+		goto err_socket;
+
+	/* responses out of order and modem handles are required */
+	if(modem_async_hello(res) || res->version < RPC_PROTO_VERSION_4)
+		goto err_connect;
+
+	if(fcntl(res->sock, F_SETFL, fcntl(res->sock, F_GETFL) | O_NONBLOCK))
+		goto err_connect;
+
+	return(res);
+
+err_connect:
+	close(res->sock);
+
+err_socket:
+	free(res);
+
+err:
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** call of modem is done, closed modem is freed by its last call */
+static void modem_async_release(modem_t* modem)
+{
+	modem_async_modem_t* mm = modem_async_modem(modem);
+
+	if(!-- mm->calls && mm->closed)
+		free(mm);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** complete call, it must be removed from list */
+static void modem_async_complete(modem_async_t* async, modem_async_call_t* call)
+{
+	modem_async_modem_t* mm;
+	const void* res = NULL;
+	uint32_t len = 0;
+	rpc_obj_t obj;
+	char* s;
+
+	if(!call->p || !call->p->hdr.data_len)
+		/* NULL result */;
+	else if(call->open)
+	{
+		/* copy of modem is the result, handle is in header of response */
+		if(!(mm = calloc(1, sizeof(*mm))))
+			/* NULL result */;
+		else if(rpc_get_modem(call->p, async->version, &mm->modem))
+			free(mm);
+		else
+		{
+			mm->handle = call->p->hdr.modem;
+
+			call->modem = &mm->modem;
+
+			res = call->modem;
+			len = sizeof(mm->modem);
+		}
+	}
+	else if(!call->res_type)
+	{
+		res = call->p->data;
+		len = call->p->hdr.data_len;
+	}
+	else if(!rpc_get_obj(call->p, call->res_type, &obj))
+	{
+		if(call->res_type == &rpc_type_str)
+		{
+			/* handler gets string itself */
+			memcpy(&s, &obj, sizeof(s));
+
+			res = s;
+			len = strlen(s);
+		}
+		else
+		{
+			res = &obj;
+			len = call->res_type->size;
+		}
+	}
+
+	if(call->func)
+		call->func(call->modem, res, len, call->prm);
+
+	if(res && call->res_type && !call->open)
+		rpc_obj_free(call->res_type, &obj);
+
+	/* opened modem belongs to handler */
+	if(call->modem && !call->open)
+		modem_async_release(call->modem);
+
+	rpc_free(call->q);
+	rpc_free(call->p);
+	free(call);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** complete all pending calls with NULL result */
+static void modem_async_fail(modem_async_t* async)
+{
+	modem_async_call_t *calls, *call;
+
+	/* handlers may queue new calls, they fail too */
+	while((calls = async->calls))
+	{
+		async->calls = async->calls_last = NULL;
+
+		while((call = calls))
+		{
+			calls = call->next;
+
+			rpc_free(call->p);
+			call->p = NULL;
+
+			modem_async_complete(async, call);
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_async_cleanup(modem_async_t* async)
+{
+	if(!async)
+		return;
+
+	modem_async_fail(async);
+
+	close(async->sock);
+
+	free(async->in);
+	free(async);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_async_fd(modem_async_t* async)
+{
+	return(async->sock);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_async_events(modem_async_t* async)
+{
+	modem_async_call_t* call;
+
+	for(call = async->calls; call; call = call->next)
+		if(call->q)
+			return(POLLIN | POLLOUT);
+
+	return(POLLIN);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** send queued queries in order, zero if socket is full or all is sent */
+static int modem_async_send(modem_async_t* async)
+{
+	modem_async_call_t* call;
+	int res;
+
+	for(call = async->calls; call; call = call->next)
+	{
+		if(!call->q)
+			continue;
+
+		if((res = rpc_send_nb(async->sock, call->q, &call->sent)) <= 0)
+			return(res);
+
+		rpc_free(call->q);
+		call->q = NULL;
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** route response to its call */
+static void modem_async_route(modem_async_t* async, rpc_packet_t* p)
+{
+	modem_async_call_t *prev, *call;
+
+	/* notifications are not supported by asynchronous client */
+	if(p->hdr.type != TYPE_RESPONSE)
+	{
+		rpc_free(p);
+
+		return;
+	}
+
+	for(prev = NULL, call = async->calls; call; prev = call, call = call->next)
+	{
+		if(call->id != p->hdr.id || call->q)
+			continue;
+
+		/* chunks are joined into one response */
+		if(!call->p)
+			call->p = p;
+		else
+		{
+			if(rpc_append(call->p, p->data, p->hdr.data_len))
+			{
+				rpc_free(call->p);
+				call->p = NULL;
+			}
+
+			if(call->p)
+				call->p->hdr.flags = p->hdr.flags;
+
+			rpc_free(p);
+		}
+
+		if(call->p && (call->p->hdr.flags & RPC_FLAG_MORE))
+			return;
+
+		/* the last chunk, call is done */
+		if(prev)
+			prev->next = call->next;
+		else
+			async->calls = call->next;
+
+		if(async->calls_last == call)
+			async->calls_last = prev;
+
+		modem_async_complete(async, call);
+
+		return;
+	}
+
+	/* response for nobody */
+	rpc_free(p);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** receive available data and handle complete responses */
+static int modem_async_recv(modem_async_t* async)
+{
+	rpc_packet_t* p;
+	uint8_t* buf;
+	uint32_t pos, size;
+	int res;
+
+	for(;;)
+	{
+		size = __READ_SIZE;
+
+		/* message must be read whole, its length is known before */
+		if(async->seqpacket && (res = recv(async->sock, NULL, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT)) > 0 && res > size)
+			size = res;
+
+		if(async->in_size - async->in_len < size)
+		{
+			if(!(buf = realloc(async->in, async->in_len + size)))
+				return(-1);
+
+			async->in = buf;
+			async->in_size = async->in_len + size;
+		}
+
+		if((res = recv(async->sock, async->in + async->in_len, async->in_size - async->in_len, MSG_DONTWAIT)) <= 0)
+			return(res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1);
+
+		async->in_len += res;
+
+		/* complete packets */
+		for(pos = 0; (res = rpc_parse(async->in + pos, async->in_len - pos, &p)) > 0; pos += res)
+			modem_async_route(async, p);
+
+		if(res < 0)
+			return(-1);
+
+		memmove(async->in, async->in + pos, async->in_len - pos);
+		async->in_len -= pos;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_async_process(modem_async_t* async)
+{
+	modem_async_call_t* call;
+	int res = 0;
+
+	if(modem_async_send(async) < 0 || modem_async_recv(async) < 0)
+	{
+		modem_async_fail(async);
+
+		return(-1);
+	}
+
+	/* handlers may queue new calls */
+	if(modem_async_send(async) < 0)
+	{
+		modem_async_fail(async);
+
+		return(-1);
+	}
+
+	for(call = async->calls; call; call = call->next)
+		++ res;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** queue call with query, query is sent by next modem_async_process() */
+static int modem_async_call(modem_async_t* async, modem_t* modem, rpc_packet_t* q,
+	const rpc_type_t* res_type, modem_async_func_t func, void* prm)
+{
+	modem_async_call_t* call;
+
+	if(!q || !(call = malloc(sizeof(*call))))
+	{
+		rpc_free(q);
+
+		return(-1);
+	}
+
+	memset(call, 0, sizeof(*call));
+
+	/* zero id is reserved for packets without request */
+	if(!++ async->last_id)
+		++ async->last_id;
+
+	call->id = async->last_id;
+	call->q = q;
+	call->res_type = res_type;
+	call->modem = modem;
+	call->func = func;
+	call->prm = prm;
+
+	/* modem is kept until its calls are done */
+	if(modem)
+		++ modem_async_modem(modem)->calls;
+
+	q->version = async->version;
+	q->hdr.id = call->id;
+	q->hdr.modem = modem ? modem_async_modem(modem)->handle : 0;
+
+	if(async->calls_last)
+		async->calls_last->next = call;
+	else
+		async->calls = call;
+
+	async->calls_last = call;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** query with described argument */
+static rpc_packet_t* modem_async_query(modem_async_t* async, uint16_t opcode, const rpc_type_t* arg_type, const void* arg)
+{
+	return(rpc_create_obj(TYPE_QUERY, opcode, arg_type, arg, async->version >= RPC_PROTO_VERSION_6));
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_async_open_by_port(modem_async_t* async, const char* port, modem_async_func_t func, void* prm)
+{
+	rpc_packet_t* q;
+
+	/* port is sent as raw string without zero */
+	q = rpc_create(TYPE_QUERY, RPC_OP_modem_open_by_port, (const uint8_t*)port, strlen(port));
+
+	if(modem_async_call(async, NULL, q, NULL, func, prm))
+		return(-1);
+
+	async->calls_last->open = 1;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_async_close(modem_async_t* async, modem_t* modem)
+{
+	modem_async_modem_t* mm;
+
+	if(!modem)
+		return;
+
+	mm = modem_async_modem(modem);
+	mm->closed = 1;
+
+	/* pending calls and the close call itself free modem when done */
+	modem_async_call(async, modem, rpc_create(TYPE_QUERY, RPC_OP_modem_close, NULL, 0), NULL, NULL, NULL);
+
+	if(!mm->calls)
+		free(mm);
+}
+
+/*------------------------------------------------------------------------*/
+
+#define __ASYNC_GET(name, res_t)																		\
+	int modem_async_##name(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm)	\
+	{																									\
+		return(modem_async_call(async, modem, modem_async_query(async, RPC_OP_modem_##name,			\
+			&rpc_type_none, NULL), &rpc_type_##res_t, func, prm));										\
+	}
+
+__ASYNC_GET(get_info, usb_device_info_t)
+__ASYNC_GET(get_imei, str)
+__ASYNC_GET(get_imsi, str)
+__ASYNC_GET(get_operator_name, str)
+__ASYNC_GET(get_network_type, str)
+__ASYNC_GET(get_signal_quality, modem_signal_quality_t)
+__ASYNC_GET(network_registration, i8)
+__ASYNC_GET(get_status, modem_status_t)
+__ASYNC_GET(get_init_state, i8)
+
+#undef __ASYNC_GET
+
+/*------------------------------------------------------------------------*/
+
+int modem_async_at_command(modem_async_t* async, modem_t* modem, const char* query, modem_async_func_t func, void* prm)
+{
+	return(modem_async_call(async, modem, modem_async_query(async, RPC_OP_modem_at_command, &rpc_type_strz, &query),
+		&rpc_type_str, func, prm));
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_async_ussd_cmd(modem_async_t* async, modem_t* modem, const char* query, modem_async_func_t func, void* prm)
+{
+	return(modem_async_call(async, modem, modem_async_query(async, RPC_OP_modem_ussd_cmd, &rpc_type_strz, &query),
+		&rpc_type_str, func, prm));
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_async_operator_scan(modem_async_t* async, modem_t* modem, modem_async_func_t func, void* prm)
+{
+	return(modem_async_call(async, modem, rpc_create(TYPE_QUERY, RPC_OP_modem_operator_scan, NULL, 0), NULL, func, prm));
+}
@@ -3,8 +3,6 @@
 #include "at/at_common.h"
 #include "qcqmi/qcqmi_common.h"
 
-#include "modems/registration.h"
-
 #include "modems/e1550/at_func.h"
 #include "modems/mc77x0/at_func.h"
 
@@ -15,7 +13,7 @@ modem_info_device_t modem_info_devices[] = {
 		/* HUAWEI E1550 */
 		.vendor_id	= 0x12d1,
 		.product_id	= 0x1001,
-		.thread_reg	= mc77x0_thread_reg,
+		.reg_table	= e1550_reg_table,
 		.iface		= {
 #if 0
 			{
@@ -50,6 +48,7 @@ modem_info_device_t modem_info_devices[] = {
 			.get_freq_band			= e1550_at_get_freq_band,
 			.set_freq_band			= e1550_at_set_freq_band,
 			.ussd_cmd				= e1550_at_ussd_cmd,
+			.get_ccid				= mc77x0_at_get_ccid,
 		},
 	},
 	{
@@ -58,7 +57,6 @@ modem_info_device_t modem_info_devices[] = {
 		.product	= "MC7700",
 		.vendor_id	= 0x1199,
 		.product_id	= 0x68a3,
-		.thread_reg	= mc77x0_thread_reg,
 		.iface		= {
 			{
 				.num	= 3,
@@ -85,6 +83,7 @@ modem_info_device_t modem_info_devices[] = {
 			.get_freq_band			= mc77x0_at_get_freq_band,
 			.set_freq_band			= mc77x0_at_set_freq_band,
 			.ussd_cmd				= at_ussd_cmd,
+			.get_ccid				= mc77x0_at_get_ccid,
 
 			/* data session */
 			.set_wwan_profile		= at_set_wwan_profile,
@@ -100,7 +99,6 @@ modem_info_device_t modem_info_devices[] = {
 		.product	= "MC7750",
 		.vendor_id	= 0x1199,
 		.product_id	= 0x68a2,
-		.thread_reg	= mc77x0_thread_reg,
 		.iface		= {
 			{
 				.num	= 3,
@@ -130,6 +128,7 @@ modem_info_device_t modem_info_devices[] = {
 			.get_freq_bands			= mc77x0_at_get_freq_bands,
 			.get_freq_band			= mc77x0_at_get_freq_band,
 			.set_freq_band			= mc77x0_at_set_freq_band,
+			.get_ccid				= mc77x0_at_get_ccid,
 
 			/* data session */
 			.set_wwan_profile		= qcqmi_set_wwan_profile,
@@ -5,9 +5,12 @@
 
 #include "modem/types.h"
 
+#include "modems/registration.h"
+
 /*------------------------------------------------------------------------*/
 
-typedef void *(*registration_func_t)(modem_t*);
+/** customisation of default table of registration states */
+typedef void (*registration_table_func_t)(reg_state_t* table);
 
 typedef void *(*pthread_func_t)(void*);
 
@@ -61,6 +64,8 @@ typedef int (*set_freq_band_func_t)(modem_t* modem, int band_index);
 
 typedef char* (*ussd_cmd_func_t)(modem_t* modem, const char* query);
 
+typedef char* (*get_ccid_func_t)(modem_t* modem, char* ccid, size_t len);
+
 /*------------------------------------------------------------------------*/
 
 typedef struct
@@ -100,10 +105,11 @@ typedef struct
 			__MODEM_INFO_FUNC(get_freq_band);
 			__MODEM_INFO_FUNC(set_freq_band);
 			__MODEM_INFO_FUNC(ussd_cmd);
+			__MODEM_INFO_FUNC(get_ccid);
 		#undef __MODEM_INFO_FUNC
 	} functions;
 
-	registration_func_t thread_reg;
+	registration_table_func_t reg_table;
 
 	struct
 	{
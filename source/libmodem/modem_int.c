@@ -9,9 +9,16 @@
 #include "hw/hw_common.h"
 #include "utils/file.h"
 #include "utils/sysfs.h"
+#include "utils/clock.h"
+#include "utils/scheduler.h"
+#include "utils/seqlock.h"
 #include "at/at_common.h"
 #include "at/at_queue.h"
 #include "proto.h"
+#include "modem_int.h"
+#include "modem_shm.h"
+#include "modem_watchdog.h"
+#include "modems/registration.h"
 
 /*------------------------------------------------------------------------*/
 
@@ -22,10 +29,61 @@ typedef struct modem_list_s
 	struct modem_list_s* next;
 } modem_list_t;
 
+/** modem allocated by daemon */
+typedef struct
+{
+	/** modem, must be first */
+	modem_t modem;
+
+	modem_priv_t priv;
+
+	/** step of opening executed by scheduler */
+	sched_timer_t init;
+
+	/** checks of missing device left */
+	int init_tries;
+
+	/** cached values published for readers, see modem_state_publish() */
+	struct cached_s state;
+
+	seqlock_t state_seq;
+
+	/** writers of published values */
+	pthread_mutex_t state_lock;
+} modem_int_t;
+
+/** worker threads of scheduler of registration routines */
+#define __SCHED_THREADS 2
+
+/** workers added per opened modem, registration step and watchdog probe block on AT commands */
+#define __SCHED_THREADS_MODEM 2
+
+/** checks of missing device after power on */
+#define __INIT_TRIES 10
+
+/** interval of checks of missing device, s */
+#define __INIT_WAIT_DEVICE 20
+
+/** vendor of modems reset by AT!RESET, others are reset by AT+CFUN=1,1 */
+#define __VENDOR_SIERRA 0x1199
+
 /*------------------------------------------------------------------------*/
 
 modem_list_t* modems = NULL;
 
+/** list of modems and their refs are changed by threads of clients */
+static pthread_mutex_t modems_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** signaled on change of state of opening */
+static pthread_cond_t modems_cond;
+
+/** scheduler of background work of all modems */
+static sched_t* sched = NULL;
+
+static modem_notify_func_t notify_func = NULL;
+
+static modem_notify_func_t invalidate_func = NULL;
+
 /*------------------------------------------------------------------------*/
 
 void modem_close(modem_t* modem);
@@ -47,13 +105,33 @@ static void* modem_thread_operator_scan(void* prm);
 
 int modem_init(const char* socket_path)
 {
+	pthread_condattr_t attr;
+
 	modems = NULL;
 
+	/* deadlines of waiting are in monotonic time */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&modems_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if(!(sched = sched_create(__SCHED_THREADS)))
+		return(-1);
+
 	return(0);
 }
 
 /*------------------------------------------------------------------------*/
 
+/** start registration routine of modem */
+static void modem_reg_start(modem_t* modem)
+{
+	if(sched && registration_start(modem, sched))
+		printf("(EE) Failed to start registration on port %s\n", modem->port);
+}
+
+/*------------------------------------------------------------------------*/
+
 void modem_cleanup(void)
 {
 	modem_list_t* item;
@@ -61,176 +139,322 @@ void modem_cleanup(void)
 	/* forced modem close */
 	while(modems)
 		modem_close(modems->modem);
+
+	sched_destroy(sched);
+	sched = NULL;
+
+	pthread_cond_destroy(&modems_cond);
 }
 
 /*------------------------------------------------------------------------*/
 
-modem_t* modem_open_by_port(const char* port)
+static modem_int_t* modem_int(modem_t* modem)
 {
-	modem_t* res = NULL;
-	modem_list_t* item;
-	void* thread_res;
-	int i;
+	/* modem_t is packed, but it is allocated as modem_int_t */
+	void* res = modem;
 
-	/* check if modem is already opened */
-	for(item = modems; item; item = item->next)
-	{
-		if(strcmp(port, item->modem->port) == 0)
-		{
-			/* modem is already opened, increase refs */
-			++ item->modem->refs;
-			res = item->modem;
+	return(res);
+}
 
-			/* and return handle */
-			return(res);
-		}
+/*------------------------------------------------------------------------*/
+
+modem_priv_t* modem_priv(modem_t* modem)
+{
+	return(&modem_int(modem)->priv);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_state_publish(modem_t* modem)
+{
+	modem_int_t* priv = modem_int(modem);
+
+	pthread_mutex_lock(&priv->state_lock);
+
+	seqlock_write_begin(&priv->state_seq);
+	memcpy(&priv->state, &modem->reg.state, sizeof(priv->state));
+	seqlock_write_end(&priv->state_seq);
+
+	pthread_mutex_unlock(&priv->state_lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+struct cached_s* modem_state_read(modem_t* modem, struct cached_s* state)
+{
+	modem_int_t* priv = modem_int(modem);
+	uint32_t seq;
+
+	/* writer is in this process and never stops in the middle */
+	do
+	{
+		seq = seqlock_read_begin(&priv->state_seq);
+		memcpy(state, &priv->state, sizeof(*state));
 	}
+	while(seqlock_read_retry(&priv->state_seq, seq));
 
-	/* allocating memory for result */
-	res = malloc(sizeof(*res));
-	memset(res, 0, sizeof(*res));
-	strncpy(res->port, port, sizeof(res->port) - 1);
-	res->port[sizeof(res->port) - 1] = 0;
+	return(state);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** change state of opening and wake up waiting callers */
+static void modem_init_set(modem_t* modem, modem_init_state_t state)
+{
+	pthread_mutex_lock(&modems_lock);
+
+	modem->init = state;
+	pthread_cond_broadcast(&modems_cond);
+
+	pthread_mutex_unlock(&modems_lock);
+
+	modem_notify(modem);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** step of opening executed by scheduler, ports are opened in parallel */
+static void modem_init_step(void* prm)
+{
+	modem_int_t* priv = prm;
+	modem_t* modem = &priv->modem;
 
 	/* check device present */
-	if(!usb_device_get_info(port, &res->usb))
+	if(!usb_device_get_info(modem->port, &modem->usb))
 	{
-		printf("(DD) Port %s power on..\n", port);
+		if(modem->init == MODEM_INIT_PENDING)
+		{
+			printf("(DD) Port %s power on..\n", modem->port);
 
-		/* device missing, maybe port power down? */
-		port_power(port, 1);
+			/* device missing, maybe port power down? */
+			port_power(modem->port, 1);
+		}
 
-		/* waiting for device ready */
-		for(i = 10; !usb_device_get_info(port, &res->usb) && i > 0; -- i)
+		if(priv->init_tries -- > 0)
 		{
 			printf("(DD) Wait for modem ready..\n");
 
-			sleep(20);
-		}
+			/* worker is not blocked while device is waited for */
+			if(modem->init != MODEM_INIT_WAIT_DEVICE)
+				modem_init_set(modem, MODEM_INIT_WAIT_DEVICE);
 
-		if(i == 0)
-		{
-			printf("(EE) Device missing..\n");
+			sched_timer_at(sched, &priv->init, clock_ms() + __INIT_WAIT_DEVICE * 1000);
 
-			goto err;
+			return;
 		}
+
+		printf("(EE) Device missing..\n");
+
+		goto err;
 	}
 
 	/* check driver ready */
-	if(!(res->mdd = modem_db_get_info(res->usb.vendor, res->usb.product, res->usb.id_vendor, res->usb.id_product)))
+	if(!(modem->mdd = modem_db_get_info(modem->usb.vendor, modem->usb.product, modem->usb.id_vendor, modem->usb.id_product)))
 		goto err;
 
 	/* creating queues */
-	if(modem_queues_init(res))
+	if(modem_queues_init(modem))
 		goto err;
 
+	/* status page for readers without socket */
+	modem_shm_create(modem);
+
 	/* starting registration routine */
-	if(((const modem_info_device_t*)res->mdd)->thread_reg)
-		pthread_create(&res->reg.thread, NULL, (pthread_func_t)((const modem_info_device_t*)res->mdd)->thread_reg, res);
-	else
-		res->reg.thread = 0;
+	modem_reg_start(modem);
 
-	/* adding modem in pull */
-	if(!(item = malloc(sizeof(*item))))
-		goto err_insert;
+	if(watchdog_start(modem, sched))
+		printf("(EE) Failed to start watchdog on port %s\n", modem->port);
 
-	/* pointer to modem info */
-	//res->priv = (void*)mdd;
+	modem_init_set(modem, MODEM_INIT_READY);
 
-	item->modem = res;
-	item->next = modems;
-	modems = item;
+	return;
 
-	return(res);
+err:
+	/* cleanup resources */
+	port_power(modem->port, 0);
+
+	modem_init_set(modem, MODEM_INIT_FAILED);
+}
+
+/*------------------------------------------------------------------------*/
+
+modem_t* modem_open_by_port(const char* port)
+{
+	modem_int_t* priv;
+	modem_t* res = NULL;
+	modem_list_t* item;
+	int n = 0;
+
+	pthread_mutex_lock(&modems_lock);
+
+	/* check if modem is already opened */
+	for(item = modems; item; item = item->next, ++ n)
+	{
+		/* failed opening is kept for its handles, port is opened again */
+		if(item->modem->init == MODEM_INIT_FAILED)
+			continue;
+
+		if(strcmp(port, item->modem->port) == 0)
+		{
+			/* modem is already opened, increase refs */
+			++ item->modem->refs;
+			res = item->modem;
+
+			/* and return handle */
+			goto exit;
+		}
+	}
 
-err_insert:
-	/* termination registration routine */
-	if(res->reg.thread)
+	/* modem is opened by scheduler created by modem_init() */
+	if(!sched || !(priv = malloc(sizeof(*priv))))
+		goto exit;
+
+	memset(priv, 0, sizeof(*priv));
+
+	res = &priv->modem;
+	strncpy(res->port, port, sizeof(res->port) - 1);
+	res->port[sizeof(res->port) - 1] = 0;
+	res->reg.state.state_wwan = MODEM_STATE_WWAN_UKNOWN;
+	res->init = MODEM_INIT_PENDING;
+
+	pthread_mutex_init(&priv->state_lock, NULL);
+	seqlock_init(&priv->state_seq);
+	modem_state_publish(res);
+
+	/* device is waited for 10 times after power on */
+	priv->init_tries = __INIT_TRIES;
+
+	/* adding modem in pull */
+	if(!(item = malloc(sizeof(*item))))
 	{
-		res->reg.terminate = 1;
+		free(priv);
+		res = NULL;
 
-		pthread_join(res->reg.thread, &thread_res);
+		goto exit;
 	}
 
-	/* termination scan routine */
-	if(res->scan.thread)
-		pthread_join(res->scan.thread, &thread_res);
+	item->modem = res;
+	item->next = modems;
+	modems = item;
 
-	/* destroying queues */
-	modem_queues_destroy(res);
+	/* blocking work of one modem can't delay other modems */
+	if(sched_threads_grow(sched, __SCHED_THREADS + (n + 1) * __SCHED_THREADS_MODEM))
+		printf("(WW) Failed to add workers of scheduler for port %s\n", res->port);
 
-err:
-	/* cleanup resources */
-	port_power(port, 0);
+	/* device, driver and queues are prepared in background */
+	sched_timer_add(sched, &priv->init, "init", res->port, modem_init_step, priv);
+	sched_timer_at(sched, &priv->init, clock_ms());
 
-	free(res);
+exit:
+	pthread_mutex_unlock(&modems_lock);
 
-	return(NULL);
+	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
 void modem_close(modem_t* modem)
 {
-	modem_list_t* item, *prev;
+	modem_int_t* priv = modem_int(modem);
+	modem_list_t* item, **prev;
 	void* thread_res;
 
 	if(!modem)
 		return;
 
+	pthread_mutex_lock(&modems_lock);
+
 	/* decrements modem clients */
 	if(modem->refs > 0)
 	{
 		-- modem->refs;
 
+		pthread_mutex_unlock(&modems_lock);
+
 		return;
 	}
 
-	/* termination registration routine */
-	if(modem->reg.thread)
+	/* removing modem from list */
+	for(prev = &modems; (item = *prev); prev = &item->next)
 	{
-		modem->reg.terminate = 1;
+		if(modem == item->modem)
+		{
+			*prev = item->next;
 
-		pthread_join(modem->reg.thread, &thread_res);
+			free(item);
+
+			break;
+		}
 	}
 
-	/* termination scan routine */
-	if(modem->scan.thread)
-		pthread_join(modem->scan.thread, &thread_res);
+	pthread_mutex_unlock(&modems_lock);
 
-	/* destroing queues */
-	modem_queues_destroy(modem);
+	/* running step of opening is finished */
+	sched_timer_del(sched, &priv->init);
 
-	/* power off modem */
-	port_power(modem->port, 0);
+	if(modem->init == MODEM_INIT_READY)
+	{
+		/* watchdog recovers modem by registration routine */
+		watchdog_stop(modem);
 
-	free(modem);
+		/* termination registration routine */
+		registration_stop(modem);
 
-	/* removing modem from list */
-	for(prev = item = modems; item; prev = item, item = item->next)
-	{
-		if(modem == item->modem)
-		{
-			if(item == modems)
-				modems = item->next;
-			else
-				prev->next = item->next;
+		/* termination scan routine */
+		if(modem->scan.thread)
+			pthread_join(modem->scan.thread, &thread_res);
 
-			free(item);
+		modem_shm_destroy(modem);
 
-			break;
-		}
+		/* destroing queues */
+		modem_queues_destroy(modem);
 	}
+
+	/* power off modem, failed modem is powered off already */
+	if(modem->init != MODEM_INIT_FAILED)
+		port_power(modem->port, 0);
+
+	pthread_mutex_destroy(&priv->state_lock);
+
+	free(priv);
+}
+
+/*------------------------------------------------------------------------*/
+
+modem_init_state_t modem_init_wait(modem_t* modem, uint32_t timeout_ms)
+{
+	uint64_t deadline = clock_ms() + timeout_ms;
+	modem_init_state_t res;
+	struct timespec ts;
+
+	ts.tv_sec = deadline / 1000;
+	ts.tv_nsec = deadline % 1000 * 1000000;
+
+	pthread_mutex_lock(&modems_lock);
+
+	while(modem->init < MODEM_INIT_READY && timeout_ms)
+		if(pthread_cond_timedwait(&modems_cond, &modems_lock, &ts) == ETIMEDOUT)
+			break;
+
+	res = modem->init;
+
+	pthread_mutex_unlock(&modems_lock);
+
+	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
 char* modem_get_imei(modem_t* modem, char* imei, int len)
 {
-	if(!*modem->reg.state.imei)
+	struct cached_s state;
+
+	modem_state_read(modem, &state);
+
+	if(!*state.imei)
 		return(NULL);
 
-	strncpy(imei, modem->reg.state.imei, len - 1);
+	strncpy(imei, state.imei, len - 1);
 	imei[len - 1] = 0;
 
 	return(imei);
@@ -240,10 +464,14 @@ char* modem_get_imei(modem_t* modem, char* imei, int len)
 
 int modem_get_signal_quality(modem_t* modem, modem_signal_quality_t* sq)
 {
+	struct cached_s state;
+
+	registration_read(modem, MODEM_STATUS_SQ);
+
 	if(!modem->reg.ready)
 		return(-1);
 
-	memcpy(sq, &modem->reg.state.sq, sizeof(*sq));
+	memcpy(sq, &modem_state_read(modem, &state)->sq, sizeof(*sq));
 
 	return(0);
 }
@@ -264,10 +492,14 @@ time_t modem_get_network_time(modem_t* modem)
 
 char* modem_get_imsi(modem_t* modem, char* imsi, int len)
 {
-	if(!*modem->reg.state.imsi)
+	struct cached_s state;
+
+	modem_state_read(modem, &state);
+
+	if(!*state.imsi)
 		return(NULL);
 
-	strncpy(imsi, modem->reg.state.imsi, len - 1);
+	strncpy(imsi, state.imsi, len - 1);
 	imsi[len - 1] = 0;
 
 	return(imsi);
@@ -277,13 +509,19 @@ char* modem_get_imsi(modem_t* modem, char* imsi, int len)
 
 char* modem_get_operator_name(modem_t* modem, char *oper, int len)
 {
+	struct cached_s state;
+
+	registration_read(modem, MODEM_STATUS_OPER);
+
 	if(!modem->reg.ready)
 		return(NULL);
 
-	if(*modem->reg.state.oper)
-		strncpy(oper, modem->reg.state.oper, len - 1);
-	else if(*modem->reg.state.oper_number)
-		strncpy(oper, modem->reg.state.oper_number, len - 1);
+	modem_state_read(modem, &state);
+
+	if(*state.oper)
+		strncpy(oper, state.oper, len - 1);
+	else if(*state.oper_number)
+		strncpy(oper, state.oper_number, len - 1);
 	else
 		return(NULL);
 	
@@ -296,17 +534,25 @@ char* modem_get_operator_name(modem_t* modem, char *oper, int len)
 
 modem_network_reg_t modem_network_registration(modem_t* modem)
 {
-	return(modem->reg.state.reg);
+	struct cached_s state;
+
+	registration_read(modem, MODEM_STATUS_REG);
+
+	return(modem_state_read(modem, &state)->reg);
 }
 
 /*------------------------------------------------------------------------*/
 
 char* modem_get_network_type(modem_t* modem, char *network, int len)
 {
+	struct cached_s state;
+
+	registration_read(modem, MODEM_STATUS_NETWORK_TYPE);
+
 	if(!modem->reg.ready)
 		return(NULL);
 
-	strncpy(network, modem->reg.state.network_type, len - 1);
+	strncpy(network, modem_state_read(modem, &state)->network_type, len - 1);
 	network[len - 1] = 0;
 
 	return(network);
@@ -323,10 +569,14 @@ int modem_change_pin(modem_t* modem, const char* old_pin, const char* new_pin)
 
 modem_fw_ver_t* modem_get_fw_version(modem_t* modem, modem_fw_ver_t* fw_info)
 {
-	if(!modem->reg.state.fw_info.release)
+	struct cached_s state;
+
+	modem_state_read(modem, &state);
+
+	if(!state.fw_info.release)
 		return(NULL);
 
-	return(memcpy(fw_info, &modem->reg.state.fw_info, sizeof(*fw_info)));
+	return(memcpy(fw_info, &state.fw_info, sizeof(*fw_info)));
 }
 
 /*------------------------------------------------------------------------*/
@@ -350,6 +600,7 @@ int modem_operator_scan(modem_t* modem, modem_oper_t** opers)
 int modem_operator_scan_start(modem_t* modem, const char* file)
 {
 	modem_thread_operator_scan_t* priv;
+	pthread_t thread;
 	int res = 0;
 
 	if(modem->scan.thread)
@@ -364,8 +615,10 @@ int modem_operator_scan_start(modem_t* modem, const char* file)
 	priv->modem = modem;
 
 	/* creating thread with a query AT+COPS=? */
-	if((res = pthread_create(&modem->scan.thread, NULL, modem_thread_operator_scan, priv)))
+	if((res = pthread_create(&thread, NULL, modem_thread_operator_scan, priv)))
 		free(priv);
+	else
+		modem->scan.thread = thread;
 
 exit:
 	return(res);
@@ -407,6 +660,64 @@ int modem_get_cell_id(modem_t* modem)
 
 /*------------------------------------------------------------------------*/
 
+#define __STATUS_STR(dst, src) \
+	do { strncpy(dst, src, sizeof(dst) - 1); dst[sizeof(dst) - 1] = 0; } while(0)
+
+modem_status_t* modem_status_snapshot(modem_t* modem, modem_status_t* status)
+{
+	struct cached_s state;
+	uint64_t now = clock_ms();
+	int i;
+
+	modem_state_read(modem, &state);
+
+	memset(status, 0, sizeof(*status));
+
+	status->version = MODEM_STATUS_VERSION;
+	status->ready = modem->reg.ready;
+	status->last_error = modem->reg.last_error;
+
+	status->reg = state.reg;
+	status->sq = state.sq;
+
+	__STATUS_STR(status->oper, *state.oper ? state.oper : state.oper_number);
+	__STATUS_STR(status->network_type, state.network_type);
+	__STATUS_STR(status->firmware, state.fw_info.firmware);
+	status->fw_release = state.fw_info.release;
+	__STATUS_STR(status->imei, state.imei);
+	__STATUS_STR(status->imsi, state.imsi);
+	__STATUS_STR(status->ccid, state.ccid);
+
+	for(i = 0; i < MODEM_STATUS_AGES; ++ i)
+	{
+		if(i >= MODEM_STATUS_FIELDS || !state.updated[i])
+			status->age[i] = MODEM_STATUS_AGE_NONE;
+		else if(now - state.updated[i] >= MODEM_STATUS_AGE_NONE)
+			status->age[i] = MODEM_STATUS_AGE_NONE - 1;
+		else
+			status->age[i] = now - state.updated[i];
+	}
+
+	return(status);
+}
+
+#undef __STATUS_STR
+
+/*------------------------------------------------------------------------*/
+
+modem_status_t* modem_get_status(modem_t* modem, modem_status_t* status)
+{
+	/* snapshot reads all polled values */
+	registration_read(modem, MODEM_STATUS_REG);
+	registration_read(modem, MODEM_STATUS_SQ);
+	registration_read(modem, MODEM_STATUS_OPER);
+	registration_read(modem, MODEM_STATUS_NETWORK_TYPE);
+
+	return(modem_status_snapshot(modem, status));
+}
+
+/*------------------------------------------------------------------------*/
+
 char* modem_at_command(modem_t* modem, const char* query)
 {
 	at_queue_t* at_q = modem_proto_get(modem, MODEM_PROTO_AT);
@@ -436,6 +747,9 @@ char* modem_at_command(modem_t* modem, const char* query)
 
 	at_query_free(q);
 
+	/* any setting of modem may be changed by raw command */
+	modem_invalidate(modem);
+
 	return(cmd);
 }
 
@@ -450,27 +764,46 @@ int modem_get_last_error(modem_t* modem)
 
 void modem_conf_reload(modem_t* modem)
 {
-	const modem_info_device_t* mdd = modem->mdd;
-	void* thread_res;
+	/* routine starts again with new config */
+	if(sched && registration_restart(modem, sched) < 0)
+		printf("(EE) Failed to start registration on port %s\n", modem->port);
+}
 
-	if(!modem->reg.thread)
-		return;
+/*------------------------------------------------------------------------*/
 
-	modem->reg.terminate = 1;
-	pthread_join(modem->reg.thread, &thread_res);
+void modem_notify_set(modem_notify_func_t func)
+{
+	notify_func = func;
+}
 
-	modem->reg.terminate = 0;
+/*------------------------------------------------------------------------*/
 
-	/* starting registration routine */
-	if(mdd && mdd->thread_reg)
-		pthread_create(&modem->reg.thread, NULL, (pthread_func_t)mdd->thread_reg, modem);
-	else
-		modem->reg.thread = 0;
+void modem_notify(modem_t* modem)
+{
+	modem_shm_update(modem);
+
+	if(notify_func)
+		notify_func(modem);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_invalidate_set(modem_notify_func_t func)
+{
+	invalidate_func = func;
 }
 
 /*------------------------------------------------------------------------*/
 
-void modem_reset(modem_t* modem)
+void modem_invalidate(modem_t* modem)
+{
+	if(invalidate_func)
+		invalidate_func(modem);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_reset(modem_t* modem, modem_recover_t how)
 {
 	void *thread_res;
 
@@ -478,16 +811,112 @@ void modem_reset(modem_t* modem)
 	if(modem->scan.thread)
 		pthread_join(modem->scan.thread, &thread_res);
 
+	/* command is sent while queues are working */
+	if(how == MODEM_RECOVER_SOFT_RESET &&
+		at_raw_ok(modem, modem->usb.id_vendor == __VENDOR_SIERRA ? "AT!RESET\r\n" : "AT+CFUN=1,1\r\n"))
+		printf("(WW) Soft reset of modem on port %s is failed\n", modem->port);
+
 	/* suspend queues */
 	modem_queues_suspend(modem);
 
 	/* reseting modem */
-	port_reset(modem->port);
+	if(how == MODEM_RECOVER_USB_RESET)
+		port_usb_reset(modem->port);
+	else if(how != MODEM_RECOVER_SOFT_RESET)
+		port_reset(modem->port);
+}
 
-	sleep(10);
+/*------------------------------------------------------------------------*/
 
+void modem_reset_done(modem_t* modem)
+{
 	/* resume queues */
 	modem_queues_resume(modem);
+
+	modem_invalidate(modem);
+}
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	modemd_sched_stats_t* stats;
+
+	int max;
+
+	int n;
+
+	uint64_t now;
+} modem_sched_stats_t;
+
+/*------------------------------------------------------------------------*/
+
+static void modem_sched_stats_timer(const sched_timer_t* timer, void* prm)
+{
+	modem_sched_stats_t* priv = prm;
+	modemd_sched_stats_t* res;
+
+	if(priv->n >= priv->max)
+		return;
+
+	res = &priv->stats[priv->n ++];
+
+	snprintf(res->port, sizeof(res->port), "%s", timer->owner);
+	snprintf(res->name, sizeof(res->name), "%s", timer->name);
+
+	res->next_ms = timer->pending ? (int64_t)(timer->deadline - priv->now) : INT64_MAX;
+	res->runs = timer->runs;
+	res->late_last_us = timer->late_last_us;
+	res->late_avg_us = timer->runs ? timer->late_us / timer->runs : 0;
+	res->late_max_us = timer->late_max_us;
+	res->run_max_us = timer->run_max_us;
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_sched_stats(modemd_sched_stats_t* stats, int max)
+{
+	modem_sched_stats_t priv = {stats, max, 0, clock_ms()};
+
+	if(sched)
+		sched_timers_foreach(sched, modem_sched_stats_timer, &priv);
+
+	return(priv.n);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_reg_stats(modem_t* modem, modem_reg_state_stats_t* stats, int max)
+{
+	return(registration_stats(modem, stats, max));
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_poll_stats(modem_t* modem, modem_poll_stats_t* stats, int max)
+{
+	return(registration_poll_stats(modem, stats, max));
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_reg_timeline(modem_t* modem, modem_reg_timeline_t* timeline, int max)
+{
+	return(registration_timeline(modem, timeline, max));
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_reg_retries(modem_t* modem, modem_reg_retry_t* trace, int max)
+{
+	return(registration_retry_trace(modem, trace, max));
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_watchdog_stats(modem_t* modem, modem_watchdog_stats_t* stats, int max)
+{
+	return(watchdog_stats(modem, stats, max));
 }
 
 /*------------------------------------------------------------------------*/
@@ -555,8 +984,29 @@ int modem_stop_wwan(modem_t* modem)
 modem_state_wwan_t modem_state_wwan(modem_t* modem)
 {
 	const modem_info_device_t* mdd = modem->mdd;
+	modem_int_t* priv = modem_int(modem);
+	modem_state_wwan_t res;
 
-	return(mdd->functions.state_wwan(modem));
+	res = mdd->functions.state_wwan(modem);
+
+	/* keep for subscribers */
+	if(modem->reg.state.state_wwan != res)
+	{
+		modem->reg.state.state_wwan = res;
+
+		/* other values may be written by registration routine meanwhile */
+		pthread_mutex_lock(&priv->state_lock);
+
+		seqlock_write_begin(&priv->state_seq);
+		priv->state.state_wwan = res;
+		seqlock_write_end(&priv->state_seq);
+
+		pthread_mutex_unlock(&priv->state_lock);
+
+		modem_notify(modem);
+	}
+
+	return(res);
 }
 
 /*------------------------------------------------------------------------*/
@@ -0,0 +1,203 @@
+#ifndef __MODEM_INT_H
+#define __MODEM_INT_H
+
+#include "modem/types.h"
+
+/***************************************************************************
+
+	Functions of libmodem available only inside of the daemon.
+
+***************************************************************************/
+
+/** called when cached values of modem may be changed */
+typedef void (*modem_notify_func_t)(modem_t* modem);
+
+/** recovery of modem, from the lightest to the heaviest */
+typedef enum
+{
+	MODEM_RECOVER_NONE = 0,
+
+	/** garbage in channels is dropped */
+	MODEM_RECOVER_REQUEUE,
+
+	/** channels are closed and opened again */
+	MODEM_RECOVER_REOPEN,
+
+	/** modem is reset by command */
+	MODEM_RECOVER_SOFT_RESET,
+
+	/** device is enumerated again by USB core */
+	MODEM_RECOVER_USB_RESET,
+
+	/** port is powered off and on */
+	MODEM_RECOVER_POWER_CYCLE
+} modem_recover_t;
+
+/*------------------------------------------------------------------------*/
+
+/** state of modem kept by daemon, it is not sent to clients */
+typedef struct
+{
+	/** registration routine executed by scheduler */
+	void* routine;
+
+	/** watchdog executed by scheduler */
+	void* watchdog;
+
+	/** status page in shared memory */
+	void* shm;
+
+	/** events subscribed by clients, MODEM_EVENT_* */
+	uint32_t events;
+
+	/** monotonic time of last read by clients in ms, by MODEM_STATUS_* */
+	uint64_t read[MODEM_STATUS_FIELDS];
+} modem_priv_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief return state of modem kept by daemon
+ * @param modem modem opened by modem_open_by_port()
+ * @return state
+ */
+modem_priv_t* modem_priv(modem_t* modem);
+
+/**
+ * @brief set handler of changes of cached values
+ * @param func handler, NULL to disable
+ */
+void modem_notify_set(modem_notify_func_t func);
+
+/**
+ * @brief report that cached values of modem may be changed
+ * @param modem modem
+ *
+ * Handler is called in the thread of caller, so it must be fast
+ */
+void modem_notify(modem_t* modem);
+
+/**
+ * @brief wait for the end of opening of modem
+ * @param modem modem
+ * @param timeout_ms maximal time of waiting, zero to return state at once
+ * @return state of opening, MODEM_INIT_*
+ *
+ * Modem is returned by modem_open_by_port() at once, device, driver and
+ * queues are prepared by scheduler.
+ */
+modem_init_state_t modem_init_wait(modem_t* modem, uint32_t timeout_ms);
+
+/**
+ * @brief start reset of modem, queues are suspended
+ * @param modem modem
+ * @param how MODEM_RECOVER_SOFT_RESET, MODEM_RECOVER_USB_RESET or MODEM_RECOVER_POWER_CYCLE
+ *
+ * Device is waited for by caller, then reset is finished by modem_reset_done()
+ */
+void modem_reset(modem_t* modem, modem_recover_t how);
+
+/**
+ * @brief finish reset of modem, queues are resumed
+ * @param modem modem
+ */
+void modem_reset_done(modem_t* modem);
+
+/**
+ * @brief return statistics of timers of scheduler
+ * @param stats buffer for statistics
+ * @param max size of buffer
+ * @return number of timers
+ */
+int modem_sched_stats(modemd_sched_stats_t* stats, int max);
+
+/**
+ * @brief return statistics of states of registration routine
+ * @param modem modem
+ * @param stats buffer for statistics
+ * @param max size of buffer
+ * @return number of entered states, -1 if routine is not running
+ */
+int modem_reg_stats(modem_t* modem, modem_reg_state_stats_t* stats, int max);
+
+/**
+ * @brief return statistics of adaptive polling of values
+ * @param modem modem
+ * @param stats buffer for statistics
+ * @param max size of buffer
+ * @return number of values, -1 if routine is not running
+ */
+int modem_poll_stats(modem_t* modem, modem_poll_stats_t* stats, int max);
+
+/**
+ * @brief return timeline of last registration cycles
+ * @param modem modem
+ * @param timeline buffer for transitions
+ * @param max size of buffer
+ * @return number of transitions, -1 if routine is not running
+ */
+int modem_reg_timeline(modem_t* modem, modem_reg_timeline_t* timeline, int max);
+
+/**
+ * @brief return last retry decisions of registration routine
+ * @param modem modem
+ * @param trace buffer for decisions
+ * @param max size of buffer
+ * @return number of decisions, -1 if routine is not running
+ */
+int modem_reg_retries(modem_t* modem, modem_reg_retry_t* trace, int max);
+
+/**
+ * @brief return statistics of probes and steps of recovery of watchdog
+ * @param modem modem
+ * @param stats buffer for statistics
+ * @param max size of buffer
+ * @return number of probes and steps, -1 if watchdog is not running
+ */
+int modem_watchdog_stats(modem_t* modem, modem_watchdog_stats_t* stats, int max);
+
+/**
+ * @brief publish cached values of modem for readers
+ * @param modem modem
+ *
+ * Registration routine updates modem->reg.state in place and then publishes
+ * whole copy, readers never see a partially written value. Only the routine
+ * writes modem->reg.state, so only it may publish it.
+ */
+void modem_state_publish(modem_t* modem);
+
+/**
+ * @brief read published cached values of modem
+ * @param modem modem
+ * @param state buffer for values
+ * @return state
+ *
+ * Reader takes no lock, it retries only if values are published meanwhile.
+ */
+struct cached_s* modem_state_read(modem_t* modem, struct cached_s* state);
+
+/**
+ * @brief fill snapshot of status of modem for the daemon itself
+ * @param modem modem
+ * @param status buffer for snapshot
+ * @return status
+ *
+ * Unlike modem_get_status() values are not reported as read by clients.
+ */
+modem_status_t* modem_status_snapshot(modem_t* modem, modem_status_t* status);
+
+/**
+ * @brief set handler of invalidation of values cached by clients
+ * @param func handler, NULL to disable
+ */
+void modem_invalidate_set(modem_notify_func_t func);
+
+/**
+ * @brief report change of values which are not sent by events
+ * @param modem modem
+ *
+ * Clients drop their cached values. Handler is called in the thread of caller
+ */
+void modem_invalidate(modem_t* modem);
+
+#endif /* __MODEM_INT_H */
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "modem/types.h"
+#include "utils/sysfs.h"
+#include "modem_persist.h"
+
+/*------------------------------------------------------------------------*/
+
+/** header of file, strings with length byte follow */
+typedef struct
+{
+	/** MODEM_PERSIST_MAGIC */
+	uint32_t magic;
+
+	/** MODEM_PERSIST_VERSION */
+	uint8_t version;
+
+	/** length of strings after header */
+	uint16_t length;
+
+	/** identity of USB device */
+	uint16_t id_vendor;
+
+	uint16_t id_product;
+
+	/** release of firmware */
+	int64_t release;
+} __attribute__((__packed__)) modem_persist_hdr_t;
+
+/** strings of file: F(string of modem) */
+#define PERSIST_STRINGS(F)		\
+	F(usb.vendor)				\
+	F(usb.product)				\
+	F(reg.state.fw_info.firmware)	\
+	F(reg.state.imei)			\
+	F(reg.state.imsi)			\
+	F(reg.state.ccid)
+
+/** maximal size of file, length of each string fits in one byte */
+#define __PERSIST_MAX (sizeof(modem_persist_hdr_t) + 6 * 0x100)
+
+/*------------------------------------------------------------------------*/
+
+/** path of file of port, zero if it fits in buffer */
+static int persist_path(const modem_t* modem, char* path, int len)
+{
+	int n, m;
+
+	n = snprintf(path, len, MODEM_PERSIST_DIR, sysfs_root());
+
+	/* length of truncated string is beyond buffer */
+	if(n < 0 || n >= len)
+		goto err;
+
+	m = snprintf(path + n, len - n, "/%s", modem->port);
+
+	if(m < 0 || m >= len - n)
+		goto err;
+
+	return(0);
+
+err:
+	printf("(WW) Path of persisted data of port %s is too long\n", modem->port);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** create missing directories of path of file */
+static int persist_mkdir(const char* path)
+{
+	char dir[0x100];
+	char* s;
+
+	snprintf(dir, sizeof(dir), "%s", path);
+
+	for(s = strchr(dir + 1, '/'); s; s = strchr(s + 1, '/'))
+	{
+		*s = 0;
+
+		if(mkdir(dir, 0755) && errno != EEXIST)
+			return(-1);
+
+		*s = '/';
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** append string with length byte, returns new position */
+static uint8_t* persist_put(uint8_t* p, const char* s)
+{
+	size_t len = strnlen(s, 0xff);
+
+	*p ++ = len;
+	memcpy(p, s, len);
+
+	return(p + len);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** read string with length byte, returns new position or NULL if invalid */
+static const uint8_t* persist_get(const uint8_t* p, const uint8_t* end, char* s, size_t size)
+{
+	size_t len;
+
+	if(p >= end || p + 1 + *p > end || *p >= size)
+		return(NULL);
+
+	len = *p ++;
+
+	memcpy(s, p, len);
+	s[len] = 0;
+
+	return(p + len);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_persist_load(modem_t* modem)
+{
+	uint8_t buf[__PERSIST_MAX];
+	const modem_persist_hdr_t* hdr = (const modem_persist_hdr_t*)buf;
+	const uint8_t* p = buf + sizeof(*hdr), *end;
+	char path[0x100];
+	modem_t file;
+	FILE* f;
+	size_t len;
+
+	if(persist_path(modem, path, sizeof(path)))
+		return(-1);
+
+	if(!(f = fopen(path, "r")))
+		return(-1);
+
+	len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+
+	if(len < sizeof(*hdr) || hdr->magic != MODEM_PERSIST_MAGIC || hdr->version != MODEM_PERSIST_VERSION ||
+		len != sizeof(*hdr) + hdr->length)
+	{
+		printf("(WW) Persisted data %s is invalid\n", path);
+
+		return(-1);
+	}
+
+	end = buf + len;
+
+	/* strings are read to a copy, modem is changed only by valid file */
+	memset(&file, 0, sizeof(file));
+
+#define __PERSIST_GET(field)																		\
+	if(!(p = persist_get(p, end, file.field, sizeof(file.field))))										\
+		return(-1);
+
+	PERSIST_STRINGS(__PERSIST_GET)
+
+#undef __PERSIST_GET
+
+	/* file of other device on the same port */
+	if(
+		hdr->id_vendor != modem->usb.id_vendor || hdr->id_product != modem->usb.id_product ||
+		strcmp(file.usb.vendor, modem->usb.vendor) || strcmp(file.usb.product, modem->usb.product)
+	)
+	{
+		printf("(DD) Persisted data of port %s belongs to other device\n", modem->port);
+
+		return(-1);
+	}
+
+	strcpy(modem->reg.state.fw_info.firmware, file.reg.state.fw_info.firmware);
+	modem->reg.state.fw_info.release = hdr->release;
+	strcpy(modem->reg.state.imei, file.reg.state.imei);
+	strcpy(modem->reg.state.imsi, file.reg.state.imsi);
+	strcpy(modem->reg.state.ccid, file.reg.state.ccid);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int modem_persist_save(const modem_t* modem)
+{
+	uint8_t buf[__PERSIST_MAX];
+	modem_persist_hdr_t* hdr = (modem_persist_hdr_t*)buf;
+	uint8_t* p = buf + sizeof(*hdr);
+	char path[0x100], tmp[0x100 + 4];
+	FILE* f;
+
+	memset(hdr, 0, sizeof(*hdr));
+
+	hdr->magic = MODEM_PERSIST_MAGIC;
+	hdr->version = MODEM_PERSIST_VERSION;
+	hdr->id_vendor = modem->usb.id_vendor;
+	hdr->id_product = modem->usb.id_product;
+	hdr->release = modem->reg.state.fw_info.release;
+
+#define __PERSIST_PUT(field) p = persist_put(p, modem->field);
+
+	PERSIST_STRINGS(__PERSIST_PUT)
+
+#undef __PERSIST_PUT
+
+	hdr->length = p - buf - sizeof(*hdr);
+
+	if(persist_path(modem, path, sizeof(path)))
+		goto err;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	if(persist_mkdir(path))
+		goto err;
+
+	if(!(f = fopen(tmp, "w")))
+		goto err;
+
+	if(fwrite(buf, 1, p - buf, f) != p - buf)
+	{
+		fclose(f);
+
+		goto err_write;
+	}
+
+	if(fclose(f))
+		goto err_write;
+
+	/* old file is replaced at once */
+	if(rename(tmp, path))
+		goto err_write;
+
+	return(0);
+
+err_write:
+	unlink(tmp);
+
+err:
+	printf("(WW) Failed to persist data of port %s\n", modem->port);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_persist_drop(const modem_t* modem)
+{
+	char path[0x100];
+
+	if(!persist_path(modem, path, sizeof(path)))
+		unlink(path);
+}
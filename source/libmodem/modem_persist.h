@@ -0,0 +1,46 @@
+#ifndef __MODEM_PERSIST_H
+#define __MODEM_PERSIST_H
+
+#include "modem/types.h"
+
+/***************************************************************************
+
+	Values of modem valid per session (firmware, IMEI, IMSI and CCID) kept
+	on disk per port, so they are known at once after restart of daemon.
+	File is valid only for the same USB device, values are validated by
+	registration routine.
+
+***************************************************************************/
+
+/** directory of persisted data, root of daemon is inserted */
+#define MODEM_PERSIST_DIR "%s/var/lib/modemd"
+
+#define MODEM_PERSIST_MAGIC 0x4d4d5044 /* MMPD */
+
+#define MODEM_PERSIST_VERSION 1
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief read persisted values of modem to its state
+ * @param modem modem with known USB device
+ * @return zero if values are read
+ */
+int modem_persist_load(modem_t* modem);
+
+/**
+ * @brief write values of modem valid per session
+ * @param modem modem
+ * @return zero if successful
+ *
+ * File is replaced at once, reader never sees a partial file.
+ */
+int modem_persist_save(const modem_t* modem);
+
+/**
+ * @brief remove persisted values of modem
+ * @param modem modem
+ */
+void modem_persist_drop(const modem_t* modem);
+
+#endif /* __MODEM_PERSIST_H */
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "modem/modem.h"
+#include "modem_shm.h"
+#include "modem_int.h"
+#include "utils/clock.h"
+
+/*------------------------------------------------------------------------*/
+
+/** page published by the daemon */
+typedef struct
+{
+	modem_shm_page_t* page;
+
+	/** serializes writers of page */
+	pthread_mutex_t lock;
+
+	char path[0x100];
+} modem_shm_t;
+
+/*------------------------------------------------------------------------*/
+
+int modem_shm_create(modem_t* modem)
+{
+	modem_shm_t* shm;
+	int fd;
+
+	if(!(shm = malloc(sizeof(*shm))))
+		goto err;
+
+	snprintf(shm->path, sizeof(shm->path), MODEM_SHM_PATH, modem->port);
+
+	if((fd = open(shm->path, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0)
+		goto err_open;
+
+	if(ftruncate(fd, sizeof(*shm->page)))
+		goto err_map;
+
+	if((shm->page = mmap(NULL, sizeof(*shm->page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		goto err_map;
+
+	close(fd);
+
+	pthread_mutex_init(&shm->lock, NULL);
+
+	seqlock_init(&shm->page->lock);
+	shm->page->size = sizeof(*shm->page);
+
+	modem_priv(modem)->shm = shm;
+
+	/* the first status is written before the page becomes valid */
+	modem_shm_update(modem);
+
+	__atomic_store_n(&shm->page->magic, MODEM_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return(0);
+
+err_map:
+	close(fd);
+	unlink(shm->path);
+
+err_open:
+	printf("(WW) Failed to create status page %s\n", shm->path);
+
+	free(shm);
+
+err:
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_shm_update(modem_t* modem)
+{
+	modem_shm_t* shm = modem_priv(modem)->shm;
+	modem_status_t status;
+
+	if(!shm)
+		return;
+
+	/* status is prepared outside of the lock, readers retry less */
+	modem_status_snapshot(modem, &status);
+
+	pthread_mutex_lock(&shm->lock);
+
+	seqlock_write_begin(&shm->page->lock);
+
+	shm->page->written = clock_ms();
+	memcpy(&shm->page->status, &status, sizeof(status));
+
+	seqlock_write_end(&shm->page->lock);
+
+	pthread_mutex_unlock(&shm->lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_shm_destroy(modem_t* modem)
+{
+	modem_shm_t* shm = modem_priv(modem)->shm;
+
+	if(!shm)
+		return;
+
+	modem_priv(modem)->shm = NULL;
+
+	unlink(shm->path);
+	munmap(shm->page, sizeof(*shm->page));
+
+	pthread_mutex_destroy(&shm->lock);
+
+	free(shm);
+}
@@ -0,0 +1,60 @@
+#ifndef __MODEM_SHM_H
+#define __MODEM_SHM_H
+
+#include <stdint.h>
+
+#include "modem/types.h"
+#include "utils/seqlock.h"
+
+/***************************************************************************
+
+	Status page of modem in shared memory, published by the daemon and
+	read by clients without socket traffic.
+
+***************************************************************************/
+
+/** path of status page, modem port is inserted */
+#define MODEM_SHM_PATH "/dev/shm/modemd-%s"
+
+#define MODEM_SHM_MAGIC 0x4d4d5350 /* MMSP */
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** MODEM_SHM_MAGIC, written after the first update */
+	uint32_t magic;
+
+	/** size of page, may grow with version of status */
+	uint32_t size;
+
+	seqlock_t lock;
+
+	/** monotonic time of writing in ms, ages of status are relative to it */
+	uint64_t written;
+
+	modem_status_t status;
+} modem_shm_page_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief create status page of modem
+ * @param modem modem
+ * @return zero if successful
+ */
+int modem_shm_create(modem_t* modem);
+
+/**
+ * @brief write current status of modem to its page
+ * @param modem modem
+ */
+void modem_shm_update(modem_t* modem);
+
+/**
+ * @brief remove status page of modem
+ * @param modem modem
+ */
+void modem_shm_destroy(modem_t* modem);
+
+#endif /* __MODEM_SHM_H */
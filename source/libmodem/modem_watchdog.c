@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+
+#include "modem/types.h"
+
+#include "utils/clock.h"
+#include "utils/sysfs.h"
+
+#include "proto.h"
+#include "modem_int.h"
+#include "modem_watchdog.h"
+
+#include "at/at_queue.h"
+#include "at/at_common.h"
+
+#include "modems/registration.h"
+
+#ifdef __QCQMI
+#	include "qcqmi/qcqmi_common.h"
+#endif /* __QCQMI */
+
+/*------------------------------------------------------------------------*/
+
+/** results of probe */
+typedef enum
+{
+	/** modem is alive */
+	WD_PASS = 0,
+
+	/** modem is not responding */
+	WD_FAIL,
+
+	/** probe is not applicable or modem is alive by other traffic */
+	WD_SKIP,
+
+	/** modem is being reset, it can't be probed */
+	WD_WAIT
+} wd_result_t;
+
+typedef struct
+{
+	modem_t* modem;
+
+	sched_t* sched;
+
+	sched_timer_t check;
+
+	/** probe at once without proofs of other traffic */
+	int kicked;
+
+	/** step of recovery in progress, -1 if modem is alive */
+	int step;
+
+	/** failed probe, recovery is finished when it passes */
+	wd_probe_id_t failed;
+
+	/** time of detection of failure, ms */
+	uint64_t detected;
+
+	/** time of start and deadline of step of recovery, ms */
+	uint64_t started;
+	uint64_t deadline;
+
+	struct
+	{
+		/** time of next probe, ms */
+		uint64_t next;
+
+		/** consecutive failures */
+		int failures;
+
+		uint32_t runs;
+		uint32_t failed;
+		uint64_t time_ms;
+		uint32_t time_max_ms;
+	} probes[WP_COUNT];
+
+	struct
+	{
+		uint32_t runs;
+		uint32_t failed;
+		uint64_t time_ms;
+		uint32_t time_max_ms;
+	} steps[WR_COUNT];
+} watchdog_t;
+
+/*------------------------------------------------------------------------*/
+
+static const char* WD_PROBE_STR[WP_COUNT] =
+{
+#define __WD_PROBE(probe, period) [probe] = #probe,
+	WD_PROBES(__WD_PROBE)
+#undef __WD_PROBE
+};
+
+static const uint32_t wd_periods[WP_COUNT] =
+{
+#define __WD_PROBE(probe, period) [probe] = period * 1000,
+	WD_PROBES(__WD_PROBE)
+#undef __WD_PROBE
+};
+
+static const struct
+{
+	const char* name;
+
+	modem_recover_t recover;
+
+	/** time given to step, ms */
+	uint32_t time;
+} wd_steps[WR_COUNT] =
+{
+#define __WD_STEP(step, recover, time) [step] = {#step, recover, time * 1000},
+	WD_STEPS(__WD_STEP)
+#undef __WD_STEP
+};
+
+/** watchdog of modem is changed and read by threads of clients */
+static pthread_mutex_t wd_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*------------------------------------------------------------------------*/
+
+/** tty of AT commands is present and not hung up */
+static wd_result_t wd_probe_tty(watchdog_t* ctx, int force)
+{
+	modem_t* modem = ctx->modem;
+	const modem_info_device_t* mdd = modem->mdd;
+	at_queue_t* at_q;
+	struct pollfd p;
+	char dev[0x100];
+	int i;
+
+	if(!(at_q = modem_proto_get(modem, MODEM_PROTO_AT)))
+		return(WD_SKIP);
+
+	/* tty is closed by reset */
+	if((p.fd = at_q->fd) < 0)
+		return(WD_WAIT);
+
+	for(i = 0; i < __MODEM_IFACE_MAX && mdd->iface[i].type; ++ i)
+	{
+		if(mdd->iface[i].type != MODEM_PROTO_AT)
+			continue;
+
+		if(!modem_get_iface_dev(modem->port, "tty", mdd->iface[i].num, dev, sizeof(dev)) || access(dev, R_OK | W_OK))
+			return(WD_FAIL);
+	}
+
+	/* device is gone under opened tty */
+	p.events = POLLIN;
+	p.revents = 0;
+
+	if(poll(&p, 1, 0) > 0 && (p.revents & (POLLERR | POLLHUP | POLLNVAL)))
+		return(WD_FAIL);
+
+	return(WD_PASS);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** modem replies to bare AT */
+static wd_result_t wd_probe_at(watchdog_t* ctx, int force)
+{
+	at_queue_t* at_q;
+	uint64_t last_read;
+
+	if(!(at_q = modem_proto_get(ctx->modem, MODEM_PROTO_AT)))
+		return(WD_SKIP);
+
+	if(at_q->fd < 0)
+		return(WD_WAIT);
+
+	/* replies to other commands prove that modem is alive */
+	last_read = __atomic_load_n(&at_q->last_read, __ATOMIC_RELAXED);
+
+	if(!force && last_read && clock_ms() - last_read < wd_periods[WP_AT])
+		return(WD_SKIP);
+
+	return(at_ping(ctx->modem) ? WD_FAIL : WD_PASS);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** modem answers QMI request */
+static wd_result_t wd_probe_qmi(watchdog_t* ctx, int force)
+{
+#ifdef __QCQMI
+	if(modem_proto_get(ctx->modem, MODEM_PROTO_QCQMI))
+		return(qcqmi_ping(ctx->modem) ? WD_FAIL : WD_PASS);
+#endif /* __QCQMI */
+
+	return(WD_SKIP);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** network interface of connected WWAN is up */
+static wd_result_t wd_probe_wwan(watchdog_t* ctx, int force)
+{
+	struct cached_s state;
+	int link;
+
+	if(modem_state_read(ctx->modem, &state)->state_wwan != MODEM_STATE_WWAN_CONNECTED)
+		return(WD_SKIP);
+
+	if((link = usb_device_net_state(ctx->modem->port)) < 0)
+		return(WD_SKIP);
+
+	return(link ? WD_PASS : WD_FAIL);
+}
+
+/*------------------------------------------------------------------------*/
+
+static wd_result_t (* const wd_probes[WP_COUNT])(watchdog_t* ctx, int force) =
+{
+	[WP_TTY] = wd_probe_tty,
+	[WP_AT] = wd_probe_at,
+	[WP_QMI] = wd_probe_qmi,
+	[WP_WWAN] = wd_probe_wwan,
+};
+
+/*------------------------------------------------------------------------*/
+
+/** execute probe and account its time */
+static wd_result_t wd_probe(watchdog_t* ctx, wd_probe_id_t probe, int force)
+{
+	uint64_t start = clock_ms(), time;
+	wd_result_t res;
+
+	res = wd_probes[probe](ctx, force);
+
+	/* only executed probes are accounted */
+	if(res != WD_PASS && res != WD_FAIL)
+		return(res);
+
+	time = clock_ms() - start;
+
+	__atomic_add_fetch(&ctx->probes[probe].runs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&ctx->probes[probe].time_ms, time, __ATOMIC_RELAXED);
+
+	if(time > ctx->probes[probe].time_max_ms)
+		__atomic_store_n(&ctx->probes[probe].time_max_ms, time, __ATOMIC_RELAXED);
+
+	if(res == WD_FAIL)
+		__atomic_add_fetch(&ctx->probes[probe].failed, 1, __ATOMIC_RELAXED);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** account time of current step of recovery */
+static void wd_step_leave(watchdog_t* ctx, uint64_t now, int failed)
+{
+	uint64_t time = now - ctx->started;
+
+	__atomic_add_fetch(&ctx->steps[ctx->step].time_ms, time, __ATOMIC_RELAXED);
+
+	if(time > ctx->steps[ctx->step].time_max_ms)
+		__atomic_store_n(&ctx->steps[ctx->step].time_max_ms, time, __ATOMIC_RELAXED);
+
+	if(failed)
+		__atomic_add_fetch(&ctx->steps[ctx->step].failed, 1, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** start step of recovery */
+static void wd_step_enter(watchdog_t* ctx, wd_step_id_t step, uint64_t now)
+{
+	modem_t* modem = ctx->modem;
+
+	printf("(WW) Watchdog of port %s: %s failed, recovery by %s\n", modem->port,
+		WD_PROBE_STR[ctx->failed], wd_steps[step].name);
+
+	ctx->started = now;
+	ctx->deadline = now + wd_steps[step].time;
+
+	__atomic_add_fetch(&ctx->steps[step].runs, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ctx->step, step, __ATOMIC_RELAXED);
+
+	if(registration_recover(modem, wd_steps[step].recover))
+		printf("(EE) Watchdog of port %s: registration is not running\n", modem->port);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** modem is alive, probes are executed by their periods */
+static void wd_check_alive(watchdog_t* ctx, int force, uint64_t now)
+{
+	wd_result_t res;
+	int i;
+
+	for(i = 0; i < WP_COUNT; ++ i)
+	{
+		if(!force && now < ctx->probes[i].next)
+			continue;
+
+		ctx->probes[i].next = now + wd_periods[i];
+
+		if((res = wd_probe(ctx, i, force)) == WD_PASS)
+			ctx->probes[i].failures = 0;
+
+		if(res != WD_FAIL)
+			continue;
+
+		/* one failure may be a slow reply, it is confirmed at once */
+		if(++ ctx->probes[i].failures < WD_FAILURES)
+		{
+			ctx->probes[i].next = now + WD_RECOVER_PROBE;
+
+			continue;
+		}
+
+		ctx->probes[i].failures = 0;
+		ctx->failed = i;
+		ctx->detected = now;
+
+		wd_step_enter(ctx, 0, now);
+
+		break;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** modem is recovered, failed probe is executed every second */
+static void wd_check_recovery(watchdog_t* ctx, uint64_t now)
+{
+	modem_t* modem = ctx->modem;
+	wd_result_t res;
+	int i;
+
+	/* skipped probe has no reason to fail anymore */
+	if((res = wd_probe(ctx, ctx->failed, 1)) == WD_PASS || res == WD_SKIP)
+	{
+		now = clock_ms();
+
+		wd_step_leave(ctx, now, 0);
+
+		printf("(DD) Watchdog of port %s: recovered by %s in %llu ms\n", modem->port,
+			wd_steps[ctx->step].name, (unsigned long long)(now - ctx->detected));
+
+		__atomic_store_n(&ctx->step, -1, __ATOMIC_RELAXED);
+
+		for(i = 0; i < WP_COUNT; ++ i)
+			ctx->probes[i].next = now + wd_periods[i];
+
+		return;
+	}
+
+	if(now < ctx->deadline)
+		return;
+
+	wd_step_leave(ctx, now, 1);
+
+	/* the heaviest step is repeated */
+	wd_step_enter(ctx, ctx->step + 1 < WR_COUNT ? ctx->step + 1 : WR_COUNT - 1, now);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void wd_check(void* prm)
+{
+	watchdog_t* ctx = prm;
+	uint64_t now = clock_ms(), next;
+	int force, i;
+
+	force = __atomic_exchange_n(&ctx->kicked, 0, __ATOMIC_RELAXED);
+
+	if(ctx->step < 0)
+		wd_check_alive(ctx, force, now);
+	else
+		wd_check_recovery(ctx, now);
+
+	/* recovery is checked every second, alive modem by the nearest probe */
+	if(ctx->step >= 0)
+		next = clock_ms() + WD_RECOVER_PROBE;
+	else
+		for(next = UINT64_MAX, i = 0; i < WP_COUNT; ++ i)
+			if(ctx->probes[i].next < next)
+				next = ctx->probes[i].next;
+
+	sched_timer_at(ctx->sched, &ctx->check, next);
+}
+
+/*------------------------------------------------------------------------*/
+
+int watchdog_start(modem_t* modem, sched_t* sched)
+{
+	watchdog_t* ctx;
+	uint64_t now = clock_ms();
+	int i;
+
+	if(!(ctx = calloc(1, sizeof(*ctx))))
+		return(-1);
+
+	ctx->modem = modem;
+	ctx->sched = sched;
+	ctx->step = -1;
+
+	/* registration is checked by its own routine first */
+	for(i = 0; i < WP_COUNT; ++ i)
+		ctx->probes[i].next = now + wd_periods[i];
+
+	sched_timer_add(sched, &ctx->check, "watchdog", modem->port, wd_check, ctx);
+
+	pthread_mutex_lock(&wd_lock);
+	modem_priv(modem)->watchdog = ctx;
+	pthread_mutex_unlock(&wd_lock);
+
+	sched_timer_at(sched, &ctx->check, now + wd_periods[WP_TTY]);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void watchdog_stop(modem_t* modem)
+{
+	watchdog_t* ctx;
+
+	pthread_mutex_lock(&wd_lock);
+	ctx = modem_priv(modem)->watchdog;
+	modem_priv(modem)->watchdog = NULL;
+	pthread_mutex_unlock(&wd_lock);
+
+	if(!ctx)
+		return;
+
+	sched_timer_del(ctx->sched, &ctx->check);
+
+	free(ctx);
+}
+
+/*------------------------------------------------------------------------*/
+
+int watchdog_kick(modem_t* modem)
+{
+	watchdog_t* ctx;
+	int res = -1;
+
+	pthread_mutex_lock(&wd_lock);
+
+	if((ctx = modem_priv(modem)->watchdog))
+	{
+		__atomic_store_n(&ctx->kicked, 1, __ATOMIC_RELAXED);
+
+		/* recovery in progress is not hurried */
+		if(__atomic_load_n(&ctx->step, __ATOMIC_RELAXED) < 0)
+			sched_timer_at(ctx->sched, &ctx->check, clock_ms());
+
+		res = 0;
+	}
+
+	pthread_mutex_unlock(&wd_lock);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int watchdog_stats(modem_t* modem, modem_watchdog_stats_t* stats, int max)
+{
+	modem_watchdog_stats_t* res;
+	watchdog_t* ctx;
+	int i, n = -1, step;
+
+	pthread_mutex_lock(&wd_lock);
+
+	if(!(ctx = modem_priv(modem)->watchdog))
+		goto exit;
+
+	step = __atomic_load_n(&ctx->step, __ATOMIC_RELAXED);
+
+	for(n = 0, i = 0; i < WP_COUNT && n < max; ++ i)
+	{
+		res = &stats[n ++];
+
+		memset(res, 0, sizeof(*res));
+
+		snprintf(res->name, sizeof(res->name), "%s", WD_PROBE_STR[i]);
+
+		res->runs = __atomic_load_n(&ctx->probes[i].runs, __ATOMIC_RELAXED);
+		res->failures = __atomic_load_n(&ctx->probes[i].failed, __ATOMIC_RELAXED);
+		res->time_ms = __atomic_load_n(&ctx->probes[i].time_ms, __ATOMIC_RELAXED);
+		res->time_max_ms = __atomic_load_n(&ctx->probes[i].time_max_ms, __ATOMIC_RELAXED);
+		res->current = step >= 0 && ctx->failed == i;
+	}
+
+	for(i = 0; i < WR_COUNT && n < max; ++ i)
+	{
+		res = &stats[n ++];
+
+		memset(res, 0, sizeof(*res));
+
+		snprintf(res->name, sizeof(res->name), "%s", wd_steps[i].name);
+
+		res->runs = __atomic_load_n(&ctx->steps[i].runs, __ATOMIC_RELAXED);
+		res->failures = __atomic_load_n(&ctx->steps[i].failed, __ATOMIC_RELAXED);
+		res->time_ms = __atomic_load_n(&ctx->steps[i].time_ms, __ATOMIC_RELAXED);
+		res->time_max_ms = __atomic_load_n(&ctx->steps[i].time_max_ms, __ATOMIC_RELAXED);
+		res->current = step == i;
+	}
+
+exit:
+	pthread_mutex_unlock(&wd_lock);
+
+	return(n);
+}
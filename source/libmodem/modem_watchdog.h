@@ -0,0 +1,89 @@
+#ifndef __MODEM_WATCHDOG_H
+#define __MODEM_WATCHDOG_H
+
+#include "modem/types.h"
+
+#include "utils/scheduler.h"
+
+/***************************************************************************
+
+	Watchdog checks liveness of modem by cheap probes on its own schedule.
+	Failed modem is recovered by steps from the lightest to the heaviest,
+	each step is given some time and modem is probed every second meanwhile,
+	so recovery ends as soon as the failed probe passes. Recovery itself is
+	made by registration routine, it owns queues of modem.
+
+***************************************************************************/
+
+/* probes: F(probe, period of probe, s) */
+#define WD_PROBES(F)	\
+	F(WP_TTY,	10)		\
+	F(WP_AT,	30)		\
+	F(WP_QMI,	30)		\
+	F(WP_WWAN,	10)
+
+typedef enum
+{
+#define __WD_PROBE(probe, period) probe,
+	WD_PROBES(__WD_PROBE)
+#undef __WD_PROBE
+
+	WP_COUNT
+} wd_probe_id_t;
+
+/* steps of recovery: F(step, recovery, time given to step, s) */
+#define WD_STEPS(F)											\
+	F(WR_REQUEUE,		MODEM_RECOVER_REQUEUE,		3)		\
+	F(WR_REOPEN,		MODEM_RECOVER_REOPEN,		5)		\
+	F(WR_SOFT_RESET,	MODEM_RECOVER_SOFT_RESET,	40)		\
+	F(WR_USB_RESET,		MODEM_RECOVER_USB_RESET,	40)		\
+	F(WR_POWER_CYCLE,	MODEM_RECOVER_POWER_CYCLE,	60)
+
+typedef enum
+{
+#define __WD_STEP(step, recover, time) step,
+	WD_STEPS(__WD_STEP)
+#undef __WD_STEP
+
+	WR_COUNT
+} wd_step_id_t;
+
+/** consecutive failures of probe starting recovery */
+#define WD_FAILURES 2
+
+/** interval of probes while failure is confirmed or modem is recovered, ms */
+#define WD_RECOVER_PROBE 1000
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief start watchdog of modem, its checks are callbacks of scheduler
+ * @param modem modem with running registration routine
+ * @param sched scheduler
+ * @return zero if successful
+ */
+int watchdog_start(modem_t* modem, sched_t* sched);
+
+/**
+ * @brief stop watchdog, running check is waited for
+ * @param modem modem
+ */
+void watchdog_stop(modem_t* modem);
+
+/**
+ * @brief probe modem at once, failures of commands are suspected
+ * @param modem modem
+ * @return zero if watchdog is running
+ */
+int watchdog_kick(modem_t* modem);
+
+/**
+ * @brief return statistics of probes and steps of recovery
+ * @param modem modem
+ * @param stats buffer for statistics
+ * @param max size of buffer
+ * @return number of probes and steps, -1 if watchdog is not running
+ */
+int watchdog_stats(modem_t* modem, modem_watchdog_stats_t* stats, int max);
+
+#endif /* __MODEM_WATCHDOG_H */
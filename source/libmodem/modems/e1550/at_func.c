@@ -208,3 +208,11 @@ err:
 
 	return(res);
 }
+
+/*------------------------------------------------------------------------*/
+
+void e1550_reg_table(reg_state_t* table)
+{
+	/* data session is not supported, state of WWAN is not polled */
+	table[RS_GET_STATE_WWAN].action = NULL;
+}
@@ -3,6 +3,8 @@
 
 #include <modem/types.h>
 
+#include "modems/registration.h"
+
 char* e1550_at_get_network_type(modem_t* modem, char* network, size_t len);
 
 int e1550_at_get_freq_bands(modem_t* modem, freq_band_t** band_list);
@@ -13,4 +15,7 @@ int e1550_at_set_freq_band(modem_t* modem, int band_index);
 
 char* e1550_at_ussd_cmd(modem_t* modem, const char* query);
 
+/** registration without data session */
+void e1550_reg_table(reg_state_t* table);
+
 #endif /* __E1550_AT_FUNC_H */
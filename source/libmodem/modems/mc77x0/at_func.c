@@ -378,7 +378,8 @@ modem_fw_ver_t* mc77x0_at_get_fw_version(modem_t* modem, modem_fw_ver_t* fw_info
 		re_strncpy(fw_info->firmware, sizeof(fw_info->firmware), q->result, q->pmatch + 1);
 		re_strncpy(release, sizeof(release), q->result, q->pmatch + 2);
 
-		/* parsing date and time */
+		/* parsing date and time, fields not in string are zero */
+		memset(&tm, 0, sizeof(tm));
 		strptime(release, "%Y/%m/%d\r\n%H:%M:%S", &tm);
 		fw_info->release = mktime(&tm);
 
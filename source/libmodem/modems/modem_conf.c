@@ -6,6 +6,36 @@
 
 #include "utils/str.h"
 #include "utils/re.h"
+#include "utils/sysfs.h"
+
+/*------------------------------------------------------------------------*/
+
+/** parse rule of retry policy, returns zero if rule is added */
+static int modem_conf_retry(modem_conf_t* conf, const char* s)
+{
+	char state[0x20], error[0x10];
+	int base, max, jitter = 0, n;
+
+	if(conf->retry_count >= MODEM_CONF_RETRY_MAX)
+		return(-1);
+
+	n = sscanf(s, "%31[^,],%15[^,],%d,%d,%d", state, error, &base, &max, &jitter);
+
+	if(n < 4 || base <= 0 || max < base || jitter < 0 || jitter > 100)
+		return(-1);
+
+	trim_r(state);
+	snprintf(conf->retry[conf->retry_count].state, sizeof(conf->retry[0].state), "%s", state);
+
+	conf->retry[conf->retry_count].error = *error == '*' ? MODEM_CONF_ANY_ERROR : atoi(error);
+	conf->retry[conf->retry_count].base = base;
+	conf->retry[conf->retry_count].max = max;
+	conf->retry[conf->retry_count].jitter = jitter;
+
+	++ conf->retry_count;
+
+	return(0);
+}
 
 /*------------------------------------------------------------------------*/
 
@@ -29,13 +59,15 @@ int modem_conf_read(const char* port, modem_conf_t* conf)
 	conf->access_technology = 0;
 	conf->frequency_band = 0;
 	conf->periodical_reset = 0;
+	conf->poll_interval_max = 0;
+	conf->retry_count = 0;
 	*conf->mcc_lock = 0;
 	*conf->mnc_lock = 0;
 	*conf->ccid.low = 0;
 	*conf->ccid.high = 0;
 
 	/* path to config */
-	snprintf(s, sizeof(s), "/etc/modemd/%s/conf", port);
+	snprintf(s, sizeof(s), "%s/etc/modemd/%s/conf", sysfs_root(), port);
 
 	if(!(f = fopen(s, "r")))
 	{
@@ -60,6 +92,8 @@ int modem_conf_read(const char* port, modem_conf_t* conf)
 #define CONF_ACT			"access_technology="
 #define CONF_BAND			"frequency_band="
 #define CONF_PERIODICAL_RST	"periodical_reset="
+#define CONF_POLL_MAX		"poll_interval_max="
+#define CONF_RETRY			"retry="
 #define CONF_MCC			"mcc="
 #define CONF_MNC			"mnc="
 #define CONF_CCID			"ccid="
@@ -119,6 +153,15 @@ int modem_conf_read(const char* port, modem_conf_t* conf)
 		{
 			conf->periodical_reset = atoi(s + strlen(CONF_PERIODICAL_RST));
 		}
+		else if(strstr(s, CONF_POLL_MAX) == s)
+		{
+			conf->poll_interval_max = atoi(s + strlen(CONF_POLL_MAX));
+		}
+		else if(strstr(s, CONF_RETRY) == s)
+		{
+			if(modem_conf_retry(conf, s + strlen(CONF_RETRY)))
+				printf("(WW) Invalid retry rule: %s", s);
+		}
 		else if(strstr(s, CONF_MCC) == s)
 		{
 			strncpy(conf->mcc_lock, s + strlen(CONF_MCC), sizeof(conf->mcc_lock) - 1);
@@ -178,7 +221,8 @@ int modem_conf_read(const char* port, modem_conf_t* conf)
 		"         mcc lock: [%s]\n"
 		"         mnc lock: [%s]\n"
 		"        ccid lock: [%s] - [%s]\n"
-		"        msin lock: [%s] - [%s]\n",
+		"        msin lock: [%s] - [%s]\n"
+		"      retry rules: %d\n",
 
 		conf->pin,
 		conf->puk,
@@ -194,7 +238,8 @@ int modem_conf_read(const char* port, modem_conf_t* conf)
 		conf->mcc_lock,
 		conf->mnc_lock,
 		conf->ccid.low, conf->ccid.high,
-		conf->msin.low, conf->msin.high
+		conf->msin.low, conf->msin.high,
+		conf->retry_count
 	);
 
 	return(0);
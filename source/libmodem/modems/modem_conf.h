@@ -3,6 +3,12 @@
 
 #include "modem/types.h"
 
+/** maximal number of rules of retry policy in config */
+#define MODEM_CONF_RETRY_MAX 16
+
+/** rule of retry policy matches any error */
+#define MODEM_CONF_ANY_ERROR (-1)
+
 typedef struct
 {
 	char pin[20];
@@ -22,6 +28,28 @@ typedef struct
 	/** time in hours */
 	int periodical_reset;
 
+	/** maximal interval of polling of stable values in seconds, 0 for default */
+	int poll_interval_max;
+
+	/** rules of retry policy: retry=STATE,ERROR|*,BASE_MS,MAX_MS[,JITTER_%] */
+	struct
+	{
+		/** name of state, it is resolved by registration routine */
+		char state[0x20];
+
+		/** error of last command of state, MODEM_CONF_ANY_ERROR for any */
+		int error;
+
+		/** delay of first retry, doubled by each next one up to maximum, ms */
+		int base;
+		int max;
+
+		/** random deviation of delay, percent */
+		int jitter;
+	} retry[MODEM_CONF_RETRY_MAX];
+
+	int retry_count;
+
 	char mcc_lock[4];
 
 	char mnc_lock[4];
@@ -4,15 +4,21 @@
 #include <string.h>
 #include <unistd.h>
 #include <strings.h>
+#include <pthread.h>
 
 #include "modem/types.h"
+#include "modem/modem.h"
 #include "modem/modem_str.h"
 #include "modem/modem_errno.h"
 
 #include "utils/str.h"
 #include "utils/re.h"
+#include "utils/clock.h"
 
 #include "proto.h"
+#include "modem_int.h"
+#include "modem_persist.h"
+#include "modem_watchdog.h"
 
 #include "at/at_queue.h"
 #include "at/at_utils.h"
@@ -21,520 +27,1649 @@
 #include "modems/modem_conf.h"
 #include "modems/registration.h"
 
-#include "modems/mc77x0/at_func.h"
+/*------------------------------------------------------------------------*/
+
+static void reg_state_updated(modem_t* priv, modem_status_field_t field)
+{
+	priv->reg.state.updated[field] = clock_ms();
+
+	modem_state_publish(priv);
+	modem_notify(priv);
+
+	/* values read once per registration have no events */
+	if(field == MODEM_STATUS_FW_INFO || field == MODEM_STATUS_IMEI || field == MODEM_STATUS_IMSI)
+		modem_invalidate(priv);
+}
+
+/*------------------------------------------------------------------------*/
+
+
+static const char *RS_STR[RS_COUNT] =
+{
+#define __STR(x) [x] = #x,
+	REG_STATES(__STR)
+#undef __STR
+};
+
+/** rules of retry decisions */
+typedef enum
+{
+	RR_CONFIG,
+	RR_DEFAULT,
+	RR_TABLE,
+	RR_ACTION,
+
+	RR_COUNT
+} reg_retry_rule_id_t;
+
+static const char* REG_RETRY_RULE_STR[RR_COUNT] =
+{
+	[RR_CONFIG] = "config",
+	[RR_DEFAULT] = "default",
+	[RR_TABLE] = "table",
+	[RR_ACTION] = "action",
+};
+
+static const reg_retry_rule_t reg_retry_default[] =
+{
+#define __REG_RETRY(state, error, base, max, jitter) {state, error, base, max, jitter},
+	REG_RETRY_POLICY(__REG_RETRY)
+#undef __REG_RETRY
+};
+
+/** lock of routine pointer of modems against readers of statistics */
+static pthread_mutex_t reg_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** stops and restarts of routines are serialized, one routine drives modem */
+static pthread_mutex_t restart_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const struct
+{
+	const char* name;
+
+	reg_state_id_t state;
+
+	uint32_t events;
+
+	modem_status_field_t field;
+
+	int commands;
+} reg_polls[RP_COUNT] =
+{
+#define __REG_POLL(poll, state, events, field, commands) [poll] = {#poll, state, events, field, commands},
+	REG_POLLS(__REG_POLL)
+#undef __REG_POLL
+};
+
+/*------------------------------------------------------------------------*/
+
+/** last error of protocol of device functions */
+static int reg_last_error(reg_ctx_t* ctx)
+{
+	return(modem_queues_last_error(ctx->modem, ctx->proto));
+}
+
+/*------------------------------------------------------------------------*/
+
+/** registration is denied with error */
+static int reg_denied(reg_ctx_t* ctx, int error)
+{
+	modem_t* priv = ctx->modem;
+
+	priv->reg.last_error = error;
+
+	/* set registration status as a denied */
+	priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+	reg_state_updated(priv, MODEM_STATUS_REG);
+
+	return(REG_FINISH);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** value is subscribed or was read by clients recently */
+static int reg_poll_observed(reg_ctx_t* ctx, reg_poll_id_t poll, uint64_t now)
+{
+	modem_t* priv = ctx->modem;
+
+	if(modem_priv(priv)->events & reg_polls[poll].events)
+		return(1);
+
+	return(now - modem_priv(priv)->read[reg_polls[poll].field] < REG_POLL_OBSERVED);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** interval of polling, observed value is polled at least with fixed period */
+static uint32_t reg_poll_interval(reg_ctx_t* ctx, reg_poll_id_t poll, uint64_t now)
+{
+	uint32_t res = __atomic_load_n(&ctx->polls[poll].interval, __ATOMIC_RELAXED);
+
+	if(res > REG_POLL_PERIOD && reg_poll_observed(ctx, poll, now))
+		res = REG_POLL_PERIOD;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** deadline of next polling of value */
+static uint64_t reg_poll_next(reg_ctx_t* ctx, reg_poll_id_t poll, uint64_t now)
+{
+	if(!ctx->polls[poll].last)
+		return(0);
+
+	return(ctx->polls[poll].last + reg_poll_interval(ctx, poll, now));
+}
+
+/*------------------------------------------------------------------------*/
+
+/** value must be polled by this step */
+static int reg_poll_due(reg_ctx_t* ctx, reg_poll_id_t poll)
+{
+	uint64_t now = clock_ms();
+
+	return(now >= reg_poll_next(ctx, poll, now));
+}
+
+/*------------------------------------------------------------------------*/
+
+/** value is polled, changed value is polled fast, stable one backs off */
+static void reg_poll_done(reg_ctx_t* ctx, reg_poll_id_t poll)
+{
+	uint64_t now = clock_ms();
+	uint32_t interval = ctx->polls[poll].interval, max;
+
+	max = (ctx->conf.poll_interval_max > 0 ? ctx->conf.poll_interval_max : REG_POLL_MAX) * 1000;
+
+	if(ctx->polls[poll].changed)
+		interval = REG_POLL_FAST;
+	else
+		interval = interval * 2 < max ? interval * 2 : max;
+
+	if(interval < REG_POLL_FAST)
+		interval = REG_POLL_FAST;
+
+	ctx->polls[poll].changed = 0;
+	ctx->polls[poll].last = now;
+
+	if(!ctx->polls[poll].first)
+		__atomic_store_n(&ctx->polls[poll].first, now, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&ctx->polls[poll].interval, interval, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&ctx->polls[poll].commands, reg_polls[poll].commands, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** rules of config are resolved by names of states */
+static void reg_retry_conf(reg_ctx_t* ctx)
+{
+	reg_retry_rule_t* rule;
+	int i, state;
+
+	ctx->retry_rules_count = 0;
+
+	for(i = 0; i < ctx->conf.retry_count; ++ i)
+	{
+		for(state = 0; state < RS_COUNT && strcmp(RS_STR[state], ctx->conf.retry[i].state); ++ state);
+
+		if(state == RS_COUNT)
+		{
+			printf("(WW) Retry rule of unknown state %s\n", ctx->conf.retry[i].state);
+
+			continue;
+		}
+
+		rule = &ctx->retry_rules[ctx->retry_rules_count ++];
+
+		rule->state = state;
+		rule->error = ctx->conf.retry[i].error;
+		rule->base = ctx->conf.retry[i].base;
+		rule->max = ctx->conf.retry[i].max;
+		rule->jitter = ctx->conf.retry[i].jitter;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** rule of state, rule of exact error goes before rule of any error */
+static const reg_retry_rule_t* reg_retry_find(const reg_retry_rule_t* rules, int n, reg_state_id_t state, int error)
+{
+	const reg_retry_rule_t* res = NULL;
+	int i;
+
+	for(i = 0; i < n; ++ i)
+	{
+		if(rules[i].state != state)
+			continue;
+
+		if(rules[i].error == error)
+			return(&rules[i]);
+
+		if(rules[i].error == MODEM_CONF_ANY_ERROR && !res)
+			res = &rules[i];
+	}
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** add decision to trace */
+static void reg_retry_trace(reg_ctx_t* ctx, uint32_t delay, int rule)
+{
+	pthread_mutex_lock(&reg_lock);
+
+	ctx->retry_trace[ctx->retries % REG_RETRY_TRACE].time = clock_ms();
+	ctx->retry_trace[ctx->retries % REG_RETRY_TRACE].state = ctx->retry.state;
+	ctx->retry_trace[ctx->retries % REG_RETRY_TRACE].error = ctx->retry.error;
+	ctx->retry_trace[ctx->retries % REG_RETRY_TRACE].attempt = ctx->retry.attempt;
+	ctx->retry_trace[ctx->retries % REG_RETRY_TRACE].delay = delay;
+	ctx->retry_trace[ctx->retries % REG_RETRY_TRACE].rule = rule;
+
+	++ ctx->retries;
+
+	pthread_mutex_unlock(&reg_lock);
+
+#ifdef _DEV_EDITION
+	printf("Retry: %s, error %d, attempt %u, delay %u ms by %s\n", RS_STR[ctx->retry.state],
+		ctx->retry.error, ctx->retry.attempt, delay, REG_RETRY_RULE_STR[rule]);
+#endif
+}
+
+/*------------------------------------------------------------------------*/
+
+/** delay before retry of current state, ms, backoff goes on while state fails with the same error */
+static uint32_t reg_retry_delay(reg_ctx_t* ctx, int error)
+{
+	const reg_retry_rule_t* rule;
+	reg_retry_rule_t table;
+	uint32_t res;
+	int id, i;
+
+	if(ctx->retry.state != ctx->state || ctx->retry.error != error)
+	{
+		ctx->retry.state = ctx->state;
+		ctx->retry.error = error;
+		ctx->retry.attempt = 0;
+	}
+
+	++ ctx->retry.attempt;
+
+	/* delay set by action is kept */
+	if(ctx->delay >= 0)
+	{
+		res = ctx->delay * 1000;
+		reg_retry_trace(ctx, res, RR_ACTION);
+
+		return(res);
+	}
+
+	if((rule = reg_retry_find(ctx->retry_rules, ctx->retry_rules_count, ctx->state, error)))
+		id = RR_CONFIG;
+	else if((rule = reg_retry_find(reg_retry_default, sizeof(reg_retry_default) / sizeof(*reg_retry_default), ctx->state, error)))
+		id = RR_DEFAULT;
+	else
+	{
+		/* fixed delay of table */
+		table.base = table.max = ctx->table[ctx->state].retry_delay * 1000;
+		table.jitter = 0;
+
+		rule = &table;
+		id = RR_TABLE;
+	}
+
+	/* exponential backoff up to maximum */
+	for(res = rule->base, i = 1; i < ctx->retry.attempt && res < rule->max; ++ i)
+		res *= 2;
+
+	if(res > rule->max)
+		res = rule->max;
+
+	/* retries of modems are spread */
+	if(rule->jitter)
+		res += (int64_t)res * rule->jitter * ((int)(rand_r(&ctx->seed) % 201) - 100) / 10000;
+
+	reg_retry_trace(ctx, res, id);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_init(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+
+	printf("Started registration for modem on port %s\n", priv->port);
+
+	/* initialize data */
+	priv->reg.last_error = __ME_REG_IN_PROGRESS;
+	priv->reg.state.reg = MODEM_NETWORK_REG_SEARCHING;
+	reg_state_updated(priv, MODEM_STATUS_REG);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_disable_echo(reg_ctx_t* ctx)
+{
+	/* only for command port */
+	if(modem_proto_get(ctx->modem, MODEM_PROTO_AT))
+		at_raw_ok(ctx->modem, "ATE0\r\n");
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_cmee_number(reg_ctx_t* ctx)
+{
+	/* only for command port */
+	if(modem_proto_get(ctx->modem, MODEM_PROTO_AT))
+		at_raw_ok(ctx->modem, "AT+CMEE=1\r\n");
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_firmware_ver(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+
+	/* persisted value is validated by RS_VALIDATE_IDENT */
+	if(ctx->ident != REG_IDENT_NONE)
+		return(REG_NEXT);
+
+	mdd->functions.get_fw_version(priv, &priv->reg.state.fw_info);
+	reg_state_updated(priv, MODEM_STATUS_FW_INFO);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_imei(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+
+	/* persisted value is validated by RS_VALIDATE_IDENT */
+	if(ctx->ident != REG_IDENT_NONE)
+		return(REG_NEXT);
+
+	mdd->functions.get_imei(priv, priv->reg.state.imei, sizeof(priv->reg.state.imei));
+	reg_state_updated(priv, MODEM_STATUS_IMEI);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** SIM is changed, persisted values are dropped and queried again */
+static void reg_ident_drop(reg_ctx_t* ctx, const char* what)
+{
+	modem_t* priv = ctx->modem;
+
+	printf("(WW) %s of port %s is changed, persisted data is dropped\n", what, priv->port);
+
+	modem_persist_drop(priv);
+
+	ctx->ident = REG_IDENT_NONE;
+
+	rs_get_firmware_ver(ctx);
+	rs_get_imei(ctx);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_read_config(reg_ctx_t* ctx)
+{
+	/* waiting for config */
+	if(modem_conf_read(ctx->modem->port, &ctx->conf))
+		return(REG_RETRY);
+
+	reg_retry_conf(ctx);
+
+	/* period of reset starts again */
+	sched_timer_stop(ctx->sched, &ctx->reset);
+
+	if(ctx->conf.periodical_reset)
+		sched_timer_at(ctx->sched, &ctx->reset, clock_ms() + ctx->conf.periodical_reset * 3600000ULL);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_set_band(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	int band;
+
+	if(!mdd->functions.get_freq_band || !mdd->functions.set_freq_band)
+		return(REG_NEXT);
+
+	/* current modem band */
+	band = mdd->functions.get_freq_band(priv);
+
+	printf("(II) Modem Band is %x\n", band);
+
+	if(ctx->conf.frequency_band == band)
+		return(REG_NEXT);
+
+	/* band selection */
+	if(mdd->functions.set_freq_band(priv, ctx->conf.frequency_band))
+	{
+		priv->reg.last_error = modem_queues_last_error(priv, MODEM_PROTO_AT);
+
+		printf("(EE) Band selection error: %d\n", priv->reg.last_error);
+
+		return(REG_FINISH);
+	}
+
+	/* delay for band setup */
+	ctx->delay = 5;
+
+	/* reset is required */
+	return(RS_RESET);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_check_pin(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+
+	switch(mdd->functions.cpin_state(priv))
+	{
+		case MODEM_CPIN_STATE_PIN:
+			return(RS_SET_PIN);
+
+		case MODEM_CPIN_STATE_PUK:
+			return(RS_SET_PUK);
+
+		case MODEM_CPIN_STATE_READY:
+			return(REG_NEXT);
+
+		default:
+			/* registration error? */;
+			priv->reg.last_error = reg_last_error(ctx);
+
+			/* busy and wrong SIM are waited for by retry policy */
+			if(priv->reg.last_error == __ME_NO_SIM)
+				return(reg_denied(ctx, __ME_NO_SIM));
+	}
+
+	return(REG_RETRY);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_set_pin(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+
+	if(*ctx->conf.pin && !mdd->functions.cpin_pin(priv, ctx->conf.pin))
+		return(REG_NEXT);
+
+	printf("(EE) PIN Error\n");
+
+	/* SIM PIN invalid */
+	return(reg_denied(ctx, *ctx->conf.pin ? reg_last_error(ctx) : __ME_SIM_PIN));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_set_puk(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+
+	if(*ctx->conf.pin && *ctx->conf.puk && !mdd->functions.cpin_puk(priv, ctx->conf.puk, ctx->conf.pin))
+		return(REG_NEXT);
+
+	/* SIM PUK invalid */
+	return(reg_denied(ctx, *ctx->conf.pin && *ctx->conf.puk ? reg_last_error(ctx) : __ME_SIM_PUK));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_imsi(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	char imsi[sizeof(priv->reg.state.imsi)];
+	int changed;
+
+	if(ctx->conf.frequency_band == 10)
+	{
+		printf("(WW) Band is CDMA skip SIM Check's\n");
+
+		return(RS_OPERATOR_SELECT);
+	}
+
+	/* SIM busy? */
+	if(!mdd->functions.get_imsi(priv, imsi, sizeof(imsi)))
+		return(REG_RETRY);
+
+	changed = strcmp(imsi, priv->reg.state.imsi);
+
+	strcpy(priv->reg.state.imsi, imsi);
+	reg_state_updated(priv, MODEM_STATUS_IMSI);
+
+	if(changed && ctx->ident != REG_IDENT_NONE)
+		reg_ident_drop(ctx, "IMSI");
+
+	/* mcc */
+	strncpy(priv->reg.state.mcc, priv->reg.state.imsi, sizeof(priv->reg.state.mcc) - 1);
+	priv->reg.state.mcc[sizeof(priv->reg.state.mcc) - 1] = 0;
+
+	/* mnc */
+	strncpy(priv->reg.state.mnc, priv->reg.state.imsi + strlen(priv->reg.state.mcc), sizeof(priv->reg.state.mnc) - 1);
+	priv->reg.state.mnc[mnc_get_length(priv->reg.state.imsi)] = 0;
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_mcc_lock(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+
+	printf("MCC = [%s]\n", priv->reg.state.mcc);
+
+	if(*ctx->conf.mcc_lock && strcmp(priv->reg.state.mcc, ctx->conf.mcc_lock) != 0)
+	{
+		printf("(EE) MCC Lock error\n");
+
+		/* Network not allowed, emergency calls only  */
+		return(reg_denied(ctx, __ME_MCC_LOCKED));
+	}
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_mnc_lock(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+
+	printf("MNC = [%s]\n", priv->reg.state.mnc);
+
+	if(*ctx->conf.mnc_lock && strcmp(priv->reg.state.mnc, ctx->conf.mnc_lock) != 0)
+	{
+		printf("(EE) MNC Lock error\n");
+
+		/* Network not allowed, emergency calls only  */
+		return(reg_denied(ctx, __ME_MNC_LOCKED));
+	}
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_ccid_lock(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	char ccid[sizeof(priv->reg.state.ccid)];
+	int changed;
+
+	if(!mdd->functions.get_ccid)
+		return(REG_NEXT);
+
+	if(!mdd->functions.get_ccid(priv, ccid, sizeof(ccid)))
+		return(REG_RETRY);
+
+	changed = strcmp(ccid, priv->reg.state.ccid);
+
+	strcpy(priv->reg.state.ccid, ccid);
+	reg_state_updated(priv, MODEM_STATUS_CCID);
+
+	if(changed && ctx->ident != REG_IDENT_NONE)
+		reg_ident_drop(ctx, "CCID");
+
+	/* values of SIM are known, they are kept for the next start */
+	if(ctx->ident == REG_IDENT_NONE && !modem_persist_save(priv))
+		ctx->ident = REG_IDENT_SAVED;
+
+	printf("CCID = [%s]\n", priv->reg.state.ccid);
+
+	if
+	(
+		*ctx->conf.ccid.low && *ctx->conf.ccid.high && (
+			strcasecmp(priv->reg.state.ccid, ctx->conf.ccid.low) < 0 ||
+			strcasecmp(ctx->conf.ccid.high, priv->reg.state.ccid) < 0
+		)
+	)
+	{
+		printf("(EE) CCID Lock error\n");
+
+		/* Network not allowed, emergency calls only  */
+		return(reg_denied(ctx, __ME_CCID_LOCKED));
+	}
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_msin_lock(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+
+	strncpy(priv->reg.state.msin,
+		priv->reg.state.imsi +
+			strlen(priv->reg.state.mcc) +
+			strlen(priv->reg.state.mnc),
+		sizeof(priv->reg.state.msin));
+
+	printf("MSIN = [%s]\n", priv->reg.state.msin);
+
+	if
+	(
+		*ctx->conf.msin.low && *ctx->conf.msin.high && (
+			strcasecmp(priv->reg.state.msin, ctx->conf.msin.low) < 0 ||
+			strcasecmp(ctx->conf.msin.high, priv->reg.state.msin) < 0
+		)
+	)
+	{
+		printf("(EE) MSIN Lock error\n");
+
+		/* Network not allowed, emergency calls only  */
+		return(reg_denied(ctx, __ME_MSIN_LOCKED));
+	}
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_operator_select(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+
+	/* operator selection is failed, try again */
+	if(mdd->functions.operator_select(priv, ctx->conf.operator_number, ctx->conf.access_technology))
+		return(REG_RETRY);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_check_registration(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	modem_network_reg_t reg = priv->reg.state.reg;
+	int i;
+
+	/* registered modem polls registration adaptively */
+	if(priv->reg.ready && !reg_poll_due(ctx, RP_REG))
+		return(REG_NEXT);
+
+	priv->reg.state.reg = mdd->functions.network_registration(priv);
+
+	/* if roaming disabled */
+	if(MODEM_NETWORK_REG_ROAMING == priv->reg.state.reg && !ctx->conf.roaming)
+		/* set registration status as a denied */
+		priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+
+	reg_state_updated(priv, MODEM_STATUS_REG);
+
+	/* other values follow registration, they are polled at once */
+	if(priv->reg.state.reg != reg)
+	{
+		ctx->polls[RP_REG].changed = 1;
+
+		for(i = 0; i < RP_COUNT; ++ i)
+			if(i != RP_REG)
+				ctx->polls[i].last = 0;
+	}
+
+	switch(priv->reg.state.reg)
+	{
+		case MODEM_NETWORK_REG_HOME:
+		case MODEM_NETWORK_REG_ROAMING:
+			priv->reg.ready = 1;
+			priv->reg.last_error = -1;
+			reg_poll_done(ctx, RP_REG);
+			return(REG_NEXT);
+
+		default:
+			priv->reg.ready = 0;
+			priv->reg.last_error = __ME_REG_IN_PROGRESS;
+			return(REG_RETRY);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_signal_quality(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	uint8_t level = priv->reg.state.sq.level;
+
+	if(!reg_poll_due(ctx, RP_SQ))
+		return(REG_NEXT);
+
+	mdd->functions.get_signal_quality(priv, &priv->reg.state.sq);
+	reg_state_updated(priv, MODEM_STATUS_SQ);
+
+	/* dBm jitters always, only change of level is a fluctuation */
+	ctx->polls[RP_SQ].changed = priv->reg.state.sq.level != level;
+	reg_poll_done(ctx, RP_SQ);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_network_type(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	char network_type[sizeof(priv->reg.state.network_type)];
+
+	if(!reg_poll_due(ctx, RP_NETWORK_TYPE))
+		return(REG_NEXT);
+
+	memcpy(network_type, priv->reg.state.network_type, sizeof(network_type));
+
+	mdd->functions.get_network_type(priv, priv->reg.state.network_type, sizeof(priv->reg.state.network_type));
+	reg_state_updated(priv, MODEM_STATUS_NETWORK_TYPE);
+
+	ctx->polls[RP_NETWORK_TYPE].changed = strcmp(network_type, priv->reg.state.network_type) != 0;
+	reg_poll_done(ctx, RP_NETWORK_TYPE);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_operator_number(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	char oper_number[sizeof(priv->reg.state.oper_number)];
+
+	/* number and name are polled together */
+	if(!(ctx->oper_polled = reg_poll_due(ctx, RP_OPER)))
+		return(REG_NEXT);
+
+	memcpy(oper_number, priv->reg.state.oper_number, sizeof(oper_number));
+
+	if(!mdd->functions.get_operator_number(priv, priv->reg.state.oper_number, sizeof(priv->reg.state.oper_number)))
+		*priv->reg.state.oper_number = 0;
+
+	ctx->polls[RP_OPER].changed = strcmp(oper_number, priv->reg.state.oper_number) != 0;
+	reg_poll_done(ctx, RP_OPER);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_operator_name(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	char oper[sizeof(priv->reg.state.oper)];
+
+	/* name is polled with number */
+	if(!ctx->oper_polled)
+		return(REG_NEXT);
+
+	ctx->oper_polled = 0;
+
+	memcpy(oper, priv->reg.state.oper, sizeof(oper));
+
+	if(!mdd->functions.get_operator_name(priv, priv->reg.state.oper, sizeof(priv->reg.state.oper)))
+		*priv->reg.state.oper = 0;
+
+	reg_state_updated(priv, MODEM_STATUS_OPER);
+
+	/* name has no event */
+	if(strcmp(oper, priv->reg.state.oper))
+	{
+		modem_invalidate(priv);
+
+		/* polling of number is done, changed name speeds it up */
+		__atomic_store_n(&ctx->polls[RP_OPER].interval, REG_POLL_FAST, __ATOMIC_RELAXED);
+	}
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_get_state_wwan(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+
+	/* extra command only if somebody is waiting for changes */
+	if(mdd->functions.state_wwan && (modem_priv(priv)->events & MODEM_EVENT_STATE_WWAN))
+		modem_state_wwan(priv);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_validate_ident(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	modem_fw_ver_t fw_info;
+	char imei[sizeof(priv->reg.state.imei)];
+	int changed = 0;
+
+	/* persisted values are checked once modem is registered */
+	if(ctx->ident != REG_IDENT_CACHED)
+		return(REG_NEXT);
+
+	memset(&fw_info, 0, sizeof(fw_info));
+
+	if(mdd->functions.get_fw_version(priv, &fw_info) && (
+		strcmp(fw_info.firmware, priv->reg.state.fw_info.firmware) ||
+		fw_info.release != priv->reg.state.fw_info.release
+	))
+	{
+		memcpy(&priv->reg.state.fw_info, &fw_info, sizeof(fw_info));
+		reg_state_updated(priv, MODEM_STATUS_FW_INFO);
+
+		changed = 1;
+	}
+
+	if(mdd->functions.get_imei(priv, imei, sizeof(imei)) && strcmp(imei, priv->reg.state.imei))
+	{
+		strcpy(priv->reg.state.imei, imei);
+		reg_state_updated(priv, MODEM_STATUS_IMEI);
+
+		changed = 1;
+	}
+
+	if(changed)
+	{
+		printf("(WW) Firmware or IMEI of port %s is changed\n", priv->port);
+
+		modem_persist_save(priv);
+	}
+
+	ctx->ident = REG_IDENT_SAVED;
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_poll_wait(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	const modem_info_device_t* mdd = priv->mdd;
+	uint64_t now = clock_ms(), next = UINT64_MAX, t;
+	int i;
+
+	for(i = 0; i < RP_COUNT; ++ i)
+	{
+		/* value of skipped state is never polled */
+		if(!ctx->table[reg_polls[i].state].action)
+			continue;
+
+		if((t = reg_poll_next(ctx, i, now)) < next)
+			next = t;
+	}
+
+	/* state of WWAN is polled by each cycle for subscribers */
+	if(mdd->functions.state_wwan && ctx->table[RS_GET_STATE_WWAN].action &&
+		(modem_priv(priv)->events & MODEM_EVENT_STATE_WWAN) && next > now + REG_POLL_PERIOD)
+		next = now + REG_POLL_PERIOD;
+
+	/* routine sleeps until the nearest polling */
+	if(next != UINT64_MAX)
+		ctx->delay = next > now + 1000 ? (next - now + 999) / 1000 : 1;
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_reset(reg_ctx_t* ctx)
+{
+	/* firmware may be updated by reset, values are validated again */
+	if(ctx->ident == REG_IDENT_SAVED)
+		ctx->ident = REG_IDENT_CACHED;
+
+	/* device is waited for by delay of state */
+	modem_reset(ctx->modem, ctx->reset_how);
+
+	ctx->reset_how = MODEM_RECOVER_POWER_CYCLE;
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rs_reset_wait(reg_ctx_t* ctx)
+{
+	modem_reset_done(ctx->modem);
+
+	return(REG_NEXT);
+}
+
+/*------------------------------------------------------------------------*/
+
+const reg_state_t reg_states_default[RS_COUNT] =
+{
+	[RS_INIT]					= {rs_init,					RS_DISABLE_ECHO,		0,	0},
+	[RS_DISABLE_ECHO]			= {rs_disable_echo,			RS_CMEE_NUMBER,			0,	0},
+	[RS_CMEE_NUMBER]			= {rs_cmee_number,			RS_GET_FIRMWARE_VER,	0,	0},
+	[RS_GET_FIRMWARE_VER]		= {rs_get_firmware_ver,		RS_GET_IMEI,			0,	0},
+	[RS_GET_IMEI]				= {rs_get_imei,				RS_READ_CONFIG,			0,	0},
+	[RS_READ_CONFIG]			= {rs_read_config,			RS_SET_BAND,			0,	1},
+	[RS_SET_BAND]				= {rs_set_band,				RS_CHECK_PIN,			0,	0},
+	[RS_SET_APN]				= {NULL,					RS_SET_AUTH,			0,	0},
+	[RS_SET_AUTH]				= {NULL,					RS_CHECK_PIN,			0,	0},
+	[RS_CHECK_PIN]				= {rs_check_pin,			RS_GET_IMSI,			0,	0},
+	[RS_SET_PIN]				= {rs_set_pin,				RS_GET_IMSI,			0,	0},
+	[RS_SET_PUK]				= {rs_set_puk,				RS_GET_IMSI,			0,	0},
+	[RS_GET_IMSI]				= {rs_get_imsi,				RS_MCC_LOCK,			0,	5},
+	[RS_MCC_LOCK]				= {rs_mcc_lock,				RS_MNC_LOCK,			0,	0},
+	[RS_MNC_LOCK]				= {rs_mnc_lock,				RS_CCID_LOCK,			0,	0},
+	[RS_CCID_LOCK]				= {rs_ccid_lock,			RS_MSIN_LOCK,			0,	5},
+	[RS_MSIN_LOCK]				= {rs_msin_lock,			RS_OPERATOR_SELECT,		0,	0},
+	[RS_OPERATOR_SELECT]		= {rs_operator_select,		RS_CHECK_REGISTRATION,	0,	5},
+	[RS_CHECK_REGISTRATION]		= {rs_check_registration,	RS_GET_SIGNAL_QUALITY,	0,	5},
+	[RS_GET_SIGNAL_QUALITY]		= {rs_get_signal_quality,	RS_GET_NETWORK_TYPE,	0,	0},
+	[RS_GET_NETWORK_TYPE]		= {rs_get_network_type,		RS_GET_OPERATOR_NUMBER,	0,	0},
+	[RS_GET_OPERATOR_NUMBER]	= {rs_get_operator_number,	RS_GET_OPERATOR_NAME,	0,	0},
+	[RS_GET_OPERATOR_NAME]		= {rs_get_operator_name,	RS_VALIDATE_IDENT,		0,	0},
+	[RS_VALIDATE_IDENT]			= {rs_validate_ident,		RS_GET_STATE_WWAN,		0,	0},
+	[RS_GET_STATE_WWAN]			= {rs_get_state_wwan,		RS_POLL_WAIT,			0,	0},
+	[RS_POLL_WAIT]				= {rs_poll_wait,			RS_CHECK_REGISTRATION,	10,	0},
+	[RS_RESET]					= {rs_reset,				RS_RESET_WAIT,			10,	0},
+	[RS_RESET_WAIT]				= {rs_reset_wait,			RS_INIT,				0,	0},
+};
+
+/*------------------------------------------------------------------------*/
+
+/** account time in current state */
+static void reg_leave(reg_ctx_t* ctx)
+{
+	uint64_t now = clock_ms(), dwell = now - ctx->entered;
+
+	__atomic_add_fetch(&ctx->stats[ctx->state].dwell_ms, dwell, __ATOMIC_RELAXED);
+
+	if(dwell > ctx->stats[ctx->state].dwell_max_ms)
+		__atomic_store_n(&ctx->stats[ctx->state].dwell_max_ms, dwell, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&ctx->entered, now, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** ends of cycle in timeline, after states */
+#define REG_TL_REGISTERED RS_COUNT
+#define REG_TL_FAILED (RS_COUNT + 1)
+
+/** current cycle of timeline */
+#define REG_TL(ctx) (&(ctx)->timeline[((ctx)->cycles - 1) % REG_TIMELINE_CYCLES])
+
+/** add transition to current cycle, lock of routines must be taken */
+static void reg_timeline_add(reg_ctx_t* ctx, int state)
+{
+	reg_cycle_t* tl = REG_TL(ctx);
+
+	if(!tl->open || tl->n >= REG_TIMELINE_ENTRIES)
+		return;
+
+	tl->entries[tl->n].state = state;
+	tl->entries[tl->n].time = clock_ms();
+	tl->entries[tl->n].retries = 0;
+
+	++ tl->n;
+}
+
+/*------------------------------------------------------------------------*/
+
+/** start new cycle of timeline, previous open one is abandoned */
+static void reg_cycle_start(reg_ctx_t* ctx, reg_state_id_t state)
+{
+	pthread_mutex_lock(&reg_lock);
+
+	++ ctx->cycles;
+
+	REG_TL(ctx)->open = 1;
+	REG_TL(ctx)->n = 0;
+
+	reg_timeline_add(ctx, state);
+
+	pthread_mutex_unlock(&reg_lock);
+}
 
 /*------------------------------------------------------------------------*/
 
-void modem_reset(modem_t* modem);
+/** end current cycle of timeline */
+static void reg_cycle_end(reg_ctx_t* ctx, int end)
+{
+	reg_cycle_t* tl = REG_TL(ctx);
+
+	/* timeline is changed only by routine, so it is read without lock */
+	if(!tl->open)
+		return;
+
+	pthread_mutex_lock(&reg_lock);
+
+	reg_timeline_add(ctx, end);
+	tl->open = 0;
+
+	pthread_mutex_unlock(&reg_lock);
+
+	if(end == REG_TL_REGISTERED)
+		printf("(DD) Modem on port %s is registered in %llu ms\n", ctx->modem->port,
+			(unsigned long long)(tl->entries[tl->n - 1].time - tl->entries[0].time));
+}
 
 /*------------------------------------------------------------------------*/
 
-enum registration_state_e
+/** track registration in timeline after action */
+static void reg_cycle_check(reg_ctx_t* ctx, int res)
 {
-	RS_INIT = 0,
-	RS_DISABLE_ECHO,
-	RS_CMEE_NUMBER,
-	RS_GET_FIRMWARE_VER,
-	RS_GET_IMEI,
-	RS_READ_CONFIG,
-	RS_SET_BAND,
-	RS_SET_APN,
-	RS_SET_AUTH,
-	RS_CHECK_PIN,
-	RS_SET_PIN,
-	RS_SET_PUK,
-	RS_GET_IMSI,
-	RS_MCC_LOCK,
-	RS_MNC_LOCK,
-	RS_CCID_LOCK,
-	RS_MSIN_LOCK,
-	RS_OPERATOR_SELECT,
-	RS_CHECK_REGISTRATION,
-	RS_GET_SIGNAL_QUALITY,
-	RS_GET_NETWORK_TYPE,
-	RS_GET_OPERATOR_NUMBER,
-	RS_GET_OPERATOR_NAME,
-	RS_RESET
-};
+	reg_cycle_t* tl = REG_TL(ctx);
 
-static const char *RS_STR[] =
-{
-#define __STR(x) #x
-	__STR(RS_INIT),
-	__STR(RS_DISABLE_ECHO),
-	__STR(RS_CMEE_NUMBER),
-	__STR(RS_GET_FIRMWARE_VER),
-	__STR(RS_GET_IMEI),
-	__STR(RS_READ_CONFIG),
-	__STR(RS_SET_BAND),
-	__STR(RS_SET_APN),
-	__STR(RS_SET_AUTH),
-	__STR(RS_CHECK_PIN),
-	__STR(RS_SET_PIN),
-	__STR(RS_SET_PUK),
-	__STR(RS_GET_IMSI),
-	__STR(RS_MCC_LOCK),
-	__STR(RS_MNC_LOCK),
-	__STR(RS_CCID_LOCK),
-	__STR(RS_MSIN_LOCK),
-	__STR(RS_OPERATOR_SELECT),
-	__STR(RS_CHECK_REGISTRATION),
-	__STR(RS_GET_SIGNAL_QUALITY),
-	__STR(RS_GET_NETWORK_TYPE),
-	__STR(RS_GET_OPERATOR_NUMBER),
-	__STR(RS_GET_OPERATOR_NAME),
-	__STR(RS_RESET)
-#undef __STR
-};
+	if(tl->open)
+	{
+		if(ctx->modem->reg.ready)
+			reg_cycle_end(ctx, REG_TL_REGISTERED);
+		else if(res == REG_FINISH)
+			reg_cycle_end(ctx, REG_TL_FAILED);
+	}
+	/* loss of registration starts new cycle */
+	else if(!ctx->modem->reg.ready && tl->n && tl->entries[tl->n - 1].state == REG_TL_REGISTERED)
+		reg_cycle_start(ctx, ctx->state);
+
+	tl = REG_TL(ctx);
+
+	/* repeats of current state */
+	if(res == REG_RETRY && tl->open && tl->n && tl->entries[tl->n - 1].state == ctx->state)
+		__atomic_add_fetch(&tl->entries[tl->n - 1].retries, 1, __ATOMIC_RELAXED);
+}
 
 /*------------------------------------------------------------------------*/
 
-void* mc77x0_thread_reg(modem_t *priv)
+/** go to state */
+static void reg_enter(reg_ctx_t* ctx, reg_state_id_t state)
 {
-	enum registration_state_e state = RS_INIT;
-	at_queue_t* at_q = modem_proto_get(priv, MODEM_PROTO_AT);
-	const modem_info_device_t* mdd = priv->mdd;
-	int periodical_reset;
+	reg_leave(ctx);
+
+	__atomic_add_fetch(&ctx->stats[state].entries, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ctx->state, state, __ATOMIC_RELAXED);
+
+	/* reset starts new cycle of registration */
+	if(state == RS_RESET)
+		reg_cycle_start(ctx, state);
+	else if(REG_TL(ctx)->open)
+	{
+		pthread_mutex_lock(&reg_lock);
+		reg_timeline_add(ctx, state);
+		pthread_mutex_unlock(&reg_lock);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** periodical reset is made by the next step executed at once */
+static void reg_reset(void* prm)
+{
+	reg_ctx_t* ctx = prm;
+
+	__atomic_store_n(&ctx->reset_due, 1, __ATOMIC_RELAXED);
+
+	sched_timer_at(ctx->sched, &ctx->step, clock_ms());
+}
+
+/*------------------------------------------------------------------------*/
+
+/** make recovery requested by watchdog */
+static void reg_recover(reg_ctx_t* ctx)
+{
+	modem_t* priv = ctx->modem;
+	modem_recover_t how;
+
+	if((how = __atomic_exchange_n(&ctx->recover, MODEM_RECOVER_NONE, __ATOMIC_RELAXED)) == MODEM_RECOVER_NONE)
+		return;
+
+	/* queues are suspended by reset in progress */
+	if(ctx->state == RS_RESET || ctx->state == RS_RESET_WAIT)
+		return;
+
+	switch(how)
+	{
+		case MODEM_RECOVER_REQUEUE:
+			modem_queues_flush(priv);
+			break;
+
+		case MODEM_RECOVER_REOPEN:
+			modem_queues_suspend(priv);
+			modem_queues_resume(priv);
+			break;
+
+		default:
+			/* reset is made by the current step */
+			ctx->reset_how = how;
+			__atomic_store_n(&ctx->reset_due, 1, __ATOMIC_RELAXED);
+			break;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** client started to read values while routine waits for polling */
+static int reg_woken(reg_ctx_t* ctx)
+{
+	if(!__atomic_exchange_n(&ctx->wake, 0, __ATOMIC_RELAXED))
+		return(0);
+
+	return(ctx->state == RS_CHECK_REGISTRATION && ctx->modem->reg.ready);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** one step of registration, the next one is armed by its delay */
+static void reg_step(void* prm)
+{
+	reg_ctx_t* ctx = prm;
+	modem_t* priv = ctx->modem;
+	const reg_state_t* st;
 	int state_delay = 0;
-	modem_conf_t conf;
+	int last_error, res;
+	uint64_t delay;
+
+	if(ctx->finished)
+		return;
 
-	int last_error;
-	int prev_last_error = 0;
-	int cnt_last_error = 0;
+	reg_recover(ctx);
 
-	while(!priv->reg.terminate)
+	/* periodical reset and reset by watchdog */
+	if(__atomic_exchange_n(&ctx->reset_due, 0, __ATOMIC_RELAXED) && ctx->state != RS_RESET && ctx->state != RS_RESET_WAIT)
 	{
-		/* delay for commands */
-		if(state_delay)
-		{
-			/* periodical reset handling */
-			if(state != RS_RESET && conf.periodical_reset)
-			{
-				if(periodical_reset == 0)
-				{
-					printf("Periodical reset modem..\n");
+		if(ctx->reset_how == MODEM_RECOVER_POWER_CYCLE)
+			printf("Periodical reset modem..\n");
 
-					periodical_reset = conf.periodical_reset * 3600;
+		reg_enter(ctx, RS_RESET);
+	}
+	else if(clock_ms() < ctx->next && !reg_woken(ctx))
+	{
+		/* woken up before deadline */
+		sched_timer_at(ctx->sched, &ctx->step, ctx->next);
 
-					state = RS_RESET;
-				}
-				else
-				{
-					-- periodical_reset;
+		return;
+	}
 
-#ifdef _DEV_EDITION
-					printf("Periodical reset modem: %d\n", periodical_reset);
+	/* publish and report changes of previous state */
+	modem_state_publish(priv);
+	modem_notify(priv);
+
+	last_error = reg_last_error(ctx);
+
+	/* I/O modem error handling */
+	if(last_error == __ME_WRITE_FAILED || last_error == __ME_READ_FAILED)
+	{
+		++ ctx->cnt_last_error;
+
+#if _DEV_EDITION
+		printf("cnt_last_error: %d\n", ctx->cnt_last_error);
 #endif
-				}
+
+		if(ctx->cnt_last_error > 3)
+		{
+			ctx->cnt_last_error = 0;
+			ctx->prev_last_error = last_error;
+
+			/* watchdog checks modem and recovers it as light as possible */
+			if(watchdog_kick(priv))
+			{
+				printf("(EE) Too many errors (%d), reseting modem..\n", ctx->prev_last_error);
+
+				reg_enter(ctx, RS_RESET);
 			}
+			else
+				printf("(EE) Too many errors (%d), modem is checked by watchdog\n", ctx->prev_last_error);
+		}
 
-			sleep(1);
+		state_delay = 1;
+	}
+	else
+	{
+		ctx->cnt_last_error = 0;
+		ctx->prev_last_error = last_error;
+	}
 
 #ifdef _DEV_EDITION
-			printf("Delay: %d\n", state_delay);
+	printf("State: %s\n", RS_STR[ctx->state]);
+	printf("last_error: %d\n", last_error);
 #endif
-			-- state_delay;
 
-			continue;
-		}
+	st = &ctx->table[ctx->state];
+	ctx->delay = -1;
 
-		last_error = modem_queues_last_error(priv, MODEM_PROTO_AT);
+	/* skipped state goes to next one */
+	res = st->action ? st->action(ctx) : REG_NEXT;
 
-		/* I/O modem error handling */
-		if(last_error == __ME_WRITE_FAILED || last_error == __ME_READ_FAILED)
-		{
-			++ cnt_last_error;
+	reg_cycle_check(ctx, res);
 
-#if _DEV_EDITION
-			printf("cnt_last_error: %d\n", cnt_last_error);
-#endif
+	if(res == REG_FINISH)
+	{
+		reg_leave(ctx);
 
-			if(cnt_last_error > 3)
-			{
-				cnt_last_error = 0;
-				prev_last_error = at_q->last_error;
+		__atomic_store_n(&ctx->finished, 1, __ATOMIC_RELAXED);
 
-				printf("(EE) Too many errors (%d), reseting modem..\n", prev_last_error);
+		return;
+	}
 
-				state = RS_RESET;
-			}
+	/* retry is delayed by policy, other results end backoff */
+	if(res == REG_RETRY)
+		delay = reg_retry_delay(ctx, reg_last_error(ctx));
+	else
+	{
+		ctx->retry.state = RS_COUNT;
 
-			state_delay = 1;
-		}
+		/* action may change delay of table */
+		if(ctx->delay >= 0)
+			delay = ctx->delay * 1000ULL;
+		else if(res == REG_NEXT)
+			delay = st->delay * 1000ULL;
 		else
-		{
-			cnt_last_error = 0;
-			prev_last_error = at_q->last_error;
-		}
+			/* jump out of order */
+			delay = 0;
+
+		reg_enter(ctx, res == REG_NEXT ? st->next : res);
+	}
+
+	if(delay < state_delay * 1000ULL)
+		delay = state_delay * 1000ULL;
 
 #ifdef _DEV_EDITION
-		printf("State: %s\n", RS_STR[state]);
-		printf("last_error: %d\n", at_q->last_error);
+	if(delay)
+		printf("Delay: %llu ms\n", (unsigned long long)delay);
 #endif
 
-		if(state == RS_INIT)
-		{
-			printf("Started registration for modem on port %s\n", priv->port);
+	/* delay for commands is a deadline of next step */
+	ctx->next = clock_ms() + delay;
 
-			/* initialize data */
-			priv->reg.last_error = __ME_REG_IN_PROGRESS;
-			priv->reg.state.reg = MODEM_NETWORK_REG_SEARCHING;
+	sched_timer_at(ctx->sched, &ctx->step, ctx->next);
+}
 
-			state = RS_DISABLE_ECHO;
-		}
-		else if(state == RS_DISABLE_ECHO)
-		{
-			at_raw_ok(priv, "ATE0\r\n");
+/*------------------------------------------------------------------------*/
 
-			state = RS_CMEE_NUMBER;
-		}
-		else if(state == RS_CMEE_NUMBER)
-		{
-			at_raw_ok(priv, "AT+CMEE=1\r\n");
+int registration_start(modem_t* priv, sched_t* sched)
+{
+	const modem_info_device_t* mdd = priv->mdd;
+	modem_queues_t* mq;
+	reg_ctx_t* ctx;
+	int i;
 
-			state = RS_GET_FIRMWARE_VER;
-		}
-		else if(state == RS_GET_FIRMWARE_VER)
-		{
-			mdd->functions.get_fw_version(priv, &priv->reg.state.fw_info);
+	if(!(ctx = calloc(1, sizeof(*ctx))))
+		return(-1);
 
-			state = RS_GET_IMEI;
-		}
-		else if(state == RS_GET_IMEI)
-		{
-			mdd->functions.get_imei(priv, priv->reg.state.imei, sizeof(priv->reg.state.imei));
+	ctx->modem = priv;
+	ctx->sched = sched;
+	ctx->state = RS_INIT;
+	ctx->entered = clock_ms();
+	ctx->stats[RS_INIT].entries = 1;
+	ctx->reset_how = MODEM_RECOVER_POWER_CYCLE;
+	ctx->retry.state = RS_COUNT;
 
-			state = RS_READ_CONFIG;
-		}
-		else if(state == RS_READ_CONFIG)
-		{
-			/* waiting for config */
-			if(modem_conf_read(priv->port, &conf))
-			{
-				state_delay = 1;
+	/* modems started together retry at different times */
+	ctx->seed = clock_ms();
 
-				continue;
-			}
+	for(i = 0; priv->port[i]; ++ i)
+		ctx->seed = ctx->seed * 31 + priv->port[i];
 
-			periodical_reset = conf.periodical_reset * 3600;
-	
-			state = RS_SET_BAND;
-		}
-		else if(state == RS_SET_BAND)
-		{
-			/* current modem band */
-			int band = mdd->functions.get_freq_band(priv);
-			
-			printf("(II) Modem Band is %x\n", band);
+	reg_cycle_start(ctx, RS_INIT);
 
-			if(conf.frequency_band != band)
-			{
-				/* band selection */
-				if(mdd->functions.set_freq_band(priv, conf.frequency_band))
-				{
-					priv->reg.last_error = at_q->last_error;
+	/* values are polled with fixed period until they are stable */
+	for(i = 0; i < RP_COUNT; ++ i)
+		ctx->polls[i].interval = REG_POLL_PERIOD;
 
-					printf("(EE) Band selection error: %d\n", at_q->last_error);
+	/* errors of device functions are in queue of its own protocol */
+	ctx->proto = MODEM_PROTO_AT;
 
-					return(NULL);
-				}
+	for(mq = priv->queues; mq; mq = mq->next)
+		if(mq->proto != MODEM_PROTO_AT)
+			ctx->proto = mq->proto;
 
-				/* delay for band setup */
-				state_delay = 5;
+	/* table of device */
+	memcpy(ctx->table, reg_states_default, sizeof(ctx->table));
 
-				/* reset is required */
-				state = RS_RESET;
+	if(mdd->reg_table)
+		mdd->reg_table(ctx->table);
 
-				continue;
-			}
+	/* values of previous session are known at once */
+	if(!modem_persist_load(priv))
+	{
+		printf("(DD) Persisted data of port %s is loaded\n", priv->port);
 
-			state = RS_CHECK_PIN;
-		}
-		else if(state == RS_CHECK_PIN)
-		{
-			switch(mdd->functions.cpin_state(priv))
-			{
-				case MODEM_CPIN_STATE_PIN:
-					state = RS_SET_PIN;
-					break;
-
-				case MODEM_CPIN_STATE_PUK:
-					state = RS_SET_PUK;
-					break;
-
-				case MODEM_CPIN_STATE_READY:
-					state = RS_GET_IMSI;
-					break;
-
-				default:
-					/* registration error? */;
-					priv->reg.last_error = at_q->last_error;
-
-					if(at_q->last_error == __ME_SIM_BUSY)
-						state_delay = 5;
-					else if(at_q->last_error == __ME_SIM_WRONG)
-						/* buggy MC7750 ... */
-						state_delay = 10;
-					else if(at_q->last_error == __ME_NO_SIM)
-					{
-						/* set registration status as a denied */
-						priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
-
-						return(NULL);
-					}
-			}
-		}
-		else if(state == RS_SET_PIN)
-		{
-			if(*conf.pin && !mdd->functions.cpin_pin(priv, conf.pin))
-			{
-				state = RS_GET_IMSI;
-			}
-			else
-			{
-				printf("(EE) PIN Error\n");
+		ctx->ident = REG_IDENT_CACHED;
 
-				if(*conf.pin)
-					/* SIM PIN invalid */
-					priv->reg.last_error = at_q->last_error;
-				else
-					priv->reg.last_error = __ME_SIM_PIN;
+		reg_state_updated(priv, MODEM_STATUS_FW_INFO);
+		reg_state_updated(priv, MODEM_STATUS_IMEI);
+		reg_state_updated(priv, MODEM_STATUS_IMSI);
+		reg_state_updated(priv, MODEM_STATUS_CCID);
+	}
 
-				/* set registration status as a denied */
-				priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+	sched_timer_add(sched, &ctx->step, "registration", priv->port, reg_step, ctx);
+	sched_timer_add(sched, &ctx->reset, "reset", priv->port, reg_reset, ctx);
 
-				return(NULL);
-			}
-		}
-		else if(state == RS_SET_PUK)
-		{
-			if(*conf.pin && *conf.puk && !mdd->functions.cpin_puk(priv, conf.puk, conf.pin))
-			{
-				state = RS_GET_IMSI;
-			}
-			else
-			{
-				if(*conf.pin && *conf.puk)
-					/* SIM PUK invalid */
-					priv->reg.last_error = at_q->last_error;
-				else
-					priv->reg.last_error = __ME_SIM_PUK;
+	pthread_mutex_lock(&reg_lock);
+	modem_priv(priv)->routine = ctx;
+	pthread_mutex_unlock(&reg_lock);
 
-				/* set registration status as a denied */
-				priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+	sched_timer_at(sched, &ctx->step, clock_ms());
 
-				return(NULL);
-			}
-		}
-		else if(state == RS_GET_IMSI)
-		{
-			if(conf.frequency_band == 10)
-			{
-				state = RS_OPERATOR_SELECT;
+	return(0);
+}
 
-				printf("(WW) Band is CDMA skip SIM Check's\n");
+/*------------------------------------------------------------------------*/
 
-				continue;
-			}
+/** stop routine, lock of restarts must be held */
+static void reg_stop(modem_t* priv)
+{
+	reg_ctx_t* ctx;
 
-			if(!mdd->functions.get_imsi(priv, priv->reg.state.imsi, sizeof(priv->reg.state.imsi)))
-			{
-				/* SIM busy? */
-				state_delay = 5;
+	pthread_mutex_lock(&reg_lock);
+	ctx = modem_priv(priv)->routine;
+	modem_priv(priv)->routine = NULL;
+	pthread_mutex_unlock(&reg_lock);
 
-				continue;
-			}
+	if(!ctx)
+		return;
 
-			/* mcc */
-			strncpy(priv->reg.state.mcc, priv->reg.state.imsi, sizeof(priv->reg.state.mcc) - 1);
-			priv->reg.state.mcc[sizeof(priv->reg.state.mcc) - 1] = 0;
+	/* reset arms step, it is removed first */
+	sched_timer_del(ctx->sched, &ctx->reset);
+	sched_timer_del(ctx->sched, &ctx->step);
 
-			/* mnc */
-			strncpy(priv->reg.state.mnc, priv->reg.state.imsi + strlen(priv->reg.state.mcc), sizeof(priv->reg.state.mnc) - 1);
-			priv->reg.state.mnc[mnc_get_length(priv->reg.state.imsi)] = 0;
+	/* queues are suspended by interrupted reset */
+	if(ctx->state == RS_RESET_WAIT)
+		modem_reset_done(priv);
 
-			state = RS_MCC_LOCK;
-		}
-		else if(state == RS_MCC_LOCK)
-		{
-			printf("MCC = [%s]\n", priv->reg.state.mcc);
+	free(ctx);
+}
 
-			if(*conf.mcc_lock)
-			{
-				if(strcmp(priv->reg.state.mcc, conf.mcc_lock) != 0)
-				{
-					/* Network not allowed, emergency calls only  */
-					priv->reg.last_error = __ME_MCC_LOCKED;
+/*------------------------------------------------------------------------*/
 
-					/* set registration status as a denied */
-					priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+void registration_stop(modem_t* priv)
+{
+	pthread_mutex_lock(&restart_lock);
+	reg_stop(priv);
+	pthread_mutex_unlock(&restart_lock);
+}
 
-					printf("(EE) MCC Lock error\n");
+/*------------------------------------------------------------------------*/
 
-					return(NULL);
-				}
-			}
+int registration_restart(modem_t* priv, sched_t* sched)
+{
+	int res = 1;
 
-			state = RS_MNC_LOCK;
-		}
-		else if(state == RS_MNC_LOCK)
-		{
-			printf("MNC = [%s]\n", priv->reg.state.mnc);
+	pthread_mutex_lock(&restart_lock);
 
-			if(*conf.mnc_lock)
-			{
-				if(strcmp(priv->reg.state.mnc, conf.mnc_lock) != 0)
-				{
-					/* Network not allowed, emergency calls only  */
-					priv->reg.last_error = __ME_MNC_LOCKED;
+	/* stopped routine is not started again */
+	pthread_mutex_lock(&reg_lock);
 
-					/* set registration status as a denied */
-					priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+	if(modem_priv(priv)->routine)
+		res = 0;
 
-					printf("(EE) MNC Lock error\n");
+	pthread_mutex_unlock(&reg_lock);
 
-					return(NULL);
-				}
-			}
+	if(!res)
+	{
+		reg_stop(priv);
 
-			state = RS_CCID_LOCK;
-		}
-		else if(state == RS_CCID_LOCK)
-		{
-			if(!mc77x0_at_get_ccid(priv, priv->reg.state.ccid, sizeof(priv->reg.state.ccid)))
-			{
-				state_delay = 5;
+		res = registration_start(priv, sched);
+	}
 
-				continue;
-			}
+	pthread_mutex_unlock(&restart_lock);
 
-			printf("CCID = [%s]\n", priv->reg.state.ccid);
+	return(res);
+}
 
-			if
-			(
-				*conf.ccid.low && *conf.ccid.high && (
-					strcasecmp(priv->reg.state.ccid, conf.ccid.low) < 0 ||
-					strcasecmp(conf.ccid.high, priv->reg.state.ccid) < 0
-				)
-			)
-			{
-				/* Network not allowed, emergency calls only  */
-				priv->reg.last_error = __ME_CCID_LOCKED;
+/*------------------------------------------------------------------------*/
 
-				/* set registration status as a denied */
-				priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+int registration_recover(modem_t* priv, modem_recover_t how)
+{
+	reg_ctx_t* ctx;
+	int res = -1;
 
-				printf("(EE) CCID Lock error\n");
+	pthread_mutex_lock(&reg_lock);
 
-				return(NULL);
-			}
+	if((ctx = modem_priv(priv)->routine) && !__atomic_load_n(&ctx->finished, __ATOMIC_RELAXED))
+	{
+		__atomic_store_n(&ctx->recover, how, __ATOMIC_RELAXED);
 
-			state = RS_MSIN_LOCK;
-		}
-		else if(state == RS_MSIN_LOCK)
-		{
-			strncpy(priv->reg.state.msin,
-				priv->reg.state.imsi +
-					strlen(priv->reg.state.mcc) +
-					strlen(priv->reg.state.mnc),
-				sizeof(priv->reg.state.msin));
-
-			printf("MSIN = [%s]\n", priv->reg.state.msin);
-
-			if
-			(
-				*conf.msin.low && *conf.msin.high && (
-					strcasecmp(priv->reg.state.msin, conf.msin.low) < 0 ||
-					strcasecmp(conf.msin.high, priv->reg.state.msin) < 0
-				)
-			)
-			{
-				/* Network not allowed, emergency calls only  */
-				priv->reg.last_error = __ME_MSIN_LOCKED;
+		sched_timer_at(ctx->sched, &ctx->step, clock_ms());
 
-				/* set registration status as a denied */
-				priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+		res = 0;
+	}
 
-				printf("(EE) MSIN Lock error\n");
+	pthread_mutex_unlock(&reg_lock);
 
-				return(NULL);
-			}
+	return(res);
+}
 
-			state = RS_OPERATOR_SELECT;
-		}
-		else if(state == RS_OPERATOR_SELECT)
-		{
-			if(mdd->functions.operator_select(priv, conf.operator_number, conf.access_technology))
-			{
-				// operator selection is failed, wait 5 seconds and try again
-				state_delay = 5;
+/*------------------------------------------------------------------------*/
 
-				continue;
-			}
+int registration_stats(modem_t* priv, modem_reg_state_stats_t* stats, int max)
+{
+	reg_state_id_t state;
+	reg_ctx_t* ctx;
+	uint64_t dwell;
+	int i, n = -1;
 
-			state = RS_CHECK_REGISTRATION;
-		}
-		else if(state == RS_CHECK_REGISTRATION)
-		{
-			priv->reg.state.reg = mdd->functions.network_registration(priv);
+	pthread_mutex_lock(&reg_lock);
 
-			/* if roaming disabled */
-			if(MODEM_NETWORK_REG_ROAMING == priv->reg.state.reg && !conf.roaming)
-				/* set registration status as a denied */
-				priv->reg.state.reg = MODEM_NETWORK_REG_DENIED;
+	if(!(ctx = modem_priv(priv)->routine))
+		goto exit;
 
-			switch(priv->reg.state.reg)
-			{
-				case MODEM_NETWORK_REG_HOME:
-				case MODEM_NETWORK_REG_ROAMING:
-					priv->reg.ready = 1;
-					priv->reg.last_error = -1;
-					state = RS_GET_SIGNAL_QUALITY;
-					break;
-
-				default:
-					priv->reg.ready = 0;
-					priv->reg.last_error = __ME_REG_IN_PROGRESS;
-
-					state_delay = 5;
-					break;
-			}
-		}
-		else if(state == RS_GET_SIGNAL_QUALITY)
-		{
-			mdd->functions.get_signal_quality(priv, &priv->reg.state.sq);
+	state = __atomic_load_n(&ctx->state, __ATOMIC_RELAXED);
 
-			state = RS_GET_NETWORK_TYPE;
-		}
-		else if(state == RS_GET_NETWORK_TYPE)
-		{
-			mdd->functions.get_network_type(priv, priv->reg.state.network_type, sizeof(priv->reg.state.network_type));
+	for(n = 0, i = 0; i < RS_COUNT && n < max; ++ i)
+	{
+		/* only entered states */
+		if(!__atomic_load_n(&ctx->stats[i].entries, __ATOMIC_RELAXED))
+			continue;
 
-			state = RS_GET_OPERATOR_NUMBER;
-		}
-		else if(state == RS_GET_OPERATOR_NUMBER)
-		{
-			if(!mdd->functions.get_operator_number(priv, priv->reg.state.oper_number, sizeof(priv->reg.state.oper_number)))
-				*priv->reg.state.oper_number = 0;
+		snprintf(stats[n].name, sizeof(stats[n].name), "%s", RS_STR[i]);
 
-			state = RS_GET_OPERATOR_NAME;
-		}
-		else if(state == RS_GET_OPERATOR_NAME)
+		stats[n].entries = __atomic_load_n(&ctx->stats[i].entries, __ATOMIC_RELAXED);
+		stats[n].dwell_ms = __atomic_load_n(&ctx->stats[i].dwell_ms, __ATOMIC_RELAXED);
+		stats[n].dwell_max_ms = __atomic_load_n(&ctx->stats[i].dwell_max_ms, __ATOMIC_RELAXED);
+		stats[n].current = (i == state);
+
+		/* time in current state is accounted too */
+		if(stats[n].current && !__atomic_load_n(&ctx->finished, __ATOMIC_RELAXED))
 		{
-			if(!mdd->functions.get_operator_name(priv, priv->reg.state.oper, sizeof(priv->reg.state.oper)))
-				*priv->reg.state.oper = 0;
+			dwell = clock_ms() - __atomic_load_n(&ctx->entered, __ATOMIC_RELAXED);
 
-			state = RS_CHECK_REGISTRATION;
+			stats[n].dwell_ms += dwell;
 
-			state_delay = 10;
+			if(dwell > stats[n].dwell_max_ms)
+				stats[n].dwell_max_ms = dwell;
 		}
-		else if(state == RS_RESET)
+
+		++ n;
+	}
+
+exit:
+	pthread_mutex_unlock(&reg_lock);
+
+	return(n);
+}
+
+/*------------------------------------------------------------------------*/
+
+int registration_retry_trace(modem_t* priv, modem_reg_retry_t* trace, int max)
+{
+	modem_reg_retry_t* res;
+	reg_ctx_t* ctx;
+	uint32_t i;
+	int n = -1;
+
+	pthread_mutex_lock(&reg_lock);
+
+	if(!(ctx = modem_priv(priv)->routine))
+		goto exit;
+
+	n = 0;
+
+	/* oldest kept decision first */
+	for(i = ctx->retries > REG_RETRY_TRACE ? ctx->retries - REG_RETRY_TRACE : 0; i < ctx->retries && n < max; ++ i)
+	{
+		res = &trace[n ++];
+
+		memset(res, 0, sizeof(*res));
+
+		res->time_ms = ctx->retry_trace[i % REG_RETRY_TRACE].time;
+		snprintf(res->name, sizeof(res->name), "%s", RS_STR[ctx->retry_trace[i % REG_RETRY_TRACE].state]);
+		res->error = ctx->retry_trace[i % REG_RETRY_TRACE].error;
+		res->attempt = ctx->retry_trace[i % REG_RETRY_TRACE].attempt;
+		res->delay_ms = ctx->retry_trace[i % REG_RETRY_TRACE].delay;
+		snprintf(res->rule, sizeof(res->rule), "%s", REG_RETRY_RULE_STR[ctx->retry_trace[i % REG_RETRY_TRACE].rule]);
+	}
+
+exit:
+	pthread_mutex_unlock(&reg_lock);
+
+	return(n);
+}
+
+/*------------------------------------------------------------------------*/
+
+int registration_poll_stats(modem_t* priv, modem_poll_stats_t* stats, int max)
+{
+	modem_poll_stats_t* res;
+	uint64_t now, first, elapsed, expected;
+	reg_ctx_t* ctx;
+	int i, n = -1;
+
+	pthread_mutex_lock(&reg_lock);
+
+	if(!(ctx = modem_priv(priv)->routine))
+		goto exit;
+
+	now = clock_ms();
+
+	for(n = 0, i = 0; i < RP_COUNT && n < max; ++ i)
+	{
+		res = &stats[n ++];
+
+		memset(res, 0, sizeof(*res));
+
+		snprintf(res->name, sizeof(res->name), "%s", reg_polls[i].name);
+
+		res->interval_ms = reg_poll_interval(ctx, i, now);
+		res->commands = __atomic_load_n(&ctx->polls[i].commands, __ATOMIC_RELAXED);
+		res->observed = reg_poll_observed(ctx, i, now);
+
+		if(!(first = __atomic_load_n(&ctx->polls[i].first, __ATOMIC_RELAXED)))
+			continue;
+
+		/* fixed period polls value at once and then once per period */
+		elapsed = now - first;
+		expected = (elapsed / REG_POLL_PERIOD + 1) * reg_polls[i].commands;
+
+		if(expected > res->commands)
+			res->saved = expected - res->commands;
+
+		if(elapsed)
+			res->saved_per_hour = res->saved * 3600000ULL / elapsed;
+	}
+
+exit:
+	pthread_mutex_unlock(&reg_lock);
+
+	return(n);
+}
+
+/*------------------------------------------------------------------------*/
+
+void registration_read(modem_t* priv, modem_status_field_t field)
+{
+	uint64_t now = clock_ms(), prev = modem_priv(priv)->read[field];
+	reg_ctx_t* ctx;
+
+	modem_priv(priv)->read[field] = now;
+
+	/* value is observed already, its polling is not backed off */
+	if(now - prev < REG_POLL_OBSERVED)
+		return;
+
+	pthread_mutex_lock(&reg_lock);
+
+	/* routine waiting for polling checks intervals again */
+	if((ctx = modem_priv(priv)->routine))
+	{
+		__atomic_store_n(&ctx->wake, 1, __ATOMIC_RELAXED);
+
+		sched_timer_at(ctx->sched, &ctx->step, now);
+	}
+
+	pthread_mutex_unlock(&reg_lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+int registration_timeline(modem_t* priv, modem_reg_timeline_t* timeline, int max)
+{
+	modem_reg_timeline_t* res;
+	reg_ctx_t* ctx;
+	uint32_t cycle;
+	int i, n = -1, state;
+
+	pthread_mutex_lock(&reg_lock);
+
+	if(!(ctx = modem_priv(priv)->routine))
+		goto exit;
+
+	n = 0;
+
+	/* oldest kept cycle first */
+	for(cycle = ctx->cycles > REG_TIMELINE_CYCLES ? ctx->cycles - REG_TIMELINE_CYCLES : 0; cycle < ctx->cycles; ++ cycle)
+	{
+		reg_cycle_t* tl = &ctx->timeline[cycle % REG_TIMELINE_CYCLES];
+
+		for(i = 0; i < tl->n && n < max; ++ i)
 		{
-			modem_reset(priv);
+			res = &timeline[n ++];
+			state = tl->entries[i].state;
 
-			state = RS_INIT;
+			memset(res, 0, sizeof(*res));
+
+			res->cycle = cycle + 1;
+			snprintf(res->name, sizeof(res->name), "%s",
+				state < RS_COUNT ? RS_STR[state] : state == REG_TL_REGISTERED ? "REGISTERED" : "FAILED");
+			res->time_ms = tl->entries[i].time;
+			res->offset_ms = tl->entries[i].time - tl->entries[0].time;
+			res->retries = __atomic_load_n(&tl->entries[i].retries, __ATOMIC_RELAXED);
 		}
 	}
 
-	return(NULL);
+exit:
+	pthread_mutex_unlock(&reg_lock);
+
+	return(n);
 }
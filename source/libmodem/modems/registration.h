@@ -1,8 +1,415 @@
-#ifndef __MC77X0_REGISTRATION_H
-#define __MC77X0_REGISTRATION_H
+#ifndef __REGISTRATION_H
+#define __REGISTRATION_H
+
+#include <stdint.h>
 
 #include "modem/types.h"
+#include "modem/modem_errno.h"
+
+#include "modem_int.h"
+
+#include "utils/scheduler.h"
+
+#include "modems/modem_conf.h"
+
+/***************************************************************************
+
+	Registration routine is a table of states. Each state has an action
+	calling only functions of modem_info_device_t, so routine does not
+	depend on protocol of modem. Device customises the default table by
+	its reg_table function: state with NULL action is skipped, next state
+	and delays may be changed, actions may be replaced.
+
+***************************************************************************/
+
+/* states of registration routine: F(state) */
+#define REG_STATES(F)			\
+	F(RS_INIT)					\
+	F(RS_DISABLE_ECHO)			\
+	F(RS_CMEE_NUMBER)			\
+	F(RS_GET_FIRMWARE_VER)		\
+	F(RS_GET_IMEI)				\
+	F(RS_READ_CONFIG)			\
+	F(RS_SET_BAND)				\
+	F(RS_SET_APN)				\
+	F(RS_SET_AUTH)				\
+	F(RS_CHECK_PIN)				\
+	F(RS_SET_PIN)				\
+	F(RS_SET_PUK)				\
+	F(RS_GET_IMSI)				\
+	F(RS_MCC_LOCK)				\
+	F(RS_MNC_LOCK)				\
+	F(RS_CCID_LOCK)				\
+	F(RS_MSIN_LOCK)				\
+	F(RS_OPERATOR_SELECT)		\
+	F(RS_CHECK_REGISTRATION)	\
+	F(RS_GET_SIGNAL_QUALITY)	\
+	F(RS_GET_NETWORK_TYPE)		\
+	F(RS_GET_OPERATOR_NUMBER)	\
+	F(RS_GET_OPERATOR_NAME)		\
+	F(RS_VALIDATE_IDENT)		\
+	F(RS_GET_STATE_WWAN)		\
+	F(RS_POLL_WAIT)				\
+	F(RS_RESET)					\
+	F(RS_RESET_WAIT)
+
+typedef enum
+{
+#define __REG_STATE(state) state,
+	REG_STATES(__REG_STATE)
+#undef __REG_STATE
+
+	RS_COUNT
+} reg_state_id_t;
+
+/*------------------------------------------------------------------------*/
+
+/* values polled by registered modem: F(poll, state, events of subscribers, field read by clients, AT commands) */
+#define REG_POLLS(F)																				\
+	F(RP_REG,			RS_CHECK_REGISTRATION,	MODEM_EVENT_REG,			MODEM_STATUS_REG,			1)	\
+	F(RP_SQ,			RS_GET_SIGNAL_QUALITY,	MODEM_EVENT_SQ,				MODEM_STATUS_SQ,			1)	\
+	F(RP_NETWORK_TYPE,	RS_GET_NETWORK_TYPE,	MODEM_EVENT_NETWORK_TYPE,	MODEM_STATUS_NETWORK_TYPE,	1)	\
+	F(RP_OPER,			RS_GET_OPERATOR_NUMBER,	MODEM_EVENT_REG,			MODEM_STATUS_OPER,			2)
+
+typedef enum
+{
+#define __REG_POLL(poll, state, events, field, commands) poll,
+	REG_POLLS(__REG_POLL)
+#undef __REG_POLL
+
+	RP_COUNT
+} reg_poll_id_t;
+
+/** fixed period of polling of values before adaptive polling, ms */
+#define REG_POLL_PERIOD 10000
+
+/** interval of polling of fluctuating values, ms */
+#define REG_POLL_FAST 5000
+
+/** value read by clients within this time is observed, ms */
+#define REG_POLL_OBSERVED 60000
+
+/** default maximal interval of polling of stable values, s */
+#define REG_POLL_MAX 120
+
+/*------------------------------------------------------------------------*/
+
+/* default retry policy: F(state, error or MODEM_CONF_ANY_ERROR, base delay ms, maximal delay ms, jitter %)
+ *
+ * Busy SIM is polled fast, buggy MC7750 reports wrong SIM for a while, flapping
+ * network is not hammered. Rules of config go first, other states retry by table. */
+#define REG_RETRY_POLICY(F)																\
+	F(RS_CHECK_PIN,				__ME_SIM_BUSY,			500,	5000,	0)				\
+	F(RS_CHECK_PIN,				__ME_SIM_WRONG,			10000,	10000,	0)				\
+	F(RS_OPERATOR_SELECT,		MODEM_CONF_ANY_ERROR,	5000,	60000,	20)				\
+	F(RS_CHECK_REGISTRATION,	MODEM_CONF_ANY_ERROR,	5000,	20000,	20)
+
+/** retry decisions kept in trace */
+#define REG_RETRY_TRACE 32
+
+/** rule of retry policy */
+typedef struct
+{
+	reg_state_id_t state;
+
+	/** error of last command of state, MODEM_CONF_ANY_ERROR for any */
+	int error;
+
+	/** delay of first retry, doubled by each next one up to maximum, ms */
+	uint32_t base;
+	uint32_t max;
+
+	/** random deviation of delay, percent */
+	int jitter;
+} reg_retry_rule_t;
+
+/*------------------------------------------------------------------------*/
+
+/** registration cycles kept in timeline */
+#define REG_TIMELINE_CYCLES 4
+
+/** transitions kept per cycle, the later ones are dropped */
+#define REG_TIMELINE_ENTRIES 48
+
+/*------------------------------------------------------------------------*/
+
+/** result of action, routine goes to next state of table */
+#define REG_NEXT (-1)
+
+/** result of action, action is repeated after retry delay */
+#define REG_RETRY (-2)
+
+/** result of action, routine is finished, registration is failed */
+#define REG_FINISH (-3)
+
+/** values valid per session: firmware, IMEI, IMSI and CCID */
+typedef enum
+{
+	/** values are queried from modem */
+	REG_IDENT_NONE = 0,
+
+	/** values are read from disk, firmware and IMEI are not validated yet */
+	REG_IDENT_CACHED,
+
+	/** values are validated and written to disk */
+	REG_IDENT_SAVED
+} reg_ident_t;
+
+/** transitions of one registration cycle */
+typedef struct
+{
+	/** cycle is not registered or failed yet */
+	int open;
+
+	int n;
+
+	struct
+	{
+		/** entered state, or end of cycle */
+		int state;
+
+		/** time of entry, ms */
+		uint64_t time;
+
+		uint32_t retries;
+	} entries[REG_TIMELINE_ENTRIES];
+} reg_cycle_t;
+
+typedef struct reg_ctx_s reg_ctx_t;
+
+/** action of state, returns REG_* or state to jump to */
+typedef int (*reg_action_t)(reg_ctx_t* ctx);
+
+typedef struct
+{
+	/** action, NULL if state is skipped */
+	reg_action_t action;
+
+	/** state after successful action */
+	reg_state_id_t next;
+
+	/** delay before next state, s */
+	int delay;
+
+	/** delay before repeating of action, s */
+	int retry_delay;
+} reg_state_t;
+
+/*------------------------------------------------------------------------*/
+
+struct reg_ctx_s
+{
+	modem_t* modem;
+
+	sched_t* sched;
+
+	/** step of routine */
+	sched_timer_t step;
+
+	/** periodical reset */
+	sched_timer_t reset;
+
+	/** table of states customised by device */
+	reg_state_t table[RS_COUNT];
+
+	reg_state_id_t state;
+
+	/** time of entry to current state, ms */
+	uint64_t entered;
+
+	/** deadline of next step, ms */
+	uint64_t next;
+
+	/** delay set by action instead of delay of table, s, -1 if not set */
+	int delay;
+
+	/** protocol of errors of device functions */
+	modem_proto_t proto;
+
+	modem_conf_t conf;
+
+	/** period of reset is expired */
+	int reset_due;
+
+	/** kind of next reset, power cycle if not requested by watchdog */
+	modem_recover_t reset_how;
+
+	/** recovery requested by watchdog, MODEM_RECOVER_* */
+	int recover;
+
+	/** routine is finished by error */
+	int finished;
+
+	/** source of values valid per session */
+	reg_ident_t ident;
+
+	/** wake up by client starting to read values */
+	int wake;
+
+	/** operator number is polled, name is polled too */
+	int oper_polled;
+
+	/** adaptive polling of values */
+	struct
+	{
+		/** interval of polling, ms */
+		uint32_t interval;
+
+		/** time of last polling, ms */
+		uint64_t last;
+
+		/** time of first polling, ms */
+		uint64_t first;
+
+		/** value is changed by current polling */
+		int changed;
+
+		uint32_t commands;
+	} polls[RP_COUNT];
+
+	int prev_last_error;
+	int cnt_last_error;
+
+	/** rules of retry policy read from config */
+	reg_retry_rule_t retry_rules[MODEM_CONF_RETRY_MAX];
+	int retry_rules_count;
+
+	/** consecutive retries of state with the same error */
+	struct
+	{
+		reg_state_id_t state;
+
+		int error;
+
+		uint32_t attempt;
+	} retry;
+
+	/** seed of jitter of retries */
+	unsigned int seed;
+
+	/** decisions made, the last one is in retry_trace[(retries - 1) % REG_RETRY_TRACE] */
+	uint32_t retries;
+
+	/** last retry decisions, guarded by lock of routines */
+	struct
+	{
+		uint64_t time;
+
+		reg_state_id_t state;
+
+		int error;
+
+		uint32_t attempt;
+
+		uint32_t delay;
+
+		/** rule of policy, see REG_RETRY_RULE_STR */
+		int rule;
+	} retry_trace[REG_RETRY_TRACE];
+
+	/** cycles started, the last one is in timeline[(cycles - 1) % REG_TIMELINE_CYCLES] */
+	uint32_t cycles;
+
+	/** last registration cycles, guarded by lock of routines */
+	reg_cycle_t timeline[REG_TIMELINE_CYCLES];
+
+	/** statistics of states */
+	struct
+	{
+		uint32_t entries;
+
+		uint64_t dwell_ms;
+
+		uint32_t dwell_max_ms;
+	} stats[RS_COUNT];
+};
+
+/*------------------------------------------------------------------------*/
+
+/** default table of states */
+extern const reg_state_t reg_states_default[RS_COUNT];
+
+/**
+ * @brief start registration routine, its steps are callbacks of scheduler
+ * @param priv modem
+ * @param sched scheduler
+ * @return zero if successful
+ */
+int registration_start(modem_t* priv, sched_t* sched);
+
+/**
+ * @brief stop registration routine, running step is waited for
+ * @param priv modem
+ */
+void registration_stop(modem_t* priv);
+
+/**
+ * @brief start running routine again, e.g. with new config
+ * @param priv modem
+ * @param sched scheduler
+ * @return zero if successful, 1 if routine is not running, -1 if failed to start
+ *
+ * Restarts and stops are serialized, so parallel restarts leave one routine.
+ */
+int registration_restart(modem_t* priv, sched_t* sched);
+
+/**
+ * @brief request recovery of modem, it is made by the next step at once
+ * @param priv modem
+ * @param how recovery
+ * @return zero if requested, -1 if routine is not running
+ *
+ * Routine owns queues, so channels are reopened and modem is reset only by
+ * routine. Resets go through RS_RESET and start new cycle of registration.
+ */
+int registration_recover(modem_t* priv, modem_recover_t how);
+
+/**
+ * @brief return statistics of states of registration routine
+ * @param priv modem
+ * @param stats buffer for statistics
+ * @param max size of buffer
+ * @return number of states, -1 if routine is not running
+ */
+int registration_stats(modem_t* priv, modem_reg_state_stats_t* stats, int max);
+
+/**
+ * @brief return timeline of last registration cycles
+ * @param priv modem
+ * @param timeline buffer for transitions
+ * @param max size of buffer
+ * @return number of transitions, -1 if routine is not running
+ *
+ * Cycle is started by start of routine, by reset and by loss of registration,
+ * it is ended by registration or failure.
+ */
+int registration_timeline(modem_t* priv, modem_reg_timeline_t* timeline, int max);
+
+/**
+ * @brief return last retry decisions of registration routine
+ * @param priv modem
+ * @param trace buffer for decisions
+ * @param max size of buffer
+ * @return number of decisions, -1 if routine is not running
+ */
+int registration_retry_trace(modem_t* priv, modem_reg_retry_t* trace, int max);
+
+/**
+ * @brief return statistics of adaptive polling of values
+ * @param priv modem
+ * @param stats buffer for statistics
+ * @param max size of buffer
+ * @return number of values, -1 if routine is not running
+ */
+int registration_poll_stats(modem_t* priv, modem_poll_stats_t* stats, int max);
 
-void* mc77x0_thread_reg(modem_t *priv);
+/**
+ * @brief report read of value by client
+ * @param priv modem
+ * @param field value, MODEM_STATUS_*
+ *
+ * Polling of value not observed before is sped up at once.
+ */
+void registration_read(modem_t* priv, modem_status_field_t field);
 
-#endif /* __MC77X0_REGISTRATION_H */
+#endif /* __REGISTRATION_H */
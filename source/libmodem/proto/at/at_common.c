@@ -115,6 +115,29 @@ int at_raw_ok(modem_t* modem, const char* cmd)
 
 /*------------------------------------------------------------------------*/
 
+int at_ping(modem_t* modem)
+{
+	at_queue_t* at_q;
+	at_query_t* q;
+	int res = -1;
+
+	if(!(at_q = modem_proto_get(modem, MODEM_PROTO_AT)))
+		return(res);
+
+	/* alive modem replies at once */
+	q = at_query_create("AT\r\n", "\r\nOK\r\n");
+	q->timeout = 2;
+	at_query_exec(at_q->queue, q);
+
+	res = at_query_is_error(q);
+
+	at_query_free(q);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
 char* at_get_imsi(modem_t* modem, char* imsi, size_t len)
 {
 	at_queue_t* at_q;
@@ -28,6 +28,15 @@ int at_raw_ok(modem_t* modem, const char* cmd);
 
 /*------------------------------------------------------------------------*/
 
+/**
+ * @brief check that modem replies to bare AT with short timeout
+ * @param modem modem that support AT queue
+ * @return zero if modem replied
+ */
+int at_ping(modem_t* modem);
+
+/*------------------------------------------------------------------------*/
+
 char* at_get_imsi(modem_t* modem, char* imsi, size_t len);
 
 /*------------------------------------------------------------------------*/
@@ -22,6 +22,7 @@
 #include "utils/re.h"
 #include "utils/str.h"
 #include "utils/file.h"
+#include "utils/clock.h"
 
 /*------------------------------------------------------------------------*/
 
@@ -35,6 +36,8 @@ void* at_queue_thread_write(void* prm)
 	at_query_t* q;
 	void* buf = NULL;
 	size_t buf_len;
+	char* cmd;
+	int res;
 
 	while(!at_q->terminate)
 	{
@@ -55,8 +58,26 @@ void* at_queue_thread_write(void* prm)
 
 		syslog(LOG_INFO | LOG_LOCAL7, "write() [%s]", q->cmd);
 
-		if(write(at_q->fd, q->cmd, strlen(q->cmd)) == -1)
+		/* query may be done and freed by its reply before write() returns */
+		if(!(cmd = strdup(q->cmd)))
 		{
+			at_q->last_error = q->error = __ME_WRITE_FAILED;
+			event_signal(q->event);
+
+			continue;
+		}
+
+		/* reply may come before write() returns, it must not be taken as unsolicited */
+		at_q->query = q;
+
+		res = write(at_q->fd, cmd, strlen(cmd));
+
+		free(cmd);
+
+		if(res == -1)
+		{
+			at_q->query = NULL;
+
 			/* failed to write command */
 			at_q->last_error = q->error = __ME_WRITE_FAILED;
 
@@ -66,8 +87,6 @@ void* at_queue_thread_write(void* prm)
 			continue;
 		}
 
-		at_q->query = q;
-
 		/* wait for answer */
 		event_wait(at_q->event);
 	}
@@ -114,6 +133,8 @@ void* at_queue_thread_read(void* prm)
 		if((res = read(at_q->fd, buf + buf_len, sizeof(buf) - buf_len - 1)) <= 0)
 			continue;
 
+		__atomic_store_n(&at_q->last_read, clock_ms(), __ATOMIC_RELAXED);
+
 		/* if query not set, this is unsolicited response */
 		if(!at_q->query)
 		{
@@ -178,6 +199,7 @@ at_queue_t* at_queue_open(const char *dev)
 	res->terminate = 0;
 	res->query = NULL;
 	res->last_error = -1;
+	res->last_read = 0;
 
 	res->event = event_create();
 
@@ -219,7 +241,8 @@ void at_queue_suspend(at_queue_t* at_queue)
 {
 	void* thread_res;
 
-	if(!at_queue)
+	/* suspended already */
+	if(!at_queue || at_queue->fd < 0)
 		return;
 
 	at_queue->terminate = 1;
@@ -250,3 +273,13 @@ void at_queue_resume(at_queue_t* at_queue, const char *dev)
 	/* creating write thread */
 	pthread_create(&at_queue->thread_write, NULL, at_queue_thread_write, at_queue);
 }
+
+/*------------------------------------------------------------------------*/
+
+void at_queue_flush(at_queue_t* at_queue)
+{
+	if(!at_queue || at_queue->fd < 0)
+		return;
+
+	tcflush(at_queue->fd, TCIOFLUSH);
+}
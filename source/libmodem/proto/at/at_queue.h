@@ -18,6 +18,9 @@ typedef struct
 
 	int fd;
 
+	/** monotonic time of last data read from modem in ms, modem is alive */
+	uint64_t last_read;
+
 	event_t* event;
 
 	queue_t* queue;
@@ -39,4 +42,13 @@ void at_queue_suspend(at_queue_t* at_queue);
 
 void at_queue_resume(at_queue_t* at_queue, const char *dev);
 
+/**
+ * @brief drop data not read or not sent by tty yet
+ * @param at_queue queue
+ *
+ * Garbage and partial replies of previous commands are not parsed with
+ * reply of the next command.
+ */
+void at_queue_flush(at_queue_t* at_queue);
+
 #endif /* __AT_QUEUE_H */
@@ -157,6 +157,27 @@ void modem_queues_suspend(modem_t* modem)
 
 /*------------------------------------------------------------------------*/
 
+void modem_queues_flush(modem_t* modem)
+{
+	modem_queues_t* mq;
+
+	for(mq = modem->queues; mq; mq = mq->next)
+	{
+		switch(mq->proto)
+		{
+			case MODEM_PROTO_AT:
+				at_queue_flush(mq->queue);
+				break;
+
+			default:
+				/* requests of other protocols are not streamed */
+				break;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
 void modem_queues_resume(modem_t* modem)
 {
 	const modem_info_device_t* mdd = modem->mdd;
@@ -15,6 +15,8 @@ void modem_queues_suspend(modem_t* modem);
 
 void modem_queues_resume(modem_t* modem);
 
+void modem_queues_flush(modem_t* modem);
+
 void* modem_proto_get(modem_t* modem, modem_proto_t proto);
 
 int modem_queues_add(modem_t* modem, modem_proto_t proto, void* queue);
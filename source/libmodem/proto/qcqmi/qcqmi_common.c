@@ -658,6 +658,22 @@ int qcqmi_stop_wwan(modem_t* modem)
 
 /*------------------------------------------------------------------------*/
 
+int qcqmi_ping(modem_t* modem)
+{
+	qcqmi_queue_t* qcqmi_q;
+	ULONG state;
+
+	if(!(qcqmi_q = (qcqmi_queue_t*)modem_proto_get(modem, MODEM_PROTO_QCQMI)))
+		return(-1);
+
+	/* the cheapest request answered by modem itself */
+	qcqmi_q->last_error = GetSessionState(&state);
+
+	return(qcqmi_q->last_error == eQCWWAN_ERR_NONE ? 0 : -1);
+}
+
+/*------------------------------------------------------------------------*/
+
 modem_state_wwan_t qcqmi_state_wwan(modem_t* modem)
 {
 	return(state_wwan);
@@ -834,6 +850,8 @@ modem_fw_ver_t* qcqmi_get_fw_version(modem_t* modem, modem_fw_ver_t* fw_info)
 			re_strncpy(fw_info->firmware, sizeof(fw_info->firmware), qcqmi_fw.dev.s.appversion_str, pmatch + 1);
 			re_strncpy(release, sizeof(release), qcqmi_fw.dev.s.appversion_str, pmatch + 2);
 
+			/* fields not in string are zero */
+			memset(&tm, 0, sizeof(tm));
 			strptime(release, "%Y/%m/%d\r\n%H:%M:%S", &tm);
 			fw_info->release = mktime(&tm);
 
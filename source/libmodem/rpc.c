@@ -2,48 +2,166 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "rpc.h"
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* rpc_create(rpc_packet_type_t type, const char* func, const uint8_t* data, uint16_t data_len)
+/** packets kept for reuse */
+#define __POOL_MAX 64
+
+/** minimal size of buffer, fits most of results */
+#define __BUF_MIN 0x400
+
+/** larger buffers are not kept for reuse */
+#define __BUF_POOL_MAX 0x4000
+
+/*------------------------------------------------------------------------*/
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** free packets with their buffers */
+static rpc_packet_t* pool[__POOL_MAX];
+
+static int pool_count = 0;
+
+/*------------------------------------------------------------------------*/
+
+static const char* rpc_func_names[] = {
+#define __RPC_NAME(name) #name,
+	RPC_FUNCTIONS(__RPC_NAME)
+#undef __RPC_NAME
+};
+
+/*------------------------------------------------------------------------*/
+
+const char* rpc_func_name(uint16_t opcode)
+{
+	return(opcode < RPC_OP_COUNT ? rpc_func_names[opcode] : NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+uint16_t rpc_func_opcode(const char* func)
+{
+	uint16_t i;
+
+	for(i = 0; i < RPC_OP_COUNT; ++ i)
+		if(strcmp(rpc_func_names[i], func) == 0)
+			break;
+
+	return(i);
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint8_t rpc_hdr_v2_len(uint8_t version)
+{
+	if(version < RPC_PROTO_VERSION_3)
+		return(RPC_HDR_V2_HAS(data_len));
+
+	if(version < RPC_PROTO_VERSION_4)
+		return(RPC_HDR_V2_HAS(id));
+
+	if(version < RPC_PROTO_VERSION_5)
+		return(RPC_HDR_V2_HAS(modem));
+
+	return(sizeof(rpc_hdr_v2_t));
+}
+
+/*------------------------------------------------------------------------*/
+
+/** take packet from pool or allocate it */
+static rpc_packet_t* rpc_alloc(void)
+{
+	rpc_packet_t* res = NULL;
+
+	pthread_mutex_lock(&pool_lock);
+
+	if(pool_count)
+		res = pool[-- pool_count];
+
+	pthread_mutex_unlock(&pool_lock);
+
+	if(!res && (res = malloc(sizeof(*res))))
+	{
+		res->buf = NULL;
+		res->buf_size = 0;
+	}
+
+	if(res)
+	{
+		res->func = NULL;
+		res->data = res->buf;
+	}
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** make own buffer of packet large enough, data is kept */
+static int rpc_reserve(rpc_packet_t* p, uint32_t size)
+{
+	uint8_t* buf;
+
+	if(size <= p->buf_size)
+		return(0);
+
+	if(size < __BUF_MIN)
+		size = __BUF_MIN;
+
+	if(!(buf = realloc(p->buf, size)))
+		return(-1);
+
+	p->buf = buf;
+	p->buf_size = size;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* rpc_create(rpc_packet_type_t type, uint16_t opcode, const uint8_t* data, uint32_t data_len)
 {
 	rpc_packet_t* res;
 
-	if(!(res = (rpc_packet_t*)malloc(sizeof(*res))))
+	if(!(res = rpc_alloc()))
 		goto err;
 
 	/* filling header */
 	res->hdr.type = type;
-	res->hdr.func_len = strlen(func);
+	res->hdr.func_len = 0;
 	res->hdr.data_len = data_len;
+	res->hdr.opcode = opcode;
+	res->hdr.id = 0;
+	res->hdr.modem = 0;
+	res->hdr.flags = 0;
+	res->version = RPC_PROTO_VERSION;
 
-	if(!(res->func = malloc(res->hdr.func_len + 1)))
-		goto err_func;
-
-	/* function name */
-	strncpy(res->func, func, res->hdr.func_len + 1);
-	res->func[res->hdr.func_len] = 0;
+	/* function name is resolved by opcode only for version 1 */
 
 	if(data_len) /* data is required field */
 	{
-		if(!(res->data = malloc(data_len)))
+		if(rpc_reserve(res, data_len))
 			goto err_data;
 
-		memcpy(res->data, data, data_len);
+		res->data = res->buf;
+
+		if(data)
+			memcpy(res->data, data, data_len);
 	}
-	else
-		res->data = NULL;
 
 	goto exit;
 
 err_data:
-	free(res->func);
-
-err_func:
-	free(res);
+	rpc_free(res);
 	res = NULL;
 
 err:
@@ -53,67 +171,293 @@ exit:
 
 /*------------------------------------------------------------------------*/
 
-int rpc_send(int sock, rpc_packet_t *p)
+rpc_packet_t* rpc_create_ref(rpc_packet_type_t type, uint16_t opcode, const void* data, uint32_t data_len)
 {
-	int res, sended;
+	rpc_packet_t* res;
 
-	/* send header */
-	res = sended = send(sock, &p->hdr, sizeof(p->hdr), 0);
+	if(!(res = rpc_create(type, opcode, NULL, 0)))
+		return(NULL);
 
-	if(sended < 0)
-		goto err;
+	/* data is not owned, rpc_free() keeps it */
+	res->data = (uint8_t*)data;
+	res->hdr.data_len = data_len;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_append(rpc_packet_t* p, const void* data, uint32_t data_len)
+{
+	uint32_t len = p->hdr.data_len;
+
+	if(rpc_reserve(p, len + data_len))
+		return(-1);
+
+	/* referenced data are moved to own buffer */
+	if(p->data != p->buf)
+		memmove(p->buf, p->data, len);
+
+	memcpy(p->buf + len, data, data_len);
+
+	p->data = p->buf;
+	p->hdr.data_len += data_len;
 
-	if(p->hdr.func_len)
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** skip sent bytes of parts */
+static void rpc_iov_skip(struct msghdr* msg, uint32_t len)
+{
+	while(msg->msg_iovlen && len >= msg->msg_iov->iov_len)
 	{
-		/* send function name */
-		sended = send(sock, p->func, p->hdr.func_len, 0);
+		len -= msg->msg_iov->iov_len;
 
-		if(sended < 0)
-		{
-			res = sended;
-			goto err;
-		}
+		++ msg->msg_iov;
+		-- msg->msg_iovlen;
+	}
+
+	if(msg->msg_iovlen)
+	{
+		msg->msg_iov->iov_base = (uint8_t*)msg->msg_iov->iov_base + len;
+		msg->msg_iov->iov_len -= len;
+	}
+}
+
+/*------------------------------------------------------------------------*/
 
-		res += sended;
+/** send all parts in one call, large data may be sent by parts */
+static int rpc_send_all(int sock, struct iovec* iov, int iovcnt)
+{
+	struct msghdr msg;
+	int res, sended = 0;
+
+	memset(&msg, 0, sizeof(msg));
+
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+
+	while(msg.msg_iovlen)
+	{
+		if((res = sendmsg(sock, &msg, 0)) <= 0)
+			return(-1);
+
+		sended += res;
+
+		rpc_iov_skip(&msg, res);
 	}
 
+	return(sended);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief frame packet for sending
+ * @param hdr_v1 storage for header of version 1
+ * @param hdr_v2 storage for header of later versions
+ * @param iov parts of frame, at least 3
+ * @return number of parts, -1 if packet can't be framed
+ */
+static int rpc_frame(rpc_packet_t* p, rpc_hdr_v1_t* hdr_v1, rpc_hdr_v2_t* hdr_v2, struct iovec* iov)
+{
+	const char* func;
+	int n = 0;
+
+	/* old framing has 16-bit length and no chunks */
+	if(p->version < RPC_PROTO_VERSION_5 && (p->hdr.data_len > RPC_DATA_MAX_V4 || (p->hdr.flags & RPC_FLAG_MORE)))
+		return(-1);
+
+	if(p->version == RPC_PROTO_VERSION_1)
+	{
+		/* legacy framing, function is identified by name */
+		if(!(func = p->func ? p->func : rpc_func_name(p->hdr.opcode)))
+			return(-1);
+
+		hdr_v1->type = p->hdr.type;
+		hdr_v1->func_len = strlen(func);
+		hdr_v1->data_len = p->hdr.data_len;
+
+		/* header and function name */
+		iov[n].iov_base = hdr_v1;
+		iov[n ++].iov_len = sizeof(*hdr_v1);
+		iov[n].iov_base = (char*)func;
+		iov[n ++].iov_len = hdr_v1->func_len;
+	}
+	else
+	{
+		hdr_v2->type = p->hdr.type | RPC_TYPE_V2;
+		hdr_v2->hdr_len = rpc_hdr_v2_len(p->version);
+		hdr_v2->opcode = p->hdr.opcode;
+		hdr_v2->data_len = p->hdr.data_len > RPC_DATA_MAX_V4 ? RPC_DATA_MAX_V4 : p->hdr.data_len;
+		hdr_v2->id = p->hdr.id;
+		hdr_v2->modem = p->hdr.modem;
+		hdr_v2->length = p->hdr.data_len;
+		hdr_v2->flags = p->hdr.flags;
+
+		iov[n].iov_base = hdr_v2;
+		iov[n ++].iov_len = hdr_v2->hdr_len;
+	}
+
+	/* data is sent from its buffer together with header */
 	if(p->hdr.data_len)
 	{
-		/* send data */
-		sended = send(sock, p->data, p->hdr.data_len, 0);
+		iov[n].iov_base = p->data;
+		iov[n ++].iov_len = p->hdr.data_len;
+	}
 
-		if(sended < 0);
-		{
-			res = sended;
-			goto err;
-		}
+	return(n);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_send(int sock, rpc_packet_t *p)
+{
+	rpc_hdr_v1_t hdr_v1;
+	rpc_hdr_v2_t hdr_v2;
+	struct iovec iov[3];
+	int n;
+
+	if((n = rpc_frame(p, &hdr_v1, &hdr_v2, iov)) < 0)
+		return(-1);
+
+	return(rpc_send_all(sock, iov, n));
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_send_nb(int sock, rpc_packet_t* p, uint32_t* sent)
+{
+	rpc_hdr_v1_t hdr_v1;
+	rpc_hdr_v2_t hdr_v2;
+	struct iovec iov[3];
+	struct msghdr msg;
+	int n, res;
+
+	if((n = rpc_frame(p, &hdr_v1, &hdr_v2, iov)) < 0)
+		return(-1);
+
+	memset(&msg, 0, sizeof(msg));
 
-		res += sended;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n;
+
+	/* continue after part sent before */
+	rpc_iov_skip(&msg, *sent);
+
+	while(msg.msg_iovlen)
+	{
+		if((res = sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL)) < 0)
+			return(errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1);
+
+		*sent += res;
+
+		rpc_iov_skip(&msg, res);
 	}
 
-err:
-	return(res);
+	return(1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** fill header of packet from header of version 2, len is its known length */
+static void rpc_hdr_v2_unpack(rpc_packet_t* res, const rpc_hdr_v2_t* hdr, int len)
+{
+	res->version = RPC_PROTO_VERSION_2;
+	res->hdr.id = 0;
+	res->hdr.modem = 0;
+	res->hdr.flags = 0;
+	res->hdr.data_len = hdr->data_len;
+
+	/* optional fields of header */
+	if(len >= RPC_HDR_V2_HAS(id))
+	{
+		res->version = RPC_PROTO_VERSION_3;
+		res->hdr.id = hdr->id;
+	}
+
+	if(len >= RPC_HDR_V2_HAS(modem))
+	{
+		res->version = RPC_PROTO_VERSION_4;
+		res->hdr.modem = hdr->modem;
+	}
+
+	if(len >= RPC_HDR_V2_HAS(flags))
+	{
+		res->version = RPC_PROTO_VERSION_5;
+		res->hdr.data_len = hdr->length;
+		res->hdr.flags = hdr->flags;
+	}
+
+	res->hdr.type = hdr->type & ~RPC_TYPE_V2;
+	res->hdr.func_len = 0;
+	res->hdr.opcode = hdr->opcode;
 }
 
 /*------------------------------------------------------------------------*/
 
 rpc_packet_t* rpc_recv(int sock)
 {
+	union
+	{
+		rpc_hdr_v1_t v1;
+
+		rpc_hdr_v2_t v2;
+	} hdr;
+	uint8_t skip[0x100];
 	rpc_packet_t* res;
-	int recved;
+	int recved, len;
 
-	if(!(res = malloc(sizeof(*res))))
+	if(!(res = rpc_alloc()))
 		goto err_malloc;
 
-	/* initialize pointers */
-	res->func = NULL;
-	res->data = NULL;
+	/* receive header, both versions starts with the same 4 bytes */
+	recved = recv(sock, &hdr, sizeof(hdr.v1), MSG_WAITALL);
+
+	if(recved != sizeof(hdr.v1))
+		goto err_recv;
+
+	if(hdr.v1.type & RPC_TYPE_V2)
+	{
+		if(hdr.v2.hdr_len < RPC_HDR_V2_HAS(data_len))
+			goto err_recv;
+
+		/* length of known part of header */
+		len = hdr.v2.hdr_len < sizeof(hdr.v2) ? hdr.v2.hdr_len : sizeof(hdr.v2);
+
+		/* receive rest of header */
+		recved = recv(sock, (uint8_t*)&hdr + sizeof(hdr.v1), len - sizeof(hdr.v1), MSG_WAITALL);
 
-	/* receive header */
-	recved = recv(sock, &res->hdr, sizeof(res->hdr), MSG_WAITALL);
+		if(recved != len - sizeof(hdr.v1))
+			goto err_recv;
+
+		/* skip fields of header from newer protocol */
+		if(hdr.v2.hdr_len > len)
+		{
+			recved = recv(sock, skip, hdr.v2.hdr_len - len, MSG_WAITALL);
+
+			if(recved != hdr.v2.hdr_len - len)
+				goto err_recv;
+		}
+
+		rpc_hdr_v2_unpack(res, &hdr.v2, len);
+	}
+	else
+	{
+		res->version = RPC_PROTO_VERSION_1;
+		res->hdr.type = hdr.v1.type;
+		res->hdr.func_len = hdr.v1.func_len;
+		res->hdr.data_len = hdr.v1.data_len;
+		res->hdr.opcode = RPC_OP_COUNT;
+		res->hdr.id = 0;
+		res->hdr.modem = 0;
+		res->hdr.flags = 0;
+	}
 
-	if(recved != sizeof(res->hdr))
-		goto err_hdr;
+	if(res->hdr.data_len > RPC_DATA_MAX)
+		goto err_recv;
 
 	if(res->hdr.func_len)
 	{
@@ -122,32 +466,151 @@ rpc_packet_t* rpc_recv(int sock)
 		recved = recv(sock, res->func, res->hdr.func_len, MSG_WAITALL);
 
 		if(recved != res->hdr.func_len)
-			goto err_func;
+			goto err_recv;
 
 		/* NULL terminated string */
 		res->func[res->hdr.func_len] = 0;
+
+		res->hdr.opcode = rpc_func_opcode(res->func);
 	}
 
 	if(res->hdr.data_len)
 	{
-		/* receving data */
-		res->data = malloc(res->hdr.data_len);
+		/* receving data to own buffer of packet */
+		if(rpc_reserve(res, res->hdr.data_len))
+			goto err_recv;
+
+		res->data = res->buf;
+
 		recved = recv(sock, res->data, res->hdr.data_len, MSG_WAITALL);
 
 		if(recved != res->hdr.data_len)
-			goto err_data;
+			goto err_recv;
 	}
 
 	goto exit;
 
-err_data:
-	free(res->data);
+err_recv:
+	rpc_free(res);
+	res = NULL;
 
-err_func:
-	free(res->func);
+err_malloc:
+exit:
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* rpc_recv_seq(int sock)
+{
+	union
+	{
+		rpc_hdr_v1_t v1;
+
+		rpc_hdr_v2_t v2;
+	} hdr;
+	uint8_t skip[0x100];
+	struct iovec iov[3];
+	struct msghdr msg;
+	rpc_packet_t* res;
+	int len, hdr_len, n = 0;
+
+	if(!(res = rpc_alloc()))
+		goto err_malloc;
 
-err_hdr:
-	free(res);
+	/* header and length of the whole message, message stays in socket */
+	if((len = recv(sock, &hdr, sizeof(hdr), MSG_PEEK | MSG_TRUNC)) < 0)
+		goto err_recv;
+
+	if(!len)
+	{
+		/* end of connection is not reported by errno of recv() */
+		errno = ECONNRESET;
+
+		goto err_recv;
+	}
+
+	if(len < (int)sizeof(hdr.v1))
+		goto err_drop;
+
+	if(hdr.v1.type & RPC_TYPE_V2)
+	{
+		if(hdr.v2.hdr_len < RPC_HDR_V2_HAS(data_len) || len < hdr.v2.hdr_len)
+			goto err_drop;
+
+		/* fields of header from newer protocol are skipped */
+		hdr_len = hdr.v2.hdr_len;
+
+		rpc_hdr_v2_unpack(res, &hdr.v2, hdr_len < sizeof(hdr.v2) ? hdr_len : sizeof(hdr.v2));
+	}
+	else
+	{
+		hdr_len = sizeof(hdr.v1);
+
+		res->version = RPC_PROTO_VERSION_1;
+		res->hdr.type = hdr.v1.type;
+		res->hdr.func_len = hdr.v1.func_len;
+		res->hdr.data_len = hdr.v1.data_len;
+		res->hdr.opcode = RPC_OP_COUNT;
+		res->hdr.id = 0;
+		res->hdr.modem = 0;
+		res->hdr.flags = 0;
+	}
+
+	/* header is received again with the message */
+	iov[n].iov_base = skip;
+	iov[n ++].iov_len = hdr_len;
+
+	if(res->hdr.func_len)
+	{
+		if(!(res->func = malloc(res->hdr.func_len + 1)))
+			goto err_drop;
+
+		iov[n].iov_base = res->func;
+		iov[n ++].iov_len = res->hdr.func_len;
+	}
+
+	/* length of data must match the message */
+	if(res->hdr.data_len > RPC_DATA_MAX || len != hdr_len + res->hdr.func_len + res->hdr.data_len)
+		goto err_drop;
+
+	if(res->hdr.data_len)
+	{
+		if(rpc_reserve(res, res->hdr.data_len))
+			goto err_drop;
+
+		res->data = res->buf;
+
+		iov[n].iov_base = res->data;
+		iov[n ++].iov_len = res->hdr.data_len;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+
+	msg.msg_iov = iov;
+	msg.msg_iovlen = n;
+
+	if(recvmsg(sock, &msg, 0) != len)
+		goto err_recv;
+
+	if(res->func)
+	{
+		/* NULL terminated string */
+		res->func[res->hdr.func_len] = 0;
+
+		res->hdr.opcode = rpc_func_opcode(res->func);
+	}
+
+	goto exit;
+
+err_drop:
+	/* invalid message is removed from socket */
+	recv(sock, skip, 0, 0);
+
+	errno = EBADMSG;
+
+err_recv:
+	rpc_free(res);
 	res = NULL;
 
 err_malloc:
@@ -157,15 +620,149 @@ exit:
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* rpc_recv_func(int sock, const char* func, int tries)
+int rpc_connect(const char* socket_path, int* seqpacket)
+{
+	static const int types[] = {SOCK_SEQPACKET, SOCK_STREAM};
+	struct sockaddr_un sa_srv;
+	int i, sock = -1;
+
+	memset(&sa_srv, 0, sizeof(sa_srv));
+	sa_srv.sun_family = AF_LOCAL;
+	strncpy(sa_srv.sun_path, socket_path, sizeof(sa_srv.sun_path) - 1);
+
+	for(i = 0; i < sizeof(types) / sizeof(*types); ++ i)
+	{
+		if((sock = socket(AF_LOCAL, types[i], 0)) < 0)
+			return(-1);
+
+		if(!connect(sock, (struct sockaddr*)&sa_srv, sizeof(sa_srv)))
+		{
+			*seqpacket = types[i] == SOCK_SEQPACKET;
+
+			return(sock);
+		}
+
+		close(sock);
+
+		/* other type of socket is tried only for server of other type */
+		if(errno != EPROTOTYPE)
+			return(-1);
+	}
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief parse packet with framing of version 1
+ * @param buf received bytes, at least header of version 1
+ * @param len number of bytes
+ * @param p parsed packet, only length is checked if NULL
+ * @return length of parsed packet, 0 if packet is incomplete, -1 if failed
+ */
+static int rpc_parse_v1(const uint8_t* buf, uint32_t len, rpc_packet_t** p)
+{
+	rpc_hdr_v1_t hdr;
+	rpc_packet_t* res;
+	uint32_t n;
+
+	memcpy(&hdr, buf, sizeof(hdr));
+
+	n = sizeof(hdr) + hdr.func_len + hdr.data_len;
+
+	if(len < n)
+		return(0);
+
+	if(!p)
+		return(n);
+
+	if(!(res = rpc_create(hdr.type, RPC_OP_COUNT, buf + sizeof(hdr) + hdr.func_len, hdr.data_len)))
+		return(-1);
+
+	res->version = RPC_PROTO_VERSION_1;
+	res->hdr.func_len = hdr.func_len;
+
+	if(hdr.func_len)
+	{
+		if(!(res->func = malloc(hdr.func_len + 1)))
+		{
+			rpc_free(res);
+			return(-1);
+		}
+
+		/* NULL terminated string */
+		memcpy(res->func, buf + sizeof(hdr), hdr.func_len);
+		res->func[hdr.func_len] = 0;
+
+		res->hdr.opcode = rpc_func_opcode(res->func);
+	}
+
+	*p = res;
+
+	return(n);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_parse(const uint8_t* buf, uint32_t len, rpc_packet_t** p)
+{
+	rpc_packet_t tmp, *res;
+	rpc_hdr_v2_t hdr;
+	int hdr_len;
+
+	/* need the common part of header */
+	if(len < sizeof(rpc_hdr_v1_t))
+		return(0);
+
+	if(!(buf[0] & RPC_TYPE_V2))
+		return(rpc_parse_v1(buf, len, p));
+
+	if(buf[1] < RPC_HDR_V2_HAS(data_len))
+		return(-1);
+
+	if(len < buf[1])
+		return(0);
+
+	/* unknown tail of header from newer protocol is skipped */
+	hdr_len = buf[1] < sizeof(hdr) ? buf[1] : sizeof(hdr);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(&hdr, buf, hdr_len);
+
+	rpc_hdr_v2_unpack(&tmp, &hdr, hdr_len);
+
+	if(tmp.hdr.data_len > RPC_DATA_MAX)
+		return(-1);
+
+	if(len - buf[1] < tmp.hdr.data_len)
+		return(0);
+
+	if(!p)
+		return(buf[1] + tmp.hdr.data_len);
+
+	if(!(res = rpc_create(tmp.hdr.type, tmp.hdr.opcode, buf + buf[1], tmp.hdr.data_len)))
+		return(-1);
+
+	res->hdr = tmp.hdr;
+	res->version = tmp.version;
+
+	*p = res;
+
+	return(buf[1] + tmp.hdr.data_len);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* rpc_recv_func(int sock, int seqpacket, uint16_t opcode, int tries)
 {
 	rpc_packet_t* res = NULL;
 
 	while(tries)
 	{
-		res = rpc_recv(sock);
+		res = seqpacket ? rpc_recv_seq(sock) : rpc_recv(sock);
 
-		if(res && strcmp(res->func, func) == 0)
+		if(res && res->hdr.opcode == opcode)
 			break;
 
 		rpc_free(res);
@@ -189,8 +786,32 @@ void rpc_free(rpc_packet_t *p)
 		return;
 
 	free(p->func);
-	free(p->data);
-	free(p);
+	p->func = NULL;
+
+	/* large buffer is not kept */
+	if(p->buf_size > __BUF_POOL_MAX)
+	{
+		free(p->buf);
+
+		p->buf = NULL;
+		p->buf_size = 0;
+	}
+
+	pthread_mutex_lock(&pool_lock);
+
+	if(pool_count < __POOL_MAX)
+	{
+		pool[pool_count ++] = p;
+		p = NULL;
+	}
+
+	pthread_mutex_unlock(&pool_lock);
+
+	if(p)
+	{
+		free(p->buf);
+		free(p);
+	}
 }
 
 /*------------------------------------------------------------------------*/
@@ -203,7 +824,9 @@ void rpc_print(rpc_packet_t *p)
 	if(!p)
 		return;
 
-	printf("==== %s %s(%d) data(%d) = [", p->hdr.type ? "Response" : "Query" , p->func, p->hdr.func_len, p->hdr.data_len);
+	printf("==== v%d #%u %s %s(%d) data(%d) = [", p->version, p->hdr.id,
+		p->hdr.type == TYPE_EVENT ? "Event" : p->hdr.type ? "Response" : "Query",
+		p->func ? p->func : rpc_func_name(p->hdr.opcode), p->hdr.opcode, p->hdr.data_len);
 
 	for(i = 0; i < p->hdr.data_len; ++ i)
 		printf(" %02x", p->data[i]);
@@ -2,6 +2,9 @@
 #define __MODEMD_RPC_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "rpc_func.h"
 
 /***************************************************************************
 
@@ -17,11 +20,103 @@ function -+					|		   |					 +- function
 
 /*------------------------------------------------------------------------*/
 
+/** protocol with function names in packets */
+#define RPC_PROTO_VERSION_1 1
+
+/** protocol with numeric opcodes from rpc_func.h */
+#define RPC_PROTO_VERSION_2 2
+
+/** protocol with request id, responses may come out of order */
+#define RPC_PROTO_VERSION_3 3
+
+/** protocol with modem handle, one connection serves many modems */
+#define RPC_PROTO_VERSION_4 4
+
+/** protocol with 32-bit data length and chunked responses */
+#define RPC_PROTO_VERSION_5 5
+
+/** protocol with compact serialization of data, see rpc_pack.h */
+#define RPC_PROTO_VERSION_6 6
+
+/** protocol with modem returned by open while it is opened by daemon */
+#define RPC_PROTO_VERSION_7 7
+
+/** latest supported version of protocol */
+#define RPC_PROTO_VERSION RPC_PROTO_VERSION_7
+
+/*------------------------------------------------------------------------*/
+
 typedef enum {
 	TYPE_QUERY = 0,
-	TYPE_RESPONSE
+	TYPE_RESPONSE,
+
+	/** notification pushed by server without query, since version 4 */
+	TYPE_EVENT
 } __attribute__((__packed__)) rpc_packet_type_t;
 
+/** flag in type field of header, packet has a framing of version 2 */
+#define RPC_TYPE_V2 0x80
+
+/** response is a chunk, more chunks with the same id follow */
+#define RPC_FLAG_MORE 0x01
+
+/** data is in compact format, response is in the same format, since version 6 */
+#define RPC_FLAG_COMPACT 0x02
+
+/** maximal length of data accepted from the wire */
+#define RPC_DATA_MAX (16 * 1024 * 1024)
+
+/** maximal length of data in packets of version below 5 */
+#define RPC_DATA_MAX_V4 0xffff
+
+/*------------------------------------------------------------------------*/
+
+/** header of packet for protocol version 1 */
+typedef struct
+{
+	/** type of packet */
+	uint8_t type;
+
+	/** length of function name */
+	uint8_t func_len;
+
+	/** length of data field */
+	uint16_t data_len;
+} __attribute__((__packed__)) rpc_hdr_v1_t;
+
+/*------------------------------------------------------------------------*/
+
+/** header of packet for protocol version 2 */
+typedef struct
+{
+	/** type of packet with flag RPC_TYPE_V2 */
+	uint8_t type;
+
+	/** length of header, unknown tail of header is skipped */
+	uint8_t hdr_len;
+
+	/** function opcode */
+	uint16_t opcode;
+
+	/** length of data field */
+	uint16_t data_len;
+
+	/** request id, since version 3 */
+	uint32_t id;
+
+	/** modem handle, since version 4 */
+	uint16_t modem;
+
+	/** length of data field replacing data_len, since version 5 */
+	uint32_t length;
+
+	/** RPC_FLAG_*, since version 5 */
+	uint8_t flags;
+} __attribute__((__packed__)) rpc_hdr_v2_t;
+
+/** minimal length of header for version 2 containing field */
+#define RPC_HDR_V2_HAS(field) (offsetof(rpc_hdr_v2_t, field) + sizeof(((rpc_hdr_v2_t*)0)->field))
+
 /*------------------------------------------------------------------------*/
 
 typedef struct
@@ -35,35 +130,77 @@ typedef struct
 		uint8_t func_len;
 
 		/** length of data field */
-		uint16_t data_len;
+		uint32_t data_len;
+
+		/** function opcode, RPC_OP_COUNT if function is unknown */
+		uint16_t opcode;
+
+		/** request id, response has the same id as a query */
+		uint32_t id;
+
+		/** modem handle, 0 is a modem opened by connection without handle */
+		uint16_t modem;
+
+		/** RPC_FLAG_* */
+		uint8_t flags;
 	} hdr;
 
-	/** function name */
+	/** version of protocol for framing of packet on the wire */
+	uint8_t version;
+
+	/** function name, only for packets of version 1 */
 	char* func;
 
-	/** data */
+	/** data, points to buf or to buffer of caller */
 	uint8_t* data;
-} __attribute__((__packed__)) rpc_packet_t;
 
-/*------------------------------------------------------------------------*/
+	/** buffer owned by packet, kept with packet for reuse */
+	uint8_t* buf;
+
+	/** capacity of buf */
+	uint32_t buf_size;
+} __attribute__((__packed__)) rpc_packet_t;
 
 /**
  * @brief create and return pointer for packet
  * @param type type of packet
- * @param func function name
+ * @param opcode function opcode
  * @param data pointer to data buffer
  * @param data_len length of data
  * @return if successeful pointer to packet
  *
- * Result must be free by function free()
+ * Packet is created with framing of RPC_PROTO_VERSION. If data is NULL,
+ * buffer of data_len bytes is reserved for the caller to fill.
+ * Result must be free by function rpc_free()
  */
-rpc_packet_t* rpc_create(rpc_packet_type_t type, const char* func, const uint8_t* data, uint16_t data_len);
+rpc_packet_t* rpc_create(rpc_packet_type_t type, uint16_t opcode, const uint8_t* data, uint32_t data_len);
 
 /**
- * @brief receive packet over socket
+ * @brief create packet referencing buffer of caller without copying
+ * @param type type of packet
+ * @param opcode function opcode
+ * @param data pointer to data buffer, must be valid until rpc_free()
+ * @param data_len length of data
+ * @return if successeful pointer to packet
+ *
+ * Result must be free by function rpc_free(), buffer is not freed
+ */
+rpc_packet_t* rpc_create_ref(rpc_packet_type_t type, uint16_t opcode, const void* data, uint32_t data_len);
+
+/**
+ * @brief append data to packet
+ * @param p packet, referenced data are copied to own buffer
+ * @param data pointer to data buffer
+ * @param data_len length of data
+ * @return zero if successful
+ */
+int rpc_append(rpc_packet_t* p, const void* data, uint32_t data_len);
+
+/**
+ * @brief send packet over socket
  * @param sock socket
- * @param p socket
- * @return Sended bytes of packet
+ * @param p packet, framing is selected by p->version
+ * @return Sended bytes of packet, -1 if data is too long for framing
  */
 int rpc_send(int sock, rpc_packet_t *p);
 
@@ -76,23 +213,83 @@ int rpc_send(int sock, rpc_packet_t *p);
  */
 rpc_packet_t* rpc_recv(int sock);
 
+/**
+ * @brief receive packet over SOCK_SEQPACKET socket
+ * @param sock socket
+ * @return packet, NULL with errno EBADMSG if invalid message is dropped
+ *
+ * Packet is one message read at once, invalid message is dropped whole and
+ * can't break framing of next ones, connection stays usable. Packet must be
+ * free by function rpc_free()
+ */
+rpc_packet_t* rpc_recv_seq(int sock);
+
+/**
+ * @brief connect to local socket of server
+ * @param socket_path path to the local socket
+ * @param seqpacket set to non zero for SOCK_SEQPACKET connection
+ * @return socket, -1 if failed
+ *
+ * SOCK_SEQPACKET is tried first, server listening on SOCK_STREAM socket is
+ * connected by stream.
+ */
+int rpc_connect(const char* socket_path, int* seqpacket);
+
+/**
+ * @brief send packet over non-blocking socket without waiting
+ * @param sock socket
+ * @param p packet, framing is selected by p->version
+ * @param sent bytes of packet sent before, updated
+ * @return 1 if the whole packet is sent, 0 if socket is full, -1 if failed
+ */
+int rpc_send_nb(int sock, rpc_packet_t* p, uint32_t* sent);
+
+/**
+ * @brief parse packet from received bytes
+ * @param buf received bytes
+ * @param len number of bytes
+ * @param p parsed packet, must be free by function rpc_free(), only length is checked if NULL
+ * @return length of parsed packet, 0 if packet is incomplete, -1 if invalid
+ */
+int rpc_parse(const uint8_t* buf, uint32_t len, rpc_packet_t** p);
+
 /**
  * @brief receive packet over socket
  * @param sock socket
- * @param func receive only this function
+ * @param seqpacket socket is SOCK_SEQPACKET
+ * @param opcode receive only this function
  * @param tries give up after tries, must be great 0
  * @return pointer to packet, or NULL if failed
  *
  * Packet must be free by function rpc_free()
  */
-rpc_packet_t* rpc_recv_func(int sock, const char* func, int tries);
+rpc_packet_t* rpc_recv_func(int sock, int seqpacket, uint16_t opcode, int tries);
 
 /**
  * @brief free memory used by packet
  * @param p packet
+ *
+ * Packets with small buffers are kept for reuse by next rpc_create() and
+ * rpc_recv(), so exchange of packets does not allocate memory.
  */
 void rpc_free(rpc_packet_t *p);
 
+/**
+ * @brief return function name by opcode
+ * @param opcode function opcode
+ * @return function name or NULL if opcode is unknown
+ */
+const char* rpc_func_name(uint16_t opcode);
+
+/**
+ * @brief return opcode by function name
+ * @param func function name
+ * @return opcode, RPC_OP_COUNT if function is unknown
+ *
+ * Used only for packets of version 1
+ */
+uint16_t rpc_func_opcode(const char* func);
+
 /**
  * @brief printing packet to stdout
  * @param p packet
@@ -0,0 +1,574 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "rpc_client.h"
+
+/*------------------------------------------------------------------------*/
+
+#define __DEFAULT_TRIES 3
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t rpc_client_next_id(rpc_client_t* client)
+{
+	/* zero id is reserved for packets without request */
+	if(!++ client->last_id)
+		++ client->last_id;
+
+	return(client->last_id);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int rpc_client_send(rpc_client_t* client, uint32_t id, uint16_t modem, rpc_packet_t* p)
+{
+	int res;
+
+	p->version = client->version;
+	p->hdr.id = id;
+	p->hdr.modem = modem;
+
+	/* and send it */
+	pthread_mutex_lock(&client->send_lock);
+	res = rpc_send(client->sock, p) < 0 ? -1 : 0;
+	pthread_mutex_unlock(&client->send_lock);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void rpc_client_queue(rpc_item_t** first, rpc_item_t** last, rpc_item_t* item)
+{
+	item->next = NULL;
+
+	if(*last)
+		(*last)->next = item;
+	else
+		*first = item;
+
+	*last = item;
+}
+
+/*------------------------------------------------------------------------*/
+
+static rpc_packet_t* rpc_client_join(rpc_packet_t* p, rpc_packet_t* chunk)
+{
+	if(!p)
+		return(chunk);
+
+	/* append data of chunk to response */
+	if(p->hdr.data_len + chunk->hdr.data_len > RPC_DATA_MAX ||
+		rpc_append(p, chunk->data, chunk->hdr.data_len))
+	{
+		rpc_free(p);
+		rpc_free(chunk);
+
+		return(NULL);
+	}
+
+	p->hdr.flags = chunk->hdr.flags;
+
+	rpc_free(chunk);
+
+	return(p);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void rpc_client_route(rpc_client_t* client, rpc_packet_t* p)
+{
+	rpc_call_t* call;
+	rpc_item_t* item;
+	int last;
+
+	if(!p)
+	{
+		/* connection is broken, wake up all callers */
+		client->broken = 1;
+
+		for(call = client->calls; call; call = call->next)
+			call->done = 1;
+
+		return;
+	}
+
+	last = !(p->hdr.flags & RPC_FLAG_MORE);
+
+	for(call = client->calls; call; call = call->next)
+	{
+		if(call->id != p->hdr.id || call->done)
+			continue;
+
+		if(!call->stream)
+		{
+			/* chunks are joined into one response */
+			if(!(call->p = rpc_client_join(call->p, p)))
+			{
+				call->done = 1;
+
+				return;
+			}
+		}
+		else if((item = malloc(sizeof(*item))))
+		{
+			item->p = p;
+
+			rpc_client_queue(&call->chunks, &call->chunks_last, item);
+		}
+		else
+		{
+			/* chunk is lost, response is incomplete */
+			rpc_free(p);
+
+			last = 0;
+			call->done = 1;
+		}
+
+		if(last)
+			call->done = call->complete = 1;
+
+		return;
+	}
+
+	/* response for nobody, caller is gone */
+	rpc_free(p);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void rpc_client_event(rpc_client_t* client, rpc_packet_t* p)
+{
+	rpc_item_t* ev;
+
+	/* nobody is listening */
+	if(!client->listening || !(ev = malloc(sizeof(*ev))))
+	{
+		rpc_free(p);
+
+		return;
+	}
+
+	ev->p = p;
+
+	rpc_client_queue(&client->events, &client->events_last, ev);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** receive one packet for all, lock must be held */
+static void rpc_client_read(rpc_client_t* client)
+{
+	rpc_packet_t* p;
+	int dropped;
+
+	client->reading = 1;
+
+	pthread_mutex_unlock(&client->lock);
+
+	p = client->seqpacket ? rpc_recv_seq(client->sock) : rpc_recv(client->sock);
+
+	/* invalid message is skipped, only disconnect breaks all calls */
+	dropped = !p && client->seqpacket && errno == EBADMSG;
+
+	pthread_mutex_lock(&client->lock);
+
+	client->reading = 0;
+
+	if(p && p->hdr.type == TYPE_EVENT)
+		rpc_client_event(client, p);
+	else if(p || !dropped)
+		rpc_client_route(client, p);
+
+	/* wake up owner of response, dispatcher of events and next reader */
+	pthread_cond_broadcast(&client->cond);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** wait for the end of call or next chunk, lock must be held */
+static void rpc_client_wait(rpc_client_t* client, rpc_call_t* call)
+{
+	while(!call->done && !call->chunks)
+	{
+		if(client->reading)
+		{
+			/* other thread is receiving, wait for it */
+			pthread_cond_wait(&client->cond, &client->lock);
+
+			continue;
+		}
+
+		/* become a reader for all waiting calls */
+		rpc_client_read(client);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief register call and send query
+ * @return zero if successful, lock is held on return
+ */
+static int rpc_client_start(rpc_client_t* client, rpc_call_t* call, int stream, uint16_t modem, rpc_packet_t* q)
+{
+	memset(call, 0, sizeof(*call));
+	call->stream = stream;
+
+	pthread_mutex_lock(&client->lock);
+
+	if(client->broken)
+		return(-1);
+
+	/* call is registered before sending, so reader can't miss response */
+	call->id = rpc_client_next_id(client);
+	call->next = client->calls;
+	client->calls = call;
+
+	pthread_mutex_unlock(&client->lock);
+
+	if(rpc_client_send(client, call->id, modem, q))
+	{
+		pthread_mutex_lock(&client->lock);
+		call->done = 1;
+	}
+	else
+		pthread_mutex_lock(&client->lock);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** unregister finished call, lock must be held */
+static void rpc_client_finish(rpc_client_t* client, rpc_call_t* call)
+{
+	rpc_call_t** prev;
+	rpc_item_t* item;
+
+	for(prev = &client->calls; *prev; prev = &(*prev)->next)
+	{
+		if(*prev == call)
+		{
+			*prev = call->next;
+			break;
+		}
+	}
+
+	/* chunks not consumed */
+	while((item = call->chunks))
+	{
+		call->chunks = item->next;
+
+		rpc_free(item->p);
+		free(item);
+	}
+
+	/* response without the last chunk is broken */
+	if(!call->complete)
+	{
+		rpc_free(call->p);
+		call->p = NULL;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** send query and wait for response, query is freed */
+static rpc_packet_t* rpc_client_call_packet(rpc_client_t* client, uint16_t modem, rpc_packet_t* q)
+{
+	rpc_packet_t* res = NULL;
+	rpc_call_t call;
+
+	if(client->version < RPC_PROTO_VERSION_3)
+	{
+		/* old server replies in order of queries without request id */
+		pthread_mutex_lock(&client->call_lock);
+
+		if(!rpc_client_send(client, 0, modem, q))
+			res = rpc_recv_func(client->sock, client->seqpacket, q->hdr.opcode, __DEFAULT_TRIES);
+
+		pthread_mutex_unlock(&client->call_lock);
+
+		rpc_free(q);
+
+		return(res);
+	}
+
+	if(!rpc_client_start(client, &call, 0, modem, q))
+	{
+		rpc_client_wait(client, &call);
+		rpc_client_finish(client, &call);
+	}
+
+	pthread_mutex_unlock(&client->lock);
+
+	rpc_free(q);
+
+	return(call.p);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* rpc_client_call(rpc_client_t* client, uint16_t modem, uint16_t opcode, const void* data, uint32_t data_len)
+{
+	rpc_packet_t* q;
+
+	/* data of caller is valid during the call, so it is not copied */
+	if(!(q = rpc_create_ref(TYPE_QUERY, opcode, data, data_len)))
+		return(NULL);
+
+	return(rpc_client_call_packet(client, modem, q));
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_client_call_obj(rpc_client_t* client, uint16_t modem, uint16_t opcode,
+	const rpc_type_t* arg_type, const void* arg, const rpc_type_t* res_type, void* res)
+{
+	rpc_packet_t *q, *p;
+	int ret;
+
+	/* older servers get raw structures */
+	if(!(q = rpc_create_obj(TYPE_QUERY, opcode, arg_type, arg, client->version >= RPC_PROTO_VERSION_6)))
+		return(-1);
+
+	if(!(p = rpc_client_call_packet(client, modem, q)))
+		return(-1);
+
+	ret = rpc_get_obj(p, res_type, res);
+
+	rpc_free(p);
+
+	return(ret);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_client_call_stream(rpc_client_t* client, uint16_t modem, uint16_t opcode, const void* data, uint32_t data_len,
+	rpc_chunk_func_t func, void* prm)
+{
+	rpc_packet_t *p, *q;
+	rpc_item_t* item;
+	rpc_call_t call;
+	int res = -1;
+
+	if(client->version < RPC_PROTO_VERSION_5)
+	{
+		/* the whole response is the only chunk */
+		if(!(p = rpc_client_call(client, modem, opcode, data, data_len)))
+			return(-1);
+
+		func(p->data, p->hdr.data_len, prm);
+
+		rpc_free(p);
+
+		return(0);
+	}
+
+	if(!(q = rpc_create_ref(TYPE_QUERY, opcode, data, data_len)))
+		return(-1);
+
+	if(rpc_client_start(client, &call, 1, modem, q))
+		goto exit;
+
+	for(;;)
+	{
+		rpc_client_wait(client, &call);
+
+		if(!(item = call.chunks))
+			break;
+
+		if(!(call.chunks = item->next))
+			call.chunks_last = NULL;
+
+		/* chunk is consumed without lock, reader continues meanwhile */
+		pthread_mutex_unlock(&client->lock);
+
+		func(item->p->data, item->p->hdr.data_len, prm);
+
+		rpc_free(item->p);
+		free(item);
+
+		pthread_mutex_lock(&client->lock);
+	}
+
+	res = call.complete ? 0 : -1;
+
+	rpc_client_finish(client, &call);
+
+exit:
+	pthread_mutex_unlock(&client->lock);
+
+	rpc_free(q);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void* rpc_client_events_thread(void* prm)
+{
+	rpc_client_t* client = prm;
+	rpc_item_t* ev;
+
+	pthread_mutex_lock(&client->lock);
+
+	while(!client->terminate)
+	{
+		if((ev = client->events))
+		{
+			if(!(client->events = ev->next))
+				client->events_last = NULL;
+
+			/* handler may call server, so lock is released */
+			pthread_mutex_unlock(&client->lock);
+
+			client->event_func(ev->p, client->event_prm);
+
+			rpc_free(ev->p);
+			free(ev);
+
+			pthread_mutex_lock(&client->lock);
+
+			continue;
+		}
+
+		if(client->broken)
+			break;
+
+		/* notifications arrive without calls, so somebody must read */
+		if(!client->reading)
+		{
+			rpc_client_read(client);
+
+			continue;
+		}
+
+		pthread_cond_wait(&client->cond, &client->lock);
+	}
+
+	pthread_mutex_unlock(&client->lock);
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_client_listen(rpc_client_t* client, rpc_event_func_t func, void* prm)
+{
+	int res = 0;
+
+	/* notifications are routed by modem handle */
+	if(client->version < RPC_PROTO_VERSION_4)
+		return(-1);
+
+	pthread_mutex_lock(&client->lock);
+
+	if(!client->listening)
+	{
+		client->event_func = func;
+		client->event_prm = prm;
+
+		if(pthread_create(&client->events_thread, NULL, rpc_client_events_thread, client))
+			res = -1;
+		else
+			client->listening = 1;
+	}
+
+	pthread_mutex_unlock(&client->lock);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_client_t* rpc_client_open(const char* socket_path)
+{
+	rpc_client_t* res;
+	rpc_packet_t* p;
+	uint8_t version;
+
+	if(!(res = malloc(sizeof(*res))))
+		goto err;
+
+	memset(res, 0, sizeof(*res));
+
+	/* connecting, packets are messages if server supports it */
+	if((res->sock = rpc_connect(socket_path, &res->seqpacket)) < 0)
+		goto err_socket;
+
+	pthread_mutex_init(&res->lock, NULL);
+	pthread_cond_init(&res->cond, NULL);
+	pthread_mutex_init(&res->send_lock, NULL);
+	pthread_mutex_init(&res->call_lock, NULL);
+
+	/* protocol version negotiation, query is sent with a legacy framing,
+	old servers reply with NULL result for unknown function and we stay
+	on version 1 */
+	res->version = RPC_PROTO_VERSION_1;
+	version = RPC_PROTO_VERSION;
+
+	p = rpc_client_call(res, 0, RPC_OP_rpc_hello, &version, sizeof(version));
+
+	if(p && p->hdr.data_len == sizeof(version) && *p->data > RPC_PROTO_VERSION_1)
+		res->version = *p->data < RPC_PROTO_VERSION ? *p->data : RPC_PROTO_VERSION;
+
+	rpc_free(p);
+
+	goto exit;
+
+err_socket:
+	free(res);
+	res = NULL;
+
+err:
+exit:
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+void rpc_client_close(rpc_client_t* client)
+{
+	rpc_item_t* ev;
+	void* thread_res;
+
+	if(!client)
+		return;
+
+	if(client->listening)
+	{
+		pthread_mutex_lock(&client->lock);
+		client->terminate = 1;
+		pthread_cond_broadcast(&client->cond);
+		pthread_mutex_unlock(&client->lock);
+
+		/* break reading of dispatcher */
+		shutdown(client->sock, SHUT_RDWR);
+
+		pthread_join(client->events_thread, &thread_res);
+	}
+
+	/* notifications not dispatched */
+	while((ev = client->events))
+	{
+		client->events = ev->next;
+
+		rpc_free(ev->p);
+		free(ev);
+	}
+
+	close(client->sock);
+
+	pthread_mutex_destroy(&client->call_lock);
+	pthread_mutex_destroy(&client->send_lock);
+	pthread_cond_destroy(&client->cond);
+	pthread_mutex_destroy(&client->lock);
+
+	free(client);
+}
@@ -0,0 +1,185 @@
+#ifndef __MODEMD_RPC_CLIENT_H
+#define __MODEMD_RPC_CLIENT_H
+
+#include <pthread.h>
+
+#include "rpc.h"
+#include "rpc_pack.h"
+
+/*------------------------------------------------------------------------*/
+
+/** packet in queue */
+typedef struct rpc_item_s
+{
+	rpc_packet_t* p;
+
+	struct rpc_item_s* next;
+} rpc_item_t;
+
+/*------------------------------------------------------------------------*/
+
+/** call waiting for response */
+typedef struct rpc_call_s
+{
+	uint32_t id;
+
+	/** response, chunks are joined, NULL if connection is broken */
+	rpc_packet_t* p;
+
+	/** chunks are passed to caller one by one */
+	int stream;
+
+	/** chunks of stream waiting for caller */
+	rpc_item_t* chunks;
+
+	rpc_item_t* chunks_last;
+
+	/** the last chunk is received */
+	int complete;
+
+	int done;
+
+	struct rpc_call_s* next;
+} rpc_call_t;
+
+/*------------------------------------------------------------------------*/
+
+/** handler of notifications pushed by server */
+typedef void (*rpc_event_func_t)(rpc_packet_t* p, void* prm);
+
+/** handler of chunk of streamed response */
+typedef void (*rpc_chunk_func_t)(const uint8_t* data, uint32_t len, void* prm);
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	int sock;
+
+	/** socket is SOCK_SEQPACKET, packet is one message */
+	int seqpacket;
+
+	/** negotiated version of protocol */
+	uint8_t version;
+
+	/** id of last sent request */
+	uint32_t last_id;
+
+	/** lock for calls list and reader flag */
+	pthread_mutex_t lock;
+
+	/** signaled when response is received or reader is gone */
+	pthread_cond_t cond;
+
+	/** serializes packets sent by concurrent threads */
+	pthread_mutex_t send_lock;
+
+	/** serializes whole calls for servers without request id */
+	pthread_mutex_t call_lock;
+
+	/** some thread is receiving responses for all */
+	int reading;
+
+	/** connection is broken */
+	int broken;
+
+	/** calls waiting for response */
+	rpc_call_t* calls;
+
+	/** handler of notifications */
+	rpc_event_func_t event_func;
+
+	void* event_prm;
+
+	/** notifications in order of arrival */
+	rpc_item_t* events;
+
+	rpc_item_t* events_last;
+
+	/** thread dispatching notifications and reading while nobody calls */
+	pthread_t events_thread;
+
+	int listening;
+
+	int terminate;
+} rpc_client_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief connect to the server and negotiate version of protocol
+ * @param socket_path path to the local socket
+ * @return pointer to client, NULL if failed
+ *
+ * Client must be closed by function rpc_client_close()
+ */
+rpc_client_t* rpc_client_open(const char* socket_path);
+
+/**
+ * @brief close connection to the server
+ * @param client client
+ */
+void rpc_client_close(rpc_client_t* client);
+
+/**
+ * @brief call function on server
+ * @param client client
+ * @param modem modem handle
+ * @param opcode function opcode
+ * @param data pointer to data buffer
+ * @param data_len length of data
+ * @return response, NULL if failed
+ *
+ * Thread safe, calls of many threads share the same connection and their
+ * responses are routed by request id.
+ * Packet must be free by function rpc_free()
+ */
+rpc_packet_t* rpc_client_call(rpc_client_t* client, uint16_t modem, uint16_t opcode, const void* data, uint32_t data_len);
+
+/**
+ * @brief call function on server with described argument and result
+ * @param client client
+ * @param modem modem handle
+ * @param opcode function opcode
+ * @param arg_type type of argument
+ * @param arg argument
+ * @param res_type type of result
+ * @param res result, must be freed by rpc_obj_free() if successful
+ * @return zero if successful, non zero for NULL result or failure
+ *
+ * Objects are sent in compact format to servers of version 6 and later,
+ * older servers get raw structures.
+ */
+int rpc_client_call_obj(rpc_client_t* client, uint16_t modem, uint16_t opcode,
+	const rpc_type_t* arg_type, const void* arg, const rpc_type_t* res_type, void* res);
+
+/**
+ * @brief call function on server and consume response by chunks
+ * @param client client
+ * @param modem modem handle
+ * @param opcode function opcode
+ * @param data pointer to data buffer
+ * @param data_len length of data
+ * @param func handler of chunks, called in thread of caller
+ * @param prm parameter of handler
+ * @return zero if the whole response is received
+ *
+ * Memory is bounded by size of chunk instead of size of response. Servers
+ * below version 5 send the whole response as one chunk.
+ */
+int rpc_client_call_stream(rpc_client_t* client, uint16_t modem, uint16_t opcode, const void* data, uint32_t data_len,
+	rpc_chunk_func_t func, void* prm);
+
+/**
+ * @brief start receiving of notifications pushed by server
+ * @param client client
+ * @param func handler of notifications
+ * @param prm parameter of handler
+ * @return zero if successful, -1 if server does not support notifications
+ *
+ * Handler is called in a separate thread in order of notifications, it may
+ * call functions of the server. Packet is freed after return of handler.
+ */
+int rpc_client_listen(rpc_client_t* client, rpc_event_func_t func, void* prm);
+
+#endif /* __MODEMD_RPC_CLIENT_H */
@@ -0,0 +1,66 @@
+#ifndef __MODEMD_RPC_FUNC_H
+#define __MODEMD_RPC_FUNC_H
+
+/***************************************************************************
+
+	Shared table of RPC functions for client and server.
+
+	Opcode of a function is its index in this table, so new functions
+	must be added only at the end of the list and existing entries must
+	never be removed or reordered.
+
+***************************************************************************/
+
+#define RPC_FUNCTIONS(F)				\
+	F(rpc_hello)						\
+	F(modem_find_first)					\
+	F(modem_find_next)					\
+	F(modem_open_by_port)				\
+	F(modem_close)						\
+	F(modem_get_info)					\
+	F(modem_get_last_error)				\
+	F(modem_get_imei)					\
+	F(modem_change_pin)					\
+	F(modem_get_fw_version)				\
+	F(modem_network_registration)		\
+	F(modem_get_imsi)					\
+	F(modem_operator_scan_start)		\
+	F(modem_operator_scan_is_running)	\
+	F(modem_get_signal_quality)			\
+	F(modem_operator_scan)				\
+	F(modem_at_command)					\
+	F(modem_get_network_time)			\
+	F(modem_get_operator_name)			\
+	F(modem_get_network_type)			\
+	F(modem_get_cell_id)				\
+	F(modem_conf_reload)				\
+	F(modem_set_wwan_profile)			\
+	F(modem_start_wwan)					\
+	F(modem_stop_wwan)					\
+	F(modem_state_wwan)					\
+	F(modem_ussd_cmd)					\
+	F(modemd_stats)						\
+	F(modem_get_status)					\
+	F(modem_subscribe)					\
+	F(modem_event)						\
+	F(modemd_func_stats)				\
+	F(modemd_sched_stats)				\
+	F(modem_get_reg_stats)				\
+	F(modem_get_init_state)				\
+	F(modem_get_poll_stats)				\
+	F(modem_get_reg_timeline)			\
+	F(modem_get_watchdog_stats)			\
+	F(modem_get_reg_retries)
+
+/*------------------------------------------------------------------------*/
+
+typedef enum
+{
+#define __RPC_OPCODE(name) RPC_OP_##name,
+	RPC_FUNCTIONS(__RPC_OPCODE)
+#undef __RPC_OPCODE
+
+	RPC_OP_COUNT
+} rpc_opcode_t;
+
+#endif /* __MODEMD_RPC_FUNC_H */
@@ -0,0 +1,313 @@
+#ifndef __MODEMD_RPC_IFACE_H
+#define __MODEMD_RPC_IFACE_H
+
+#include <time.h>
+
+#include "modem/types.h"
+
+#include "rpc_pack.h"
+
+/***************************************************************************
+
+	Interface definition shared by client and server.
+
+	RPC_INTERFACE lists functions whose client stubs (libmodem/modem.c)
+	and server handlers (modemd/thread.c) are generated from argument and
+	result types. Types are described by field tables below, new fields
+	must be added only at the end of a table. Arrays of described
+	structures are results of variable length, rpc_array_t objects.
+
+	Adding a call: append it to RPC_FUNCTIONS in rpc_func.h and here, then
+	write the public wrapper of the stub and the implementation on server.
+
+***************************************************************************/
+
+/*------------------------------------------------------------------------*/
+
+/* fields of structures: F(structure, RPC_FIELD_* kind, field) */
+
+#define RPC_STRUCT_usb_device_info_t(F)					\
+	F(usb_device_info_t, STR, port)						\
+	F(usb_device_info_t, UINT, id_vendor)				\
+	F(usb_device_info_t, UINT, id_product)				\
+	F(usb_device_info_t, STR, vendor)					\
+	F(usb_device_info_t, STR, product)
+
+#define RPC_STRUCT_modem_find_first_next_t(F)			\
+	F(modem_find_first_next_t, STR, mi.port)			\
+	F(modem_find_first_next_t, UINT, mi.id_vendor)		\
+	F(modem_find_first_next_t, UINT, mi.id_product)		\
+	F(modem_find_first_next_t, STR, mi.vendor)			\
+	F(modem_find_first_next_t, STR, mi.product)			\
+	F(modem_find_first_next_t, UINT, find)
+
+#define RPC_STRUCT_modem_signal_quality_t(F)			\
+	F(modem_signal_quality_t, INT, dbm)					\
+	F(modem_signal_quality_t, UINT, level)
+
+#define RPC_STRUCT_modem_fw_ver_t(F)					\
+	F(modem_fw_ver_t, STR, firmware)					\
+	F(modem_fw_ver_t, INT, release)
+
+#define RPC_STRUCT_modem_status_t(F)					\
+	F(modem_status_t, UINT, version)					\
+	F(modem_status_t, UINT, ready)						\
+	F(modem_status_t, INT, last_error)					\
+	F(modem_status_t, INT, reg)							\
+	F(modem_status_t, INT, sq.dbm)						\
+	F(modem_status_t, UINT, sq.level)					\
+	F(modem_status_t, STR, oper)						\
+	F(modem_status_t, STR, network_type)				\
+	F(modem_status_t, STR, firmware)					\
+	F(modem_status_t, INT, fw_release)					\
+	F(modem_status_t, STR, imei)						\
+	F(modem_status_t, STR, imsi)						\
+	F(modem_status_t, STR, ccid)						\
+	F(modem_status_t, UINTS, age)
+
+#define RPC_STRUCT_modemd_stats_t(F)					\
+	F(modemd_stats_t, UINT, connections)				\
+	F(modemd_stats_t, UINT, connections_max)			\
+	F(modemd_stats_t, UINT, accepted)					\
+	F(modemd_stats_t, UINT, pool.threads)				\
+	F(modemd_stats_t, UINT, pool.busy)					\
+	F(modemd_stats_t, UINT, pool.queued)				\
+	F(modemd_stats_t, UINT, pool.queued_max)			\
+	F(modemd_stats_t, UINT, pool.done)					\
+	F(modemd_stats_t, UINT, pool.rejected)				\
+	F(modemd_stats_t, UINT, pool_slow.threads)			\
+	F(modemd_stats_t, UINT, pool_slow.busy)				\
+	F(modemd_stats_t, UINT, pool_slow.queued)			\
+	F(modemd_stats_t, UINT, pool_slow.queued_max)		\
+	F(modemd_stats_t, UINT, pool_slow.done)				\
+	F(modemd_stats_t, UINT, pool_slow.rejected)
+
+#define RPC_STRUCT_modemd_func_stats_t(F)				\
+	F(modemd_func_stats_t, STR, name)					\
+	F(modemd_func_stats_t, UINT, ok.calls)				\
+	F(modemd_func_stats_t, UINT, ok.time_us)			\
+	F(modemd_func_stats_t, UINT, ok.time_max_us)		\
+	F(modemd_func_stats_t, UINTS, ok.hist)				\
+	F(modemd_func_stats_t, UINT, null.calls)			\
+	F(modemd_func_stats_t, UINT, null.time_us)			\
+	F(modemd_func_stats_t, UINT, null.time_max_us)		\
+	F(modemd_func_stats_t, UINTS, null.hist)
+
+#define RPC_STRUCT_modemd_sched_stats_t(F)			\
+	F(modemd_sched_stats_t, STR, port)				\
+	F(modemd_sched_stats_t, STR, name)				\
+	F(modemd_sched_stats_t, INT, next_ms)			\
+	F(modemd_sched_stats_t, UINT, runs)				\
+	F(modemd_sched_stats_t, UINT, late_last_us)		\
+	F(modemd_sched_stats_t, UINT, late_avg_us)		\
+	F(modemd_sched_stats_t, UINT, late_max_us)		\
+	F(modemd_sched_stats_t, UINT, run_max_us)
+
+#define RPC_STRUCT_modem_reg_state_stats_t(F)		\
+	F(modem_reg_state_stats_t, STR, name)			\
+	F(modem_reg_state_stats_t, UINT, entries)		\
+	F(modem_reg_state_stats_t, UINT, dwell_ms)		\
+	F(modem_reg_state_stats_t, UINT, dwell_max_ms)	\
+	F(modem_reg_state_stats_t, UINT, current)
+
+#define RPC_STRUCT_modem_poll_stats_t(F)			\
+	F(modem_poll_stats_t, STR, name)				\
+	F(modem_poll_stats_t, UINT, interval_ms)		\
+	F(modem_poll_stats_t, UINT, commands)			\
+	F(modem_poll_stats_t, UINT, saved)				\
+	F(modem_poll_stats_t, UINT, saved_per_hour)		\
+	F(modem_poll_stats_t, UINT, observed)
+
+#define RPC_STRUCT_modem_reg_timeline_t(F)			\
+	F(modem_reg_timeline_t, UINT, cycle)			\
+	F(modem_reg_timeline_t, STR, name)				\
+	F(modem_reg_timeline_t, UINT, time_ms)			\
+	F(modem_reg_timeline_t, UINT, offset_ms)		\
+	F(modem_reg_timeline_t, UINT, retries)
+
+#define RPC_STRUCT_modem_watchdog_stats_t(F)		\
+	F(modem_watchdog_stats_t, STR, name)			\
+	F(modem_watchdog_stats_t, UINT, runs)			\
+	F(modem_watchdog_stats_t, UINT, failures)		\
+	F(modem_watchdog_stats_t, UINT, time_ms)		\
+	F(modem_watchdog_stats_t, UINT, time_max_ms)	\
+	F(modem_watchdog_stats_t, UINT, current)
+
+#define RPC_STRUCT_modem_reg_retry_t(F)				\
+	F(modem_reg_retry_t, UINT, time_ms)				\
+	F(modem_reg_retry_t, STR, name)					\
+	F(modem_reg_retry_t, INT, error)				\
+	F(modem_reg_retry_t, UINT, attempt)				\
+	F(modem_reg_retry_t, UINT, delay_ms)			\
+	F(modem_reg_retry_t, STR, rule)
+
+/* described structures: S(structure, RPC_TYPE_F_* flags) */
+#define RPC_STRUCTS(S)									\
+	S(usb_device_info_t, 0)								\
+	S(modem_find_first_next_t, 0)						\
+	S(modem_signal_quality_t, 0)						\
+	S(modem_fw_ver_t, 0)								\
+	S(modem_status_t, RPC_TYPE_F_GROWS)					\
+	S(modemd_stats_t, 0)								\
+	S(modemd_func_stats_t, 0)						\
+	S(modemd_sched_stats_t, 0)						\
+	S(modem_reg_state_stats_t, 0)					\
+	S(modem_poll_stats_t, 0)						\
+	S(modem_reg_timeline_t, 0)						\
+	S(modem_watchdog_stats_t, 0)					\
+	S(modem_reg_retry_t, 0)
+
+/* arrays of described structures: A(array, structure) */
+#define RPC_ARRAYS(A)									\
+	A(modemd_func_stats_array, modemd_func_stats_t)	\
+	A(modemd_sched_stats_array, modemd_sched_stats_t)	\
+	A(modem_reg_state_stats_array, modem_reg_state_stats_t)	\
+	A(modem_poll_stats_array, modem_poll_stats_t)	\
+	A(modem_reg_timeline_array, modem_reg_timeline_t)	\
+	A(modem_watchdog_stats_array, modem_watchdog_stats_t)	\
+	A(modem_reg_retry_array, modem_reg_retry_t)
+
+/*------------------------------------------------------------------------*/
+
+/** cached values of modem_legacy_t, the first fields of struct cached_s */
+struct cached_legacy_s
+{
+	modem_network_reg_t reg;
+
+	modem_signal_quality_t sq;
+
+	char oper[0x100];
+
+	char oper_number[0x100];
+
+	char network_type[0x32];
+
+	modem_fw_ver_t fw_info;
+
+	char imsi[0x32];
+
+	char imei[0x32];
+
+	char ccid[0x32];
+
+	char msin[0x32];
+
+	char mcc[4];
+
+	char mnc[4];
+};
+
+/** modem_t returned by modem_open_by_port to protocol versions before 7,
+the layout is frozen */
+typedef struct
+{
+	int refs;
+
+	char port[0x100];
+
+	void* queues;
+
+	usb_device_info_t usb;
+
+	const void* mdd;
+
+	struct
+	{
+		pthread_t thread;
+
+		int terminate;
+
+		int ready;
+
+		int last_error;
+
+		struct cached_legacy_s state;
+	} reg;
+
+	struct
+	{
+		pthread_t thread;
+	} scan;
+} __attribute__((__packed__)) modem_legacy_t;
+
+/*------------------------------------------------------------------------*/
+
+/* functions with generated stubs: F(name, argument type, result type) */
+#define RPC_INTERFACE(F)												\
+	F(modem_find_first,					none,	modem_find_first_next_t)	\
+	F(modem_find_next,					ptr,	modem_find_first_next_t)	\
+	F(modem_get_info,					none,	usb_device_info_t)			\
+	F(modem_get_last_error,				none,	i32)						\
+	F(modem_get_imei,					none,	str)						\
+	F(modem_get_fw_version,				none,	modem_fw_ver_t)				\
+	F(modem_network_registration,		none,	i8)							\
+	F(modem_get_imsi,					none,	str)						\
+	F(modem_operator_scan_start,		strz,	i32)						\
+	F(modem_operator_scan_is_running,	none,	i8)							\
+	F(modem_get_signal_quality,			none,	modem_signal_quality_t)		\
+	F(modem_at_command,					strz,	str)						\
+	F(modem_get_network_time,			none,	time)						\
+	F(modem_get_operator_name,			none,	str)						\
+	F(modem_get_network_type,			none,	str)						\
+	F(modem_get_cell_id,				none,	i32)						\
+	F(modem_start_wwan,					none,	i32)						\
+	F(modem_stop_wwan,					none,	i32)						\
+	F(modem_state_wwan,					none,	i8)							\
+	F(modem_ussd_cmd,					strz,	str)						\
+	F(modemd_stats,						none,	modemd_stats_t)				\
+	F(modem_get_status,					none,	modem_status_t)				\
+	F(modemd_func_stats,				none,	modemd_func_stats_array)	\
+	F(modemd_sched_stats,				none,	modemd_sched_stats_array)	\
+	F(modem_get_reg_stats,				none,	modem_reg_state_stats_array)	\
+	F(modem_get_poll_stats,				none,	modem_poll_stats_array)	\
+	F(modem_get_reg_timeline,			none,	modem_reg_timeline_array)	\
+	F(modem_get_watchdog_stats,			none,	modem_watchdog_stats_array)	\
+	F(modem_get_reg_retries,			none,	modem_reg_retry_array)
+
+/*------------------------------------------------------------------------*/
+
+/** no data */
+extern const rpc_type_t rpc_type_none;
+
+/** allocated string, object is char* */
+extern const rpc_type_t rpc_type_str;
+
+/** allocated string sent with terminating zero by legacy format */
+extern const rpc_type_t rpc_type_strz;
+
+/** object is int8_t or packed enum */
+extern const rpc_type_t rpc_type_i8;
+
+/** object is int32_t */
+extern const rpc_type_t rpc_type_i32;
+
+/** object is time_t */
+extern const rpc_type_t rpc_type_time;
+
+/** object is a pointer */
+extern const rpc_type_t rpc_type_ptr;
+
+/**
+ * @brief create response of modem_open_by_port
+ * @param opcode function opcode
+ * @param modem opened modem
+ * @param version protocol version of client, older ones get modem_legacy_t
+ * @return packet, NULL if failed
+ */
+rpc_packet_t* rpc_create_modem(uint16_t opcode, const modem_t* modem, uint8_t version);
+
+/**
+ * @brief get modem from response of modem_open_by_port
+ * @param p packet
+ * @param version protocol version of server, older ones send modem_legacy_t
+ * @param modem modem
+ * @return zero if successful
+ */
+int rpc_get_modem(const rpc_packet_t* p, uint8_t version, modem_t* modem);
+
+#define __RPC_TYPE_DECL(type, flags) extern const rpc_type_t rpc_type_##type;
+	RPC_STRUCTS(__RPC_TYPE_DECL)
+	RPC_ARRAYS(__RPC_TYPE_DECL)
+#undef __RPC_TYPE_DECL
+
+#endif /* __MODEMD_RPC_IFACE_H */
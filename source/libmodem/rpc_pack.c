@@ -0,0 +1,631 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "rpc_pack.h"
+#include "rpc_iface.h"
+
+/*------------------------------------------------------------------------*/
+
+/** maximal length of varint for 64-bit value */
+#define __VARINT_MAX 10
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t varint_put(uint8_t* buf, uint64_t v)
+{
+	uint32_t res = 0;
+
+	do
+	{
+		if(buf)
+			buf[res] = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+
+		++ res;
+		v >>= 7;
+	} while(v);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** read varint, zero if data is invalid */
+static uint32_t varint_get(const uint8_t* data, uint32_t len, uint64_t* v)
+{
+	uint32_t i;
+
+	*v = 0;
+
+	for(i = 0; i < len && i < __VARINT_MAX; ++ i)
+	{
+		*v |= (uint64_t)(data[i] & 0x7f) << (7 * i);
+
+		if(!(data[i] & 0x80))
+			return(i + 1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint64_t field_get_uint(const uint8_t* p, uint16_t size)
+{
+	uint64_t u64 = 0;
+	uint32_t u32;
+	uint16_t u16;
+
+	switch(size)
+	{
+		case 1: return(*p);
+		case 2: memcpy(&u16, p, 2); return(u16);
+		case 4: memcpy(&u32, p, 4); return(u32);
+		case 8: memcpy(&u64, p, 8); return(u64);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int64_t field_get_int(const uint8_t* p, uint16_t size)
+{
+	uint64_t v = field_get_uint(p, size);
+
+	/* sign extension */
+	if(size < 8 && (v >> (size * 8 - 1)) & 1)
+		v |= ~0ULL << (size * 8);
+
+	return((int64_t)v);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void field_set_uint(uint8_t* p, uint16_t size, uint64_t v)
+{
+	uint32_t u32 = v;
+	uint16_t u16 = v;
+
+	switch(size)
+	{
+		case 1: *p = v; break;
+		case 2: memcpy(p, &u16, 2); break;
+		case 4: memcpy(p, &u32, 4); break;
+		case 8: memcpy(p, &v, 8); break;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t pack_bytes(uint8_t* buf, const void* s, uint32_t len)
+{
+	uint32_t res = varint_put(buf, len);
+
+	if(buf)
+		memcpy(buf + res, s, len);
+
+	return(res + len);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** pack count of items and items with their lengths */
+static uint32_t pack_array(const rpc_type_t* item, const rpc_array_t* a, uint8_t* buf)
+{
+	const uint8_t* p;
+	uint32_t res, len, i;
+
+	res = varint_put(buf, a->count);
+
+	for(i = 0; i < a->count; ++ i)
+	{
+		p = (const uint8_t*)a->items + i * item->size;
+		len = rpc_pack(item, p, NULL);
+
+		res += varint_put(buf ? buf + res : NULL, len);
+
+		if(buf)
+			rpc_pack(item, p, buf + res);
+
+		res += len;
+	}
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** unpack items, count is increased by each unpacked one for freeing on error */
+static int unpack_array(const rpc_type_t* item, rpc_array_t* a, const uint8_t* data, uint32_t len)
+{
+	uint32_t pos, n;
+	uint64_t cnt, v;
+
+	if(!(pos = varint_get(data, len, &cnt)))
+		return(-1);
+
+	/* each item takes one byte of its length at least */
+	if(cnt > len - pos)
+		return(-1);
+
+	if(cnt && !(a->items = calloc(cnt, item->size)))
+		return(-1);
+
+	for(; a->count < cnt; ++ a->count)
+	{
+		if(!(n = varint_get(data + pos, len - pos, &v)) || v > len - pos - n)
+			return(-1);
+
+		pos += n;
+
+		if(rpc_unpack(item, (uint8_t*)a->items + a->count * item->size, data + pos, v))
+			return(-1);
+
+		pos += v;
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void array_free(const rpc_type_t* item, rpc_array_t* a)
+{
+	uint32_t i;
+
+	for(i = 0; i < a->count; ++ i)
+		rpc_obj_free(item, (uint8_t*)a->items + i * item->size);
+
+	free(a->items);
+
+	a->count = 0;
+	a->items = NULL;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int array_copy(const rpc_type_t* item, rpc_array_t* dst, const rpc_array_t* src)
+{
+	uint32_t i;
+
+	dst->count = 0;
+	dst->items = NULL;
+
+	if(src->count && !(dst->items = calloc(src->count, item->size)))
+		return(-1);
+
+	for(; dst->count < src->count; ++ dst->count)
+	{
+		i = dst->count * item->size;
+
+		if(rpc_obj_copy(item, (uint8_t*)dst->items + i, (const uint8_t*)src->items + i))
+		{
+			/* items of source are not freed */
+			array_free(item, dst);
+
+			return(-1);
+		}
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+uint32_t rpc_pack(const rpc_type_t* type, const void* obj, uint8_t* buf)
+{
+	const rpc_field_t* f;
+	const uint8_t* p;
+	const char* s;
+	uint32_t res = 0, u32;
+	int64_t i64;
+	int i, j;
+
+	if(type->item)
+		return(pack_array(type->item, obj, buf));
+
+	for(i = 0; i < type->nfields; ++ i)
+	{
+		f = &type->fields[i];
+		p = (const uint8_t*)obj + f->offset;
+
+		switch(f->kind)
+		{
+			case RPC_FIELD_UINT:
+				res += varint_put(buf ? buf + res : NULL, field_get_uint(p, f->size));
+				break;
+
+			case RPC_FIELD_INT:
+				/* zigzag, small negative values are short too */
+				i64 = field_get_int(p, f->size);
+				res += varint_put(buf ? buf + res : NULL, ((uint64_t)i64 << 1) ^ (uint64_t)(i64 >> 63));
+				break;
+
+			case RPC_FIELD_STR:
+				s = (const char*)p;
+				res += pack_bytes(buf ? buf + res : NULL, s, strnlen(s, f->size));
+				break;
+
+			case RPC_FIELD_PSTR:
+				memcpy(&s, p, sizeof(s));
+				res += pack_bytes(buf ? buf + res : NULL, s, s ? strlen(s) : 0);
+				break;
+
+			case RPC_FIELD_UINTS:
+				res += varint_put(buf ? buf + res : NULL, f->size / sizeof(u32));
+
+				for(j = 0; j < f->size / sizeof(u32); ++ j)
+				{
+					memcpy(&u32, p + j * sizeof(u32), sizeof(u32));
+					res += varint_put(buf ? buf + res : NULL, u32);
+				}
+
+				break;
+		}
+	}
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_unpack(const rpc_type_t* type, void* obj, const uint8_t* data, uint32_t len)
+{
+	const rpc_field_t* f;
+	uint32_t pos = 0, n, u32;
+	uint64_t v, cnt;
+	uint8_t* p;
+	char* s;
+	int i, j;
+
+	memset(obj, 0, type->size);
+
+	if(type->item && unpack_array(type->item, obj, data, len))
+		goto err;
+
+	/* fields missing in data of older peer stay zero */
+	for(i = 0; i < type->nfields && pos < len; ++ i)
+	{
+		f = &type->fields[i];
+		p = (uint8_t*)obj + f->offset;
+
+		if(!(n = varint_get(data + pos, len - pos, &v)))
+			goto err;
+
+		pos += n;
+
+		switch(f->kind)
+		{
+			case RPC_FIELD_UINT:
+				field_set_uint(p, f->size, v);
+				break;
+
+			case RPC_FIELD_INT:
+				field_set_uint(p, f->size, (v >> 1) ^ -(v & 1));
+				break;
+
+			case RPC_FIELD_STR:
+				if(v > len - pos)
+					goto err;
+
+				/* too long string is truncated */
+				memcpy(p, data + pos, v < f->size ? v : f->size - 1);
+				pos += v;
+				break;
+
+			case RPC_FIELD_PSTR:
+				if(v > len - pos || !(s = malloc(v + 1)))
+					goto err;
+
+				memcpy(s, data + pos, v);
+				s[v] = 0;
+				memcpy(p, &s, sizeof(s));
+				pos += v;
+				break;
+
+			case RPC_FIELD_UINTS:
+				for(cnt = v, j = 0; j < cnt; ++ j)
+				{
+					if(!(n = varint_get(data + pos, len - pos, &v)))
+						goto err;
+
+					pos += n;
+
+					/* items of longer array are skipped */
+					if(j < f->size / sizeof(u32))
+					{
+						u32 = v;
+						memcpy(p + j * sizeof(u32), &u32, sizeof(u32));
+					}
+				}
+
+				break;
+		}
+	}
+
+	return(0);
+
+err:
+	rpc_obj_free(type, obj);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** object is a single allocated string */
+static int rpc_type_is_str(const rpc_type_t* type)
+{
+	return(type->nfields == 1 && type->fields[0].kind == RPC_FIELD_PSTR);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* rpc_create_obj(rpc_packet_type_t type, uint16_t opcode, const rpc_type_t* obj_type, const void* obj, int compact)
+{
+	const rpc_array_t* a;
+	const char* s;
+	rpc_packet_t* res;
+	uint32_t len;
+
+	if(!obj_type->size)
+	{
+		/* query without argument still asks for result in compact format */
+		if((res = rpc_create(type, opcode, NULL, 0)) && compact)
+			res->hdr.flags |= RPC_FLAG_COMPACT;
+
+		return(res);
+	}
+
+	if(compact)
+		len = rpc_pack(obj_type, obj, NULL);
+	else if(rpc_type_is_str(obj_type))
+	{
+		memcpy(&s, obj, sizeof(s));
+
+		/* string without terminating zero, or with it for old servers expecting C string */
+		len = (s ? strlen(s) : 0) + (obj_type->flags & RPC_TYPE_F_NUL ? 1 : 0);
+
+		return(rpc_create(type, opcode, (const uint8_t*)s, len));
+	}
+	else if(obj_type->item)
+	{
+		a = obj;
+
+		/* items one after another */
+		return(rpc_create(type, opcode, a->items, a->count * obj_type->item->size));
+	}
+	else
+		return(rpc_create(type, opcode, obj, obj_type->size));
+
+	/* packed directly to buffer of packet */
+	if(!(res = rpc_create(type, opcode, NULL, len)))
+		return(NULL);
+
+	rpc_pack(obj_type, obj, res->data);
+	res->hdr.flags |= RPC_FLAG_COMPACT;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_get_obj(const rpc_packet_t* p, const rpc_type_t* type, void* obj)
+{
+	rpc_array_t* a;
+	char* s;
+
+	if(!type->size)
+		return(0);
+
+	if(type->size > sizeof(rpc_obj_t))
+		return(-1);
+
+	/* NULL result */
+	if(!p->hdr.data_len)
+		return(-1);
+
+	if(p->hdr.flags & RPC_FLAG_COMPACT)
+		return(rpc_unpack(type, obj, p->data, p->hdr.data_len));
+
+	if(rpc_type_is_str(type))
+	{
+		if(!(s = malloc(p->hdr.data_len + 1)))
+			return(-1);
+
+		/* string may be with or without terminating zero */
+		memcpy(s, p->data, p->hdr.data_len);
+		s[p->hdr.data_len] = 0;
+
+		memcpy(obj, &s, sizeof(s));
+
+		return(0);
+	}
+
+	if(type->item)
+	{
+		a = obj;
+
+		if(p->hdr.data_len % type->item->size || !(a->items = malloc(p->hdr.data_len)))
+			return(-1);
+
+		memcpy(a->items, p->data, p->hdr.data_len);
+		a->count = p->hdr.data_len / type->item->size;
+
+		return(0);
+	}
+
+	if(p->hdr.data_len != type->size && !(type->flags & RPC_TYPE_F_GROWS))
+		return(-1);
+
+	/* structure of other version may be shorter or longer */
+	memset(obj, 0, type->size);
+	memcpy(obj, p->data, p->hdr.data_len < type->size ? p->hdr.data_len : type->size);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* rpc_create_modem(uint16_t opcode, const modem_t* modem, uint8_t version)
+{
+	modem_legacy_t legacy;
+
+	if(version >= RPC_PROTO_VERSION_7)
+		return(rpc_create(TYPE_RESPONSE, opcode, (const uint8_t*)modem, sizeof(*modem)));
+
+	memset(&legacy, 0, sizeof(legacy));
+
+	legacy.refs = modem->refs;
+	memcpy(legacy.port, modem->port, sizeof(legacy.port));
+	memcpy(&legacy.usb, &modem->usb, sizeof(legacy.usb));
+	legacy.reg.ready = modem->reg.ready;
+	legacy.reg.last_error = modem->reg.last_error;
+
+	/* values of later versions are appended to struct cached_s */
+	memcpy(&legacy.reg.state, &modem->reg.state, sizeof(legacy.reg.state));
+
+	return(rpc_create(TYPE_RESPONSE, opcode, (const uint8_t*)&legacy, sizeof(legacy)));
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_get_modem(const rpc_packet_t* p, uint8_t version, modem_t* modem)
+{
+	modem_legacy_t legacy;
+
+	if(version >= RPC_PROTO_VERSION_7)
+	{
+		if(p->hdr.data_len != sizeof(*modem))
+			return(-1);
+
+		memcpy(modem, p->data, sizeof(*modem));
+
+		return(0);
+	}
+
+	if(p->hdr.data_len != sizeof(legacy))
+		return(-1);
+
+	memcpy(&legacy, p->data, sizeof(legacy));
+	memset(modem, 0, sizeof(*modem));
+
+	modem->refs = legacy.refs;
+	memcpy(modem->port, legacy.port, sizeof(modem->port));
+	memcpy(&modem->usb, &legacy.usb, sizeof(modem->usb));
+	modem->reg.ready = legacy.reg.ready;
+	modem->reg.last_error = legacy.reg.last_error;
+	memcpy(&modem->reg.state, &legacy.reg.state, sizeof(legacy.reg.state));
+	modem->reg.state.state_wwan = MODEM_STATE_WWAN_UKNOWN;
+
+	/* older server returns only opened modem */
+	modem->init = MODEM_INIT_READY;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+int rpc_obj_copy(const rpc_type_t* type, void* dst, const void* src)
+{
+	char* s;
+	int i;
+
+	if(type->item)
+		return(array_copy(type->item, dst, src));
+
+	memcpy(dst, src, type->size);
+
+	for(i = 0; i < type->nfields; ++ i)
+	{
+		if(type->fields[i].kind != RPC_FIELD_PSTR)
+			continue;
+
+		memcpy(&s, (const uint8_t*)src + type->fields[i].offset, sizeof(s));
+
+		if(s && !(s = strdup(s)))
+			goto err;
+
+		memcpy((uint8_t*)dst + type->fields[i].offset, &s, sizeof(s));
+	}
+
+	return(0);
+
+err:
+	/* strings of source are not freed */
+	for(-- i; i >= 0; -- i)
+	{
+		if(type->fields[i].kind != RPC_FIELD_PSTR)
+			continue;
+
+		memcpy(&s, (uint8_t*)dst + type->fields[i].offset, sizeof(s));
+		free(s);
+	}
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void rpc_obj_free(const rpc_type_t* type, void* obj)
+{
+	char* s;
+	int i;
+
+	if(type->item)
+		array_free(type->item, obj);
+
+	for(i = 0; i < type->nfields; ++ i)
+	{
+		if(type->fields[i].kind != RPC_FIELD_PSTR)
+			continue;
+
+		memcpy(&s, (uint8_t*)obj + type->fields[i].offset, sizeof(s));
+		free(s);
+
+		s = NULL;
+		memcpy((uint8_t*)obj + type->fields[i].offset, &s, sizeof(s));
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+#define __RPC_SCALAR(name, kind, flags, ctype)									\
+	static const rpc_field_t rpc_fields_##name[] = {{kind, 0, sizeof(ctype)}};	\
+	const rpc_type_t rpc_type_##name = {#name, sizeof(ctype), flags, 1, rpc_fields_##name, NULL};
+
+const rpc_type_t rpc_type_none = {"none", 0, 0, 0, NULL, NULL};
+
+__RPC_SCALAR(str, RPC_FIELD_PSTR, 0, char*)
+__RPC_SCALAR(strz, RPC_FIELD_PSTR, RPC_TYPE_F_NUL, char*)
+__RPC_SCALAR(i8, RPC_FIELD_INT, 0, int8_t)
+__RPC_SCALAR(i32, RPC_FIELD_INT, 0, int32_t)
+__RPC_SCALAR(time, RPC_FIELD_INT, 0, time_t)
+__RPC_SCALAR(ptr, RPC_FIELD_UINT, 0, void*)
+
+#undef __RPC_SCALAR
+
+/*------------------------------------------------------------------------*/
+
+#define __RPC_FIELD(type, kind, field) \
+	{RPC_FIELD_##kind, offsetof(type, field), sizeof(((type*)0)->field)},
+
+#define __RPC_STRUCT(type, flags)															\
+	static const rpc_field_t rpc_fields_##type[] = {RPC_STRUCT_##type(__RPC_FIELD)};		\
+	const rpc_type_t rpc_type_##type = {#type, sizeof(type), flags,							\
+		sizeof(rpc_fields_##type) / sizeof(*rpc_fields_##type), rpc_fields_##type, NULL};
+
+RPC_STRUCTS(__RPC_STRUCT)
+
+#undef __RPC_STRUCT
+#undef __RPC_FIELD
+
+/*------------------------------------------------------------------------*/
+
+#define __RPC_ARRAY(name, type) \
+	const rpc_type_t rpc_type_##name = {#name, sizeof(rpc_array_t), 0, 0, NULL, &rpc_type_##type};
+
+RPC_ARRAYS(__RPC_ARRAY)
+
+#undef __RPC_ARRAY
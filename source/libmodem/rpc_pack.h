@@ -0,0 +1,165 @@
+#ifndef __MODEMD_RPC_PACK_H
+#define __MODEMD_RPC_PACK_H
+
+#include <stdint.h>
+
+#include "rpc.h"
+
+/***************************************************************************
+
+	Serialization of objects described by field tables of rpc_iface.h.
+
+	Compact format (since protocol version 6, packet flag RPC_FLAG_COMPACT)
+	writes fields in order of the table without padding:
+	 - integers as LEB128 varints, signed ones with zigzag encoding;
+	 - strings as varint length and bytes without terminating zero;
+	 - arrays as varint count and varints;
+	 - arrays of objects as varint count and items, each one as varint
+	   length and packed object.
+
+	Fields are only appended to the tables, so missing trailing fields of
+	older peers are zero and unknown trailing fields of newer peers are
+	skipped.
+
+	Legacy format of older versions is a raw copy of the packed structure,
+	items of array follow each other, so empty array is a NULL result.
+
+***************************************************************************/
+
+/*------------------------------------------------------------------------*/
+
+typedef enum
+{
+	/** unsigned integer of field size, pointers too */
+	RPC_FIELD_UINT = 0,
+
+	/** signed integer of field size */
+	RPC_FIELD_INT,
+
+	/** zero terminated string in fixed buffer */
+	RPC_FIELD_STR,
+
+	/** array of uint32_t */
+	RPC_FIELD_UINTS,
+
+	/** pointer to allocated string, freed by rpc_obj_free() */
+	RPC_FIELD_PSTR
+} rpc_field_kind_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** rpc_field_kind_t */
+	uint8_t kind;
+
+	uint16_t offset;
+
+	uint16_t size;
+} rpc_field_t;
+
+/*------------------------------------------------------------------------*/
+
+/** legacy data may be shorter than structure, the rest is zeroed */
+#define RPC_TYPE_F_GROWS 0x01
+
+/** legacy string is sent with terminating zero */
+#define RPC_TYPE_F_NUL 0x02
+
+typedef struct rpc_type_s
+{
+	const char* name;
+
+	/** size of object */
+	uint32_t size;
+
+	/** RPC_TYPE_F_* */
+	uint8_t flags;
+
+	uint8_t nfields;
+
+	const rpc_field_t* fields;
+
+	/** type of items if object is rpc_array_t, NULL otherwise */
+	const struct rpc_type_s* item;
+} rpc_type_t;
+
+/*------------------------------------------------------------------------*/
+
+/** array of objects, items are freed by rpc_obj_free() */
+typedef struct
+{
+	uint32_t count;
+
+	/** NULL if array is empty */
+	void* items;
+} rpc_array_t;
+
+/*------------------------------------------------------------------------*/
+
+/** storage for object of any described type */
+typedef union
+{
+	uint64_t align;
+
+	uint8_t data[0x400];
+} rpc_obj_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief pack object in compact format
+ * @param type type of object
+ * @param obj object
+ * @param buf buffer, NULL to calculate length
+ * @return length of packed object
+ */
+uint32_t rpc_pack(const rpc_type_t* type, const void* obj, uint8_t* buf);
+
+/**
+ * @brief unpack object from compact format
+ * @param type type of object
+ * @param obj object, filled with zeroes before unpacking
+ * @param data packed object
+ * @param len length of data
+ * @return zero if successful
+ */
+int rpc_unpack(const rpc_type_t* type, void* obj, const uint8_t* data, uint32_t len);
+
+/**
+ * @brief create packet with object
+ * @param type type of packet
+ * @param opcode function opcode
+ * @param obj_type type of object
+ * @param obj object
+ * @param compact compact format, otherwise legacy
+ * @return packet, NULL if failed
+ */
+rpc_packet_t* rpc_create_obj(rpc_packet_type_t type, uint16_t opcode, const rpc_type_t* obj_type, const void* obj, int compact);
+
+/**
+ * @brief get object from packet in format marked by its flags
+ * @param p packet
+ * @param type type of object
+ * @param obj object, must be freed by rpc_obj_free() if successful
+ * @return zero if successful, non zero for NULL result or invalid data
+ */
+int rpc_get_obj(const rpc_packet_t* p, const rpc_type_t* type, void* obj);
+
+/**
+ * @brief copy object with its strings and items
+ * @param type type of object
+ * @param dst copy, must be freed by rpc_obj_free() if successful
+ * @param src object
+ * @return zero if successful
+ */
+int rpc_obj_copy(const rpc_type_t* type, void* dst, const void* src);
+
+/**
+ * @brief free strings and items allocated for object
+ * @param type type of object
+ * @param obj object
+ */
+void rpc_obj_free(const rpc_type_t* type, void* obj);
+
+#endif /* __MODEMD_RPC_PACK_H */
@@ -0,0 +1,18 @@
+#ifndef __CLOCK_H
+#define __CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * @brief monotonic time, not affected by changes of system time
+ * @return milliseconds since unspecified starting point
+ */
+uint64_t clock_ms(void);
+
+/**
+ * @brief monotonic time in microseconds for measuring of short intervals
+ * @return microseconds since unspecified starting point
+ */
+uint64_t clock_us(void);
+
+#endif /* __CLOCK_H */
@@ -2,19 +2,28 @@
 #include <stdlib.h>
 
 #include "event.h"
+#include "clock.h"
 
 /*------------------------------------------------------------------------*/
 
 event_t* event_create(void)
 {
+	pthread_condattr_t attr;
 	event_t* res;
 
 	if(!(res = malloc(sizeof(*res))))
 		return(res);
 
-	pthread_cond_init(&res->cond, NULL);
+	/* timeouts are calculated with monotonic clock */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&res->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
 	pthread_mutex_init(&res->mutex, NULL);
 
+	res->signaled = 0;
+
 	return(res);
 }
 
@@ -23,23 +32,44 @@ event_t* event_create(void)
 void event_wait(event_t* event)
 {
 	pthread_mutex_lock(&event->mutex);
-	pthread_cond_wait(&event->cond, &event->mutex);
+
+	/* signal may be sent before waiting */
+	while(!event->signaled)
+		pthread_cond_wait(&event->cond, &event->mutex);
+
+	event->signaled = 0;
+
 	pthread_mutex_unlock(&event->mutex);
 }
 
 /*------------------------------------------------------------------------*/
 
 int event_wait_time(event_t* event, int seconds)
+{
+	return(event_wait_until(event, clock_ms() + seconds * 1000ULL));
+}
+
+/*------------------------------------------------------------------------*/
+
+int event_wait_until(event_t* event, uint64_t deadline)
 {
 	struct timespec timeout;
-	int res;
+	int res = 0;
 
-	/* setup timeout */
-	timeout.tv_sec = time(NULL) + seconds;
-	timeout.tv_nsec = 0;
+	timeout.tv_sec = deadline / 1000;
+	timeout.tv_nsec = deadline % 1000 * 1000000;
 
 	pthread_mutex_lock(&event->mutex);
-	res = pthread_cond_timedwait(&event->cond, &event->mutex, &timeout);
+
+	while(!event->signaled && !res)
+		res = pthread_cond_timedwait(&event->cond, &event->mutex, &timeout);
+
+	if(event->signaled)
+	{
+		event->signaled = 0;
+		res = 0;
+	}
+
 	pthread_mutex_unlock(&event->mutex);
 
 	return(res);
@@ -50,6 +80,7 @@ int event_wait_time(event_t* event, int seconds)
 void event_signal(event_t* event)
 {
 	pthread_mutex_lock(&event->mutex);
+	event->signaled = 1;
 	pthread_cond_signal(&event->cond);
 	pthread_mutex_unlock(&event->mutex);
 }
@@ -59,6 +90,7 @@ void event_signal(event_t* event)
 void event_signal_all(event_t* event)
 {
 	pthread_mutex_lock(&event->mutex);
+	event->signaled = 1;
 	pthread_cond_broadcast(&event->cond);
 	pthread_mutex_unlock(&event->mutex);
 }
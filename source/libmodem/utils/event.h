@@ -1,15 +1,20 @@
 #ifndef __EVENT_H
 #define __EVENT_H
 
+#include <stdint.h>
 #include <pthread.h>
 
 /*------------------------------------------------------------------------*/
 
+/** auto reset event, signal is kept until one waiter receives it */
 typedef struct
 {
 	pthread_cond_t cond;
 
 	pthread_mutex_t mutex;
+
+	/** signal is not received yet */
+	int signaled;
 } event_t;
 
 /*------------------------------------------------------------------------*/
@@ -20,6 +25,14 @@ void event_wait(event_t* event);
 
 int event_wait_time(event_t* event, int seconds);
 
+/**
+ * @brief wait for signal until deadline
+ * @param event event
+ * @param deadline monotonic time of clock_ms()
+ * @return zero if signal is received, non zero on timeout
+ */
+int event_wait_until(event_t* event, uint64_t deadline);
+
 void event_signal(event_t* event);
 
 void event_signal_all(event_t* event);
@@ -88,3 +88,21 @@ unsigned int file_get_contents_hex(const char* filename)
 
 	return(res);
 }
+
+/*------------------------------------------------------------------------*/
+
+int file_put_contents(const char* filename, const char* s)
+{
+	FILE *f;
+	int res;
+
+	if(!(f = fopen(filename, "w")))
+		return(-1);
+
+	res = fputs(s, f) < 0;
+
+	if(fclose(f))
+		res = 1;
+
+	return(res ? -1 : 0);
+}
@@ -28,4 +28,14 @@ char* file_get_contents(const char *filename, char* s, const int size);
  */
 unsigned int file_get_contents_hex(const char* filename);
 
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief write string to file, sysfs attributes are written in one call
+ * @param filename name of file
+ * @param s string
+ * @return zero if successful
+ */
+int file_put_contents(const char* filename, const char* s);
+
 #endif /* __FILE_H */
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+
+#include "pool.h"
+
+/*------------------------------------------------------------------------*/
+
+static void* pool_thread(void* prm)
+{
+	pool_t* pool = prm;
+	pool_job_t* job;
+
+	pthread_mutex_lock(&pool->lock);
+
+	for(;;)
+	{
+		/* wait for job */
+		while(!pool->first && !pool->terminate)
+			pthread_cond_wait(&pool->cond, &pool->lock);
+
+		/* queued jobs are finished before termination */
+		if(!(job = pool->first))
+			break;
+
+		if(!(pool->first = job->next))
+			pool->last = NULL;
+
+		-- pool->queued;
+		++ pool->busy;
+
+		pthread_mutex_unlock(&pool->lock);
+
+		job->func(job->prm);
+
+		pthread_mutex_lock(&pool->lock);
+
+		job->next = pool->free;
+		pool->free = job;
+
+		-- pool->busy;
+		++ pool->done;
+	}
+
+	pthread_mutex_unlock(&pool->lock);
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+pool_t* pool_create(int threads, int max_jobs)
+{
+	pool_t* res;
+
+	if(!(res = malloc(sizeof(*res))))
+		goto err;
+
+	res->terminate = 0;
+	res->max_jobs = max_jobs;
+	res->first = NULL;
+	res->last = NULL;
+	res->free = NULL;
+	res->busy = 0;
+	res->queued = 0;
+	res->queued_max = 0;
+	res->done = 0;
+	res->rejected = 0;
+
+	pthread_mutex_init(&res->lock, NULL);
+	pthread_cond_init(&res->cond, NULL);
+
+	if(!(res->threads = malloc(sizeof(*res->threads) * threads)))
+		goto err_threads;
+
+	/* creating workers */
+	for(res->nthreads = 0; res->nthreads < threads; ++ res->nthreads)
+		if(pthread_create(&res->threads[res->nthreads], NULL, pool_thread, res))
+			break;
+
+	if(!res->nthreads)
+		goto err_create;
+
+	goto exit;
+
+err_create:
+	free(res->threads);
+
+err_threads:
+	pthread_cond_destroy(&res->cond);
+	pthread_mutex_destroy(&res->lock);
+
+	free(res);
+	res = NULL;
+
+err:
+exit:
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+void pool_destroy(pool_t* pool)
+{
+	pool_job_t* job;
+	void* thread_res;
+	int i;
+
+	if(!pool)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->terminate = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for(i = 0; i < pool->nthreads; ++ i)
+		pthread_join(pool->threads[i], &thread_res);
+
+	while((job = pool->free))
+	{
+		pool->free = job->next;
+
+		free(job);
+	}
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->lock);
+
+	free(pool->threads);
+	free(pool);
+}
+
+/*------------------------------------------------------------------------*/
+
+int pool_add(pool_t* pool, pool_func_t func, void* prm)
+{
+	pool_job_t* job;
+	int res = -1;
+
+	pthread_mutex_lock(&pool->lock);
+
+	if(pool->terminate || pool->queued >= pool->max_jobs)
+	{
+		++ pool->rejected;
+
+		goto exit;
+	}
+
+	/* finished job is reused, allocation is only on growth of queue */
+	if((job = pool->free))
+		pool->free = job->next;
+	else if(!(job = malloc(sizeof(*job))))
+		goto exit;
+
+	job->func = func;
+	job->prm = prm;
+	job->next = NULL;
+
+	/* add job to the list */
+	if(pool->last)
+		pool->last->next = job;
+	else
+		pool->first = job;
+
+	pool->last = job;
+
+	if(++ pool->queued > pool->queued_max)
+		pool->queued_max = pool->queued;
+
+	/* wake up one worker */
+	pthread_cond_signal(&pool->cond);
+
+	res = 0;
+
+exit:
+	pthread_mutex_unlock(&pool->lock);
+
+	return(res);
+}
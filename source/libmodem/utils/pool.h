@@ -0,0 +1,90 @@
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*------------------------------------------------------------------------*/
+
+typedef void (*pool_func_t)(void* prm);
+
+/*------------------------------------------------------------------------*/
+
+typedef struct pool_job_s
+{
+	pool_func_t func;
+
+	void* prm;
+
+	struct pool_job_s* next;
+} pool_job_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	int terminate;
+
+	/** number of worker threads */
+	int nthreads;
+
+	pthread_t* threads;
+
+	/** limit of queued jobs */
+	int max_jobs;
+
+	pool_job_t* first;
+
+	pool_job_t* last;
+
+	/** finished jobs kept for reuse, bounded by limit of queued jobs */
+	pool_job_t* free;
+
+	pthread_mutex_t lock;
+
+	pthread_cond_t cond;
+
+	/** workers executing a job */
+	int busy;
+
+	/** jobs waiting for worker */
+	int queued;
+
+	/** maximum of queued jobs */
+	int queued_max;
+
+	/** executed jobs */
+	uint64_t done;
+
+	/** jobs rejected on full queue */
+	uint64_t rejected;
+} pool_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief create pool of worker threads
+ * @param threads number of worker threads
+ * @param max_jobs limit of jobs waiting for worker
+ * @return pointer to pool, NULL if failed
+ *
+ * Pool must be destroyed by function pool_destroy()
+ */
+pool_t* pool_create(int threads, int max_jobs);
+
+/**
+ * @brief destroy pool, queued jobs are executed before
+ * @param pool pool
+ */
+void pool_destroy(pool_t* pool);
+
+/**
+ * @brief add job to the pool
+ * @param pool pool
+ * @param func job function
+ * @param prm parameter for job function
+ * @return 0 if successful, -1 if queue is full
+ */
+int pool_add(pool_t* pool, pool_func_t func, void* prm);
+
+#endif /* __POOL_H */
@@ -0,0 +1,479 @@
+#include <time.h>
+#include <stdlib.h>
+
+#include "scheduler.h"
+#include "clock.h"
+
+/*------------------------------------------------------------------------*/
+
+#define SCHED_WHEEL_MASK (SCHED_WHEEL_SIZE - 1)
+
+/** ticks covered by levels below level */
+#define SCHED_LEVEL_SPAN(level) (1ULL << (SCHED_WHEEL_BITS * (level)))
+
+/*------------------------------------------------------------------------*/
+
+static void sched_unlink(sched_t* sched, sched_timer_t* timer)
+{
+	if(timer->list == &sched->expired && timer == sched->expired_last)
+		sched->expired_last = timer->prev;
+
+	if(timer->prev)
+		timer->prev->next = timer->next;
+	else
+		*timer->list = timer->next;
+
+	if(timer->next)
+		timer->next->prev = timer->prev;
+
+	timer->list = NULL;
+}
+
+/*------------------------------------------------------------------------*/
+
+/** put timer to slot of wheel by its deadline or to list of expired timers */
+static void sched_link(sched_t* sched, sched_timer_t* timer)
+{
+	uint64_t expires, delta;
+	sched_timer_t** list;
+	int level;
+
+	/* timer is not executed before deadline */
+	expires = (timer->deadline + SCHED_TICK_MS - 1) / SCHED_TICK_MS;
+
+	if(expires <= sched->tick)
+	{
+		/* expired timers are executed in order of expiration */
+		timer->prev = sched->expired_last;
+		timer->next = NULL;
+
+		if(sched->expired_last)
+			sched->expired_last->next = timer;
+		else
+			sched->expired = timer;
+
+		sched->expired_last = timer;
+		timer->list = &sched->expired;
+
+		return;
+	}
+
+	delta = expires - sched->tick;
+
+	for(level = 0; level < SCHED_WHEEL_LEVELS - 1 && delta >= SCHED_LEVEL_SPAN(level + 1); ++ level);
+
+	/* too far timer waits in the last slot and is cascaded again */
+	if(delta >= SCHED_LEVEL_SPAN(SCHED_WHEEL_LEVELS))
+		expires = sched->tick + SCHED_LEVEL_SPAN(SCHED_WHEEL_LEVELS) - 1;
+
+	list = &sched->wheel[level][(expires >> (SCHED_WHEEL_BITS * level)) & SCHED_WHEEL_MASK];
+
+	timer->prev = NULL;
+	timer->next = *list;
+
+	if(*list)
+		(*list)->prev = timer;
+
+	*list = timer;
+	timer->list = list;
+}
+
+/*------------------------------------------------------------------------*/
+
+/** move timers of slot to lower levels or to list of expired timers */
+static void sched_cascade(sched_t* sched, int level, int slot)
+{
+	sched_timer_t* timer, *next;
+
+	timer = sched->wheel[level][slot];
+	sched->wheel[level][slot] = NULL;
+
+	for(; timer; timer = next)
+	{
+		next = timer->next;
+
+		sched_link(sched, timer);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** advance wheel to current time */
+static void sched_advance(sched_t* sched, uint64_t now)
+{
+	uint64_t tick = now / SCHED_TICK_MS;
+	int level;
+
+	while(sched->tick < tick)
+	{
+		++ sched->tick;
+
+		/* slots of upper levels are cascaded on wrap of lower ones */
+		for(level = 1; level < SCHED_WHEEL_LEVELS; ++ level)
+		{
+			if(sched->tick & (SCHED_LEVEL_SPAN(level) - 1))
+				break;
+
+			sched_cascade(sched, level, (sched->tick >> (SCHED_WHEEL_BITS * level)) & SCHED_WHEEL_MASK);
+		}
+
+		sched_cascade(sched, 0, sched->tick & SCHED_WHEEL_MASK);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** nearest time when wheel has work, ms */
+static uint64_t sched_next(sched_t* sched)
+{
+	uint64_t pos, res = UINT64_MAX, at;
+	int level, i;
+
+	if(sched->expired)
+		return(0);
+
+	for(level = 0; level < SCHED_WHEEL_LEVELS; ++ level)
+	{
+		pos = sched->tick >> (SCHED_WHEEL_BITS * level);
+
+		/* the first used slot, for upper levels the time of its cascading */
+		for(i = 1; i <= SCHED_WHEEL_SIZE; ++ i)
+		{
+			if(!sched->wheel[level][(pos + i) & SCHED_WHEEL_MASK])
+				continue;
+
+			at = ((pos + i) << (SCHED_WHEEL_BITS * level)) * SCHED_TICK_MS;
+
+			if(at < res)
+				res = at;
+
+			break;
+		}
+	}
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** link armed timer and wake up idle worker for earlier deadline */
+static void sched_arm(sched_t* sched, sched_timer_t* timer)
+{
+	sched_link(sched, timer);
+
+	if(timer->deadline < sched->wait_deadline)
+	{
+		sched->wait_deadline = timer->deadline;
+
+		pthread_cond_signal(&sched->cond);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void sched_run(sched_t* sched, sched_timer_t* timer)
+{
+	uint64_t start, late;
+
+	sched_unlink(sched, timer);
+
+	timer->pending = 0;
+	timer->running = 1;
+
+	start = clock_us();
+	late = start > timer->deadline * 1000 ? start - timer->deadline * 1000 : 0;
+
+	pthread_mutex_unlock(&sched->lock);
+
+	timer->func(timer->prm);
+
+	pthread_mutex_lock(&sched->lock);
+
+	timer->running = 0;
+
+	/* statistics */
+	++ timer->runs;
+	timer->late_us += late;
+	timer->late_last_us = late > UINT32_MAX ? UINT32_MAX : late;
+
+	if(timer->late_last_us > timer->late_max_us)
+		timer->late_max_us = timer->late_last_us;
+
+	if((start = clock_us() - start) > timer->run_max_us)
+		timer->run_max_us = start > UINT32_MAX ? UINT32_MAX : start;
+
+	/* armed by callback */
+	if(timer->pending && !timer->removed)
+		sched_arm(sched, timer);
+
+	pthread_cond_broadcast(&sched->done);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void* sched_thread(void* prm)
+{
+	sched_t* sched = prm;
+	struct timespec timeout;
+	uint64_t next;
+
+	pthread_mutex_lock(&sched->lock);
+
+	while(!sched->terminate)
+	{
+		sched_advance(sched, clock_ms());
+
+		if(sched->expired)
+		{
+			sched_run(sched, sched->expired);
+
+			continue;
+		}
+
+		next = sched_next(sched);
+
+		/* new earlier deadline wakes up one of waiting workers */
+		sched->wait_deadline = next;
+
+		if(next == UINT64_MAX)
+			pthread_cond_wait(&sched->cond, &sched->lock);
+		else
+		{
+			timeout.tv_sec = next / 1000;
+			timeout.tv_nsec = next % 1000 * 1000000;
+
+			pthread_cond_timedwait(&sched->cond, &sched->lock, &timeout);
+		}
+
+		/* other waiting workers are woken up by any new deadline */
+		sched->wait_deadline = UINT64_MAX;
+	}
+
+	pthread_mutex_unlock(&sched->lock);
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+sched_t* sched_create(int threads)
+{
+	pthread_condattr_t attr;
+	sched_t* res;
+
+	if(!(res = calloc(1, sizeof(*res))))
+		goto err;
+
+	res->tick = clock_ms() / SCHED_TICK_MS;
+	res->wait_deadline = UINT64_MAX;
+
+	pthread_mutex_init(&res->lock, NULL);
+
+	/* deadlines are in monotonic time */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&res->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pthread_cond_init(&res->done, NULL);
+
+	if(!(res->threads = malloc(sizeof(*res->threads) * threads)))
+		goto err_threads;
+
+	/* creating workers */
+	for(res->nthreads = 0; res->nthreads < threads; ++ res->nthreads)
+		if(pthread_create(&res->threads[res->nthreads], NULL, sched_thread, res))
+			break;
+
+	if(!res->nthreads)
+		goto err_create;
+
+	goto exit;
+
+err_create:
+	free(res->threads);
+
+err_threads:
+	pthread_cond_destroy(&res->done);
+	pthread_cond_destroy(&res->cond);
+	pthread_mutex_destroy(&res->lock);
+
+	free(res);
+	res = NULL;
+
+err:
+exit:
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int sched_threads_grow(sched_t* sched, int threads)
+{
+	pthread_t* res;
+	int ret = 0;
+
+	pthread_mutex_lock(&sched->lock);
+
+	if(threads <= sched->nthreads)
+		goto exit;
+
+	if(!(res = realloc(sched->threads, sizeof(*res) * threads)))
+	{
+		ret = -1;
+		goto exit;
+	}
+
+	sched->threads = res;
+
+	/* new workers wait for the lock held here */
+	for(; sched->nthreads < threads; ++ sched->nthreads)
+	{
+		if(pthread_create(&sched->threads[sched->nthreads], NULL, sched_thread, sched))
+		{
+			ret = -1;
+			break;
+		}
+	}
+
+exit:
+	pthread_mutex_unlock(&sched->lock);
+
+	return(ret);
+}
+
+/*------------------------------------------------------------------------*/
+
+void sched_destroy(sched_t* sched)
+{
+	void* thread_res;
+	int i;
+
+	if(!sched)
+		return;
+
+	pthread_mutex_lock(&sched->lock);
+	sched->terminate = 1;
+	pthread_cond_broadcast(&sched->cond);
+	pthread_mutex_unlock(&sched->lock);
+
+	for(i = 0; i < sched->nthreads; ++ i)
+		pthread_join(sched->threads[i], &thread_res);
+
+	pthread_cond_destroy(&sched->done);
+	pthread_cond_destroy(&sched->cond);
+	pthread_mutex_destroy(&sched->lock);
+
+	free(sched->threads);
+	free(sched);
+}
+
+/*------------------------------------------------------------------------*/
+
+void sched_timer_add(sched_t* sched, sched_timer_t* timer, const char* name, const char* owner, sched_func_t func, void* prm)
+{
+	timer->name = name;
+	timer->owner = owner;
+	timer->func = func;
+	timer->prm = prm;
+	timer->deadline = 0;
+	timer->pending = 0;
+	timer->list = NULL;
+	timer->running = 0;
+	timer->removed = 0;
+	timer->prev = NULL;
+	timer->next = NULL;
+	timer->runs = 0;
+	timer->late_us = 0;
+	timer->late_last_us = 0;
+	timer->late_max_us = 0;
+	timer->run_max_us = 0;
+
+	pthread_mutex_lock(&sched->lock);
+
+	timer->all = sched->timers;
+	sched->timers = timer;
+
+	pthread_mutex_unlock(&sched->lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void sched_timer_del(sched_t* sched, sched_timer_t* timer)
+{
+	sched_timer_t** item;
+
+	pthread_mutex_lock(&sched->lock);
+
+	if(timer->list)
+		sched_unlink(sched, timer);
+
+	timer->pending = 0;
+	timer->removed = 1;
+
+	while(timer->running)
+		pthread_cond_wait(&sched->done, &sched->lock);
+
+	for(item = &sched->timers; *item; item = &(*item)->all)
+	{
+		if(*item == timer)
+		{
+			*item = timer->all;
+
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&sched->lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void sched_timer_at(sched_t* sched, sched_timer_t* timer, uint64_t deadline)
+{
+	pthread_mutex_lock(&sched->lock);
+
+	if(timer->removed || (timer->pending && timer->deadline <= deadline))
+		goto exit;
+
+	if(timer->list)
+		sched_unlink(sched, timer);
+
+	timer->deadline = deadline;
+	timer->pending = 1;
+
+	/* running timer is linked after the end of callback */
+	if(!timer->running)
+		sched_arm(sched, timer);
+
+exit:
+	pthread_mutex_unlock(&sched->lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void sched_timer_stop(sched_t* sched, sched_timer_t* timer)
+{
+	pthread_mutex_lock(&sched->lock);
+
+	if(timer->list)
+		sched_unlink(sched, timer);
+
+	timer->pending = 0;
+
+	pthread_mutex_unlock(&sched->lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void sched_timers_foreach(sched_t* sched, void (*func)(const sched_timer_t* timer, void* prm), void* prm)
+{
+	sched_timer_t* timer;
+
+	pthread_mutex_lock(&sched->lock);
+
+	for(timer = sched->timers; timer; timer = timer->all)
+		func(timer, prm);
+
+	pthread_mutex_unlock(&sched->lock);
+}
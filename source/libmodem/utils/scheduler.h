@@ -0,0 +1,186 @@
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*------------------------------------------------------------------------*/
+
+/** resolution of timers, ms */
+#define SCHED_TICK_MS 10
+
+/** bits of slot index in one level of timer wheel */
+#define SCHED_WHEEL_BITS 6
+
+/** slots in one level of timer wheel */
+#define SCHED_WHEEL_SIZE (1 << SCHED_WHEEL_BITS)
+
+/** levels of timer wheel, 10 ms * 64^4 is about 46 hours */
+#define SCHED_WHEEL_LEVELS 4
+
+/*------------------------------------------------------------------------*/
+
+typedef void (*sched_func_t)(void* prm);
+
+/*------------------------------------------------------------------------*/
+
+typedef struct sched_timer_s
+{
+	/** name of timer for statistics */
+	const char* name;
+
+	/** owner of timer for statistics, modem port */
+	const char* owner;
+
+	sched_func_t func;
+
+	void* prm;
+
+	/** deadline of armed timer, ms of clock_ms() */
+	uint64_t deadline;
+
+	/** timer is armed */
+	int pending;
+
+	/** list of slot of wheel or of expired timers, NULL if not linked */
+	struct sched_timer_s** list;
+
+	/** callback is executed now */
+	int running;
+
+	/** timer is removed, arming is ignored */
+	int removed;
+
+	/** neighbours in slot of wheel or in list of expired timers */
+	struct sched_timer_s* prev;
+	struct sched_timer_s* next;
+
+	/** list of all timers of scheduler */
+	struct sched_timer_s* all;
+
+	/** executed callbacks */
+	uint64_t runs;
+
+	/** lateness of callbacks against deadline, us */
+	uint64_t late_us;
+	uint32_t late_last_us;
+	uint32_t late_max_us;
+
+	/** maximal time of callback, us */
+	uint32_t run_max_us;
+} sched_timer_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	int terminate;
+
+	/** number of worker threads */
+	int nthreads;
+
+	pthread_t* threads;
+
+	pthread_mutex_t lock;
+
+	/** signaled on new deadline earlier than waited one */
+	pthread_cond_t cond;
+
+	/** signaled on end of callback */
+	pthread_cond_t done;
+
+	/** current tick of wheel */
+	uint64_t tick;
+
+	/** deadline waited for by idle workers, ms */
+	uint64_t wait_deadline;
+
+	/** lists of timers in slots */
+	sched_timer_t* wheel[SCHED_WHEEL_LEVELS][SCHED_WHEEL_SIZE];
+
+	/** expired timers waiting for worker */
+	sched_timer_t* expired;
+	sched_timer_t* expired_last;
+
+	/** all timers added to scheduler */
+	sched_timer_t* timers;
+} sched_t;
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief create scheduler with pool of worker threads
+ * @param threads number of worker threads
+ * @return pointer to scheduler, NULL if failed
+ *
+ * Timers are kept in hierarchical timer wheel, idle workers sleep until
+ * the nearest deadline. Scheduler must be destroyed by sched_destroy()
+ */
+sched_t* sched_create(int threads);
+
+/**
+ * @brief add worker threads up to the number
+ * @param sched scheduler
+ * @param threads required number of worker threads
+ * @return zero if successful
+ *
+ * Pool is never shrunk, idle workers sleep until the nearest deadline.
+ */
+int sched_threads_grow(sched_t* sched, int threads);
+
+/**
+ * @brief destroy scheduler, timers must be removed before
+ * @param sched scheduler
+ */
+void sched_destroy(sched_t* sched);
+
+/**
+ * @brief add timer to scheduler, timer is not armed
+ * @param sched scheduler
+ * @param timer timer, memory of caller valid until sched_timer_del()
+ * @param name name of timer for statistics
+ * @param owner owner of timer for statistics
+ * @param func callback
+ * @param prm parameter of callback
+ *
+ * Callbacks of one timer are never executed in parallel.
+ */
+void sched_timer_add(sched_t* sched, sched_timer_t* timer, const char* name, const char* owner, sched_func_t func, void* prm);
+
+/**
+ * @brief remove timer, running callback is waited for
+ * @param sched scheduler
+ * @param timer timer
+ *
+ * Must not be called from callback of the same timer.
+ */
+void sched_timer_del(sched_t* sched, sched_timer_t* timer);
+
+/**
+ * @brief arm timer
+ * @param sched scheduler
+ * @param timer timer
+ * @param deadline ms of clock_ms(), past deadline executes callback at once
+ *
+ * Armed timer keeps the earlier deadline, so waking up of timer is not lost
+ * when callback arms its timer again for later. Timer armed by its running
+ * callback is executed after the end of callback.
+ */
+void sched_timer_at(sched_t* sched, sched_timer_t* timer, uint64_t deadline);
+
+/**
+ * @brief disarm timer, running callback is not waited for
+ * @param sched scheduler
+ * @param timer timer
+ */
+void sched_timer_stop(sched_t* sched, sched_timer_t* timer);
+
+/**
+ * @brief iterate timers for statistics under lock of scheduler
+ * @param sched scheduler
+ * @param func called for each timer, must not call functions of scheduler
+ * @param prm parameter of func
+ */
+void sched_timers_foreach(sched_t* sched, void (*func)(const sched_timer_t* timer, void* prm), void* prm);
+
+#endif /* __SCHEDULER_H */
@@ -0,0 +1,76 @@
+#ifndef __SEQLOCK_H
+#define __SEQLOCK_H
+
+#include <stdint.h>
+
+/***************************************************************************
+
+	Sequence lock for data with one writer and many readers which never
+	block the writer. Reader copies data and retries if sequence was
+	changed meanwhile. Odd sequence means that writing is in progress.
+
+	Writers must be serialized by the caller.
+
+***************************************************************************/
+
+typedef struct
+{
+	uint32_t seq;
+} seqlock_t;
+
+/*------------------------------------------------------------------------*/
+
+static inline void seqlock_init(seqlock_t* sl)
+{
+	__atomic_store_n(&sl->seq, 0, __ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+static inline void seqlock_write_begin(seqlock_t* sl)
+{
+	__atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELAXED);
+
+	/* data can't be written before odd sequence is visible */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+static inline void seqlock_write_end(seqlock_t* sl)
+{
+	__atomic_store_n(&sl->seq, sl->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief begin reading
+ * @param sl lock
+ * @return sequence for seqlock_read_retry()
+ */
+static inline uint32_t seqlock_read_begin(const seqlock_t* sl)
+{
+	return(__atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE));
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief end reading
+ * @param sl lock
+ * @param seq sequence returned by seqlock_read_begin()
+ * @return non zero if data was written while reading and must be read again
+ *
+ * Reader does not wait for the writer, so number of retries may be limited
+ * if writer is in other process which may die
+ */
+static inline int seqlock_read_retry(const seqlock_t* sl, uint32_t seq)
+{
+	/* data must be read before sequence is checked */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return((seq & 1) || __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != seq);
+}
+
+#endif /* __SEQLOCK_H */
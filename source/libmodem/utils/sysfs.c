@@ -17,6 +17,26 @@
 
 /*------------------------------------------------------------------------*/
 
+/** prefix of /sys, /dev and /etc, empty for real devices */
+static char root[0x100] = "";
+
+/*------------------------------------------------------------------------*/
+
+void sysfs_root_set(const char* path)
+{
+	strncpy(root, path ? path : "", sizeof(root) - 1);
+	root[sizeof(root) - 1] = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+const char* sysfs_root(void)
+{
+	return(root);
+}
+
+/*------------------------------------------------------------------------*/
+
 int modem_is_supported(const char* vendor, const char* product, uint16_t vendor_id, uint16_t product_id)
 {
 	return(!!modem_db_get_info(vendor, product, vendor_id, product_id));
@@ -53,7 +73,7 @@ char* modem_get_iface_dev(const char* port, const char* dev_type, int iface, cha
 	DIR *dir;
 	int i, j;
 
-	snprintf(path, sizeof(path), "/sys/bus/usb/devices/%s:1.%d/", port, iface);
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s:1.%d/", root, port, iface);
 
 	if((dir = opendir(path)) == NULL)
 		return(res);
@@ -64,7 +84,7 @@ char* modem_get_iface_dev(const char* port, const char* dev_type, int iface, cha
 		if((s = strstr(item->d_name, dev_type)) == item->d_name)
 		{
 			/* name of tty in /dev */
-			snprintf(dev, dev_len - 1, "/dev/%s", s);
+			snprintf(dev, dev_len - 1, "%s/dev/%s", root, s);
 
 			res = dev;
 			break;
@@ -78,24 +98,72 @@ char* modem_get_iface_dev(const char* port, const char* dev_type, int iface, cha
 
 /*------------------------------------------------------------------------*/
 
+int usb_device_net_state(const char* port)
+{
+	char path[0x200], state[0x20];
+	struct dirent *item, *net;
+	DIR *dir, *dir_net;
+	size_t len = strlen(port);
+	int res = -1;
+
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices", root);
+
+	if((dir = opendir(path)) == NULL)
+		return(res);
+
+	/* network interface of any interface of device */
+	while(res == -1 && (item = readdir(dir)))
+	{
+		if(strncmp(item->d_name, port, len) || item->d_name[len] != ':')
+			continue;
+
+		snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s/net", root, item->d_name);
+
+		if((dir_net = opendir(path)) == NULL)
+			continue;
+
+		while((net = readdir(dir_net)))
+		{
+			if(*net->d_name == '.')
+				continue;
+
+			snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s/net/%s/operstate", root, item->d_name, net->d_name);
+
+			/* link of point-to-point interfaces is often unknown */
+			if(file_get_contents(path, state, sizeof(state)))
+				res = !strcmp(state, "up") || !strcmp(state, "unknown");
+
+			break;
+		}
+
+		closedir(dir_net);
+	}
+
+	closedir(dir);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
 usb_device_info_t* usb_device_get_info(const char* port, usb_device_info_t* di)
 {
 	char path[0x100];
 
 	/* read device name and id */
-	snprintf(path, sizeof(path), "/sys/bus/usb/devices/%s/idVendor", port);
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s/idVendor", root, port);
 	if(!(di->id_vendor = file_get_contents_hex(path)))
 		return(NULL);
 
-	snprintf(path, sizeof(path), "/sys/bus/usb/devices/%s/idProduct", port);
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s/idProduct", root, port);
 	if(!(di->id_product = file_get_contents_hex(path)))
 		return(NULL);
 
-	snprintf(path, sizeof(path), "/sys/bus/usb/devices/%s/manufacturer", port);
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s/manufacturer", root, port);
 	if(!file_get_contents(path, di->vendor, sizeof(di->vendor)))
 		return(NULL);
 
-	snprintf(path, sizeof(path), "/sys/bus/usb/devices/%s/product", port);
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s/product", root, port);
 	if(!file_get_contents(path, di->product, sizeof(di->product)))
 		return(NULL);
 
@@ -110,9 +178,12 @@ usb_device_info_t* usb_device_get_info(const char* port, usb_device_info_t* di)
 modem_find_t* modem_find_first(usb_device_info_t* mi)
 {
 	struct dirent *sysfs_item;
+	char path[0x100];
 	DIR *res;
 
-	if(!(res = opendir("/sys/bus/usb/devices/")))
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/", root);
+
+	if(!(res = opendir(path)))
 		return(res);
 
 	while((sysfs_item = readdir(res)))
@@ -10,6 +10,22 @@
 
 /*------------------------------------------------------------------------*/
 
+/**
+ * @brief set prefix of /sys, /dev and /etc paths
+ * @param path directory with fake sysfs tree, NULL or empty for real devices
+ *
+ * Allows to run daemon on any machine with simulated modems
+ */
+void sysfs_root_set(const char* path);
+
+/**
+ * @brief prefix of /sys, /dev and /etc paths
+ * @return prefix, empty string for real devices
+ */
+const char* sysfs_root(void);
+
+/*------------------------------------------------------------------------*/
+
 /**
  * @brief check vendor and product id on modem db
  * @param vendor name of manufacturer
@@ -41,6 +57,13 @@ char* modem_get_iface_dev(const char* port, const char* dev_type, int iface, cha
 
 usb_device_info_t* usb_device_get_info(const char* port, usb_device_info_t* di);
 
+/**
+ * @brief check link of network interface of device
+ * @param port port
+ * @return 1 if link is up, 0 if it is down, -1 if device has no network interface
+ */
+int usb_device_net_state(const char* port);
+
 modem_find_t* modem_find_first(usb_device_info_t* mi);
 
 modem_find_t* modem_find_next(modem_find_t* find, usb_device_info_t* mi);
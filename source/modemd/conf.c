@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
 #include <libgen.h>
@@ -12,12 +13,16 @@ modemd_conf_t conf;
 /*------------------------------------------------------------------------*/
 
 const char help[] =
-	"Usage: %s [-h] [-s SOCKET] [-p PID] [-l] [-i BUS-DEV]\n"
+	"Usage: %s [-h] [-s SOCKET] [-p PID] [-l] [-i BUS-DEV] [-w NUM] [-W NUM] [-r DIR] [-q]\n"
 	"-h - show this help\n"
 	"-s - file socket path (default: /var/run/%s.ctl)\n"
 	"-p - pid file path (default: /var/run/%s.pid)\n"
 	"-l - log to syslog\n"
-	"-i - initialize modem on port, for example 1-1\n";
+	"-i - initialize modem on port, for example 1-1\n"
+	"-w - worker threads for requests (default: 4)\n"
+	"-W - worker threads for slow requests like scan and USSD (default: 2)\n"
+	"-r - prefix of /sys, /dev and /etc paths, for simulated modems\n"
+	"-q - SOCK_SEQPACKET control socket, one packet per message (old clients need stream)\n";
 
 /*------------------------------------------------------------------------*/
 
@@ -31,9 +36,13 @@ int conf_read_cmdline(int argc, char** argv)
 	snprintf(conf.sock_path, sizeof(conf.sock_path), "/var/run/%s.ctl", conf.basename);
 	snprintf(conf.pid_path, sizeof(conf.pid_path), "/var/run/%s.pid", conf.basename);
 	*conf.port = 0;
+	*conf.root = 0;
+	conf.workers = 4;
+	conf.workers_slow = 2;
+	conf.seqpacket = 0;
 
 	/* analyze command line */
-	while((param = getopt(argc, argv, "hs:p:li:")) != -1)
+	while((param = getopt(argc, argv, "hs:p:li:w:W:r:q")) != -1)
 	{
 		switch(param)
 		{
@@ -56,10 +65,29 @@ int conf_read_cmdline(int argc, char** argv)
 				conf.port[sizeof(conf.port) - 1] = 0;
 				break;
 
+			case 'r':
+				strncpy(conf.root, optarg, sizeof(conf.root) - 1);
+				conf.root[sizeof(conf.root) - 1] = 0;
+				break;
+
 			case 'l':
 				conf.syslog = 1;
 				break;
 
+			case 'q':
+				conf.seqpacket = 1;
+				break;
+
+			case 'w':
+				if((conf.workers = atoi(optarg)) < 1)
+					conf.workers = 1;
+				break;
+
+			case 'W':
+				if((conf.workers_slow = atoi(optarg)) < 1)
+					conf.workers_slow = 1;
+				break;
+
 			default: /* '?' */
 				printf(help, conf.basename, conf.basename, conf.basename);
 				return(-1);
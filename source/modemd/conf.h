@@ -11,9 +11,21 @@ typedef struct
 
 	char port[0x100];
 
+	/** prefix of /sys, /dev and /etc paths */
+	char root[0x100];
+
 	int syslog;
 
 	int daemonize;
+
+	/** worker threads for fast requests */
+	int workers;
+
+	/** worker threads for slow requests */
+	int workers_slow;
+
+	/** control socket is SOCK_SEQPACKET */
+	int seqpacket;
 } modemd_conf_t;
 
 /*------------------------------------------------------------------------*/
@@ -16,153 +16,19 @@
 #include <string.h>
 #include <syslog.h>
 
-#include "conf.h"
-#include "thread.h"
-
-/*------------------------------------------------------------------------*/
-
-static int sock = -1;
-
-static int terminate = 0;
-
-static modem_t* modem = NULL;
-
-/*------------------------------------------------------------------------*/
-
-int proccess_connection(int sock)
-{
-	modemd_client_thread_t *priv_data;
-	pthread_attr_t attr;
-	pthread_t thread;
-	int res = 0;
-
-	/* allocate memory for private data */
-	if(!(priv_data = (modemd_client_thread_t*)malloc(sizeof(*priv_data))))
-	{
-		res = -1;
-		goto err_malloc;
-	}
-
-	memset(priv_data, 0, sizeof(*priv_data));
-	priv_data->sock = sock;
-
-	pthread_attr_init(&attr);
-	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-
-	/* creating thread */
-	res = pthread_create(&thread, &attr, ThreadWrapper, priv_data);
-
-	pthread_attr_destroy(&attr);
-
-	if(res)
-		free(priv_data);
-
-err_malloc:
-	return(res);
-}
-
-/*------------------------------------------------------------------------*/
+#include "modem/modem.h"
 
-int srv_run(void)
-{
-	struct sockaddr_un sa_bind;
-	struct sockaddr_un sa_client;
-	socklen_t sa_client_len;
-	int sock_client = -1;
-	int res = 0;
-#if 0
-	struct timeval tv = {5, 0};
-	fd_set rfds;
-#endif
-
-	/* creating socket server */
-	if((sock = socket(AF_LOCAL, SOCK_STREAM, 0)) < 0)
-	{
-		res = -1;
-		goto err_socket;
-	}
-
-	/* filling address */
-	memset(&sa_bind, 0, sizeof(sa_bind));
-	sa_bind.sun_family = AF_LOCAL;
-	strncpy(sa_bind.sun_path, conf.sock_path, sizeof(sa_bind.sun_path) - 1);
-	sa_bind.sun_path[sizeof(sa_bind.sun_path) - 1] = 0;
-
-	if(bind(sock, (struct sockaddr *)&sa_bind, sizeof(sa_bind)))
-	{
-		res = -1;
-		goto err_bind;
-	}
-
-	if(listen(sock, 1))
-	{
-		res = -1;
-		goto err_listen;
-	}
-
-	if(*conf.port)
-		modem = modem_open_by_port(conf.port);
+#include "utils/sysfs.h"
 
-	sa_client_len = sizeof(sa_client);
-
-	/* processing connections */
-	while(!terminate)
-	{
-#if 0
-		FD_ZERO(&rfds);
-		FD_SET(sock, &rfds);
-
-		tv.tv_sec = 5;
-		tv.tv_usec = 0;
-
-		if(!(res = select(sock + 1, &rfds, NULL, NULL, &tv)))
-		{
-			printf("Wait more %d\n", srv_terminate);
-			continue;
-		}
-
-		if(!FD_ISSET(sock, &rfds))
-		{
-			printf("sig Wait more %d\n", srv_terminate);
-			continue;
-		}
-#endif
-		sock_client = accept(sock, (struct sockaddr*)&sa_client, &sa_client_len);
-
-		/* create thread for connection */
-		if((res = proccess_connection(sock_client)))
-		{
-			perror(NULL);
-
-			close(sock_client);
-		}
-
-		/* and wait another connection */
-		sa_client_len = sizeof(sa_client);
-
-#if 0
-		terminate = 1;
-		sleep(240);
-#endif
-	}
-
-err_listen:
-	unlink(conf.sock_path);
-
-err_bind:
-	close(sock);
-
-err_socket:
-	return(res);
-}
+#include "conf.h"
+#include "srv.h"
 
 /*------------------------------------------------------------------------*/
 
 void on_sigterm(int prm)
 {
 	printf("SIGTERM %d\n", prm);
-	terminate = 1;
-	close(sock);
+	srv_terminate();
 }
 
 /*------------------------------------------------------------------------*/
@@ -192,16 +58,23 @@ int main(int argc, char** argv)
 		"   Basename: %s\n"
 		"Socket file: %s\n"
 		"   PID file: %s\n"
-		"     Syslog: %s\n\n",
+		"     Syslog: %s\n"
+		"    Workers: %d, slow %d\n"
+		"       Root: %s\n\n",
 		conf.basename,
 		conf.sock_path,
 		conf.pid_path,
-		conf.syslog ? "Yes" : "No"
+		conf.syslog ? "Yes" : "No",
+		conf.workers, conf.workers_slow,
+		*conf.root ? conf.root : "/"
 	);
 
 	signal(SIGTERM, on_sigterm);
 	signal(SIGINT, on_sigterm);
 
+	/* client may close connection before response */
+	signal(SIGPIPE, SIG_IGN);
+
 	if(*conf.pid_path)
 		create_pid_file(conf.pid_path);
 
@@ -214,14 +87,14 @@ int main(int argc, char** argv)
 		unlink(conf.sock_path);
 	}
 
+	sysfs_root_set(conf.root);
+
 	modem_init(NULL);
 
 	/* run socket server */
 	if(srv_run())
 		perror(conf.basename);
 
-	modem_close(modem);
-
 	modem_cleanup();
 
 	if(conf.syslog)
@@ -0,0 +1,519 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rpc.h"
+#include "srv.h"
+#include "notify.h"
+#include "modem_int.h"
+#include "utils/clock.h"
+
+/*------------------------------------------------------------------------*/
+
+/** period of checks if registration thread did not report changes, ms */
+#define __CHECK_PERIOD 1000
+
+/** minimal interval between notifications of one subscription, ms */
+#define __INTERVAL_MIN 50
+
+/*------------------------------------------------------------------------*/
+
+typedef struct notify_sub_s
+{
+	modemd_client_thread_t* priv;
+
+	/** modem handle in connection of client */
+	uint16_t handle;
+
+	modem_t* modem;
+
+	/** subscribed events */
+	uint32_t mask;
+
+	/** minimal interval between notifications, ms */
+	uint32_t interval;
+
+	/** client knows values from the last notification */
+	int known;
+
+	/** cached values of client must be dropped */
+	int invalidated;
+
+	/** values of the last notification */
+	modem_event_t sent;
+
+	/** time of the last notification, ms */
+	uint64_t sent_time;
+
+	struct notify_sub_s* next;
+} notify_sub_t;
+
+/** notification prepared under lock and sent after it is released */
+typedef struct notify_out_s
+{
+	/** referenced client */
+	modemd_client_thread_t* priv;
+
+	uint16_t handle;
+
+	rpc_packet_t* p;
+
+	/** result of client_push() */
+	int res;
+
+	struct notify_out_s* next;
+} notify_out_t;
+
+/*------------------------------------------------------------------------*/
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t cond;
+
+static pthread_t thread;
+
+static int running = 0;
+
+static int terminate = 0;
+
+/** some modem reported changes */
+static int changed = 0;
+
+static notify_sub_t* subs = NULL;
+
+/*------------------------------------------------------------------------*/
+
+static void notify_read(modem_t* modem, modem_event_t* ev)
+{
+	struct cached_s state;
+
+	modem_state_read(modem, &state);
+
+	memset(ev, 0, sizeof(*ev));
+
+	ev->reg = state.reg;
+	ev->sq = state.sq;
+	strncpy(ev->network_type, state.network_type, sizeof(ev->network_type) - 1);
+	ev->state_wwan = state.state_wwan;
+	ev->last_error = modem->reg.last_error;
+	ev->init = modem->init;
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint32_t notify_diff(const modem_event_t* a, const modem_event_t* b)
+{
+	uint32_t res = 0;
+
+	if(a->reg != b->reg)
+		res |= MODEM_EVENT_REG;
+
+	if(memcmp(&a->sq, &b->sq, sizeof(a->sq)))
+		res |= MODEM_EVENT_SQ;
+
+	if(strcmp(a->network_type, b->network_type))
+		res |= MODEM_EVENT_NETWORK_TYPE;
+
+	if(a->state_wwan != b->state_wwan)
+		res |= MODEM_EVENT_STATE_WWAN;
+
+	if(a->last_error != b->last_error)
+		res |= MODEM_EVENT_LAST_ERROR;
+
+	if(a->init != b->init)
+		res |= MODEM_EVENT_INIT;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** update events of modem needed by all subscribers, lock must be held */
+static void notify_modem_events(modem_t* modem)
+{
+	notify_sub_t* sub;
+	uint32_t events = 0;
+
+	for(sub = subs; sub; sub = sub->next)
+	{
+		if(sub->modem == modem)
+			events |= sub->mask;
+	}
+
+	modem_priv(modem)->events = events;
+}
+
+/*------------------------------------------------------------------------*/
+
+/** remove subscriptions of client, lock must be held */
+static void notify_remove(modemd_client_thread_t* priv, int all, uint16_t handle)
+{
+	notify_sub_t** prev, *sub;
+
+	for(prev = &subs; (sub = *prev);)
+	{
+		if(sub->priv != priv || (!all && sub->handle != handle))
+		{
+			prev = &sub->next;
+
+			continue;
+		}
+
+		*prev = sub->next;
+
+		notify_modem_events(sub->modem);
+
+		free(sub);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** prepare notification of subscriber, lock must be held */
+static notify_out_t* notify_out_create(notify_sub_t* sub, const modem_event_t* ev)
+{
+	notify_out_t* res;
+
+	if(!(res = malloc(sizeof(*res))))
+		return(NULL);
+
+	/* client being closed gets nothing */
+	if(srv_client_try_ref(sub->priv))
+	{
+		free(res);
+
+		return(NULL);
+	}
+
+	if(!(res->p = rpc_create(TYPE_EVENT, RPC_OP_modem_event, (const uint8_t*)ev, sizeof(*ev))))
+	{
+		srv_client_unref(sub->priv);
+		free(res);
+
+		return(NULL);
+	}
+
+	res->p->hdr.modem = sub->handle;
+
+	res->priv = sub->priv;
+	res->handle = sub->handle;
+	res->res = 0;
+	res->next = NULL;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** send prepared notifications, lock must not be held */
+static void notify_out_send(notify_out_t* outs)
+{
+	notify_out_t* out;
+
+	for(out = outs; out; out = out->next)
+	{
+		out->res = client_push(out->priv, out->p);
+		out->p = NULL;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** apply results of sending while clients are referenced, lock must be held */
+static void notify_out_result(notify_out_t* outs)
+{
+	notify_out_t* out;
+	notify_sub_t* sub;
+
+	for(out = outs; out; out = out->next)
+	{
+		/* client which can't read is shut down, it gets nothing more */
+		if(out->res < 0)
+		{
+			notify_remove(out->priv, 1, 0);
+
+			continue;
+		}
+
+		/* busy client gets all values on the next check */
+		for(sub = subs; out->res && sub; sub = sub->next)
+		{
+			if(sub->priv == out->priv && sub->handle == out->handle)
+				sub->known = 0;
+		}
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** release clients, lock must not be held */
+static void notify_out_free(notify_out_t* outs)
+{
+	notify_out_t* out;
+
+	while((out = outs))
+	{
+		outs = out->next;
+
+		srv_client_unref(out->priv);
+
+		free(out);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+static void* notify_thread(void* prm)
+{
+	struct timespec ts;
+	notify_sub_t* sub;
+	notify_out_t* outs, **last, *out;
+	modem_event_t ev;
+	uint64_t now, next;
+	uint32_t diff;
+
+	pthread_mutex_lock(&lock);
+
+	while(!terminate)
+	{
+		now = clock_ms();
+		next = now + __CHECK_PERIOD;
+
+		changed = 0;
+
+		outs = NULL;
+		last = &outs;
+
+		for(sub = subs; sub; sub = sub->next)
+		{
+			notify_read(sub->modem, &ev);
+
+			/* client gets only changed values */
+			diff = sub->known ? notify_diff(&sub->sent, &ev) : MODEM_EVENT_ALL;
+
+			if(sub->invalidated)
+				diff |= MODEM_EVENT_INVALIDATE;
+
+			diff &= sub->mask;
+
+			if(!diff)
+				continue;
+
+			/* rate limit, changes are coalesced into the next notification */
+			if(sub->known && now < sub->sent_time + sub->interval)
+			{
+				if(sub->sent_time + sub->interval < next)
+					next = sub->sent_time + sub->interval;
+
+				continue;
+			}
+
+			ev.mask = diff;
+
+			if(!(out = notify_out_create(sub, &ev)))
+				continue;
+
+			*last = out;
+			last = &out->next;
+
+			sub->sent = ev;
+			sub->sent_time = now;
+			sub->known = 1;
+			sub->invalidated = 0;
+		}
+
+		if(outs)
+		{
+			/* slow client can't block threads reporting changes of modems */
+			pthread_mutex_unlock(&lock);
+			notify_out_send(outs);
+			pthread_mutex_lock(&lock);
+
+			notify_out_result(outs);
+
+			/* the last reference of client may unsubscribe it */
+			pthread_mutex_unlock(&lock);
+			notify_out_free(outs);
+			pthread_mutex_lock(&lock);
+		}
+
+		if(changed)
+			continue;
+
+		ts.tv_sec = next / 1000;
+		ts.tv_nsec = next % 1000 * 1000000;
+
+		pthread_cond_timedwait(&cond, &lock, &ts);
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void notify_wake(modem_t* modem)
+{
+	/* nobody is waiting for changes */
+	if(!modem_priv(modem)->events)
+		return;
+
+	pthread_mutex_lock(&lock);
+
+	changed = 1;
+	pthread_cond_signal(&cond);
+
+	pthread_mutex_unlock(&lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void notify_invalidate(modem_t* modem)
+{
+	notify_sub_t* sub;
+
+	/* nobody caches values */
+	if(!(modem_priv(modem)->events & MODEM_EVENT_INVALIDATE))
+		return;
+
+	pthread_mutex_lock(&lock);
+
+	for(sub = subs; sub; sub = sub->next)
+	{
+		if(sub->modem == modem)
+			sub->invalidated = 1;
+	}
+
+	changed = 1;
+	pthread_cond_signal(&cond);
+
+	pthread_mutex_unlock(&lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+int notify_start(void)
+{
+	pthread_condattr_t attr;
+
+	/* timeouts are calculated with monotonic clock */
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	terminate = 0;
+
+	if(pthread_create(&thread, NULL, notify_thread, NULL))
+	{
+		pthread_cond_destroy(&cond);
+
+		return(-1);
+	}
+
+	running = 1;
+
+	modem_notify_set(notify_wake);
+	modem_invalidate_set(notify_invalidate);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void notify_stop(void)
+{
+	void* thread_res;
+
+	if(!running)
+		return;
+
+	modem_notify_set(NULL);
+	modem_invalidate_set(NULL);
+
+	pthread_mutex_lock(&lock);
+	terminate = 1;
+	pthread_cond_signal(&cond);
+	pthread_mutex_unlock(&lock);
+
+	pthread_join(thread, &thread_res);
+
+	running = 0;
+
+	/* free subscriptions */
+	pthread_mutex_lock(&lock);
+
+	while(subs)
+		notify_remove(subs->priv, 1, 0);
+
+	pthread_mutex_unlock(&lock);
+
+	pthread_cond_destroy(&cond);
+}
+
+/*------------------------------------------------------------------------*/
+
+int notify_subscribe(modemd_client_thread_t* priv, uint16_t handle, modem_t* modem, const modem_subscribe_t* sub)
+{
+	notify_sub_t* item;
+
+	pthread_mutex_lock(&lock);
+
+	/* new subscription replaces old one */
+	notify_remove(priv, 0, handle);
+
+	if(!sub->mask)
+		goto exit;
+
+	if(!(item = malloc(sizeof(*item))))
+		goto err;
+
+	memset(item, 0, sizeof(*item));
+
+	item->priv = priv;
+	item->handle = handle;
+	item->modem = modem;
+	item->mask = sub->mask & MODEM_EVENT_ALL;
+	item->interval = sub->interval < __INTERVAL_MIN ? __INTERVAL_MIN : sub->interval;
+
+	item->next = subs;
+	subs = item;
+
+	notify_modem_events(modem);
+
+	/* send current values */
+	changed = 1;
+
+	if(running)
+		pthread_cond_signal(&cond);
+
+exit:
+	pthread_mutex_unlock(&lock);
+
+	return(0);
+
+err:
+	pthread_mutex_unlock(&lock);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void notify_unsubscribe(modemd_client_thread_t* priv, uint16_t handle)
+{
+	pthread_mutex_lock(&lock);
+	notify_remove(priv, 0, handle);
+	pthread_mutex_unlock(&lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void notify_unsubscribe_all(modemd_client_thread_t* priv)
+{
+	pthread_mutex_lock(&lock);
+	notify_remove(priv, 1, 0);
+	pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,44 @@
+#ifndef __NOTIFY_H
+#define __NOTIFY_H
+
+#include <modem/types.h>
+
+#include "thread.h"
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief start thread sending notifications to subscribed clients
+ * @return zero if successful
+ */
+int notify_start(void);
+
+/** stop thread of notifications and remove all subscriptions */
+void notify_stop(void);
+
+/**
+ * @brief subscribe client to changes of modem
+ * @param priv client
+ * @param handle modem handle in connection of client
+ * @param modem modem
+ * @param sub events and rate limit, zero mask removes subscription
+ * @return zero if successful
+ *
+ * Current values of subscribed fields are sent right after subscription
+ */
+int notify_subscribe(modemd_client_thread_t* priv, uint16_t handle, modem_t* modem, const modem_subscribe_t* sub);
+
+/**
+ * @brief remove subscriptions of client for modem
+ * @param priv client
+ * @param handle modem handle in connection of client
+ */
+void notify_unsubscribe(modemd_client_thread_t* priv, uint16_t handle);
+
+/**
+ * @brief remove all subscriptions of client
+ * @param priv client
+ */
+void notify_unsubscribe_all(modemd_client_thread_t* priv);
+
+#endif /* __NOTIFY_H */
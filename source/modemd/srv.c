@@ -0,0 +1,581 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "rpc.h"
+#include "conf.h"
+#include "srv.h"
+#include "thread.h"
+#include "notify.h"
+#include "modem_int.h"
+#include "utils/pool.h"
+
+/*------------------------------------------------------------------------*/
+
+/** length of queue for pending connections */
+#define __LISTEN_BACKLOG 64
+
+/** events processed by one call of epoll_wait() */
+#define __EVENTS_MAX 32
+
+/** limit of requests waiting for worker */
+#define __POOL_QUEUE_MAX 256
+
+/** bytes received from client at once */
+#define __RECV_SIZE 0x10000
+
+/** seconds to wait for client reading responses and notifications */
+#define __SEND_TIMEOUT 1
+
+/*------------------------------------------------------------------------*/
+
+typedef struct srv_job_s
+{
+	modemd_client_thread_t* priv;
+
+	rpc_packet_t* p;
+
+	/** next free job */
+	struct srv_job_s* next;
+} srv_job_t;
+
+/*------------------------------------------------------------------------*/
+
+static int sock = -1;
+
+static int epoll_fd = -1;
+
+static volatile int terminate = 0;
+
+static modem_t* modem = NULL;
+
+/** pool for fast requests */
+static pool_t* pool = NULL;
+
+/** pool for requests which may block for a long time */
+static pool_t* pool_slow = NULL;
+
+/** lock for statistics of connections */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t connections = 0;
+
+static uint32_t connections_max = 0;
+
+static uint64_t accepted = 0;
+
+/** finished jobs kept for reuse, bounded by queues of pools */
+static srv_job_t* jobs_free = NULL;
+
+static pthread_mutex_t jobs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*------------------------------------------------------------------------*/
+
+static modemd_client_thread_t* srv_client_create(int sock)
+{
+	modemd_client_thread_t *res;
+
+	/* allocate memory for private data */
+	if(!(res = (modemd_client_thread_t*)malloc(sizeof(*res))))
+		return(NULL);
+
+	memset(res, 0, sizeof(*res));
+	res->sock = sock;
+	res->version = RPC_PROTO_VERSION_1;
+
+	/* reference of event loop */
+	res->refs = 1;
+
+	pthread_mutex_init(&res->lock, NULL);
+	pthread_mutex_init(&res->send_lock, NULL);
+
+	pthread_mutex_lock(&stats_lock);
+
+	++ accepted;
+
+	if(++ connections > connections_max)
+		connections_max = connections;
+
+	pthread_mutex_unlock(&stats_lock);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_client_ref(modemd_client_thread_t* priv)
+{
+	__atomic_add_fetch(&priv->refs, 1, __ATOMIC_RELAXED);
+}
+
+/*------------------------------------------------------------------------*/
+
+int srv_client_try_ref(modemd_client_thread_t* priv)
+{
+	int refs = __atomic_load_n(&priv->refs, __ATOMIC_RELAXED);
+
+	/* released client is being freed */
+	do
+	{
+		if(!refs)
+			return(-1);
+	}
+	while(!__atomic_compare_exchange_n(&priv->refs, &refs, refs + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+void srv_client_unref(modemd_client_thread_t* priv)
+{
+	if(__atomic_sub_fetch(&priv->refs, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	/* cleanup resources */
+	notify_unsubscribe_all(priv);
+
+	client_modems_close(priv);
+
+	close(priv->sock);
+
+	pthread_mutex_destroy(&priv->send_lock);
+	pthread_mutex_destroy(&priv->lock);
+
+	free(priv->in);
+	free(priv);
+
+	pthread_mutex_lock(&stats_lock);
+	-- connections;
+	pthread_mutex_unlock(&stats_lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_client_wait(modemd_client_thread_t* priv)
+{
+	struct epoll_event ev;
+
+	/* one packet is received per event */
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = priv;
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_MOD, priv->sock, &ev);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_client_close(modemd_client_thread_t* priv)
+{
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, priv->sock, NULL);
+
+	/* reference of event loop */
+	srv_client_unref(priv);
+}
+
+/*------------------------------------------------------------------------*/
+
+static srv_job_t* srv_job_get(void)
+{
+	srv_job_t* res;
+
+	pthread_mutex_lock(&jobs_lock);
+
+	if((res = jobs_free))
+		jobs_free = res->next;
+
+	pthread_mutex_unlock(&jobs_lock);
+
+	if(!res)
+		res = malloc(sizeof(*res));
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_job_put(srv_job_t* job)
+{
+	pthread_mutex_lock(&jobs_lock);
+
+	job->next = jobs_free;
+	jobs_free = job;
+
+	pthread_mutex_unlock(&jobs_lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_client_process(modemd_client_thread_t* priv);
+
+/*------------------------------------------------------------------------*/
+
+static void srv_job(void* prm)
+{
+	srv_job_t* job = prm;
+	int in_order;
+
+	/* legacy clients expect responses in order of queries */
+	in_order = job->p->version < RPC_PROTO_VERSION_3;
+
+	client_query(job->priv, job->p);
+
+	/* next query of legacy client is started after response */
+	if(in_order)
+		srv_client_process(job->priv);
+
+	srv_client_unref(job->priv);
+
+	srv_job_put(job);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief start query of client
+ * @param priv client
+ * @param p query, freed by this function
+ * @return non zero if query holds connection until its response
+ */
+static int srv_client_query(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	srv_job_t* job;
+	int in_order;
+
+	if(p->hdr.type != TYPE_QUERY || !(job = srv_job_get()))
+	{
+		rpc_free(p);
+
+		return(0);
+	}
+
+	job->priv = priv;
+	job->p = p;
+
+	in_order = p->version < RPC_PROTO_VERSION_3;
+
+	srv_client_ref(priv);
+
+	if(pool_add(rpc_function_is_slow(p->hdr.opcode) ? pool_slow : pool, srv_job, job))
+	{
+		/* server is overloaded, reply with NULL result */
+		client_reply(priv, p, NULL);
+
+		srv_client_unref(priv);
+
+		srv_job_put(job);
+
+		in_order = 0;
+	}
+
+	return(in_order);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief start queries received whole and wait for the next ones
+ * @param priv client
+ *
+ * Caller owns the buffer of client, ownership goes to the job of held query.
+ */
+static void srv_client_process(modemd_client_thread_t* priv)
+{
+	rpc_packet_t* p;
+	int res;
+
+	while((res = rpc_parse(priv->in + priv->in_pos, priv->in_len - priv->in_pos, &p)) > 0)
+	{
+		priv->in_pos += res;
+
+		/* clients with request id may send next query right now */
+		if(srv_client_query(priv, p))
+			return;
+	}
+
+	/* stream can't be framed after invalid packet */
+	if(res < 0)
+		srv_client_close(priv);
+	else
+		srv_client_wait(priv);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_client_read(modemd_client_thread_t* priv)
+{
+	uint32_t size = __RECV_SIZE;
+	uint8_t* buf;
+	int res;
+
+	/* bytes of started queries are dropped */
+	if(priv->in_pos)
+	{
+		memmove(priv->in, priv->in + priv->in_pos, priv->in_len - priv->in_pos);
+
+		priv->in_len -= priv->in_pos;
+		priv->in_pos = 0;
+	}
+
+	/* buffer of large query is not kept */
+	if(!priv->in_len && priv->in_size > __RECV_SIZE)
+	{
+		free(priv->in);
+
+		priv->in = NULL;
+		priv->in_size = 0;
+	}
+
+	/* message of SOCK_SEQPACKET is received whole */
+	if(conf.seqpacket && (res = recv(priv->sock, NULL, 0, MSG_PEEK | MSG_TRUNC | MSG_DONTWAIT)) > (int)size)
+		size = res;
+
+	if(priv->in_size - priv->in_len < size)
+	{
+		if(!(buf = realloc(priv->in, priv->in_len + size)))
+		{
+			srv_client_close(priv);
+
+			return;
+		}
+
+		priv->in = buf;
+		priv->in_size = priv->in_len + size;
+	}
+
+	if((res = recv(priv->sock, priv->in + priv->in_len, size, MSG_DONTWAIT)) < 0 &&
+		(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+	{
+		srv_client_wait(priv);
+
+		return;
+	}
+
+	if(res <= 0)
+	{
+		/* connection closed */
+		srv_client_close(priv);
+
+		return;
+	}
+
+	/* invalid message is dropped whole, framing of next ones is kept */
+	if(conf.seqpacket && rpc_parse(priv->in + priv->in_len, res, NULL) != res)
+	{
+		srv_client_wait(priv);
+
+		return;
+	}
+
+	priv->in_len += res;
+
+	srv_client_process(priv);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_accept(void)
+{
+	struct timeval tv = {__SEND_TIMEOUT, 0};
+	modemd_client_thread_t* priv;
+	struct epoll_event ev;
+	int sock_client;
+
+	if((sock_client = accept(sock, NULL, NULL)) < 0)
+		return;
+
+	/* client not reading responses can't block workers forever */
+	setsockopt(sock_client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	if(!(priv = srv_client_create(sock_client)))
+	{
+		perror(NULL);
+
+		close(sock_client);
+
+		return;
+	}
+
+	ev.events = EPOLLIN | EPOLLONESHOT;
+	ev.data.ptr = priv;
+
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock_client, &ev))
+		srv_client_unref(priv);
+}
+
+/*------------------------------------------------------------------------*/
+
+int srv_run(void)
+{
+	srv_job_t* job;
+	struct epoll_event events[__EVENTS_MAX];
+	struct sockaddr_un sa_bind;
+	struct epoll_event ev;
+	int res = 0;
+	int i, n;
+
+	/* creating socket server */
+	if((sock = socket(AF_LOCAL, conf.seqpacket ? SOCK_SEQPACKET : SOCK_STREAM, 0)) < 0)
+	{
+		res = -1;
+		goto err_socket;
+	}
+
+	/* filling address */
+	memset(&sa_bind, 0, sizeof(sa_bind));
+	sa_bind.sun_family = AF_LOCAL;
+	strncpy(sa_bind.sun_path, conf.sock_path, sizeof(sa_bind.sun_path) - 1);
+	sa_bind.sun_path[sizeof(sa_bind.sun_path) - 1] = 0;
+
+	if(bind(sock, (struct sockaddr *)&sa_bind, sizeof(sa_bind)))
+	{
+		res = -1;
+		goto err_bind;
+	}
+
+	if(listen(sock, __LISTEN_BACKLOG))
+	{
+		res = -1;
+		goto err_listen;
+	}
+
+	if((epoll_fd = epoll_create(__EVENTS_MAX)) < 0)
+	{
+		res = -1;
+		goto err_listen;
+	}
+
+	/* listening socket has NULL in event data */
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+
+	if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev))
+	{
+		res = -1;
+		goto err_pool;
+	}
+
+	/* creating workers */
+	pool = pool_create(conf.workers, __POOL_QUEUE_MAX);
+	pool_slow = pool_create(conf.workers_slow, __POOL_QUEUE_MAX);
+
+	if(!pool || !pool_slow)
+	{
+		res = -1;
+		goto err_pool;
+	}
+
+	if(notify_start())
+	{
+		res = -1;
+		goto err_pool;
+	}
+
+	if(*conf.port)
+		modem = modem_open_by_port(conf.port);
+
+	/* processing connections */
+	while(!terminate)
+	{
+		/* failed modem is opened again by the next client */
+		if(modem && modem_init_wait(modem, 0) == MODEM_INIT_FAILED)
+		{
+			printf("(WW) Opening of port %s failed\n", conf.port);
+
+			modem_close(modem);
+			modem = NULL;
+		}
+
+		if((n = epoll_wait(epoll_fd, events, __EVENTS_MAX, 1000)) < 0)
+			continue;
+
+		for(i = 0; i < n; ++ i)
+		{
+			if(events[i].data.ptr)
+				srv_client_read(events[i].data.ptr);
+			else
+				srv_accept();
+		}
+	}
+
+	notify_stop();
+
+	modem_close(modem);
+
+err_pool:
+	/* running requests are finished */
+	pool_destroy(pool_slow);
+	pool_destroy(pool);
+
+	pool = pool_slow = NULL;
+
+	while((job = jobs_free))
+	{
+		jobs_free = job->next;
+
+		free(job);
+	}
+
+	close(epoll_fd);
+
+err_listen:
+	unlink(conf.sock_path);
+
+err_bind:
+	close(sock);
+
+err_socket:
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+void srv_terminate(void)
+{
+	terminate = 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void srv_pool_stats(pool_t* pool, modemd_pool_stats_t* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if(!pool)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+
+	stats->threads = pool->nthreads;
+	stats->busy = pool->busy;
+	stats->queued = pool->queued;
+	stats->queued_max = pool->queued_max;
+	stats->done = pool->done;
+	stats->rejected = pool->rejected;
+
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*------------------------------------------------------------------------*/
+
+void srv_get_stats(modemd_stats_t* stats)
+{
+	pthread_mutex_lock(&stats_lock);
+
+	stats->connections = connections;
+	stats->connections_max = connections_max;
+	stats->accepted = accepted;
+
+	pthread_mutex_unlock(&stats_lock);
+
+	srv_pool_stats(pool, &stats->pool);
+	srv_pool_stats(pool_slow, &stats->pool_slow);
+}
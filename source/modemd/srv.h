@@ -0,0 +1,38 @@
+#ifndef __SRV_H
+#define __SRV_H
+
+#include <modem/types.h>
+
+#include "thread.h"
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief run socket server until srv_terminate() is called
+ * @return zero if successful
+ */
+int srv_run(void);
+
+/** stop socket server */
+void srv_terminate(void);
+
+/**
+ * @brief return statistics of socket server
+ * @param stats buffer for statistics
+ */
+void srv_get_stats(modemd_stats_t* stats);
+
+/**
+ * @brief take reference of client unless the last one is released
+ * @param priv client
+ * @return zero if successful, client must be released by srv_client_unref()
+ */
+int srv_client_try_ref(modemd_client_thread_t* priv);
+
+/**
+ * @brief release reference of client, client is freed with the last one
+ * @param priv client
+ */
+void srv_client_unref(modemd_client_thread_t* priv);
+
+#endif /* __SRV_H */
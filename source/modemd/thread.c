@@ -5,55 +5,178 @@
 #include <errno.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <sys/socket.h>
 
 #include "modem/modem.h"
 #include "rpc.h"
+#include "rpc_iface.h"
+#include "srv.h"
 #include "thread.h"
+#include "notify.h"
+#include "modem_int.h"
 #include "modem/types.h"
+#include "utils/clock.h"
 
 /*------------------------------------------------------------------------*/
 
-typedef rpc_packet_t* (*rpc_function_t)(modemd_client_thread_t*, rpc_packet_t*);
+/** operators in one chunk of operator scan result */
+#define __OPERS_CHUNK 8
+
+/** maximum of timers in statistics of scheduler */
+#define __SCHED_STATS_MAX 64
+
+/** maximum of states in statistics of registration */
+#define __REG_STATS_MAX 64
+
+/** maximum of values in statistics of polling */
+#define __POLL_STATS_MAX 16
+
+/** maximum of transitions in timeline of registration */
+#define __REG_TIMELINE_MAX 256
+
+/** maximum of retry decisions in trace */
+#define __REG_RETRIES_MAX 64
+
+/** maximum of probes and steps in statistics of watchdog */
+#define __WATCHDOG_STATS_MAX 16
+
+/** maximal waiting for opening of modem by one query, ms */
+#define __INIT_WAIT_MAX 10000
 
 /*------------------------------------------------------------------------*/
 
+typedef rpc_packet_t* (*rpc_function_t)(modemd_client_thread_t*, rpc_packet_t*);
+
+/** implementation of function from RPC_INTERFACE, zero if successful */
+typedef int (*rpc_impl_t)(modem_t* modem, const void* arg, void* res);
+
+/** times of calls with the same kind of result, updated atomically */
 typedef struct
 {
-	char name[0x100];
+	uint64_t calls;
 
-	rpc_function_t func;
-} rpc_function_info_t;
+	uint64_t time_us;
+
+	uint32_t time_max_us;
+
+	uint32_t hist[MODEMD_FUNC_HIST];
+} rpc_func_time_t;
+
+/*------------------------------------------------------------------------*/
+
+/** statistics of functions by opcode, calls with result and NULL result */
+static rpc_func_time_t rpc_func_times[RPC_OP_COUNT][2];
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_find_first_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+modem_t* client_modem_any(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
-	modem_find_first_next_t find_res;
-	rpc_packet_t *res = NULL;
+	modem_t* res = NULL;
+
+	pthread_mutex_lock(&priv->lock);
+
+	if(p->hdr.modem == 0)
+		res = priv->modem;
+	else if(p->hdr.modem <= __CLIENT_MODEMS_MAX)
+		res = priv->modems[p->hdr.modem - 1];
 
-	if((find_res.find = modem_find_first(&find_res.mi)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&find_res, sizeof(find_res));
+	pthread_mutex_unlock(&priv->lock);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_find_next_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+modem_t* client_modem(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
-	modem_find_first_next_t find_res;
-	rpc_packet_t *res = NULL;
+	modem_t* res;
+
+	/* functions of modem fail until it is opened */
+	if((res = client_modem_any(priv, p)) && modem_init_wait(res, 0) != MODEM_INIT_READY)
+		res = NULL;
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+void client_modems_close(modemd_client_thread_t* priv)
+{
+	int i;
+
+	for(i = 0; i < __CLIENT_MODEMS_MAX; ++ i)
+	{
+		if(!priv->modems[i])
+			continue;
+
+		modem_close(priv->modems[i]);
+		priv->modems[i] = NULL;
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+/** unpack argument, call implementation and pack result in format of query */
+static rpc_packet_t* rpc_serve(modemd_client_thread_t* priv, rpc_packet_t* p,
+	const rpc_type_t* arg_type, const rpc_type_t* res_type, rpc_impl_t impl)
+{
+	rpc_packet_t* res = NULL;
+	rpc_obj_t arg, obj;
+
+	if(rpc_get_obj(p, arg_type, &arg))
+		return(NULL);
+
+	memset(&obj, 0, res_type->size);
 
-	find_res.find = *((modem_find_t**)p->data);
+	if(!impl(client_modem(priv, p), &arg, &obj))
+		res = rpc_create_obj(TYPE_RESPONSE, p->hdr.opcode, res_type, &obj, p->hdr.flags & RPC_FLAG_COMPACT);
 
-	if((find_res.find = modem_find_next(find_res.find, &find_res.mi)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&find_res, sizeof(find_res));
+	rpc_obj_free(res_type, &obj);
+	rpc_obj_free(arg_type, &arg);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
+rpc_packet_t* rpc_hello_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	uint8_t version;
+
+	if(p->hdr.data_len != sizeof(version))
+		return(NULL);
+
+	/* use the latest version supported by both sides */
+	version = *p->data;
+
+	if(version > RPC_PROTO_VERSION)
+		version = RPC_PROTO_VERSION;
+
+	priv->version = version;
+
+	return(rpc_create(TYPE_RESPONSE, p->hdr.opcode, &version, sizeof(version)));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int modem_find_first_impl(modem_t* modem, const void* arg, void* res)
+{
+	modem_find_first_next_t* find_res = res;
+
+	return((find_res->find = modem_find_first(&find_res->mi)) ? 0 : -1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int modem_find_next_impl(modem_t* modem, const void* arg, void* res)
+{
+	modem_find_first_next_t* find_res = res;
+
+	return((find_res->find = modem_find_next(*(modem_find_t* const*)arg, &find_res->mi)) ? 0 : -1);
+}
+
+/*------------------------------------------------------------------------*/
+
 rpc_packet_t* modem_find_close_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
 	modem_find_t* find;
@@ -70,6 +193,8 @@ rpc_packet_t* modem_find_close_packet(modemd_client_thread_t* priv, rpc_packet_t
 rpc_packet_t* modem_open_by_port_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
 	rpc_packet_t *res = NULL;
+	modem_t* modem;
+	int i;
 	char port[0x100] = {0};
 	int path_len;
 
@@ -77,468 +202,828 @@ rpc_packet_t* modem_open_by_port_packet(modemd_client_thread_t* priv, rpc_packet
 	memcpy(port, p->data, path_len);
 	port[path_len] = 0;
 
-	if((priv->modem = modem_open_by_port(port)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)priv->modem, sizeof(*priv->modem));
+	if(!(modem = modem_open_by_port(port)))
+		return(NULL);
+
+	/* older client gets modem only when it is opened, slow worker is not held by missing device */
+	if(priv->version < RPC_PROTO_VERSION_7 && modem_init_wait(modem, __INIT_WAIT_MAX) != MODEM_INIT_READY)
+		goto err;
+
+	/* older client gets modem in layout of its version */
+	if(!(res = rpc_create_modem(p->hdr.opcode, modem, priv->version)))
+		goto err;
+
+	if(p->version < RPC_PROTO_VERSION_4)
+	{
+		/* legacy client works with one modem per connection */
+		priv->modem = modem;
+
+		return(res);
+	}
+
+	pthread_mutex_lock(&priv->lock);
+
+	for(i = 0; i < __CLIENT_MODEMS_MAX && priv->modems[i]; ++ i);
+
+	if(i < __CLIENT_MODEMS_MAX)
+		priv->modems[i] = modem;
+
+	pthread_mutex_unlock(&priv->lock);
+
+	if(i == __CLIENT_MODEMS_MAX)
+	{
+		printf("(EE) Too many modems opened by client\n");
+
+		goto err_res;
+	}
+
+	/* handle of the modem in this connection */
+	res->hdr.modem = i + 1;
 
 	return(res);
+
+err_res:
+	rpc_free(res);
+
+err:
+	modem_close(modem);
+
+	return(NULL);
 }
 
 /*------------------------------------------------------------------------*/
 
 rpc_packet_t* modem_close_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
-	if(!priv->modem)
+	modem_t* modem = NULL;
+
+	pthread_mutex_lock(&priv->lock);
+
+	if(p->hdr.modem == 0)
+	{
+		modem = priv->modem;
+		priv->modem = NULL;
+	}
+	else if(p->hdr.modem <= __CLIENT_MODEMS_MAX)
+	{
+		modem = priv->modems[p->hdr.modem - 1];
+		priv->modems[p->hdr.modem - 1] = NULL;
+	}
+
+	pthread_mutex_unlock(&priv->lock);
+
+	if(!modem)
 		return(NULL);
 
-	modem_close(priv->modem);
+	notify_unsubscribe(priv, p->hdr.modem);
 
-	return(rpc_create(TYPE_RESPONSE, p->func, NULL, 0));
+	modem_close(modem);
+
+	return(rpc_create(TYPE_RESPONSE, p->hdr.opcode, NULL, 0));
 }
 
 /*------------------------------------------------------------------------*/
 
 rpc_packet_t* modem_conf_reload_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
-	if(!priv->modem)
+	modem_t* modem;
+
+	if(!(modem = client_modem(priv, p)))
 		return(NULL);
 
-	modem_conf_reload(priv->modem);
+	modem_conf_reload(modem);
 
-	return(rpc_create(TYPE_RESPONSE, p->func, NULL, 0));
+	return(rpc_create(TYPE_RESPONSE, p->hdr.opcode, NULL, 0));
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_imei_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_imei_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
 	char imei[0x100];
 
-	if(!priv->modem)
-		return(NULL);
+	if(!modem)
+		return(-1);
 
-	if(modem_get_imei(priv->modem, imei, sizeof(imei)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)imei, strlen(imei));
+	/* empty string is a NULL result as before */
+	if(!modem_get_imei(modem, imei, sizeof(imei)) || !*imei)
+		return(-1);
 
-	return(res);
+	return((*(char**)res = strdup(imei)) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_imsi_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_imsi_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
 	char imsi[0x100];
 
-	if(!priv->modem)
-		return(NULL);
+	if(!modem)
+		return(-1);
 
-	if(modem_get_imsi(priv->modem, imsi, sizeof(imsi)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)imsi, strlen(imsi));
+	/* empty string is a NULL result as before */
+	if(!modem_get_imsi(modem, imsi, sizeof(imsi)) || !*imsi)
+		return(-1);
 
-	return(res);
+	return((*(char**)res = strdup(imsi)) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_signal_quality_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_signal_quality_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	modem_signal_quality_t sq;
-
-	if(!priv->modem)
-		return(NULL);
+	if(!modem)
+		return(-1);
 
 	/* if signal present */
-	if(!modem_get_signal_quality(priv->modem, &sq))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&sq, sizeof(sq));
-
-	return(res);
+	return(modem_get_signal_quality(modem, res));
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_network_time_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_network_time_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	time_t t;
-
-	if(!priv->modem)
-		return(NULL);
+	if(!modem)
+		return(-1);
 
-	if((t = modem_get_network_time(priv->modem)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&t, sizeof(t));
-
-	return(res);
+	return((*(time_t*)res = modem_get_network_time(modem)) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_operator_name_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_operator_name_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
 	char oper[0x100];
 
-	if(!priv->modem)
-		return(NULL);
+	if(!modem)
+		return(-1);
 
-	if(modem_get_operator_name(priv->modem, oper, sizeof(oper)))
-		res = rpc_create(TYPE_RESPONSE, p->func,
-			(uint8_t*)oper, strlen(oper)
-		);
+	/* empty string is a NULL result as before */
+	if(!modem_get_operator_name(modem, oper, sizeof(oper)) || !*oper)
+		return(-1);
 
-	return(res);
+	return((*(char**)res = strdup(oper)) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_network_registration_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_network_registration_impl(modem_t* modem, const void* arg, void* res)
 {
-	modem_network_reg_t nr;;
+	if(!modem)
+		return(-1);
 
-	if(!priv->modem)
-		return(NULL);
-
-	nr = modem_network_registration(priv->modem);
+	*(modem_network_reg_t*)res = modem_network_registration(modem);
 
-	return(rpc_create(TYPE_RESPONSE, p->func, &nr, sizeof(nr)));
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_network_type_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_network_type_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
 	char nt[0x100];
 
-	if(!priv->modem)
-		return(NULL);
+	if(!modem)
+		return(-1);
 
-	if(modem_get_network_type(priv->modem, nt, sizeof(nt)))
-		res = rpc_create(TYPE_RESPONSE, p->func,
-			(uint8_t*)nt, strlen(nt)
-		);
+	/* empty string is a NULL result as before */
+	if(!modem_get_network_type(modem, nt, sizeof(nt)) || !*nt)
+		return(-1);
 
-	return(res);
+	return((*(char**)res = strdup(nt)) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
 rpc_packet_t* modem_change_pin_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
+	modem_t* modem;
 	modem_change_pin_t *pc = (modem_change_pin_t*)p->data;
 	rpc_packet_t *res = NULL;
 
-	if(!priv->modem)
+	if(!(modem = client_modem(priv, p)))
 		return(NULL);
 
 	if(p->hdr.data_len != sizeof(*pc))
 		return(res);
 
-	if(!modem_change_pin(priv->modem, pc->old_pin, pc->new_pin))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)pc, sizeof(*pc));
+	if(!modem_change_pin(modem, pc->old_pin, pc->new_pin))
+		res = rpc_create(TYPE_RESPONSE, p->hdr.opcode, (uint8_t*)pc, sizeof(*pc));
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_fw_version_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_fw_version_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	modem_fw_ver_t fw_ver;
+	if(!modem)
+		return(-1);
 
-	if(!priv->modem)
-		return(NULL);
+	return(modem_get_fw_version(modem, res) ? 0 : -1);
+}
 
-	if(modem_get_fw_version(priv->modem, &fw_ver))
-		res = rpc_create(TYPE_RESPONSE, p->func,
-			(uint8_t*)&fw_ver, sizeof(fw_ver));
+/*------------------------------------------------------------------------*/
 
-	return(res);
+static int modem_get_info_impl(modem_t* modem, const void* arg, void* res)
+{
+	if(!modem)
+		return(-1);
+
+	return(modem_get_info(modem, res) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_info_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+rpc_packet_t* modem_operator_scan_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
 {
+	modem_t* modem;
 	rpc_packet_t *res = NULL;
-	usb_device_info_t mi;
+	modem_oper_t *opers = NULL;
+	int nopers = 0, i = 0;
 
-	if(!priv->modem)
+	if(!(modem = client_modem(priv, p)))
 		return(NULL);
 
-	if(modem_get_info(priv->modem, &mi))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&mi, sizeof(mi));
+	if((nopers = modem_operator_scan(modem, &opers)) <= 0)
+		goto exit;
+
+	/* new clients get operators in chunks, the last ones are in the result */
+	for(i = 0; nopers - i > __OPERS_CHUNK; i += __OPERS_CHUNK)
+	{
+		if(client_reply_chunk(priv, p, opers + i, sizeof(modem_oper_t) * __OPERS_CHUNK))
+			break;
+	}
+
+	res = rpc_create(TYPE_RESPONSE, p->hdr.opcode, (uint8_t*)(opers + i), sizeof(modem_oper_t) * (nopers - i));
+
+exit:
+	free(opers);
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_operator_scan_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_at_command_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	modem_oper_t *opers;
-	int nopers = 0;
+	if(!modem)
+		return(-1);
 
-	if(!priv->modem)
-		return(NULL);
+	/* reply is freed with result */
+	return((*(char**)res = modem_at_command(modem, *(char* const*)arg)) ? 0 : -1);
+}
 
-	if((nopers = modem_operator_scan(priv->modem, &opers)) > 0)
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)opers, sizeof(modem_oper_t) * nopers);
+/*------------------------------------------------------------------------*/
 
-	free(opers);
+static int modem_get_cell_id_impl(modem_t* modem, const void* arg, void* res)
+{
+	if(!modem)
+		return(-1);
 
-	return(res);
+	/* cutting Cell ID number from the reply */
+	return((*(int32_t*)res = modem_get_cell_id(modem)) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_at_command_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_status_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	char *reply;
+	if(!modem)
+		return(-1);
 
-	if(!priv->modem)
+	modem_get_status(modem, res);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* modem_subscribe_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	modem_subscribe_t* sub;
+	modem_t* modem;
+	uint32_t mask;
+
+	/* notifications are routed by modem handle */
+	if(p->version < RPC_PROTO_VERSION_4 || p->hdr.data_len != sizeof(modem_subscribe_t))
 		return(NULL);
 
-	if((reply = modem_at_command(priv->modem, (char*)p->data)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)reply, strlen(reply));
+	/* opening of modem may be waited for by events */
+	if(!(modem = client_modem_any(priv, p)))
+		return(NULL);
 
-	free(reply);
+	sub = (modem_subscribe_t*)p->data;
 
-	return(res);
+	if(notify_subscribe(priv, p->hdr.modem, modem, sub))
+		return(NULL);
+
+	/* reply with accepted events */
+	mask = sub->mask & MODEM_EVENT_ALL;
+
+	return(rpc_create(TYPE_RESPONSE, p->hdr.opcode, (uint8_t*)&mask, sizeof(mask)));
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* modem_event_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	/* notifications are sent only by server */
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int modem_operator_scan_start_impl(modem_t* modem, const void* arg, void* res)
+{
+	if(!modem)
+		return(-1);
+
+	*(int32_t*)res = modem_operator_scan_start(modem, *(char* const*)arg);
+
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_cell_id_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_operator_scan_is_running_impl(modem_t* modem, const void* arg, void* res)
 {
+	if(!modem)
+		return(-1);
+
+	*(int8_t*)res = modem_operator_scan_is_running(modem);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int modem_get_last_error_impl(modem_t* modem, const void* arg, void* res)
+{
+	if(!modem)
+		return(-1);
+
+	*(int32_t*)res = modem_get_last_error(modem);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* modem_set_wwan_profile_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	modem_t* modem;
 	rpc_packet_t *res = NULL;
-	int32_t cell_id;
 
-	if(!priv->modem)
+	if(!(modem = client_modem(priv, p)))
 		return(NULL);
 
-	/* cutting Cell ID number from the reply */
-	if((cell_id = modem_get_cell_id(priv->modem)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&cell_id, sizeof(cell_id));
+	if(!modem_set_wwan_profile(modem, (modem_data_profile_t*)p->data))
+		res = rpc_create(TYPE_RESPONSE, p->hdr.opcode, (uint8_t*)p, sizeof(*p));
 
 	return(res);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_operator_scan_start_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_start_wwan_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t* res = NULL;
-	int scan_res;
+	if(!modem)
+		return(-1);
 
-	if(!priv->modem)
-		return(NULL);
+	return(*(int32_t*)res = modem_start_wwan(modem));
+}
 
-	scan_res = modem_operator_scan_start(priv->modem, (char*)p->data);
-	res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&scan_res, sizeof(scan_res));
+/*------------------------------------------------------------------------*/
 
-	return(res);
+static int modem_stop_wwan_impl(modem_t* modem, const void* arg, void* res)
+{
+	if(!modem)
+		return(-1);
+
+	return(*(int32_t*)res = modem_stop_wwan(modem));
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_operator_scan_is_running_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_state_wwan_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	int8_t scan_res;
+	if(!modem)
+		return(-1);
 
-	if(!priv->modem)
-		return(NULL);
+	*(modem_state_wwan_t*)res = modem_state_wwan(modem);
 
-	scan_res = modem_operator_scan_is_running(priv->modem);
+	return(0);
+}
 
-	res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&scan_res, sizeof(scan_res));
+/*------------------------------------------------------------------------*/
 
-	return(res);
+static int modem_ussd_cmd_impl(modem_t* modem, const void* arg, void* res)
+{
+	if(!modem)
+		return(-1);
+
+	/* reply is freed with result */
+	return((*(char**)res = modem_ussd_cmd(modem, *(char* const*)arg)) ? 0 : -1);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_get_last_error_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modemd_stats_impl(modem_t* modem, const void* arg, void* res)
 {
-	int32_t err;
+	srv_get_stats(res);
 
-	if(!priv->modem)
-		return(NULL);
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
 
-	err = modem_get_last_error(priv->modem);
+static void rpc_func_time_get(const rpc_func_time_t* t, modemd_func_time_t* res)
+{
+	int i;
+
+	res->calls = __atomic_load_n(&t->calls, __ATOMIC_RELAXED);
+	res->time_us = __atomic_load_n(&t->time_us, __ATOMIC_RELAXED);
+	res->time_max_us = __atomic_load_n(&t->time_max_us, __ATOMIC_RELAXED);
 
-	return
-	(
-		rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&err, sizeof(err))
-	);
+	for(i = 0; i < MODEMD_FUNC_HIST; ++ i)
+		res->hist[i] = __atomic_load_n(&t->hist[i], __ATOMIC_RELAXED);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_set_wwan_profile_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modemd_func_stats_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
+	rpc_array_t* a = res;
+	modemd_func_stats_t* stats;
+	int i;
 
-	if(!priv->modem)
-		return(NULL);
+	if(!(stats = a->items = calloc(RPC_OP_COUNT, sizeof(*stats))))
+		return(-1);
 
-	if(!modem_set_wwan_profile(priv->modem, (modem_data_profile_t*)p->data))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)p, sizeof(*p));
+	for(i = 0; i < RPC_OP_COUNT; ++ i)
+	{
+		/* only called functions */
+		if(!rpc_func_times[i][0].calls && !rpc_func_times[i][1].calls)
+			continue;
 
-	return(res);
+		snprintf(stats[a->count].name, sizeof(stats[a->count].name), "%s", rpc_func_name(i));
+
+		rpc_func_time_get(&rpc_func_times[i][0], &stats[a->count].ok);
+		rpc_func_time_get(&rpc_func_times[i][1], &stats[a->count].null);
+
+		++ a->count;
+	}
+
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_start_wwan_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modemd_sched_stats_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	int32_t result;
+	rpc_array_t* a = res;
 
-	if(!priv->modem)
-		return(NULL);
+	if(!(a->items = calloc(__SCHED_STATS_MAX, sizeof(modemd_sched_stats_t))))
+		return(-1);
 
-	if(!(result = modem_start_wwan(priv->modem)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&result, sizeof(result));
+	a->count = modem_sched_stats(a->items, __SCHED_STATS_MAX);
 
-	return(res);
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_stop_wwan_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_reg_stats_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	int32_t result;
+	rpc_array_t* a = res;
+	int n;
 
-	if(!priv->modem)
-		return(NULL);
+	if(!modem || !(a->items = calloc(__REG_STATS_MAX, sizeof(modem_reg_state_stats_t))))
+		return(-1);
 
-	if(!(result = modem_stop_wwan(priv->modem)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&result, sizeof(result));
+	if((n = modem_reg_stats(modem, a->items, __REG_STATS_MAX)) < 0)
+		return(-1);
 
-	return(res);
+	a->count = n;
+
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_state_wwan_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_poll_stats_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	modem_state_wwan_t state;
+	rpc_array_t* a = res;
+	int n;
 
-	if(!priv->modem)
-		return(NULL);
+	if(!modem || !(a->items = calloc(__POLL_STATS_MAX, sizeof(modem_poll_stats_t))))
+		return(-1);
 
-	state = modem_state_wwan(priv->modem);
-	res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)&state, sizeof(state));
+	if((n = modem_poll_stats(modem, a->items, __POLL_STATS_MAX)) < 0)
+		return(-1);
 
-	return(res);
+	a->count = n;
+
+	return(0);
 }
 
 /*------------------------------------------------------------------------*/
 
-rpc_packet_t* modem_ussd_cmd_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+static int modem_get_reg_timeline_impl(modem_t* modem, const void* arg, void* res)
 {
-	rpc_packet_t *res = NULL;
-	char *reply;
+	rpc_array_t* a = res;
+	int n;
+
+	if(!modem || !(a->items = calloc(__REG_TIMELINE_MAX, sizeof(modem_reg_timeline_t))))
+		return(-1);
+
+	if((n = modem_reg_timeline(modem, a->items, __REG_TIMELINE_MAX)) < 0)
+		return(-1);
+
+	a->count = n;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int modem_get_watchdog_stats_impl(modem_t* modem, const void* arg, void* res)
+{
+	rpc_array_t* a = res;
+	int n;
+
+	if(!modem || !(a->items = calloc(__WATCHDOG_STATS_MAX, sizeof(modem_watchdog_stats_t))))
+		return(-1);
+
+	if((n = modem_watchdog_stats(modem, a->items, __WATCHDOG_STATS_MAX)) < 0)
+		return(-1);
+
+	a->count = n;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int modem_get_reg_retries_impl(modem_t* modem, const void* arg, void* res)
+{
+	rpc_array_t* a = res;
+	int n;
+
+	if(!modem || !(a->items = calloc(__REG_RETRIES_MAX, sizeof(modem_reg_retry_t))))
+		return(-1);
+
+	if((n = modem_reg_retries(modem, a->items, __REG_RETRIES_MAX)) < 0)
+		return(-1);
+
+	a->count = n;
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+#define __RPC_SERVE(name, arg_t, res_t)										\
+	rpc_packet_t* name##_packet(modemd_client_thread_t* priv, rpc_packet_t* p)	\
+	{																			\
+		return(rpc_serve(priv, p, &rpc_type_##arg_t, &rpc_type_##res_t, name##_impl));	\
+	}
+
+RPC_INTERFACE(__RPC_SERVE)
+
+#undef __RPC_SERVE
+
+/*------------------------------------------------------------------------*/
+
+rpc_packet_t* modem_get_init_state_packet(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	modem_init_state_t state;
+	uint32_t wait_ms = 0;
+	modem_t* modem;
 
-	if(!priv->modem)
+	if(!(modem = client_modem_any(priv, p)))
 		return(NULL);
 
-	if((reply = modem_ussd_cmd(priv->modem, (char*)p->data)))
-		res = rpc_create(TYPE_RESPONSE, p->func, (uint8_t*)reply, strlen(reply));
+	/* optional time of waiting for the end of opening */
+	if(p->hdr.data_len == sizeof(wait_ms))
+		memcpy(&wait_ms, p->data, sizeof(wait_ms));
 
-	free(reply);
+	if(wait_ms > __INIT_WAIT_MAX)
+		wait_ms = __INIT_WAIT_MAX;
 
-	return(res);
+	state = modem_init_wait(modem, wait_ms);
+
+	return(rpc_create(TYPE_RESPONSE, p->hdr.opcode, (uint8_t*)&state, sizeof(state)));
 }
 
 /*------------------------------------------------------------------------*/
 
-const rpc_function_info_t rpc_functions[] = {
-	{"modem_find_first", modem_find_first_packet},
-	{"modem_find_next", modem_find_next_packet},
-	{"modem_open_by_port", modem_open_by_port_packet},
-	{"modem_close", modem_close_packet},
-	{"modem_get_info", modem_get_info_packet},
-	{"modem_get_last_error", modem_get_last_error_packet},
-	{"modem_get_imei", modem_get_imei_packet},
-	{"modem_change_pin", modem_change_pin_packet},
-	{"modem_get_fw_version", modem_get_fw_version_packet},
-	{"modem_network_registration", modem_network_registration_packet},
-	{"modem_get_imsi", modem_get_imsi_packet},
-	{"modem_operator_scan_start", modem_operator_scan_start_packet},
-	{"modem_operator_scan_is_running", modem_operator_scan_is_running_packet},
-	{"modem_get_signal_quality", modem_get_signal_quality_packet},
-	{"modem_operator_scan", modem_operator_scan_packet},
-	{"modem_at_command", modem_at_command_packet},
-	{"modem_get_network_time", modem_get_network_time_packet},
-	{"modem_get_operator_name", modem_get_operator_name_packet},
-	{"modem_get_network_type", modem_get_network_type_packet},
-	{"modem_get_cell_id", modem_get_cell_id_packet},
-	{"modem_conf_reload", modem_conf_reload_packet},
-	{"modem_set_wwan_profile", modem_set_wwan_profile_packet},
-	{"modem_start_wwan", modem_start_wwan_packet},
-	{"modem_stop_wwan", modem_stop_wwan_packet},
-	{"modem_state_wwan", modem_state_wwan_packet},
-	{"modem_ussd_cmd", modem_ussd_cmd_packet},
-	{{0, 0, 0}},
+static const rpc_function_t rpc_functions[RPC_OP_COUNT] = {
+#define __RPC_HANDLER(name) [RPC_OP_##name] = name##_packet,
+	RPC_FUNCTIONS(__RPC_HANDLER)
+#undef __RPC_HANDLER
 };
 
 /*------------------------------------------------------------------------*/
 
-void* ThreadWrapper(void* prm)
+int rpc_function_is_slow(uint16_t opcode)
+{
+	static const uint8_t rpc_slow[RPC_OP_COUNT] = {
+		[RPC_OP_modem_open_by_port] = 1,
+		[RPC_OP_modem_close] = 1,
+		[RPC_OP_modem_conf_reload] = 1,
+		[RPC_OP_modem_change_pin] = 1,
+		[RPC_OP_modem_operator_scan] = 1,
+		[RPC_OP_modem_at_command] = 1,
+		[RPC_OP_modem_ussd_cmd] = 1,
+		[RPC_OP_modem_set_wwan_profile] = 1,
+		[RPC_OP_modem_start_wwan] = 1,
+		[RPC_OP_modem_stop_wwan] = 1,
+		[RPC_OP_modem_get_init_state] = 1,
+	};
+
+	return(opcode < RPC_OP_COUNT && rpc_slow[opcode]);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** account time of handler to statistics of function */
+static void rpc_func_time_add(uint16_t opcode, int null, uint64_t time_us)
+{
+	rpc_func_time_t* t = &rpc_func_times[opcode][null];
+	uint32_t max;
+	int i;
+
+	if(time_us > UINT32_MAX)
+		time_us = UINT32_MAX;
+
+	/* bucket by power of two */
+	for(i = 0; i < MODEMD_FUNC_HIST - 1 && time_us >= (1ULL << i); ++ i);
+
+	__atomic_add_fetch(&t->calls, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&t->time_us, time_us, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&t->hist[i], 1, __ATOMIC_RELAXED);
+
+	max = __atomic_load_n(&t->time_max_us, __ATOMIC_RELAXED);
+
+	while(time_us > max && !__atomic_compare_exchange_n(&t->time_max_us, &max, time_us, 1,
+		__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/*------------------------------------------------------------------------*/
+
+void client_query(modemd_client_thread_t* priv, rpc_packet_t* p_in)
 {
-	const rpc_function_info_t *rpc_func;
-	modemd_client_thread_t* priv = prm;
-	rpc_packet_t *p_in = NULL, *p_out;
+	rpc_packet_t *p_out = NULL;
+	uint64_t start;
+
+	rpc_print(p_in);
 
-	while(!priv->terminate && (p_in = rpc_recv(priv->sock)))
+	/* execute function */
+	if(p_in->hdr.opcode < RPC_OP_COUNT)
 	{
-		rpc_print(p_in);
+		start = clock_us();
 
-		if(p_in->hdr.type != TYPE_QUERY)
-		{
-			rpc_free(p_in);
-			continue;
-		}
+		p_out = rpc_functions[p_in->hdr.opcode](priv, p_in);
+
+		rpc_func_time_add(p_in->hdr.opcode, !p_out || !p_out->hdr.data_len, clock_us() - start);
+	}
+
+	client_reply(priv, p_in, p_out);
+}
+
+/*------------------------------------------------------------------------*/
+
+/**
+ * @brief send packet to the client, lock for sending must be held
+ * @param priv client
+ * @param p packet
+ * @return zero if successful
+ *
+ * Socket timed out in the middle of frame is shut down and never written
+ * again, event loop closes the client on end of stream.
+ */
+static int client_send(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	if(priv->broken)
+		return(-1);
+
+	if(rpc_send(priv->sock, p) >= 0)
+		return(0);
+
+	priv->broken = 1;
 
-		rpc_func = rpc_functions;
+	shutdown(priv->sock, SHUT_RDWR);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void client_reply(modemd_client_thread_t* priv, rpc_packet_t* p_in, rpc_packet_t* p_out)
+{
+	if(p_out && p_in->version < RPC_PROTO_VERSION_5 && p_out->hdr.data_len > RPC_DATA_MAX_V4)
+	{
+		/* result can't be framed for old client, it must not wait forever */
+		printf("(WW) Result of %u is too long for protocol version %u\n", p_in->hdr.opcode, p_in->version);
+
+		rpc_free(p_out);
 		p_out = NULL;
+	}
 
-		while(rpc_func->func)
-		{
-			if(strcmp(rpc_func->name, p_in->func) == 0)
-			{
-				/* execute function */
-				p_out = rpc_func->func(priv, p_in);
+	if(!p_out)
+		/* function failed, create NULL result */
+		p_out = rpc_create(TYPE_RESPONSE, p_in->hdr.opcode, NULL, 0);
 
-				break;
-			}
+	if(p_out)
+	{
+		/* reply with the same framing and id as query */
+		p_out->version = p_in->version;
+		p_out->hdr.id = p_in->hdr.id;
 
-			++ rpc_func;
+		if(p_in->func)
+		{
+			/* legacy client, reply with the same function name */
+			p_out->func = p_in->func;
+			p_in->func = NULL;
 		}
 
-		if(!p_out)
-			/* function failed, create NULL result */
-			p_out = rpc_create(TYPE_RESPONSE, p_in->func, NULL, 0);
+		/* responses of parallel requests must not be mixed */
+		pthread_mutex_lock(&priv->send_lock);
+		client_send(priv, p_out);
+		pthread_mutex_unlock(&priv->send_lock);
 
-		rpc_send(priv->sock, p_out);
 		rpc_print(p_out);
 		rpc_free(p_out);
-		rpc_free(p_in);
 	}
 
-	/* cleanup resources */
-	close(priv->sock);
+	rpc_free(p_in);
+}
 
-	free(priv);
+/*------------------------------------------------------------------------*/
 
-	return(NULL);
+int client_reply_chunk(modemd_client_thread_t* priv, rpc_packet_t* p_in, const void* data, uint32_t len)
+{
+	rpc_packet_t* p;
+	int res;
+
+	/* chunks are not supported by old clients */
+	if(p_in->version < RPC_PROTO_VERSION_5)
+		return(-1);
+
+	/* chunk is sent before return, so data is not copied */
+	if(!(p = rpc_create_ref(TYPE_RESPONSE, p_in->hdr.opcode, data, len)))
+		return(-1);
+
+	p->version = p_in->version;
+	p->hdr.id = p_in->hdr.id;
+	p->hdr.modem = p_in->hdr.modem;
+	p->hdr.flags = RPC_FLAG_MORE;
+
+	pthread_mutex_lock(&priv->send_lock);
+	res = client_send(priv, p);
+	pthread_mutex_unlock(&priv->send_lock);
+
+	rpc_print(p);
+	rpc_free(p);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+int client_push(modemd_client_thread_t* priv, rpc_packet_t* p)
+{
+	uint32_t sent = 0;
+	int res = 1;
+
+	p->version = priv->version;
+
+	/* response being sent is not waited for, packet is sent later */
+	if(pthread_mutex_trylock(&priv->send_lock))
+		goto exit;
+
+	if(priv->broken)
+		res = -1;
+	else if((res = rpc_send_nb(priv->sock, p, &sent)) == 1)
+		res = 0;
+	else
+	{
+		/* full socket may hold part of frame, client is dropped */
+		priv->broken = 1;
+
+		shutdown(priv->sock, SHUT_RDWR);
+
+		res = -1;
+	}
+
+	pthread_mutex_unlock(&priv->send_lock);
+
+	rpc_print(p);
+
+exit:
+	rpc_free(p);
+
+	return(res);
 }
@@ -1,21 +1,122 @@
 #ifndef __THREAD_H
 #define __THREAD_H
 
+#include <pthread.h>
+
 #include <modem/modem.h>
 
+#include "rpc.h"
+
+/*------------------------------------------------------------------------*/
+
+/** maximum number of modems opened in one connection */
+#define __CLIENT_MODEMS_MAX 16
+
 /*------------------------------------------------------------------------*/
 
 typedef struct
 {
 	int sock;
 
+	/** negotiated version of protocol */
+	uint8_t version;
+
+	/** modem of legacy client */
 	modem_t* modem;
 
-	int terminate;
+	/** modems opened by handle, handle is index + 1 */
+	modem_t* modems[__CLIENT_MODEMS_MAX];
+
+	/** references of event loop and running requests, changed atomically */
+	int refs;
+
+	/** lock for opened modems */
+	pthread_mutex_t lock;
+
+	/** lock for sending of responses and notifications */
+	pthread_mutex_t send_lock;
+
+	/** sending failed, socket is shut down, guarded by send_lock */
+	int broken;
+
+	/** received bytes, owned by event loop or by the job of legacy client */
+	uint8_t* in;
+
+	/** length of received bytes */
+	uint32_t in_len;
+
+	/** length of bytes of queries already started */
+	uint32_t in_pos;
+
+	/** allocated size of buffer */
+	uint32_t in_size;
 } modemd_client_thread_t;
 
 /*------------------------------------------------------------------------*/
 
-void* ThreadWrapper(void* prm);
+/**
+ * @brief find opened modem addressed by query
+ * @param priv client
+ * @param p query
+ * @return modem or NULL if handle is invalid or modem is not opened yet
+ */
+modem_t* client_modem(modemd_client_thread_t* priv, rpc_packet_t* p);
+
+/**
+ * @brief find modem addressed by query in any state of opening
+ * @param priv client
+ * @param p query
+ * @return modem or NULL if handle is invalid
+ */
+modem_t* client_modem_any(modemd_client_thread_t* priv, rpc_packet_t* p);
+
+/**
+ * @brief close all modems opened by handle
+ * @param priv client
+ */
+void client_modems_close(modemd_client_thread_t* priv);
+
+/**
+ * @brief check if function may block for a long time
+ * @param opcode function opcode
+ * @return non zero if function must be executed in pool of slow requests
+ */
+int rpc_function_is_slow(uint16_t opcode);
+
+/**
+ * @brief execute query and send response to the client
+ * @param priv client
+ * @param p_in query, freed by this function
+ */
+void client_query(modemd_client_thread_t* priv, rpc_packet_t* p_in);
+
+/**
+ * @brief send response to the client
+ * @param priv client
+ * @param p_in query, freed by this function
+ * @param p_out response, NULL result is sent if NULL
+ */
+void client_reply(modemd_client_thread_t* priv, rpc_packet_t* p_in, rpc_packet_t* p_out);
+
+/**
+ * @brief send part of response before the result
+ * @param priv client
+ * @param p_in query
+ * @param data chunk of response
+ * @param len length of chunk
+ * @return zero if successful, non zero if client does not support chunks
+ *
+ * Client joins chunks and the result sent by client_reply()
+ */
+int client_reply_chunk(modemd_client_thread_t* priv, rpc_packet_t* p_in, const void* data, uint32_t len);
+
+/**
+ * @brief send packet to the client without query and without blocking
+ * @param priv client
+ * @param p packet, freed by this function
+ * @return zero if successful, 1 if client is sending now and nothing is
+ * written, -1 if failed and client is shut down
+ */
+int client_push(modemd_client_thread_t* priv, rpc_packet_t* p);
 
 #endif /* __THREAD_H */
@@ -0,0 +1,804 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "modem/types.h"
+
+#include "rpc.h"
+#include "rpc_client.h"
+#include "utils/clock.h"
+
+#include "sim.h"
+
+/*------------------------------------------------------------------------*/
+
+/* default names */
+#define MODEMD_NAME			"modemd"
+#define MODEMD_BENCH_NAME	"modemd_bench"
+
+/** buckets of histogram per power of two */
+#define __HIST_SUB 4
+
+/** buckets of histogram, enough for 2^40 us */
+#define __HIST_BUCKETS (40 * __HIST_SUB)
+
+/** time to wait for registration of modem, s */
+#define __READY_TIMEOUT 30
+
+/*------------------------------------------------------------------------*/
+
+const char help[] =
+	"Usage:\n"
+	MODEMD_BENCH_NAME " [-s SOCKET] [-c NUM] [-j NUM] [-t SEC] [-r RATE] [-m MIX] [-p PORT] [-a CMD]\n"
+	MODEMD_BENCH_NAME " -E DIR [-L MS] ...\n\n"
+	"Keys:\n"
+	"-h - show this help\n"
+	"-s - file socket path (default: /var/run/" MODEMD_NAME ".ctl)\n"
+	"-c - client connections (default: 4)\n"
+	"-j - threads per connection (default: 1)\n"
+	"-t - duration of test, seconds (default: 10)\n"
+	"-r - target rate of all threads, requests per second (default: 0 - unlimited)\n"
+	"-m - mix of calls as NAME=WEIGHT,.. (default: status=80,at=10,open=5,find=5)\n"
+	"     calls: stats, find, status, sq, imei, at, open\n"
+	"-p - modem port, for example 1-1 (default: 1-1 with -E)\n"
+	"-a - AT command of call 'at' (default: AT+CSQ)\n"
+	"-E - simulate modem, fake sysfs tree is created in DIR for " MODEMD_NAME " -r DIR\n"
+	"-L - delay of simulated modem replies, ms (default: 0)\n\n"
+	"Examples:\n"
+	MODEMD_NAME " -s /tmp/m.ctl -r /tmp/sim &\n"
+	MODEMD_BENCH_NAME " -s /tmp/m.ctl -E /tmp/sim -c 8 -t 5\n"
+	MODEMD_BENCH_NAME " -s /tmp/m.ctl -m stats=1 -r 10000";
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	uint64_t count;
+
+	uint64_t errors;
+
+	/** latencies, us */
+	uint64_t hist[__HIST_BUCKETS];
+
+	uint64_t max;
+} bench_stat_t;
+
+/*------------------------------------------------------------------------*/
+
+/** connection shared by threads */
+typedef struct
+{
+	rpc_client_t* client;
+
+	/** handle of opened modem */
+	uint16_t modem;
+} bench_conn_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef int (*bench_func_t)(bench_conn_t* conn);
+
+typedef struct
+{
+	const char* name;
+
+	bench_func_t func;
+
+	/** call needs opened modem */
+	int modem;
+
+	/** weight in mix */
+	int weight;
+} bench_op_t;
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	bench_conn_t* conn;
+
+	/** seed of random choice of call */
+	unsigned int seed;
+
+	/** interval between calls, us, zero if unlimited */
+	uint64_t period;
+
+	uint64_t stop;
+
+	pthread_t thread;
+
+	/** per call */
+	bench_stat_t* stats;
+} bench_thread_t;
+
+/*------------------------------------------------------------------------*/
+
+static char opt_sock_path[0x100];
+static char opt_modem_port[0x100];
+static char opt_at_cmd[0x100];
+static char opt_mix[0x100];
+static char opt_sim_root[0x100];
+static int opt_conns;
+static int opt_threads;
+static int opt_duration;
+static int opt_rate;
+static int opt_sim_delay;
+
+/*------------------------------------------------------------------------*/
+
+/** call function, zero if server returned a result */
+static int bench_call(bench_conn_t* conn, uint16_t modem, uint16_t opcode, const void* data, uint32_t len)
+{
+	rpc_packet_t* p;
+	int res;
+
+	p = rpc_client_call(conn->client, modem, opcode, data, len);
+	res = p && p->hdr.data_len ? 0 : -1;
+
+	rpc_free(p);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int bench_stats(bench_conn_t* conn)
+{
+	return(bench_call(conn, 0, RPC_OP_modemd_stats, NULL, 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int bench_find(bench_conn_t* conn)
+{
+	modem_find_first_next_t item;
+	modem_find_t* find;
+	rpc_packet_t* p;
+	int res;
+
+	p = rpc_client_call(conn->client, 0, RPC_OP_modem_find_first, NULL, 0);
+
+	/* search is closed by the server after the last modem */
+	while(p && p->hdr.data_len == sizeof(item))
+	{
+		memcpy(&item, p->data, sizeof(item));
+		rpc_free(p);
+
+		if(!(find = item.find))
+			return(0);
+
+		p = rpc_client_call(conn->client, 0, RPC_OP_modem_find_next, &find, sizeof(find));
+	}
+
+	res = p ? 0 : -1;
+
+	rpc_free(p);
+
+	return(res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int bench_status(bench_conn_t* conn)
+{
+	return(bench_call(conn, conn->modem, RPC_OP_modem_get_status, NULL, 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int bench_sq(bench_conn_t* conn)
+{
+	return(bench_call(conn, conn->modem, RPC_OP_modem_get_signal_quality, NULL, 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int bench_imei(bench_conn_t* conn)
+{
+	return(bench_call(conn, conn->modem, RPC_OP_modem_get_imei, NULL, 0));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int bench_at(bench_conn_t* conn)
+{
+	return(bench_call(conn, conn->modem, RPC_OP_modem_at_command, opt_at_cmd, strlen(opt_at_cmd) + 1));
+}
+
+/*------------------------------------------------------------------------*/
+
+static int bench_open(bench_conn_t* conn)
+{
+	rpc_packet_t* p;
+	uint16_t modem;
+
+	p = rpc_client_call(conn->client, 0, RPC_OP_modem_open_by_port, opt_modem_port, strlen(opt_modem_port));
+
+	if(!p || !p->hdr.data_len)
+	{
+		rpc_free(p);
+
+		return(-1);
+	}
+
+	modem = p->hdr.modem;
+	rpc_free(p);
+
+	/* legacy modem of connection is not closed */
+	if(!modem)
+		return(0);
+
+	p = rpc_client_call(conn->client, modem, RPC_OP_modem_close, NULL, 0);
+	rpc_free(p);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static bench_op_t ops[] =
+{
+	{"stats",	bench_stats,	0},
+	{"find",	bench_find,		0},
+	{"status",	bench_status,	1},
+	{"sq",		bench_sq,		1},
+	{"imei",	bench_imei,		1},
+	{"at",		bench_at,		1},
+	{"open",	bench_open,		1},
+};
+
+#define __OPS (sizeof(ops) / sizeof(*ops))
+
+/** sum of weights */
+static int ops_weight;
+
+/*------------------------------------------------------------------------*/
+
+int conf_read_cmdline(int argc, char** argv)
+{
+	int param;
+
+	/* receiving default parameters */
+	snprintf(opt_sock_path, sizeof(opt_sock_path), "/var/run/%s.ctl", MODEMD_NAME);
+	strncpy(opt_at_cmd, "AT+CSQ", sizeof(opt_at_cmd) - 1);
+	strncpy(opt_mix, "status=80,at=10,open=5,find=5", sizeof(opt_mix) - 1);
+	*opt_modem_port = 0;
+	*opt_sim_root = 0;
+	opt_conns = 4;
+	opt_threads = 1;
+	opt_duration = 10;
+	opt_rate = 0;
+	opt_sim_delay = 0;
+
+	/* analyze command line */
+	while((param = getopt(argc, argv, "hs:c:j:t:r:m:p:a:E:L:")) != -1)
+	{
+		switch(param)
+		{
+			case 's':
+				strncpy(opt_sock_path, optarg, sizeof(opt_sock_path) - 1);
+				opt_sock_path[sizeof(opt_sock_path) - 1] = 0;
+				break;
+
+			case 'c':
+				if((opt_conns = atoi(optarg)) < 1)
+					opt_conns = 1;
+				break;
+
+			case 'j':
+				if((opt_threads = atoi(optarg)) < 1)
+					opt_threads = 1;
+				break;
+
+			case 't':
+				if((opt_duration = atoi(optarg)) < 1)
+					opt_duration = 1;
+				break;
+
+			case 'r':
+				if((opt_rate = atoi(optarg)) < 0)
+					opt_rate = 0;
+				break;
+
+			case 'm':
+				strncpy(opt_mix, optarg, sizeof(opt_mix) - 1);
+				opt_mix[sizeof(opt_mix) - 1] = 0;
+				break;
+
+			case 'p':
+				strncpy(opt_modem_port, optarg, sizeof(opt_modem_port) - 1);
+				opt_modem_port[sizeof(opt_modem_port) - 1] = 0;
+				break;
+
+			case 'a':
+				strncpy(opt_at_cmd, optarg, sizeof(opt_at_cmd) - 1);
+				opt_at_cmd[sizeof(opt_at_cmd) - 1] = 0;
+				break;
+
+			case 'E':
+				strncpy(opt_sim_root, optarg, sizeof(opt_sim_root) - 1);
+				opt_sim_root[sizeof(opt_sim_root) - 1] = 0;
+				break;
+
+			case 'L':
+				if((opt_sim_delay = atoi(optarg)) < 0)
+					opt_sim_delay = 0;
+				break;
+
+			default: /* '?' */
+				puts(help);
+				return(1);
+		}
+	}
+
+	if(*opt_sim_root && !*opt_modem_port)
+		strcpy(opt_modem_port, "1-1");
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** parse mix of calls, non zero if calls need modem */
+static int mix_parse(const char* mix, int* modem)
+{
+	char s[0x100], *name, *save, *weight;
+	int i;
+
+	strncpy(s, mix, sizeof(s) - 1);
+	s[sizeof(s) - 1] = 0;
+
+	*modem = 0;
+	ops_weight = 0;
+
+	for(name = strtok_r(s, ",", &save); name; name = strtok_r(NULL, ",", &save))
+	{
+		if((weight = strchr(name, '=')))
+			*weight ++ = 0;
+
+		for(i = 0; i < __OPS && strcmp(ops[i].name, name); ++ i);
+
+		if(i == __OPS)
+		{
+			printf("(EE) Unknown call %s\n", name);
+
+			return(-1);
+		}
+
+		ops[i].weight = weight ? atoi(weight) : 1;
+		ops_weight += ops[i].weight;
+
+		if(ops[i].weight && ops[i].modem)
+			*modem = 1;
+	}
+
+	if(!ops_weight)
+	{
+		printf("(EE) Empty mix of calls\n");
+
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int hist_bucket(uint64_t us)
+{
+	int msb, res;
+
+	if(us < __HIST_SUB)
+		return(us);
+
+	msb = 63 - __builtin_clzll(us);
+
+	/* power of two and its fraction */
+	res = msb * __HIST_SUB + ((us >> (msb - 2)) & (__HIST_SUB - 1));
+
+	return(res < __HIST_BUCKETS ? res : __HIST_BUCKETS - 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** upper bound of bucket, us */
+static uint64_t hist_value(int bucket)
+{
+	int msb = bucket / __HIST_SUB;
+
+	if(bucket < __HIST_SUB)
+		return(bucket);
+
+	return(((uint64_t)(__HIST_SUB + bucket % __HIST_SUB + 1) << (msb - 2)) - 1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static uint64_t hist_percentile(const bench_stat_t* stat, double pct)
+{
+	uint64_t sum = 0, need;
+	int i;
+
+	if(!stat->count)
+		return(0);
+
+	need = stat->count * pct / 100;
+
+	for(i = 0; i < __HIST_BUCKETS; ++ i)
+	{
+		if((sum += stat->hist[i]) > need)
+			break;
+	}
+
+	/* bucket may be wider than observed maximum */
+	return(hist_value(i) < stat->max ? hist_value(i) : stat->max);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void stat_add(bench_stat_t* to, const bench_stat_t* from)
+{
+	int i;
+
+	to->count += from->count;
+	to->errors += from->errors;
+
+	for(i = 0; i < __HIST_BUCKETS; ++ i)
+		to->hist[i] += from->hist[i];
+
+	if(from->max > to->max)
+		to->max = from->max;
+}
+
+/*------------------------------------------------------------------------*/
+
+static const char* us_str(uint64_t us, char* s, int len)
+{
+	if(us < 10000)
+		snprintf(s, len, "%lluus", (unsigned long long)us);
+	else if(us < 10000000)
+		snprintf(s, len, "%llums", (unsigned long long)us / 1000);
+	else
+		snprintf(s, len, "%llus", (unsigned long long)us / 1000000);
+
+	return(s);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void* bench_thread(void* prm)
+{
+	bench_thread_t* priv = prm;
+	uint64_t next, start, end;
+	int i, w;
+
+	next = clock_us();
+
+	while((start = clock_us()) < priv->stop)
+	{
+		if(priv->period)
+		{
+			if(start < next)
+			{
+				usleep(next - start);
+
+				continue;
+			}
+
+			/* latency includes waiting for previous calls if late */
+			start = next;
+			next += priv->period;
+		}
+
+		/* weighted random choice of call */
+		w = rand_r(&priv->seed) % ops_weight;
+
+		for(i = 0; w >= ops[i].weight; w -= ops[i ++].weight);
+
+		if(ops[i].func(priv->conn))
+			++ priv->stats[i].errors;
+
+		end = clock_us() - start;
+
+		++ priv->stats[i].count;
+		++ priv->stats[i].hist[hist_bucket(end)];
+
+		if(end > priv->stats[i].max)
+			priv->stats[i].max = end;
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** wait for the end of opening of modem, zero if modem is ready */
+static int conn_wait_modem(bench_conn_t* conn)
+{
+	modem_init_state_t state = MODEM_INIT_PENDING;
+	uint32_t wait_ms = 1000;
+	rpc_packet_t* p;
+
+	while(state < MODEM_INIT_READY)
+	{
+		p = rpc_client_call(conn->client, conn->modem, RPC_OP_modem_get_init_state, &wait_ms, sizeof(wait_ms));
+
+		/* daemon without opening in background */
+		if(!p || p->hdr.data_len != sizeof(state))
+			state = MODEM_INIT_READY;
+		else
+			memcpy(&state, p->data, sizeof(state));
+
+		rpc_free(p);
+	}
+
+	if(state != MODEM_INIT_READY)
+	{
+		printf("(EE) Failed to open modem on port %s\n", opt_modem_port);
+
+		return(-1);
+	}
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** open modem on connection, zero if successful */
+static int conn_open_modem(bench_conn_t* conn)
+{
+	rpc_packet_t* p;
+
+	p = rpc_client_call(conn->client, 0, RPC_OP_modem_open_by_port, opt_modem_port, strlen(opt_modem_port));
+
+	if(!p || !p->hdr.data_len)
+	{
+		rpc_free(p);
+
+		printf("(EE) Failed to open modem on port %s\n", opt_modem_port);
+
+		return(-1);
+	}
+
+	conn->modem = p->hdr.modem;
+	rpc_free(p);
+
+	/* modem is opened by daemon in background */
+	return(conn_wait_modem(conn));
+}
+
+/*------------------------------------------------------------------------*/
+
+/** wait for registration of simulated modem */
+static void conn_wait_ready(bench_conn_t* conn)
+{
+	modem_status_t status;
+	rpc_packet_t* p;
+	int i;
+
+	for(i = 0; i < __READY_TIMEOUT * 10; ++ i)
+	{
+		p = rpc_client_call(conn->client, conn->modem, RPC_OP_modem_get_status, NULL, 0);
+
+		memset(&status, 0, sizeof(status));
+
+		if(p && p->hdr.data_len)
+			memcpy(&status, p->data, p->hdr.data_len < sizeof(status) ? p->hdr.data_len : sizeof(status));
+
+		rpc_free(p);
+
+		if(status.ready)
+		{
+			printf("Modem is registered in %.1f s\n", i / 10.0);
+
+			return;
+		}
+
+		usleep(100000);
+	}
+
+	printf("(WW) Modem is not registered, results of modem calls are errors\n");
+}
+
+/*------------------------------------------------------------------------*/
+
+static void print_stat(const char* name, const bench_stat_t* stat, double duration)
+{
+	char p50[0x10], p90[0x10], p99[0x10], p999[0x10], max[0x10];
+
+	printf("%8s %10llu %8llu %10.1f %8s %8s %8s %8s %8s\n",
+		name,
+		(unsigned long long)stat->count,
+		(unsigned long long)stat->errors,
+		stat->count / duration,
+		us_str(hist_percentile(stat, 50), p50, sizeof(p50)),
+		us_str(hist_percentile(stat, 90), p90, sizeof(p90)),
+		us_str(hist_percentile(stat, 99), p99, sizeof(p99)),
+		us_str(hist_percentile(stat, 99.9), p999, sizeof(p999)),
+		us_str(stat->max, max, sizeof(max))
+	);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void print_hist(const bench_stat_t* stat)
+{
+	uint64_t peak = 0, sum = 0;
+	char s[0x10];
+	int i, j, first, last;
+
+	for(i = 0, first = -1, last = 0; i < __HIST_BUCKETS; ++ i)
+	{
+		if(!stat->hist[i])
+			continue;
+
+		if(first < 0)
+			first = i;
+
+		last = i;
+
+		if(stat->hist[i] > peak)
+			peak = stat->hist[i];
+	}
+
+	if(first < 0)
+		return;
+
+	printf("\nLatency histogram of all calls:\n");
+
+	for(i = first; i <= last; ++ i)
+	{
+		sum += stat->hist[i];
+
+		printf("  <= %-8s %10llu %6.2f%% %6.2f%% ",
+			us_str(hist_value(i), s, sizeof(s)),
+			(unsigned long long)stat->hist[i],
+			100.0 * stat->hist[i] / stat->count,
+			100.0 * sum / stat->count);
+
+		for(j = 0; j < 40 * stat->hist[i] / peak; ++ j)
+			putchar('#');
+
+		putchar('\n');
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+int main(int argc, char** argv)
+{
+	bench_stat_t stats[__OPS], total;
+	bench_thread_t* threads = NULL;
+	bench_conn_t* conns = NULL;
+	uint64_t start, end;
+	double duration;
+	int i, j, k, modem;
+	int res = 1;
+
+	if(conf_read_cmdline(argc, argv) || mix_parse(opt_mix, &modem))
+		return(1);
+
+	if(modem && !*opt_modem_port)
+	{
+		printf("(EE) Modem port is required for mix %s\n", opt_mix);
+
+		return(1);
+	}
+
+	printf(
+		"Socket file: %s\n"
+		"Connections: %d, threads %d\n"
+		"   Duration: %d s\n"
+		"       Rate: %d\n"
+		"        Mix: %s\n"
+		"       Port: %s\n\n",
+		opt_sock_path,
+		opt_conns, opt_threads,
+		opt_duration,
+		opt_rate,
+		opt_mix,
+		opt_modem_port
+	);
+
+	if(*opt_sim_root && sim_start(opt_sim_root, opt_modem_port, opt_sim_delay))
+		return(1);
+
+	if(!(conns = calloc(opt_conns, sizeof(*conns))) ||
+		!(threads = calloc(opt_conns * opt_threads, sizeof(*threads))))
+		goto exit;
+
+	for(i = 0; i < opt_conns; ++ i)
+	{
+		if(!(conns[i].client = rpc_client_open(opt_sock_path)))
+		{
+			printf("(EE) Failed to connect to %s\n", opt_sock_path);
+
+			goto exit;
+		}
+
+		if(modem && conn_open_modem(&conns[i]))
+			goto exit;
+	}
+
+	if(modem && *opt_sim_root)
+		conn_wait_ready(&conns[0]);
+
+	start = clock_us();
+
+	for(i = 0; i < opt_conns * opt_threads; ++ i)
+	{
+		threads[i].conn = &conns[i / opt_threads];
+		threads[i].seed = i + 1;
+		threads[i].period = opt_rate ? 1000000ULL * opt_conns * opt_threads / opt_rate : 0;
+		threads[i].stop = start + opt_duration * 1000000ULL;
+
+		if(!(threads[i].stats = calloc(__OPS, sizeof(bench_stat_t))) ||
+			pthread_create(&threads[i].thread, NULL, bench_thread, &threads[i]))
+		{
+			printf("(EE) Failed to start thread\n");
+
+			threads[i].stop = 0;
+			break;
+		}
+	}
+
+	memset(stats, 0, sizeof(stats));
+	memset(&total, 0, sizeof(total));
+
+	/* collect results */
+	for(j = 0; j < i; ++ j)
+	{
+		pthread_join(threads[j].thread, NULL);
+
+		for(k = 0; k < __OPS; ++ k)
+			stat_add(&stats[k], &threads[j].stats[k]);
+	}
+
+	end = clock_us();
+	duration = (end - start) / 1000000.0;
+
+	printf("%8s %10s %8s %10s %8s %8s %8s %8s %8s\n", "call", "count", "errors", "rate/s", "p50", "p90", "p99", "p99.9", "max");
+
+	for(j = 0; j < __OPS; ++ j)
+	{
+		if(!ops[j].weight)
+			continue;
+
+		print_stat(ops[j].name, &stats[j], duration);
+		stat_add(&total, &stats[j]);
+	}
+
+	print_stat("total", &total, duration);
+	print_hist(&total);
+
+	if(*opt_sim_root)
+		printf("\nAT commands of simulated modem: %u\n", sim_commands());
+
+	res = 0;
+
+exit:
+	if(threads)
+	{
+		for(i = 0; i < opt_conns * opt_threads; ++ i)
+			free(threads[i].stats);
+
+		free(threads);
+	}
+
+	if(conns)
+	{
+		/* modems are closed by the server with connection */
+		for(i = 0; i < opt_conns; ++ i)
+			rpc_client_close(conns[i].client);
+
+		free(conns);
+	}
+
+	sim_stop();
+
+	return(res);
+}
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "sim.h"
+
+/*------------------------------------------------------------------------*/
+
+/** interface of AT commands of MC7700 */
+#define __AT_IFACE 3
+
+/** period of checks for termination, ms */
+#define __POLL_PERIOD 100
+
+/*------------------------------------------------------------------------*/
+
+typedef struct
+{
+	/** command, ending with '=' for any arguments */
+	const char* cmd;
+
+	const char* reply;
+} sim_reply_t;
+
+/*------------------------------------------------------------------------*/
+
+static const sim_reply_t replies[] =
+{
+	{"AT",					"\r\nOK\r\n"},
+	{"ATE0",				"\r\nOK\r\n"},
+	{"AT+CMEE=",			"\r\nOK\r\n"},
+	{"AT+CGMR",				"\r\nSWI9200X_03.05.10.02AP R4684 CARMD-EN-10527 2012/02/25 11:58:38\r\n\r\nOK\r\n"},
+	{"AT+CGSN",				"\r\n358178040000001\r\n\r\nOK\r\n"},
+	{"AT+CIMI",				"\r\n250990000000001\r\n\r\nOK\r\n"},
+	{"AT+CPIN?",			"\r\n+CPIN: READY\r\n\r\nOK\r\n"},
+	{"AT+CRSM=",			"\r\n+CRSM: 144,0,\"98109909000000000001\"\r\n\r\nOK\r\n"},
+	{"AT!BAND?",			"\r\nIndex, Name\r\n00, All bands\r\n\r\nOK\r\n"},
+	{"AT+CREG?",			"\r\n+CREG: 0,1\r\n\r\nOK\r\n"},
+	{"AT+CEREG?",			"\r\n+CEREG: 0,1\r\n\r\nOK\r\n"},
+	{"AT+CSQ",				"\r\n+CSQ: 20,99\r\n\r\nOK\r\n"},
+	{"AT*CNTI=0",			"\r\n*CNTI: 0,LTE\r\n\r\nOK\r\n"},
+	{"AT+COPS=",			"\r\nOK\r\n"},
+	{"AT!SCACT?",			"\r\n!SCACT: 3,0\r\n\r\nOK\r\n"},
+	{"AT!SCACT=",			"\r\nOK\r\n"},
+	{"AT$QCPDPP=",			"\r\nOK\r\n"},
+	{"AT+CGDCONT=",			"\r\nOK\r\n"},
+};
+
+/*------------------------------------------------------------------------*/
+
+static pthread_t thread;
+
+static int running = 0;
+
+static int terminate;
+
+/** pty master */
+static int fd_master = -1;
+
+/** slave is kept open, so master is not hung up when daemon closes it */
+static int fd_slave = -1;
+
+/** reply delay, ms */
+static int reply_delay;
+
+/** format of operator in AT+COPS? reply set by AT+COPS=3,N */
+static int cops_format;
+
+static uint32_t commands;
+
+/*------------------------------------------------------------------------*/
+
+static int sim_mkdir(const char* path)
+{
+	char s[0x100], *p;
+
+	strncpy(s, path, sizeof(s) - 1);
+	s[sizeof(s) - 1] = 0;
+
+	/* create all parents */
+	for(p = s + 1; *p; ++ p)
+	{
+		if(*p != '/')
+			continue;
+
+		*p = 0;
+
+		if(mkdir(s, 0755) && errno != EEXIST)
+			return(-1);
+
+		*p = '/';
+	}
+
+	if(mkdir(s, 0755) && errno != EEXIST)
+		return(-1);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_write_file(const char* path, const char* s, int replace)
+{
+	FILE* f;
+
+	if(!replace && !access(path, F_OK))
+		return(0);
+
+	if(!(f = fopen(path, "w")))
+		return(-1);
+
+	fputs(s, f);
+	fclose(f);
+
+	return(0);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int sim_tree(const char* root, const char* port, const char* tty)
+{
+	char path[0x100], dev[0x100];
+
+	/* USB device */
+	snprintf(dev, sizeof(dev), "%s/sys/bus/usb/devices/%s", root, port);
+
+	if(sim_mkdir(dev))
+		goto err;
+
+	snprintf(path, sizeof(path), "%s/idVendor", dev);
+	sim_write_file(path, "1199\n", 1);
+
+	snprintf(path, sizeof(path), "%s/idProduct", dev);
+	sim_write_file(path, "68a3\n", 1);
+
+	snprintf(path, sizeof(path), "%s/manufacturer", dev);
+	sim_write_file(path, "Sierra Wireless, Incorporated\n", 1);
+
+	snprintf(path, sizeof(path), "%s/product", dev);
+	sim_write_file(path, "MC7700\n", 1);
+
+	/* tty of AT interface */
+	snprintf(path, sizeof(path), "%s/sys/bus/usb/devices/%s:1.%d/ttyUSB%d", root, port, __AT_IFACE, __AT_IFACE);
+
+	if(sim_mkdir(path))
+		goto err;
+
+	snprintf(path, sizeof(path), "%s/dev", root);
+
+	if(sim_mkdir(path))
+		goto err;
+
+	snprintf(path, sizeof(path), "%s/dev/ttyUSB%d", root, __AT_IFACE);
+	unlink(path);
+
+	if(symlink(tty, path))
+		goto err;
+
+	/* configuration is not replaced, user may change it */
+	snprintf(path, sizeof(path), "%s/etc/modemd/%s", root, port);
+
+	if(sim_mkdir(path))
+		goto err;
+
+	snprintf(path, sizeof(path), "%s/etc/modemd/%s/conf", root, port);
+	sim_write_file(path, "apn=internet\nroaming_enable=yes\n", 0);
+
+	return(0);
+
+err:
+	printf("(EE) Failed to create fake sysfs tree in %s\n", root);
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+static const char* sim_reply(const char* cmd)
+{
+	static char s[0x100];
+	size_t len;
+	int i;
+
+	/* operator depends on format selected before */
+	if(!strcmp(cmd, "AT+COPS?"))
+	{
+		snprintf(s, sizeof(s), "\r\n+COPS: 0,%d,\"%s\",7\r\n\r\nOK\r\n", cops_format, cops_format == 2 ? "25099" : "Simulator");
+
+		return(s);
+	}
+
+	if(!strncmp(cmd, "AT+COPS=3,", 10))
+		cops_format = atoi(cmd + 10);
+
+	for(i = 0; i < sizeof(replies) / sizeof(*replies); ++ i)
+	{
+		len = strlen(replies[i].cmd);
+
+		if(replies[i].cmd[len - 1] == '=' ? !strncmp(cmd, replies[i].cmd, len) : !strcmp(cmd, replies[i].cmd))
+			return(replies[i].reply);
+	}
+
+	return("\r\nERROR\r\n");
+}
+
+/*------------------------------------------------------------------------*/
+
+static void* sim_thread(void* prm)
+{
+	char buf[0x400], cmd[0x100];
+	const char* reply;
+	struct pollfd p;
+	int cmd_len = 0;
+	int i, len;
+
+	while(!terminate)
+	{
+		p.fd = fd_master;
+		p.events = POLLIN;
+		p.revents = 0;
+
+		if(poll(&p, 1, __POLL_PERIOD) <= 0 || !(p.revents & POLLIN))
+			continue;
+
+		if((len = read(fd_master, buf, sizeof(buf))) <= 0)
+			continue;
+
+		for(i = 0; i < len; ++ i)
+		{
+			if(buf[i] != '\r' && buf[i] != '\n')
+			{
+				if(cmd_len < sizeof(cmd) - 1)
+					cmd[cmd_len ++] = buf[i];
+
+				continue;
+			}
+
+			if(!cmd_len)
+				continue;
+
+			cmd[cmd_len] = 0;
+			cmd_len = 0;
+
+			reply = sim_reply(cmd);
+
+			if(reply_delay)
+				usleep(reply_delay * 1000);
+
+			if(write(fd_master, reply, strlen(reply)) < 0)
+				printf("(WW) Simulator failed to reply to %s\n", cmd);
+
+			__atomic_add_fetch(&commands, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	return(NULL);
+}
+
+/*------------------------------------------------------------------------*/
+
+int sim_start(const char* root, const char* port, int delay)
+{
+	char* tty;
+
+	if((fd_master = posix_openpt(O_RDWR | O_NOCTTY)) < 0)
+		goto err;
+
+	if(grantpt(fd_master) || unlockpt(fd_master) || !(tty = ptsname(fd_master)))
+		goto err_pt;
+
+	if((fd_slave = open(tty, O_RDWR | O_NOCTTY)) < 0)
+		goto err_pt;
+
+	if(sim_tree(root, port, tty))
+		goto err_tree;
+
+	reply_delay = delay;
+	cops_format = 0;
+	commands = 0;
+	terminate = 0;
+
+	if(pthread_create(&thread, NULL, sim_thread, NULL))
+		goto err_tree;
+
+	running = 1;
+
+	printf("Simulated modem on port %s, tty %s, root %s\n", port, tty, root);
+
+	return(0);
+
+err_tree:
+	close(fd_slave);
+
+err_pt:
+	close(fd_master);
+
+err:
+	printf("(EE) Failed to start simulator\n");
+
+	return(-1);
+}
+
+/*------------------------------------------------------------------------*/
+
+void sim_stop(void)
+{
+	void* thread_res;
+
+	if(!running)
+		return;
+
+	terminate = 1;
+	pthread_join(thread, &thread_res);
+
+	running = 0;
+
+	close(fd_slave);
+	close(fd_master);
+}
+
+/*------------------------------------------------------------------------*/
+
+uint32_t sim_commands(void)
+{
+	return(__atomic_load_n(&commands, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,34 @@
+#ifndef __SIM_H
+#define __SIM_H
+
+#include <stdint.h>
+
+/***************************************************************************
+
+	Simulator of Sierra Wireless MC7700 modem on pseudo terminal.
+
+	Fake sysfs tree with USB device, tty of AT interface and configuration
+	of modem is created in a root directory, so modemd started with the
+	same root (option -r) finds and registers the modem on any machine.
+
+***************************************************************************/
+
+/**
+ * @brief create fake sysfs tree and start answering AT commands
+ * @param root directory of tree, created if missing
+ * @param port USB port of simulated modem, for example 1-1
+ * @param delay delay of every reply, ms
+ * @return zero if successful
+ */
+int sim_start(const char* root, const char* port, int delay);
+
+/** stop simulator, tree is left for the next run */
+void sim_stop(void);
+
+/**
+ * @brief number of answered AT commands
+ * @return commands since start
+ */
+uint32_t sim_commands(void);
+
+#endif /* __SIM_H */
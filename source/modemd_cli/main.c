@@ -26,7 +26,8 @@ const char help[] =
 	MODEMD_CLI_NAME " [-s SOCKET] -u USSD -d\n"
 	MODEMD_CLI_NAME " [-s SOCKET] -u USSD -p PORT\n\n"
 	MODEMD_CLI_NAME " [-s SOCKET] -c COMMAND -d\n"
-	MODEMD_CLI_NAME " [-s SOCKET] -c COMMAND -p PORT\n\n"
+	MODEMD_CLI_NAME " [-s SOCKET] -c COMMAND -p PORT\n"
+	MODEMD_CLI_NAME " [-s SOCKET] -S\n\n"
 	"Keys:\n"
 	"-h - show this help\n"
 	"-s - file socket path (default: /var/run/" MODEMD_NAME ".ctl)\n"
@@ -34,7 +35,8 @@ const char help[] =
 	"-p - modem port, for example 1-1\n"
 	"-u - execute USSD command\n"
 	"-c - execute AT command\n"
-	"-t - perform a standard sequence of commands on modem\n\n"
+	"-t - perform a standard sequence of commands on modem\n"
+	"-S - show statistics of daemon\n\n"
 	"Examples:\n"
 	MODEMD_CLI_NAME " -d -c ATI                             - show AT information\n"
 	MODEMD_CLI_NAME " -d -c 'AT+CGDCONT=1,\"IP\",\"apn.com\"'   - set apn\n"
@@ -49,6 +51,7 @@ static char opt_modem_cmd[0x100];
 static char opt_modem_ussd[0x100];
 static int opt_detect_modems;
 static int opt_modems_test;
+static int opt_stats;
 
 /*------------------------------------------------------------------------*/
 
@@ -63,9 +66,10 @@ int conf_read_cmdline(int argc, char** argv)
 	*opt_modem_ussd = 0;
 	opt_detect_modems = 0;
 	opt_modems_test = 0;
+	opt_stats = 0;
 
 	/* analyze command line */
-	while((param = getopt(argc, argv, "hs:dp:c:tu:")) != -1)
+	while((param = getopt(argc, argv, "hs:dp:c:tu:S")) != -1)
 	{
 		switch(param)
 		{
@@ -97,6 +101,10 @@ int conf_read_cmdline(int argc, char** argv)
 				opt_modem_ussd[sizeof(opt_modem_ussd) - 1] = 0;
 				break;
 
+			case 'S':
+				opt_stats = 1;
+				break;
+
 			default: /* '?' */
 				puts(help);
 				return(1);
@@ -104,7 +112,7 @@ int conf_read_cmdline(int argc, char** argv)
 	}
 
 	/* check input paramets ... */
-	if(!*opt_modem_port && !opt_detect_modems)
+	if(!*opt_modem_port && !opt_detect_modems && !opt_stats)
 	{
 		puts(help);
 		return(1);
@@ -147,13 +155,201 @@ const char* modem_signal_level_str(uint8_t level)
 
 /*------------------------------------------------------------------------*/
 
-void modem_test(const char* port)
+const char* modem_status_age_str(const modem_status_t* status, modem_status_field_t field, char* s, int len)
+{
+	uint32_t age = status->age[field];
+
+	if(age == MODEM_STATUS_AGE_NONE)
+		*s = 0;
+	else
+		snprintf(s, len, ", %u.%u s ago", age / 1000, age % 1000 / 100);
+
+	return(s);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modem_status(const modem_status_t* status)
+{
+	const struct tm* tm;
+	char msg[0x100];
+	char age[0x20];
+	time_t t;
+
+#define __AGE(field) modem_status_age_str(status, MODEM_STATUS_##field, age, sizeof(age))
+
+	if(*status->imei)
+		printf("        IMEI: [%s]%s\n", status->imei, __AGE(IMEI));
+
+	if(*status->imsi)
+		printf("        IMSI: [%s]%s\n", status->imsi, __AGE(IMSI));
+
+	if(*status->ccid)
+		printf("        CCID: [%s]%s\n", status->ccid, __AGE(CCID));
+
+	if(status->ready)
+	{
+		if(*status->oper)
+			printf("    Operator: [%s]%s\n", status->oper, __AGE(OPER));
+
+		printf("     Network: [%s]%s\n", status->network_type, __AGE(NETWORK_TYPE));
+
+		printf("      Signal: [%d] dBm, [%-5s] Level%s\n",
+			status->sq.dbm, modem_signal_level_str(status->sq.level), __AGE(SQ));
+	}
+
+	printf("Registration: [%s]%s\n", str_network_registration(status->reg), __AGE(REG));
+
+	if(status->fw_release)
+	{
+		t = status->fw_release;
+		tm = gmtime(&t);
+		strftime(msg, sizeof(msg), "%Y.%m.%d %H:%M:%S", tm);
+		printf("    Firmware: [%s], Release: [%s]%s\n", status->firmware, msg, __AGE(FW_INFO));
+	}
+
+#undef __AGE
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modem_info(modem_t* modem)
 {
 	modem_signal_quality_t sq;
 	modem_fw_ver_t fw_info;
 	const struct tm* tm;
-	usb_device_info_t mi;
 	char msg[0x100];
+	time_t t;
+
+	if(modem_get_imei(modem, msg, sizeof(msg)))
+		printf("        IMEI: [%s]\n", msg);
+
+	if(modem_get_imsi(modem, msg, sizeof(msg)))
+		printf("        IMSI: [%s]\n", msg);
+
+	if(modem_get_operator_name(modem, msg, sizeof(msg)))
+		printf("    Operator: [%s]\n", msg);
+
+	if(modem_get_network_type(modem, msg, sizeof(msg)))
+		printf("     Network: [%s]\n", msg);
+
+	if(!modem_get_signal_quality(modem, &sq))
+		printf("      Signal: [%d] dBm, [%-5s] Level\n", sq.dbm, modem_signal_level_str(sq.level));
+
+	printf("Registration: [%s]\n", str_network_registration(modem_network_registration(modem)));
+
+	if(modem_get_fw_version(modem, &fw_info))
+	{
+		t = fw_info.release;
+		tm = gmtime(&t);
+		strftime(msg, sizeof(msg), "%Y.%m.%d %H:%M:%S", tm);
+		printf("    Firmware: [%s], Release: [%s]\n", fw_info.firmware, msg);
+	}
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modem_reg_stats(modem_t* modem)
+{
+	modem_reg_state_stats_t* stats;
+	int i, n;
+
+	if((n = modem_get_reg_stats(modem, &stats)) < 0)
+		return;
+
+	printf("\n%24s %10s %12s %12s\n", "State", "Entries", "Time, ms", "Max, ms");
+
+	for(i = 0; i < n; ++ i)
+		printf("%24s %10u %12llu %12u%s\n", stats[i].name, stats[i].entries,
+			(unsigned long long)stats[i].dwell_ms, stats[i].dwell_max_ms, stats[i].current ? " *" : "");
+
+	free(stats);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modem_poll_stats(modem_t* modem)
+{
+	modem_poll_stats_t* stats;
+	int i, n;
+
+	if((n = modem_get_poll_stats(modem, &stats)) < 0)
+		return;
+
+	printf("\n%24s %12s %10s %10s %10s\n", "Value", "Interval, ms", "Commands", "Saved", "Saved/h");
+
+	for(i = 0; i < n; ++ i)
+		printf("%24s %12u %10u %10u %10u%s\n", stats[i].name, stats[i].interval_ms, stats[i].commands,
+			stats[i].saved, stats[i].saved_per_hour, stats[i].observed ? " *" : "");
+
+	free(stats);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modem_reg_timeline(modem_t* modem)
+{
+	modem_reg_timeline_t* timeline;
+	int i, n;
+
+	if((n = modem_get_reg_timeline(modem, &timeline)) < 0)
+		return;
+
+	for(i = 0; i < n; ++ i)
+	{
+		if(i == 0 || timeline[i].cycle != timeline[i - 1].cycle)
+			printf("\n%24s %-6u %12s %10s\n", "Cycle", timeline[i].cycle, "Offset, ms", "Retries");
+
+		printf("%24s %-6s %12u %10u\n", timeline[i].name, "", timeline[i].offset_ms, timeline[i].retries);
+	}
+
+	free(timeline);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modem_reg_retries(modem_t* modem)
+{
+	modem_reg_retry_t* trace;
+	int i, n;
+
+	if((n = modem_get_reg_retries(modem, &trace)) < 0)
+		return;
+
+	printf("\n%24s %8s %8s %10s %-8s\n", "Retry", "Error", "Attempt", "Delay, ms", "Rule");
+
+	for(i = 0; i < n; ++ i)
+		printf("%24s %8d %8u %10u %-8s\n", trace[i].name, trace[i].error, trace[i].attempt, trace[i].delay_ms, trace[i].rule);
+
+	free(trace);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modem_watchdog_stats(modem_t* modem)
+{
+	modem_watchdog_stats_t* stats;
+	int i, n;
+
+	if((n = modem_get_watchdog_stats(modem, &stats)) < 0)
+		return;
+
+	printf("\n%24s %10s %10s %12s %12s\n", "Watchdog", "Runs", "Failures", "Time, ms", "Max, ms");
+
+	for(i = 0; i < n; ++ i)
+		printf("%24s %10u %10u %12llu %12u%s\n", stats[i].name, stats[i].runs, stats[i].failures,
+			(unsigned long long)stats[i].time_ms, stats[i].time_max_ms, stats[i].current ? " *" : "");
+
+	free(stats);
+}
+
+/*------------------------------------------------------------------------*/
+
+void modem_test(const char* port)
+{
+	modem_status_t status;
+	const struct tm* tm;
+	usb_device_info_t mi;
 	modem_t* modem;
 	int cell_id;
 	time_t t;
@@ -179,40 +375,27 @@ void modem_test(const char* port)
 
 	/* show modem info */
 
-	if(modem_get_imei(modem, msg, sizeof(msg)))
-		printf("        IMEI: [%s]\n", msg);
-
-	if(modem_get_imsi(modem, msg, sizeof(msg)))
-		printf("        IMSI: [%s]\n", msg);
-
-	if(modem_get_operator_name(modem, msg, sizeof(msg)))
-		printf("    Operator: [%s]\n", msg);
-
-	if(modem_get_network_type(modem, msg, sizeof(msg)))
-		printf("     Network: [%s]\n", msg);
-
-	if(!modem_get_signal_quality(modem, &sq))
-		printf("      Signal: [%d] dBm, [%-5s] Level\n", sq.dbm, modem_signal_level_str(sq.level));
+	if(modem_get_status(modem, &status))
+		print_modem_status(&status);
+	else
+		/* daemon without status snapshot */
+		print_modem_info(modem);
 
 	if((t = modem_get_network_time(modem)))
 	{
 		tm = gmtime(&t);
-		strftime(msg, sizeof(msg), "%Y.%m.%d %H:%M:%S", tm);
 		printf("  Modem time: %s", asctime(tm));
 	}
 
-	printf("Registration: [%s]\n", str_network_registration(modem_network_registration(modem)));
-
-	if(modem_get_fw_version(modem, &fw_info))
-	{
-		tm = gmtime(&fw_info.release);
-		strftime(msg, sizeof(msg), "%Y.%m.%d %H:%M:%S", tm);
-		printf("    Firmware: [%s], Release: [%s]\n", fw_info.firmware, msg);
-	}
-
 	if((cell_id = modem_get_cell_id(modem)))
 		printf("     Cell ID: [%d]\n", cell_id);
 
+	print_modem_reg_stats(modem);
+	print_modem_poll_stats(modem);
+	print_modem_reg_timeline(modem);
+	print_modem_reg_retries(modem);
+	print_modem_watchdog_stats(modem);
+
 #if _DEV_EDITION /* for testing purpose */
 	const char wait_bar[] = "|/-\\";
 	int nbar = 0;
@@ -308,6 +491,125 @@ void print_modem_ussd_cmd(const char* port, const char* cmd)
 
 /*------------------------------------------------------------------------*/
 
+void print_modemd_pool_stats(const char* name, const modemd_pool_stats_t* pool)
+{
+	printf("%13s: threads %u, busy %u, queued %u (max %u), done %llu, rejected %llu\n",
+		name, pool->threads, pool->busy, pool->queued, pool->queued_max,
+		(unsigned long long)pool->done, (unsigned long long)pool->rejected);
+}
+
+/*------------------------------------------------------------------------*/
+
+/** upper bound of histogram bucket with percentile, in microseconds */
+unsigned long long modemd_func_percentile(const modemd_func_time_t* t, int percent)
+{
+	uint64_t n = 0;
+	int i;
+
+	for(i = 0; i < MODEMD_FUNC_HIST - 1; ++ i)
+	{
+		n += t->hist[i];
+
+		if(n * 100 >= t->calls * percent)
+			break;
+	}
+
+	/* bucket is limited by maximum too */
+	return(i < MODEMD_FUNC_HIST - 1 && (1ULL << i) < t->time_max_us ? 1ULL << i : t->time_max_us);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modemd_func_time(const char* name, const char* result, const modemd_func_time_t* t)
+{
+	if(!t->calls)
+		return;
+
+	printf("%32s %6s %10llu %10llu %10llu %10llu %10u\n", name, result,
+		(unsigned long long)t->calls, (unsigned long long)(t->time_us / t->calls),
+		modemd_func_percentile(t, 50), modemd_func_percentile(t, 99), t->time_max_us);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modemd_func_stats(void)
+{
+	modemd_func_stats_t* stats;
+	int i, n;
+
+	if((n = modemd_func_stats(&stats)) < 0)
+	{
+		puts("(EE) Failed to receive statistics of functions");
+		return;
+	}
+
+	printf("\n%32s %6s %10s %10s %10s %10s %10s\n", "Function", "Result", "Calls", "Avg, us", "p50, us", "p99, us", "Max, us");
+
+	for(i = 0; i < n; ++ i)
+	{
+		print_modemd_func_time(stats[i].name, "ok", &stats[i].ok);
+		print_modemd_func_time(stats[i].name, "NULL", &stats[i].null);
+	}
+
+	free(stats);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modemd_sched_stats(void)
+{
+	modemd_sched_stats_t* stats;
+	char next[0x20];
+	int i, n;
+
+	if((n = modemd_sched_stats(&stats)) < 0)
+	{
+		puts("(EE) Failed to receive statistics of scheduler");
+		return;
+	}
+
+	printf("\n%16s %13s %10s %10s %10s %10s %10s %10s\n", "Port", "Timer", "Next, ms", "Runs", "Late, us", "Avg, us", "Max, us", "Run max");
+
+	for(i = 0; i < n; ++ i)
+	{
+		if(stats[i].next_ms == INT64_MAX)
+			snprintf(next, sizeof(next), "-");
+		else
+			snprintf(next, sizeof(next), "%lld", (long long)stats[i].next_ms);
+
+		printf("%16s %13s %10s %10llu %10u %10u %10u %10u\n", stats[i].port, stats[i].name, next,
+			(unsigned long long)stats[i].runs, stats[i].late_last_us, stats[i].late_avg_us,
+			stats[i].late_max_us, stats[i].run_max_us);
+	}
+
+	free(stats);
+}
+
+/*------------------------------------------------------------------------*/
+
+void print_modemd_stats(void)
+{
+	modemd_stats_t stats;
+
+	if(modemd_stats(&stats))
+	{
+		puts("(EE) Failed to receive statistics");
+		return;
+	}
+
+	printf("\n  Connections: %u (max %u), accepted %llu\n",
+		stats.connections, stats.connections_max, (unsigned long long)stats.accepted);
+
+	print_modemd_pool_stats("Pool", &stats.pool);
+	print_modemd_pool_stats("Slow pool", &stats.pool_slow);
+
+	print_modemd_func_stats();
+
+	print_modemd_sched_stats();
+}
+
+/*------------------------------------------------------------------------*/
+
 void modem_do(const char* port)
 {
 	if(opt_modems_test)
@@ -370,6 +672,9 @@ int main(int argc, char** argv)
 	else if(*opt_modem_port)
 		modem_do(opt_modem_port);
 
+	if(opt_stats)
+		print_modemd_stats();
+
 	modem_cleanup();
 
 exit: